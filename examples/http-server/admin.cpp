@@ -0,0 +1,330 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <QCoreApplication>
+#include <QPair>
+#include <QUrl>
+
+#include "QDjangoHttpController.h"
+#include "QDjangoHttpRequest.h"
+#include "QDjangoHttpResponse.h"
+#include "QDjangoTemplateEngine.h"
+#include "QDjangoUrlResolver.h"
+
+#include "admin.h"
+
+typedef QPair<QString, QString> QueryItem;
+
+static const struct {
+    const char *suffix;
+    QDjangoWhere::Operation operation;
+} lookups[] = {
+    { "", QDjangoWhere::Equals },
+    { "__exact", QDjangoWhere::Equals },
+    { "__iexact", QDjangoWhere::IEquals },
+    { "__contains", QDjangoWhere::Contains },
+    { "__icontains", QDjangoWhere::IContains },
+    { "__startswith", QDjangoWhere::StartsWith },
+    { "__istartswith", QDjangoWhere::IStartsWith },
+    { "__endswith", QDjangoWhere::EndsWith },
+    { "__iendswith", QDjangoWhere::IEndsWith },
+    { "__gt", QDjangoWhere::GreaterThan },
+    { "__gte", QDjangoWhere::GreaterOrEquals },
+    { "__lt", QDjangoWhere::LessThan },
+    { "__lte", QDjangoWhere::LessOrEquals },
+    { 0, QDjangoWhere::Equals }
+};
+
+static QString displayName(const QByteArray &key)
+{
+    return QString::fromLatin1(key).replace("__", " ").replace("_", " ");
+}
+
+static QString queryString(const QList<QueryItem> &items)
+{
+    QString query;
+    foreach (const QueryItem &item, items) {
+        query += query.isEmpty() ? QLatin1Char('?') : QLatin1Char('&');
+        query += QString::fromLatin1(QUrl::toPercentEncoding(item.first));
+        query += QLatin1Char('=');
+        query += QString::fromLatin1(QUrl::toPercentEncoding(item.second));
+    }
+    return query.isEmpty() ? QString("?") : query;
+}
+
+QDjangoHttpResponse *renderToResponse(const QDjangoHttpRequest &request, const QString &name, const QVariantMap &context)
+{
+    Q_UNUSED(request);
+    static QDjangoTemplateEngine *engine = 0;
+    if (!engine) {
+        engine = new QDjangoTemplateEngine(qApp);
+        engine->setSearchPaths(QStringList() << ":/templates");
+    }
+
+    QDjangoHttpResponse *response = new QDjangoHttpResponse;
+    response->setHeader("Content-Type", "text/html; charset=utf-8");
+    response->setBody(engine->render(name, context));
+    return response;
+}
+
+class ModelAdminPrivate
+{
+public:
+    QDjangoHttpResponse* redirectHome(const QDjangoHttpRequest &request)
+    {
+        return QDjangoHttpController::serveRedirect(request, QUrl("/" + modelFetcher->modelName() + "/"));
+    }
+
+    QList<QByteArray> changeFields;
+    QList<QByteArray> listFields;
+    int listPerPage;
+    ModelAdminFetcher *modelFetcher;
+    QDjangoUrlResolver *urlResolver;
+};
+
+ModelAdmin::ModelAdmin(ModelAdminFetcher *fetcher, QObject *parent)
+    : QObject(parent)
+{
+    d = new ModelAdminPrivate;
+    d->listPerPage = 100;
+    d->modelFetcher = fetcher;
+    d->urlResolver = new QDjangoUrlResolver(this);
+    d->urlResolver->set(QRegExp("^$"), this, "changeList");
+    d->urlResolver->set(QRegExp("^add/$"), this, "addForm");
+    d->urlResolver->set(QRegExp("^([0-9]+)/"), this, "changeForm");
+    d->urlResolver->set(QRegExp("^([0-9]+)/delete/"), this, "deleteForm");
+}
+
+ModelAdmin::~ModelAdmin()
+{
+    delete d->modelFetcher;
+    delete d;
+}
+
+QList<QByteArray> ModelAdmin::changeFields() const
+{
+    return d->changeFields;
+}
+
+void ModelAdmin::setChangeFields(const QList<QByteArray> fields)
+{
+    d->changeFields = fields;
+}
+
+QList<QByteArray> ModelAdmin::listFields() const
+{
+    return d->listFields;
+}
+
+void ModelAdmin::setListFields(const QList<QByteArray> fields)
+{
+    d->listFields = fields;
+}
+
+int ModelAdmin::listPerPage() const
+{
+    return d->listPerPage;
+}
+
+void ModelAdmin::setListPerPage(int listPerPage)
+{
+    d->listPerPage = qMax(1, listPerPage);
+}
+
+QDjangoHttpResponse* ModelAdmin::addForm(const QDjangoHttpRequest &request)
+{
+    const QString modelName = d->modelFetcher->modelName();
+
+    // collect fields
+    QVariantList fieldList;
+    foreach (const QByteArray &key, d->changeFields) {
+        QVariantMap props;
+        props.insert("key", key);
+        props.insert("name", displayName(key));
+        fieldList << props;
+    }
+
+    if (request.method() == "POST") {
+        QDjangoModel *obj = d->modelFetcher->createObject();
+        foreach (const QByteArray &key, d->changeFields)
+            obj->setProperty(key, request.post(key));
+        obj->save();
+        delete obj;
+        return d->redirectHome(request);
+    } else {
+        QVariantMap context;
+        context.insert("model_name", modelName);
+        context.insert("field_list", fieldList);
+        context.insert("title", QString("Add %1").arg(modelName));
+        return renderToResponse(request, "change_form.html", context);
+    }
+}
+
+QDjangoHttpResponse* ModelAdmin::changeForm(const QDjangoHttpRequest &request, const QString &objectId)
+{
+    QDjangoModel *original = d->modelFetcher->getObject(objectId);
+    if (!original)
+        return QDjangoHttpController::serveNotFound(request);
+
+    // collect fields
+    QVariantList fieldList;
+    foreach (const QByteArray &key, d->changeFields) {
+        QVariantMap props;
+        props.insert("key", key);
+        props.insert("name", displayName(key));
+        props.insert("value", original->property(key));
+        fieldList << props;
+    }
+
+    QDjangoHttpResponse *response;
+    if (request.method() == "POST") {
+        foreach (const QByteArray &key, d->changeFields)
+            original->setProperty(key, request.post(key));
+        original->save();
+        response = d->redirectHome(request);
+    } else {
+        const QString modelName = d->modelFetcher->modelName();
+        QVariantMap context;
+        context.insert("model_name", modelName);
+        context.insert("field_list", fieldList);
+        context.insert("original", d->modelFetcher->dumpObject(original));
+        context.insert("title", QString("Change %1").arg(modelName));
+        response = renderToResponse(request, "change_form.html", context);
+    }
+    delete original;
+    return response;
+}
+
+QDjangoHttpResponse* ModelAdmin::changeList(const QDjangoHttpRequest &request)
+{
+    // filter on the list fields, e.g. ?username__startswith=foo
+    QDjangoWhere where;
+    QList<QueryItem> filterItems;
+    foreach (const QByteArray &key, d->listFields) {
+        for (int i = 0; lookups[i].suffix; ++i) {
+            const QString param = QString::fromLatin1(key) + QLatin1String(lookups[i].suffix);
+            const QString value = request.get(param);
+            if (value.isEmpty())
+                continue;
+            where = where && QDjangoWhere(QString::fromLatin1(key), lookups[i].operation, value);
+            filterItems << qMakePair(param, value);
+        }
+    }
+
+    // order on a list field, e.g. ?o=-username
+    QString ordering = request.get("o");
+    const QString orderKey = ordering.startsWith(QLatin1Char('-')) ? ordering.mid(1) : ordering;
+    if (!d->listFields.contains(orderKey.toLatin1()))
+        ordering.clear();
+    QList<QueryItem> orderItems(filterItems);
+    if (!ordering.isEmpty())
+        orderItems << qMakePair(QString("o"), ordering);
+
+    // count the matching objects once, then clamp the page number
+    const int count = d->modelFetcher->countObjects(where);
+    const int pageCount = qMax(1, (count + d->listPerPage - 1) / d->listPerPage);
+    const int page = qBound(0, request.get("p").toInt(), pageCount - 1);
+
+    // only fetch the primary key and the list fields for the current page
+    QStringList fields;
+    fields << "pk";
+    foreach (const QByteArray &key, d->listFields)
+        fields << QString::fromLatin1(key);
+    QStringList orderBy;
+    if (!ordering.isEmpty())
+        orderBy << ordering;
+    orderBy << "pk";
+
+    QVariantList objectList;
+    if (count) {
+        const QList<QVariantList> rows = d->modelFetcher->listObjects(where, orderBy, fields, page * d->listPerPage, d->listPerPage);
+        foreach (const QVariantList &row, rows) {
+            QVariantMap object;
+            object.insert("pk", row.value(0));
+            object.insert("value_list", row.mid(1));
+            objectList << object;
+        }
+    }
+
+    QVariantList fieldList;
+    foreach (const QByteArray &key, d->listFields) {
+        const QString name = QString::fromLatin1(key);
+        QList<QueryItem> items(filterItems);
+        items << qMakePair(QString("o"), QString(ordering == name ? "-" : "") + name);
+
+        QVariantMap props;
+        props.insert("key", key);
+        props.insert("name", displayName(key));
+        props.insert("order_url", queryString(items));
+        if (ordering == name)
+            props.insert("sorted", "asc");
+        else if (orderKey == name)
+            props.insert("sorted", "desc");
+        fieldList << props;
+    }
+
+    const QString modelName = d->modelFetcher->modelName();
+    QVariantMap context;
+    context.insert("title", QString("Select %1 to change").arg(modelName));
+    context.insert("add_link", QString("Add %1").arg(modelName));
+    context.insert("edit_link", QString("Edit"));
+    context.insert("delete_link", QString("Remove"));
+    context.insert("model_name", modelName);
+    context.insert("field_list", fieldList);
+    context.insert("object_list", objectList);
+    context.insert("count", count);
+    context.insert("page", page + 1);
+    context.insert("page_count", pageCount);
+    if (page > 0) {
+        QList<QueryItem> items(orderItems);
+        items << qMakePair(QString("p"), QString::number(page - 1));
+        context.insert("previous_url", queryString(items));
+    }
+    if (page < pageCount - 1) {
+        QList<QueryItem> items(orderItems);
+        items << qMakePair(QString("p"), QString::number(page + 1));
+        context.insert("next_url", queryString(items));
+    }
+    return renderToResponse(request, "change_list.html", context);
+}
+
+QDjangoHttpResponse* ModelAdmin::deleteForm(const QDjangoHttpRequest &request, const QString &objectId)
+{
+    QDjangoModel *original = d->modelFetcher->getObject(objectId);
+    if (!original)
+        return QDjangoHttpController::serveNotFound(request);
+
+    QDjangoHttpResponse *response;
+    if (request.method() == "POST") {
+        original->remove();
+        response = d->redirectHome(request);
+    } else {
+        const QString modelName = d->modelFetcher->modelName();
+        QVariantMap context;
+        context.insert("model_name", modelName);
+        context.insert("original", d->modelFetcher->dumpObject(original));
+        context.insert("title", "Are you sure?");
+        response = renderToResponse(request, "delete_confirmation.html", context);
+    }
+    delete original;
+    return response;
+}
+
+QDjangoUrlResolver *ModelAdmin::urls() const
+{
+    return d->urlResolver;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef ADMIN_H
+#define ADMIN_H
+
+#include <QMetaProperty>
+#include <QObject>
+#include <QStringList>
+#include <QVariant>
+
+#include "QDjangoModel.h"
+#include "QDjangoQuerySet.h"
+
+class QDjangoHttpRequest;
+class QDjangoHttpResponse;
+class QDjangoUrlResolver;
+class ModelAdminPrivate;
+
+QDjangoHttpResponse *renderToResponse(const QDjangoHttpRequest &request, const QString &name, const QVariantMap &context);
+
+/** The ModelAdminFetcher class gives a ModelAdmin access to the objects
+ *  of a model, without the ModelAdmin needing to know the model's type.
+ */
+class ModelAdminFetcher
+{
+public:
+    virtual ~ModelAdminFetcher() {}
+    virtual int countObjects(const QDjangoWhere &where) const = 0;
+    virtual QDjangoModel *createObject() const = 0;
+    virtual QVariantMap dumpObject(const QObject *object) const = 0;
+    virtual QDjangoModel *getObject(const QString& objectId) const = 0;
+    virtual QList<QVariantList> listObjects(const QDjangoWhere &where, const QStringList &orderBy, const QStringList &fields, int pos, int length) const = 0;
+    virtual QString modelName() const = 0;
+};
+
+template<class T>
+class ModelAdminFetcherImpl : public ModelAdminFetcher
+{
+public:
+    int countObjects(const QDjangoWhere &where) const
+    {
+        return QDjangoQuerySet<T>().filter(where).count();
+    }
+
+    QDjangoModel *createObject() const
+    {
+        return new T;
+    }
+
+    QVariantMap dumpObject(const QObject *object) const
+    {
+        const QMetaObject *metaObject = object->metaObject();
+        QVariantMap props;
+        props.insert("pk", object->property("pk"));
+        for (int i = metaObject->propertyOffset(); i < metaObject->propertyCount(); ++i) {
+            const char *key = metaObject->property(i).name();
+            props.insert(key, object->property(key));
+        }
+        return props;
+    }
+
+    QDjangoModel *getObject(const QString& objectId) const
+    {
+        return QDjangoQuerySet<T>().get(QDjangoWhere("pk", QDjangoWhere::Equals, objectId));
+    }
+
+    QList<QVariantList> listObjects(const QDjangoWhere &where, const QStringList &orderBy, const QStringList &fields, int pos, int length) const
+    {
+        return QDjangoQuerySet<T>().filter(where).orderBy(orderBy).limit(pos, length).valuesList(fields);
+    }
+
+    QString modelName() const
+    {
+        return QString::fromLatin1(T::staticMetaObject.className()).toLower();
+    }
+};
+
+/** The ModelAdmin class provides the add, change, delete and list views
+ *  for a model.
+ *
+ *  The list fields are the only columns fetched for the change list. They
+ *  can follow foreign keys using the "__" notation, in which case the
+ *  related table is joined in the same query.
+ */
+class ModelAdmin : public QObject
+{
+    Q_OBJECT
+
+public:
+    ModelAdmin(ModelAdminFetcher *fetcher, QObject *parent = 0);
+    ~ModelAdmin();
+
+    QList<QByteArray> changeFields() const;
+    void setChangeFields(const QList<QByteArray> fields);
+
+    QList<QByteArray> listFields() const;
+    void setListFields(const QList<QByteArray> fields);
+
+    int listPerPage() const;
+    void setListPerPage(int listPerPage);
+
+    QDjangoUrlResolver *urls() const;
+
+public slots:
+    QDjangoHttpResponse* addForm(const QDjangoHttpRequest &request);
+    QDjangoHttpResponse* changeForm(const QDjangoHttpRequest &request, const QString &objectId);
+    QDjangoHttpResponse* changeList(const QDjangoHttpRequest &request);
+    QDjangoHttpResponse* deleteForm(const QDjangoHttpRequest &request, const QString &objectId);
+
+private:
+    ModelAdminPrivate *d;
+};
+
+#endif
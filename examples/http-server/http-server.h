@@ -21,8 +21,6 @@ class QDjangoHttpRequest;
 class QDjangoHttpResponse;
 class QDjangoUrlResolver;
 class AdminControllerPrivate;
-class ModelAdminFetcher;
-class ModelAdminPrivate;
 
 class AdminController : public QObject
 {
@@ -39,30 +37,3 @@ public slots:
 private:
     AdminControllerPrivate *d;
 };
-
-class ModelAdmin : public QObject
-{
-    Q_OBJECT
-
-public:
-    ModelAdmin(ModelAdminFetcher *fetcher, QObject *parent = 0);
-    ~ModelAdmin();
-
-    QList<QByteArray> changeFields() const;
-    void setChangeFields(const QList<QByteArray> fields);
-
-    QList<QByteArray> listFields() const;
-    void setListFields(const QList<QByteArray> fields);
-
-    QDjangoUrlResolver *urls() const;
-
-public slots:
-    QDjangoHttpResponse* addForm(const QDjangoHttpRequest &request);
-    QDjangoHttpResponse* changeForm(const QDjangoHttpRequest &request, const QString &objectId);
-    QDjangoHttpResponse* changeList(const QDjangoHttpRequest &request);
-    QDjangoHttpResponse* deleteForm(const QDjangoHttpRequest &request, const QString &objectId);
-
-private:
-    ModelAdminPrivate *d;
-};
-
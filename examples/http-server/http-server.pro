@@ -7,7 +7,8 @@ TARGET = qdjango-http-server
 INCLUDEPATH += ../../tests/db $$QDJANGO_INCLUDEPATH
 LIBS += \
     -L../../src/db $$QDJANGO_DB_LIBS \
-    -L../../src/http $$QDJANGO_HTTP_LIBS
+    -L../../src/http $$QDJANGO_HTTP_LIBS \
+    -L../../src/template $$QDJANGO_TEMPLATE_LIBS
 RESOURCES += http-server.qrc
-HEADERS += http-server.h ../../tests/db/auth-models.h
-SOURCES += http-server.cpp ../../tests/db/auth-models.cpp
+HEADERS += admin.h http-server.h ../../tests/db/auth-models.h
+SOURCES += admin.cpp http-server.cpp ../../tests/db/auth-models.cpp
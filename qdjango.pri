@@ -11,16 +11,19 @@ isEmpty(QDJANGO_LIBRARY_TYPE) {
 }
 
 # Libraries for apps which use QDjango
-QDJANGO_INCLUDEPATH = $$PWD/src/db $$PWD/src/http
+QDJANGO_INCLUDEPATH = $$PWD/src/db $$PWD/src/http $$PWD/src/template
 QDJANGO_DB_LIBS = -lqdjango-db
 QDJANGO_HTTP_LIBS = -lqdjango-http
+QDJANGO_TEMPLATE_LIBS = -lqdjango-template
 contains(QDJANGO_LIBRARY_TYPE,staticlib) {
+    QDJANGO_HTTP_LIBS += -lz
     DEFINES += QDJANGO_STATIC
 } else {
     # Windows needs the major library version
     win32 {
         QDJANGO_DB_LIBS = -lqdjango-db0
         QDJANGO_HTTP_LIBS = -lqdjango-http0
+        QDJANGO_TEMPLATE_LIBS = -lqdjango-template0
     }
     DEFINES += QDJANGO_SHARED
 }
@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <cstring>
+
+#include <QDateTime>
+#include <qnumeric.h>
+#include <QSqlError>
+
+#include "QDjango.h"
+#include "QDjangoJsonSerializer.h"
+#include "QDjangoMetaModel.h"
+
+/// \cond
+
+class QDjangoJsonColumn
+{
+public:
+    enum Encoding {
+        BoolEncoding,
+        ByteArrayEncoding,
+        DateEncoding,
+        DateTimeEncoding,
+        DoubleEncoding,
+        IntegerEncoding,
+        StringEncoding,
+        TimeEncoding
+    };
+
+    // the punctuation and key written before the value
+    QByteArray prefix;
+    Encoding encoding;
+    int index;
+};
+
+class QDjangoJsonSerializerPrivate
+{
+public:
+    QDjangoJsonSerializerPrivate(QDjangoQuerySetPrivate *querySet, const QStringList &fields);
+    ~QDjangoJsonSerializerPrivate();
+
+    void buildObject(const QList<QStringList> &paths, const QList<QDjangoMetaField> &metaFields, const QList<int> &members, int depth, QByteArray &pending);
+    QStringList expandFields() const;
+    void fetch(qint64 size);
+    void finish(bool complete);
+    bool start();
+
+    QByteArray buffer;
+    int bufferPos;
+    QList<QDjangoJsonColumn> columns;
+    QStringList fields;
+    bool finished;
+    QDjangoQuery *query;
+    QDjangoQuerySetPrivate *querySet;
+    int rows;
+    QByteArray suffix;
+
+    QDjangoJsonSerializer *q;
+};
+
+static QDjangoJsonColumn::Encoding columnEncoding(QVariant::Type type)
+{
+    switch (type) {
+    case QVariant::Bool:
+        return QDjangoJsonColumn::BoolEncoding;
+    case QVariant::ByteArray:
+        return QDjangoJsonColumn::ByteArrayEncoding;
+    case QVariant::Date:
+        return QDjangoJsonColumn::DateEncoding;
+    case QVariant::DateTime:
+        return QDjangoJsonColumn::DateTimeEncoding;
+    case QVariant::Double:
+        return QDjangoJsonColumn::DoubleEncoding;
+    case QVariant::Int:
+    case QVariant::LongLong:
+    case QVariant::UInt:
+    case QVariant::ULongLong:
+        return QDjangoJsonColumn::IntegerEncoding;
+    case QVariant::Time:
+        return QDjangoJsonColumn::TimeEncoding;
+    default:
+        return QDjangoJsonColumn::StringEncoding;
+    }
+}
+
+static void writeString(QByteArray &output, const QByteArray &utf8)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    output += '"';
+    const char *ptr = utf8.constData();
+    const char *end = ptr + utf8.size();
+    const char *start = ptr;
+    for (; ptr < end; ++ptr) {
+        const unsigned char c = *ptr;
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        output.append(start, ptr - start);
+        start = ptr + 1;
+        switch (c) {
+        case '"': output += "\\\""; break;
+        case '\\': output += "\\\\"; break;
+        case '\b': output += "\\b"; break;
+        case '\f': output += "\\f"; break;
+        case '\n': output += "\\n"; break;
+        case '\r': output += "\\r"; break;
+        case '\t': output += "\\t"; break;
+        default:
+            output += "\\u00";
+            output += hexDigits[c >> 4];
+            output += hexDigits[c & 0xf];
+            break;
+        }
+    }
+    output.append(start, ptr - start);
+    output += '"';
+}
+
+static void writeValue(QByteArray &output, const QVariant &value, QDjangoJsonColumn::Encoding encoding)
+{
+    if (value.isNull()) {
+        output += "null";
+        return;
+    }
+
+    switch (encoding) {
+    case QDjangoJsonColumn::BoolEncoding:
+        output += value.toBool() ? "true" : "false";
+        break;
+    case QDjangoJsonColumn::ByteArrayEncoding:
+        output += '"';
+        output += value.toByteArray().toBase64();
+        output += '"';
+        break;
+    case QDjangoJsonColumn::DateEncoding:
+        writeString(output, value.toDate().toString(Qt::ISODate).toLatin1());
+        break;
+    case QDjangoJsonColumn::DateTimeEncoding:
+        writeString(output, value.toDateTime().toString(Qt::ISODate).toLatin1());
+        break;
+    case QDjangoJsonColumn::DoubleEncoding: {
+        const double number = value.toDouble();
+        if (qIsInf(number) || qIsNaN(number))
+            output += "null";
+        else
+            output += QByteArray::number(number, 'g', 17);
+        break;
+    }
+    case QDjangoJsonColumn::IntegerEncoding:
+        output += QByteArray::number(value.toLongLong());
+        break;
+    case QDjangoJsonColumn::TimeEncoding:
+        writeString(output, value.toTime().toString(Qt::ISODate).toLatin1());
+        break;
+    case QDjangoJsonColumn::StringEncoding:
+        writeString(output, value.toString().toUtf8());
+        break;
+    }
+}
+
+QDjangoJsonSerializerPrivate::QDjangoJsonSerializerPrivate(QDjangoQuerySetPrivate *querySet, const QStringList &fields)
+    : bufferPos(0)
+    , fields(fields)
+    , finished(false)
+    , query(0)
+    , querySet(querySet)
+    , rows(0)
+    , q(0)
+{
+    querySet->counter.ref();
+}
+
+QDjangoJsonSerializerPrivate::~QDjangoJsonSerializerPrivate()
+{
+    delete query;
+    if (!querySet->counter.deref())
+        delete querySet;
+}
+
+/** Lays out the JSON object made of the \a members of the field list whose
+ *  paths share the same first \a depth keys.
+ *
+ * The text preceding each value is accumulated in \a pending, then stored
+ * as the prefix of the value's column.
+ */
+void QDjangoJsonSerializerPrivate::buildObject(const QList<QStringList> &paths, const QList<QDjangoMetaField> &metaFields, const QList<int> &members, int depth, QByteArray &pending)
+{
+    QStringList keys;
+    pending += '{';
+    foreach (int i, members) {
+        const QString key = paths[i].at(depth);
+        if (keys.contains(key))
+            continue;
+        if (!keys.isEmpty())
+            pending += ',';
+        keys << key;
+        writeString(pending, key.toUtf8());
+        pending += ':';
+
+        if (paths[i].size() == depth + 1) {
+            QDjangoJsonColumn column;
+            column.prefix = pending;
+            column.encoding = columnEncoding(metaFields[i].type());
+            column.index = i;
+            columns << column;
+            pending.clear();
+        } else {
+            QList<int> children;
+            foreach (int j, members) {
+                if (paths[j].size() > depth + 1 && paths[j].at(depth) == key)
+                    children << j;
+            }
+            buildObject(paths, metaFields, children, depth + 1, pending);
+        }
+    }
+    pending += '}';
+}
+
+/** Returns the requested fields, where a field which names a foreign key
+ *  is replaced by the local fields of the related model.
+ */
+QStringList QDjangoJsonSerializerPrivate::expandFields() const
+{
+    const QDjangoMetaModel metaModel = QDjango::metaModel(querySet->m_modelName);
+    QStringList names;
+    foreach (const QString &name, fields) {
+        QDjangoMetaModel model = metaModel;
+        const QStringList bits = name.split(QLatin1String("__"));
+        for (int i = 0; i < bits.size() && model.isValid(); ++i) {
+            const QByteArray fk = bits[i].toLatin1();
+            model = model.foreignFields().contains(fk) ? QDjango::metaModel(model.foreignFields()[fk]) : QDjangoMetaModel();
+        }
+        if (model.isValid()) {
+            foreach (const QDjangoMetaField &field, model.localFields())
+                names << name + QLatin1String("__") + field.name();
+        } else {
+            names << name;
+        }
+    }
+    return names;
+}
+
+/** Fetches rows until at least \a size bytes are buffered or the end of
+ *  the results is reached.
+ */
+void QDjangoJsonSerializerPrivate::fetch(qint64 size)
+{
+    if (bufferPos) {
+        buffer.remove(0, bufferPos);
+        bufferPos = 0;
+    }
+
+    if (!query && !start())
+        return;
+
+    while (buffer.size() < size) {
+        if (!query->next()) {
+            if (query->lastError().isValid()) {
+                q->setErrorString(query->lastError().text());
+                qWarning("Could not fetch rows: %s", qPrintable(q->errorString()));
+                finish(false);
+            } else {
+                finish(true);
+            }
+            return;
+        }
+
+        if (rows++)
+            buffer += ',';
+        for (int i = 0; i < columns.size(); ++i) {
+            const QDjangoJsonColumn &column = columns.at(i);
+            buffer += column.prefix;
+            writeValue(buffer, query->value(column.index), column.encoding);
+        }
+        buffer += suffix;
+    }
+}
+
+/** Signals the end of the data.
+ *
+ * The JSON array is only closed if the results are \a complete, so that
+ * a failed query never passes for a valid document.
+ */
+void QDjangoJsonSerializerPrivate::finish(bool complete)
+{
+    if (complete)
+        buffer += ']';
+    finished = true;
+    delete query;
+    query = 0;
+    emit q->readChannelFinished();
+}
+
+/** Executes the query and opens the JSON array.
+ *
+ * Returns false if there are no rows to fetch.
+ */
+bool QDjangoJsonSerializerPrivate::start()
+{
+    buffer += '[';
+    if (querySet->whereClause.isNone()) {
+        finish(true);
+        return false;
+    }
+
+    QStringList names;
+    QList<QDjangoMetaField> metaFields;
+    query = new QDjangoQuery(querySet->valuesQuery(expandFields(), &names, &metaFields));
+    if (!query->exec()) {
+        q->setErrorString(query->lastError().text());
+        qWarning("Could not fetch rows: %s", qPrintable(q->errorString()));
+        finish(false);
+        return false;
+    }
+
+    // lay out the JSON object for a row
+    QList<QStringList> paths;
+    QList<int> members;
+    for (int i = 0; i < names.size(); ++i) {
+        paths << names[i].split(QLatin1String("__"));
+        members << i;
+    }
+    buildObject(paths, metaFields, members, 0, suffix);
+    return true;
+}
+
+/// \endcond
+
+void QDjangoJsonSerializer::init(QDjangoQuerySetPrivate *querySet, const QStringList &fields)
+{
+    d = new QDjangoJsonSerializerPrivate(querySet, fields);
+    d->q = this;
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+/** Destroys the serializer.
+ */
+QDjangoJsonSerializer::~QDjangoJsonSerializer()
+{
+    delete d;
+}
+
+/** \reimp
+ */
+bool QDjangoJsonSerializer::atEnd() const
+{
+    return d->finished && d->bufferPos >= d->buffer.size();
+}
+
+/** \reimp
+ */
+qint64 QDjangoJsonSerializer::bytesAvailable() const
+{
+    return d->buffer.size() - d->bufferPos + QIODevice::bytesAvailable();
+}
+
+/** \reimp
+ */
+bool QDjangoJsonSerializer::isSequential() const
+{
+    return true;
+}
+
+/** \reimp
+ */
+qint64 QDjangoJsonSerializer::readData(char *data, qint64 maxSize)
+{
+    if (!d->finished && d->buffer.size() - d->bufferPos < maxSize)
+        d->fetch(maxSize);
+
+    const qint64 length = qMin(qint64(d->buffer.size() - d->bufferPos), maxSize);
+    if (length > 0) {
+        memcpy(data, d->buffer.constData() + d->bufferPos, length);
+        d->bufferPos += length;
+    }
+    return length;
+}
+
+/** \reimp
+ */
+qint64 QDjangoJsonSerializer::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
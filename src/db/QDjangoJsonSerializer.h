@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_JSON_SERIALIZER_H
+#define QDJANGO_JSON_SERIALIZER_H
+
+#include <QIODevice>
+#include <QStringList>
+
+#include "QDjangoQuerySet.h"
+
+class QDjangoJsonSerializerPrivate;
+
+/** \brief The QDjangoJsonSerializer class reads the rows of a queryset as
+ *  a JSON array.
+ *
+ * QDjangoJsonSerializer is a sequential QIODevice which produces the JSON
+ * representation of a QDjangoQuerySet as it is read. The rows are fetched
+ * from a forward-only database cursor and written out one at a time, so
+ * neither the rows nor the whole document are ever held in memory.
+ *
+ * Each row is written as a JSON object whose members are the requested
+ * fields. Fields of related models are selected using django's double
+ * underscore syntax and are written as nested objects, and naming a
+ * foreign key selects all the fields of the related model:
+ *
+ * \code
+ * QDjangoQuerySet<Message> messages;
+ * QDjangoJsonSerializer *serializer = new QDjangoJsonSerializer(
+ *     messages.filter(QDjangoWhere("user__is_active", QDjangoWhere::Equals, true)),
+ *     QStringList() << "message" << "user__username" << "user__email");
+ *
+ * // [{"message":"hello","user":{"username":"foo","email":"foo@example.com"}}, ...]
+ * response->setHeader("Content-Type", "application/json");
+ * response->setBodyDevice(serializer);
+ * \endcode
+ *
+ * When the serializer is the body device of an HTTP response, the body is
+ * sent using chunked transfer encoding and rows are only fetched as fast as
+ * the client reads them. The query is executed the first time data is read,
+ * using the database connection of the reading thread.
+ *
+ * The database cursor stays open until the last row has been read, that is
+ * for as long as the client takes to download the body. On SQLite, an open
+ * cursor holds a shared lock which blocks writers to the database in the
+ * meantime, so only serve large querysets this way from a database which
+ * is not written to concurrently, or which lets readers and writers proceed
+ * at the same time, such as SQLite in WAL journal mode.
+ *
+ * If the query fails, the error is available from errorString() and the
+ * JSON array is left unterminated, so that the reader can tell the data is
+ * incomplete.
+ *
+ * Values are encoded according to the type of their field: booleans and
+ * numbers as JSON literals, dates and times as ISO 8601 strings, byte
+ * arrays as base64 strings and NULL values as null.
+ *
+ * \ingroup Database
+ */
+class QDJANGO_DB_EXPORT QDjangoJsonSerializer : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    /** Constructs a serializer for the given \a fields of the \a querySet.
+     *
+     * If \a fields is empty, all the local fields of the model are written.
+     *
+     * \param querySet
+     * \param fields
+     * \param parent
+     */
+    template <class T>
+    QDjangoJsonSerializer(const QDjangoQuerySet<T> &querySet, const QStringList &fields = QStringList(), QObject *parent = 0)
+        : QIODevice(parent)
+    {
+        init(querySet.d, fields);
+    }
+    ~QDjangoJsonSerializer();
+
+    bool atEnd() const;
+    qint64 bytesAvailable() const;
+    bool isSequential() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+    Q_DISABLE_COPY(QDjangoJsonSerializer)
+    void init(QDjangoQuerySetPrivate *querySet, const QStringList &fields);
+
+    QDjangoJsonSerializerPrivate *d;
+    friend class QDjangoJsonSerializerPrivate;
+};
+
+#endif
@@ -208,6 +208,14 @@ QVariant QDjangoMetaField::toDatabase(const QVariant &value) const
         return value;
 }
 
+/*!
+    Returns the type of the property backing this meta field.
+*/
+QVariant::Type QDjangoMetaField::type() const
+{
+    return d->type;
+}
+
 static QMap<QString, QString> parseOptions(const char *value)
 {
     QMap<QString, QString> options;
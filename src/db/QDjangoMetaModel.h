@@ -49,6 +49,7 @@ public:
     QString name() const;
     int maxLength() const;
     QVariant toDatabase(const QVariant &value) const;
+    QVariant::Type type() const;
 
 private:
     QSharedDataPointer<QDjangoMetaFieldPrivate> d;
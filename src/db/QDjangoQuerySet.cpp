@@ -46,7 +46,12 @@ QString QDjangoCompiler::referenceModel(const QString &modelPath, QDjangoMetaMod
     return modelRef;
 }
 
-QString QDjangoCompiler::databaseColumn(const QString &name)
+/** Returns the database column for the field called \a name, adding the
+ *  joins it requires.
+ *
+ * If \a field is not null, it receives the field's meta data.
+ */
+QString QDjangoCompiler::databaseColumn(const QString &name, QDjangoMetaField *field)
 {
     QDjangoMetaModel model = baseModel;
     QString modelName;
@@ -95,8 +100,10 @@ QString QDjangoCompiler::databaseColumn(const QString &name)
         bits.takeFirst();
     }
 
-    const QDjangoMetaField field = model.localField(bits.join(QLatin1String("__")).toLatin1());
-    return modelRef + QLatin1Char('.') + driver->escapeIdentifier(field.column(), QSqlDriver::FieldName);
+    const QDjangoMetaField localField = model.localField(bits.join(QLatin1String("__")).toLatin1());
+    if (field)
+        *field = localField;
+    return modelRef + QLatin1Char('.') + driver->escapeIdentifier(localField.column(), QSqlDriver::FieldName);
 }
 
 QStringList QDjangoCompiler::fieldNames(bool recurse, const QStringList *fields, QDjangoMetaModel *metaModel, const QString &modelPath, bool nullable)
@@ -499,6 +506,61 @@ QDjangoQuery QDjangoQuerySetPrivate::updateQuery(const QVariantMap &fields) cons
     return query;
 }
 
+/** Returns the SQL query to perform a SELECT of the specified \a fields on
+    the current set.
+
+    Each field gives one column, and fields of related models are named
+    using the "__" notation. An empty list selects all the local fields of
+    the model. Unknown fields are reported and left out, the names and meta
+    data of the selected fields are stored in \a fieldNames and
+    \a metaFields.
+
+    The query is forward-only, as its rows are meant to be read once.
+ */
+QDjangoQuery QDjangoQuerySetPrivate::valuesQuery(const QStringList &fields, QStringList *fieldNames, QList<QDjangoMetaField> *metaFields) const
+{
+    QSqlDatabase db = QDjango::database();
+
+    QStringList names(fields);
+    if (names.isEmpty()) {
+        foreach (const QDjangoMetaField &field, QDjango::metaModel(m_modelName).localFields())
+            names << field.name();
+    }
+
+    // build query
+    QDjangoCompiler compiler(m_modelName, db);
+    QDjangoWhere resolvedWhere(whereClause);
+    compiler.resolve(resolvedWhere);
+
+    QStringList columns;
+    foreach (const QString &name, names) {
+        QDjangoMetaField field;
+        const QString column = compiler.databaseColumn(name, &field);
+        if (!field.isValid()) {
+            qWarning("Unknown field '%s' for model '%s'", qPrintable(name), m_modelName.constData());
+            continue;
+        }
+        columns << column;
+        if (fieldNames)
+            *fieldNames << name;
+        if (metaFields)
+            *metaFields << field;
+    }
+
+    const QString where = resolvedWhere.sql(db);
+    const QString limit = compiler.orderLimitSql(orderBy, lowMark, highMark);
+    QString sql = QLatin1String("SELECT ") + columns.join(QLatin1String(", ")) + QLatin1String(" FROM ") + compiler.fromSql();
+    if (!where.isEmpty())
+        sql += QLatin1String(" WHERE ") + where;
+    sql += limit;
+    QDjangoQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    resolvedWhere.bindValues(query);
+
+    return query;
+}
+
 int QDjangoQuerySetPrivate::sqlUpdate(const QVariantMap &fields)
 {
     // UPDATE on an empty queryset doesn't need a query
@@ -566,37 +628,35 @@ QList<QVariantMap> QDjangoQuerySetPrivate::sqlValues(const QStringList &fields)
 QList<QVariantList> QDjangoQuerySetPrivate::sqlValuesList(const QStringList &fields)
 {
     QList<QVariantList> values;
-    if (!sqlFetch())
-        return values;
-
-    const QDjangoMetaModel metaModel = QDjango::metaModel(m_modelName);
 
-    // build field list
-    const QList<QDjangoMetaField> localFields = metaModel.localFields();
-    QList<int> fieldPos;
-    if (fields.isEmpty()) {
-        for (int i = 0; i < localFields.size(); ++i)
-            fieldPos << i;
-    } else {
-        foreach (const QString &name, fields) {
-            int pos = 0;
-            foreach (const QDjangoMetaField &field, localFields) {
-                if (field.name() == name)
-                    break;
-                pos++;
-            }
-            Q_ASSERT_X(pos < localFields.size(), "QDjangoQuerySet<T>::valuesList", "unknown field requested");
-            fieldPos << pos;
+    // the requested fields are selected by a dedicated query, whether
+    // or not the results are cached
+    if (!fields.isEmpty()) {
+        if (whereClause.isNone())
+            return values;
+
+        QStringList names;
+        QDjangoQuery query(valuesQuery(fields, &names, 0));
+        if (names.size() != fields.size() || !query.exec())
+            return values;
+
+        const int columnCount = names.size();
+        while (query.next()) {
+            QVariantList list;
+            for (int i = 0; i < columnCount; ++i)
+                list << query.value(i);
+            values.append(list);
         }
+        return values;
     }
 
-    // extract values
-    foreach (const QVariantList &props, properties) {
-        QVariantList list;
-        foreach (int pos, fieldPos)
-            list << props.at(pos);
-        values.append(list);
-    }
+    if (!sqlFetch())
+        return values;
+
+    // extract the values of the local fields
+    const int fieldCount = QDjango::metaModel(m_modelName).localFields().size();
+    foreach (const QVariantList &props, properties)
+        values.append(props.mid(0, fieldCount));
     return values;
 }
 
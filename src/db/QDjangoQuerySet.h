@@ -321,6 +321,7 @@ public:
 
 private:
     QDjangoQuerySetPrivate *d;
+    friend class QDjangoJsonSerializer;
 };
 
 /** Constructs a new queryset.
@@ -644,6 +645,12 @@ QList<QVariantMap> QDjangoQuerySet<T>::values(const QStringList &fields)
  *  If no \a fields are specified, all the model's fields are returned in the
  *  order they where declared.
  *
+ *  If \a fields are specified, only the requested columns are selected and
+ *  each list holds one value per field, in the requested order. Fields of
+ *  related models are named using the "__" notation, which joins the related
+ *  tables. If a field is unknown, a warning is printed and an empty list is
+ *  returned.
+ *
  * \param fields
  */
 template <class T>
@@ -30,6 +30,7 @@
 #include "QDjango_p.h"
 #include "QDjangoWhere.h"
 
+class QDjangoMetaField;
 class QDjangoMetaModel;
 
 class QDJANGO_DB_EXPORT QDjangoModelReference
@@ -60,13 +61,13 @@ class QDJANGO_DB_EXPORT QDjangoCompiler
 {
 public:
     QDjangoCompiler(const char *modelName, const QSqlDatabase &db);
+    QString databaseColumn(const QString &name, QDjangoMetaField *field = 0);
     QString fromSql();
     QStringList fieldNames(bool recurse, const QStringList *fields = 0, QDjangoMetaModel *metaModel = 0, const QString &modelPath = QString(), bool nullable = false);
     QString orderLimitSql(const QStringList &orderBy, int lowMark, int highMark);
     void resolve(QDjangoWhere &where);
 
 private:
-    QString databaseColumn(const QString &name);
     QString referenceModel(const QString &modelPath, QDjangoMetaModel *metaModel, bool nullable);
 
     QSqlDriver *driver;
@@ -99,6 +100,7 @@ public:
     QDjangoQuery insertQuery(const QVariantMap &fields) const;
     QDjangoQuery selectQuery() const;
     QDjangoQuery updateQuery(const QVariantMap &fields) const;
+    QDjangoQuery valuesQuery(const QStringList &fields, QStringList *fieldNames, QList<QDjangoMetaField> *metaFields) const;
 
     // reference counter
     QAtomicInt counter;
@@ -117,6 +119,7 @@ private:
 
     QByteArray m_modelName;
 
+    friend class QDjangoJsonSerializerPrivate;
     friend class QDjangoMetaModel;
 };
 
@@ -13,6 +13,7 @@ win32 {
 HEADERS += \
     QDjango.h \
     QDjango_p.h \
+    QDjangoJsonSerializer.h \
     QDjangoMetaModel.h \
     QDjangoModel.h \
     QDjangoQuerySet.h \
@@ -21,6 +22,7 @@ HEADERS += \
     QDjangoWhere_p.h
 SOURCES += \
     QDjango.cpp \
+    QDjangoJsonSerializer.cpp \
     QDjangoMetaModel.cpp \
     QDjangoModel.cpp \
     QDjangoQuerySet.cpp \
@@ -18,14 +18,20 @@
 #include <QDebug>
 #include <QLocalServer>
 #include <QLocalSocket>
+#include <QMutex>
 #include <QTcpServer>
 #include <QTcpSocket>
 #include <QUrl>
 
 #include "QDjangoFastCgiServer.h"
 #include "QDjangoFastCgiServer_p.h"
+#include "QDjangoHttpCompressor_p.h"
+#include "QDjangoHttpETag_p.h"
 #include "QDjangoHttpController.h"
+#include "QDjangoHttpMetrics.h"
+#include "QDjangoHttpMetrics_p.h"
 #include "QDjangoHttpRequest.h"
+#include "QDjangoHttpRequestBody_p.h"
 #include "QDjangoHttpRequest_p.h"
 #include "QDjangoHttpResponse.h"
 #include "QDjangoHttpResponse_p.h"
@@ -34,6 +40,52 @@
 
 //#define QDJANGO_DEBUG_FCGI
 
+// maximum size of the body data carried by a STDOUT record
+#define FCGI_STDOUT_SIZE 32768
+
+// amount of data queued on the device above which we stop reading body devices
+#define WRITE_BUFFER_SIZE (64 * 1024)
+
+// maximum number of concurrent requests on a connection
+#define MAX_REQUESTS 32
+
+// maximum number of free buffers kept by the buffer pool
+#define POOL_SIZE 32
+
+static QMutex poolMutex;
+static QList<QByteArray> poolBuffers;
+
+/** Returns a buffer of the given \a size, reusing a free buffer if
+ *  one is large enough.
+ */
+QByteArray QDjangoFastCgiBufferPool::acquire(int size)
+{
+    QByteArray buffer;
+    if (size > 0) {
+        QMutexLocker locker(&poolMutex);
+        for (int i = 0; i < poolBuffers.size(); ++i) {
+            if (poolBuffers.at(i).capacity() >= size) {
+                buffer = poolBuffers.takeAt(i);
+                break;
+            }
+        }
+    }
+    buffer.resize(size);
+    return buffer;
+}
+
+/** Returns the \a buffer to the pool, leaving it empty.
+ */
+void QDjangoFastCgiBufferPool::release(QByteArray &buffer)
+{
+    if (buffer.capacity() > 0) {
+        QMutexLocker locker(&poolMutex);
+        if (poolBuffers.size() < POOL_SIZE)
+            poolBuffers << buffer;
+    }
+    buffer = QByteArray();
+}
+
 quint16 QDjangoFastCgiHeader::contentLength(FCGI_Header *header)
 {
     return (header->contentLengthB1 << 8) | header->contentLengthB0;
@@ -56,6 +108,47 @@ void QDjangoFastCgiHeader::setRequestId(FCGI_Header *header, quint16 requestId)
     header->requestIdB0 = (requestId & 0xff);
 }
 
+/** Reads a name-value pair at \a d, which is advanced past the pair.
+ *
+ * The \a name and \a value refer to the data at \a d without copying
+ * it. Returns false if the pair does not fit before \a end.
+ */
+static bool readPair(const quint8 *&d, const quint8 *end, QByteArray &name, QByteArray &value)
+{
+    quint32 lengths[2];
+    for (int i = 0; i < 2; ++i) {
+        if (d >= end)
+            return false;
+        if (d[0] >> 7) {
+            if (end - d < 4)
+                return false;
+            lengths[i] = ((d[0] & 0x7f) << 24) | (d[1] << 16) | (d[2] << 8) | d[3];
+            d += 4;
+        } else {
+            lengths[i] = d[0];
+            d++;
+        }
+    }
+    if (quint32(end - d) < lengths[0] || quint32(end - d) - lengths[0] < lengths[1])
+        return false;
+    name = QByteArray::fromRawData((const char*)d, lengths[0]);
+    d += lengths[0];
+    value = QByteArray::fromRawData((const char*)d, lengths[1]);
+    d += lengths[1];
+    return true;
+}
+
+/** Appends a name-value pair whose name and value are shorter than
+ *  128 bytes to \a ba.
+ */
+static void writePair(QByteArray &ba, const QByteArray &name, const QByteArray &value)
+{
+    ba.append(char(name.size()));
+    ba.append(char(value.size()));
+    ba.append(name);
+    ba.append(value);
+}
+
 #ifdef QDJANGO_DEBUG_FCGI
 static void hDebug(FCGI_Header *header, const char *dir)
 {
@@ -72,12 +165,15 @@ static void hDebug(FCGI_Header *header, const char *dir)
 
 QDjangoFastCgiConnection::QDjangoFastCgiConnection(QIODevice *device, QDjangoFastCgiServer *server)
     : QObject(server)
+    , m_acceptTime(QDjangoHttpMetricsPrivate::now())
+    , m_closing(false)
     , m_device(device)
     , m_inputPos(0)
-    , m_keepConnection(false)
-    , m_pendingRequest(0)
-    , m_pendingRequestId(0)
+    , m_limits(server->limits())
+    , m_metrics(server->metrics()->d)
+    , m_overloaded(false)
     , m_server(server)
+    , m_writingResponse(false)
 {
     bool check;
     Q_UNUSED(check);
@@ -94,62 +190,222 @@ QDjangoFastCgiConnection::QDjangoFastCgiConnection(QIODevice *device, QDjangoFas
     check = connect(m_device, SIGNAL(readyRead()),
                     this, SLOT(_q_readyRead()));
     Q_ASSERT(check);
+
+    updateTimeout();
 }
 
 QDjangoFastCgiConnection::~QDjangoFastCgiConnection()
 {
-    if (m_pendingRequest)
-        delete m_pendingRequest;
+    m_metrics->activeRequests -= m_pendingJobs.size();
+    foreach (const QDjangoFastCgiJob &job, m_pendingJobs) {
+        // a streamed request is also pending until its body has arrived
+        m_pendingRequests.remove(job.requestId);
+        delete job.request;
+        delete job.response;
+    }
+    foreach (QDjangoHttpRequest *request, m_pendingRequests)
+        delete request;
 }
 
-void QDjangoFastCgiConnection::writeResponse(quint16 requestId, QDjangoHttpResponse *response)
+void QDjangoFastCgiConnection::writeRecord(quint16 requestId, quint8 type, const char *data, quint16 length)
 {
-    // serialise HTTP response
-    QString httpHeader = QString::fromLatin1("Status: %1 %2\r\n").arg(response->d->statusCode).arg(response->d->reasonPhrase);
-    QList<QPair<QString, QString> >::ConstIterator it = response->d->headers.constBegin();
-    while (it != response->d->headers.constEnd()) {
-        httpHeader += (*it).first + QLatin1String(": ") + (*it).second + QLatin1String("\r\n");
-        ++it;
-    }
-    const QByteArray data = httpHeader.toUtf8() + "\r\n" + response->d->body;
-
-    const char *ptr = data.constData();
-    FCGI_Header *header = (FCGI_Header*)m_outputBuffer;
+    char buffer[FCGI_HEADER_LEN];
+    FCGI_Header *header = (FCGI_Header*)buffer;
     memset(header, 0, FCGI_HEADER_LEN);
     header->version = 1;
+    header->type = type;
     QDjangoFastCgiHeader::setRequestId(header, requestId);
+    QDjangoFastCgiHeader::setContentLength(header, length);
 
-    for (qint64 bytesRemaining = data.size(); ; ) {
-        const quint16 contentLength = qMin(bytesRemaining, qint64(32768));
+    // the content is written straight from the caller's data
+    m_device->write(buffer, FCGI_HEADER_LEN);
+    if (length)
+        m_device->write(data, length);
+    m_metrics->bytesSent += FCGI_HEADER_LEN + length;
+#ifdef QDJANGO_DEBUG_FCGI
+    hDebug(header, "sent");
+#endif
+}
 
-        header->type = FCGI_STDOUT;
-        QDjangoFastCgiHeader::setContentLength(header, contentLength);
-        memcpy(m_outputBuffer + FCGI_HEADER_LEN, ptr, contentLength);
-        m_device->write(m_outputBuffer, FCGI_HEADER_LEN + contentLength);
+void QDjangoFastCgiConnection::writeStdout(quint16 requestId, const QByteArray &data)
+{
+    const char *ptr = data.constData();
+    for (qint64 bytesRemaining = data.size(); bytesRemaining > 0; ) {
+        const quint16 contentLength = qMin(bytesRemaining, qint64(FCGI_STDOUT_SIZE));
+        writeRecord(requestId, FCGI_STDOUT, ptr, contentLength);
 #ifdef QDJANGO_DEBUG_FCGI
-        hDebug(header, "sent");
         qDebug("[STDOUT]");
 #endif
+        ptr += contentLength;
+        bytesRemaining -= contentLength;
+    }
+}
 
-        if (contentLength > 0) {
-            ptr += contentLength;
-            bytesRemaining -= contentLength;
-        } else {
-            break;
-        }
+void QDjangoFastCgiConnection::writeEndRequest(quint16 requestId, quint8 protocolStatus)
+{
+    // an empty STDOUT record signals the end of the stream
+    if (protocolStatus == FCGI_REQUEST_COMPLETE) {
+        writeRecord(requestId, FCGI_STDOUT, 0, 0);
+#ifdef QDJANGO_DEBUG_FCGI
+        qDebug("[STDOUT]");
+#endif
     }
 
-    quint16 contentLength = 8;
-    header->type = FCGI_END_REQUEST;
-    QDjangoFastCgiHeader::setContentLength(header, contentLength);
-    memset(m_outputBuffer + FCGI_HEADER_LEN, 0, contentLength);
-    m_device->write(m_outputBuffer, FCGI_HEADER_LEN + contentLength);
+    const char body[8] = {0, 0, 0, 0, char(protocolStatus), 0, 0, 0};
+    writeRecord(requestId, FCGI_END_REQUEST, body, sizeof(body));
 #ifdef QDJANGO_DEBUG_FCGI
-    hDebug(header, "sent");
     qDebug("[END REQUEST]");
 #endif
 }
 
+/** Aborts the request with the given \a requestId, discarding its
+ *  response if it is pending.
+ *
+ * The front-end may abort a request whose end is already on its way, so
+ * aborts for unknown requests are ignored.
+ */
+void QDjangoFastCgiConnection::abortRequest(quint16 requestId)
+{
+    const bool pending = m_pendingRequests.contains(requestId);
+    QDjangoHttpRequest *request = m_pendingRequests.take(requestId);
+
+    // a streamed request is both pending and has a job
+    const int i = jobIndex(requestId);
+    if (i >= 0) {
+        const QDjangoFastCgiJob job = m_pendingJobs.takeAt(i);
+        m_metrics->activeRequests--;
+        job.response->disconnect(this);
+        if (job.response->d->bodyDevice)
+            job.response->d->bodyDevice->disconnect(this);
+        delete job.request;
+        job.response->deleteLater();
+    } else if (pending) {
+        delete request;
+    } else {
+#ifdef QDJANGO_DEBUG_FCGI
+        qDebug("Ignoring abort for request %i, which has already ended", requestId);
+#endif
+        return;
+    }
+    writeEndRequest(requestId);
+    finishRequest(requestId);
+}
+
+/** Prepares the \a request with the given \a requestId once its
+ *  parameters have been received, and dispatches it right away if its
+ *  handler streams the body.
+ *
+ * Returns false if the request was rejected.
+ */
+bool QDjangoFastCgiConnection::startRequest(quint16 requestId, QDjangoHttpRequest *request)
+{
+    request->d->timestamps[QDjangoHttpMetrics::HeaderPhase] = QDjangoHttpMetricsPrivate::now();
+
+    // apply the route's policy to the body
+    qint64 maximumSize;
+    const bool streamed = m_server->urls()->bodyPolicy(*request, &maximumSize);
+    if (maximumSize < 0)
+        maximumSize = m_limits.maximumBodySize();
+    if (maximumSize > 0 && request->d->metaValue(QLatin1String("CONTENT_LENGTH")).toLongLong() > maximumSize) {
+        qWarning("FastCGI request body is too large");
+        emit rejected();
+        return false;
+    }
+    request->d->bodyDevice = QSharedPointer<QDjangoHttpRequestBody>(new QDjangoHttpRequestBody(
+        request->d->metaValue(QLatin1String("CONTENT_TYPE")).toLatin1(), m_limits.bodySpoolThreshold(), maximumSize, streamed));
+
+    // the response is written once the body has arrived
+    if (streamed)
+        dispatchRequest(requestId, request);
+    return true;
+}
+
+/** Invokes the handler for the \a request with the given \a requestId
+ *  and queues its response.
+ */
+void QDjangoFastCgiConnection::dispatchRequest(quint16 requestId, QDjangoHttpRequest *request)
+{
+    QDjangoFastCgiJob job;
+    job.requestId = requestId;
+    job.request = request;
+    job.response = m_server->urls()->respond(*request, request->path());
+    job.headerWritten = false;
+    request->d->timestamps[QDjangoHttpMetrics::HandlerPhase] = QDjangoHttpMetricsPrivate::now();
+    m_metrics->activeRequests++;
+    m_pendingJobs << job;
+
+    connect(job.response, SIGNAL(ready()), this, SLOT(_q_writeResponse()));
+}
+
+/** Returns the index of the job for the given \a requestId, or -1 if
+ *  there is no such job.
+ */
+int QDjangoFastCgiConnection::jobIndex(quint16 requestId) const
+{
+    for (int i = 0; i < m_pendingJobs.size(); ++i) {
+        if (m_pendingJobs.at(i).requestId == requestId)
+            return i;
+    }
+    return -1;
+}
+
+/** Writes the next record of the body of the \a job's response, and
+ *  sets \a written if a record was written.
+ *
+ * Returns true once the whole body has been written.
+ */
+bool QDjangoFastCgiConnection::writeBody(const QDjangoFastCgiJob &job, bool *written)
+{
+    const QByteArray chunk = job.response->d->readBody(FCGI_STDOUT_SIZE);
+    if (!chunk.isEmpty()) {
+        writeStdout(job.requestId, chunk);
+        *written = true;
+        return false;
+    } else if (job.response->d->bodyAtEnd()) {
+        writeEndRequest(job.requestId);
+        *written = true;
+        return true;
+    }
+
+    // wait for the device to provide more data
+    return false;
+}
+
+/** Writes the header and body of the \a job's response.
+ *
+ * Returns true once the whole response has been written, false if
+ * its body is streamed by _q_writeResponse().
+ */
+bool QDjangoFastCgiConnection::writeResponse(const QDjangoFastCgiJob &job)
+{
+    QDjangoHttpResponse *response = job.response;
+
+    // the body is never sent in reply to a HEAD request, but the body
+    // device belongs to the response and may still be fed by its handler
+    const bool skipBody = job.request->method() == QLatin1String("HEAD");
+    if (m_server->isETagEnabled() && !skipBody)
+        QDjangoHttpETag::tagResponse(*job.request, response);
+    if (m_server->isCompressionEnabled() && !skipBody)
+        QDjangoHttpCompressor::compressResponse(*job.request, response);
+
+    // serialise HTTP response
+    writeStdout(job.requestId, response->d->headerData(QDjangoHttpResponsePrivate::FastCgiHeader));
+    if (!skipBody && !response->d->body.isEmpty())
+        writeStdout(job.requestId, response->d->body);
+
+    if (!response->d->bodyDevice || skipBody) {
+        writeEndRequest(job.requestId);
+        return true;
+    }
+
+    // stream body
+    connect(response->d->bodyDevice, SIGNAL(readyRead()),
+            this, SLOT(_q_writeResponse()));
+    connect(response->d->bodyDevice, SIGNAL(readChannelFinished()),
+            this, SLOT(_q_writeResponse()));
+    return false;
+}
+
 /** When bytes have been written, check whether we need to close
  *  the connection.
  *
@@ -158,7 +414,11 @@ void QDjangoFastCgiConnection::writeResponse(quint16 requestId, QDjangoHttpRespo
 void QDjangoFastCgiConnection::_q_bytesWritten(qint64 bytes)
 {
     Q_UNUSED(bytes);
-    if (!m_device->bytesToWrite() && !m_keepConnection) {
+    if (!m_pendingJobs.isEmpty()) {
+        // resume streaming response bodies
+        if (m_device->bytesToWrite() < WRITE_BUFFER_SIZE)
+            _q_writeResponse();
+    } else if (m_closing && m_pendingRequests.isEmpty() && !m_device->bytesToWrite()) {
 #ifdef QDJANGO_DEBUG_FCGI
         qDebug("Closing connection");
 #endif
@@ -167,12 +427,179 @@ void QDjangoFastCgiConnection::_q_bytesWritten(qint64 bytes)
     }
 }
 
+/** Records that the request with the given \a requestId has ended, so
+ *  that the connection is closed once idle if the request asked for it.
+ */
+void QDjangoFastCgiConnection::finishRequest(quint16 requestId)
+{
+    if (m_closingRequests.remove(requestId))
+        m_closing = true;
+}
+
+/** Processes a received record, whose \a header is followed by
+ *  the content \a d.
+ *
+ * Returns false if the record is invalid.
+ */
+bool QDjangoFastCgiConnection::processRecord(FCGI_Header *header, const quint8 *d)
+{
+#ifdef QDJANGO_DEBUG_FCGI
+    hDebug(header, "received");
+#endif
+    if (header->version != 1) {
+        qWarning("Received FastCGI record with an invalid version %i", header->version);
+        return false;
+    }
+    const quint16 requestId = QDjangoFastCgiHeader::requestId(header);
+    const quint16 contentLength = QDjangoFastCgiHeader::contentLength(header);
+    const quint8 *end = d + contentLength;
+
+    // management records
+    if (!requestId) {
+        if (header->type == FCGI_GET_VALUES) {
+#ifdef QDJANGO_DEBUG_FCGI
+            qDebug("[GET VALUES]");
+#endif
+            QByteArray result;
+            QByteArray name, value;
+            while (readPair(d, end, name, value)) {
+                if (name == "FCGI_MAX_REQS")
+                    writePair(result, name, QByteArray::number(MAX_REQUESTS));
+                else if (name == "FCGI_MPXS_CONNS")
+                    writePair(result, name, "1");
+            }
+            writeRecord(0, FCGI_GET_VALUES_RESULT, result.constData(), result.size());
+        } else {
+            const char body[8] = {char(header->type), 0, 0, 0, 0, 0, 0, 0};
+            writeRecord(0, FCGI_UNKNOWN_TYPE, body, sizeof(body));
+        }
+        return true;
+    }
+
+    // application records
+    if (header->type == FCGI_ABORT_REQUEST) {
+#ifdef QDJANGO_DEBUG_FCGI
+        qDebug("[ABORT]");
+#endif
+        abortRequest(requestId);
+        return true;
+    }
+    if (header->type != FCGI_BEGIN_REQUEST && !m_pendingRequests.contains(requestId)) {
+        // the request may have been rejected, discard its records
+        if (m_overloaded && (header->type == FCGI_PARAMS || header->type == FCGI_STDIN))
+            return true;
+        qWarning("Received FastCGI record for an invalid request %i", requestId);
+        return false;
+    }
+    QDjangoHttpRequest *request = m_pendingRequests.value(requestId);
+
+    switch (header->type) {
+    case FCGI_BEGIN_REQUEST: {
+        if (contentLength < 8) {
+            qWarning("Received FastCGI record with an invalid length %i", contentLength);
+            return false;
+        }
+        const quint8 flags = d[2];
+#ifdef QDJANGO_DEBUG_FCGI
+        const quint16 role = (d[0] << 8) | d[1];
+        qDebug("[BEGIN REQUEST]");
+        qDebug("role: %i", role);
+        qDebug("flags: %i", flags);
+#endif
+        if (m_pendingRequests.contains(requestId) || jobIndex(requestId) >= 0) {
+            qWarning("Received new FastCGI request %i which is already being handled", requestId);
+            return false;
+        }
+        if (m_pendingRequests.size() + m_pendingJobs.size() >= MAX_REQUESTS) {
+            writeEndRequest(requestId, FCGI_OVERLOADED);
+            m_overloaded = true;
+            if (!(flags & FCGI_KEEP_CONN))
+                m_closing = true;
+        } else {
+            // the connection is closed once a request without FCGI_KEEP_CONN
+            // has ended and no other request is in flight
+            if (!(flags & FCGI_KEEP_CONN))
+                m_closingRequests.insert(requestId);
+
+            // the first request of the connection started when it was accepted
+            request = new QDjangoHttpRequest;
+            request->d->timestamps[QDjangoHttpMetrics::AcceptPhase] = m_acceptTime ? m_acceptTime : QDjangoHttpMetricsPrivate::now();
+            m_acceptTime = 0;
+            m_pendingRequests.insert(requestId, request);
+        }
+        break;
+    }
+    case FCGI_PARAMS:
+#ifdef QDJANGO_DEBUG_FCGI
+        qDebug("[PARAMS]");
+#endif
+        while (d < end) {
+            QByteArray name, value;
+            if (!readPair(d, end, name, value)) {
+                qWarning("Received FastCGI record with invalid parameters");
+                return false;
+            }
+
+#ifdef QDJANGO_DEBUG_FCGI
+            qDebug() << name << ":" << value;
+#endif
+            if (name == "PATH_INFO") {
+                request->d->path = QString::fromUtf8(value);
+            } else if (name == "REQUEST_URI") {
+                request->d->path = QUrl(QString::fromUtf8(value)).path();
+            } else if (name == "REQUEST_METHOD") {
+                request->d->method = QString::fromUtf8(value);
+            }
+
+            // other parameters are only decoded when they are looked up
+            request->d->addRawMeta(name, value);
+        }
+        if ((m_limits.maximumHeaderCount() > 0 && request->d->rawMetaIndex.size() > m_limits.maximumHeaderCount()) ||
+            (m_limits.maximumHeaderSize() > 0 && request->d->rawMeta.size() > m_limits.maximumHeaderSize())) {
+            qWarning("FastCGI request parameters are too large");
+            emit rejected();
+            return false;
+        }
+
+        // an empty PARAMS record signals the end of the parameters
+        if (!contentLength && !request->d->bodyDevice)
+            return startRequest(requestId, request);
+        break;
+    case FCGI_STDIN:
+#ifdef QDJANGO_DEBUG_FCGI
+        qDebug("[STDIN]");
+#endif
+        // some front-ends do not signal the end of the parameters
+        if (!request->d->bodyDevice && !startRequest(requestId, request))
+            return false;
+        if (contentLength) {
+            if (!request->d->bodyDevice->append((const char*)d, contentLength)) {
+                emit rejected();
+                return false;
+            }
+        } else {
+            // an empty STDIN record signals the end of the request
+            m_pendingRequests.remove(requestId);
+            request->d->bodyDevice->finish();
+            if (jobIndex(requestId) < 0)
+                dispatchRequest(requestId, request);
+            _q_writeResponse();
+        }
+        break;
+    default:
+        qWarning("Received FastCGI record with an invalid type %i", header->type);
+        return false;
+    }
+    return true;
+}
+
 void QDjangoFastCgiConnection::_q_readyRead()
 {
     while (m_device->bytesAvailable()) {
         // read record header
+        FCGI_Header *header = (FCGI_Header*)m_inputHeader;
         if (m_inputPos < FCGI_HEADER_LEN) {
-            const qint64 length = m_device->read(m_inputBuffer + m_inputPos, FCGI_HEADER_LEN - m_inputPos);
+            const qint64 length = m_device->read(m_inputHeader + m_inputPos, FCGI_HEADER_LEN - m_inputPos);
             if (length < 0) {
                 qWarning("Failed to read FastCGI record header from socket");
                 m_device->close();
@@ -180,15 +607,18 @@ void QDjangoFastCgiConnection::_q_readyRead()
                 return;
             }
             m_inputPos += length;
+            m_metrics->bytesReceived += length;
             if (m_inputPos < FCGI_HEADER_LEN)
-                return;
+                break;
+
+            // only hold a buffer while a record is being received
+            const int bodyLength = QDjangoFastCgiHeader::contentLength(header) + header->paddingLength;
+            m_inputBuffer = QDjangoFastCgiBufferPool::acquire(bodyLength);
         }
 
         // read record body
-        FCGI_Header *header = (FCGI_Header*)m_inputBuffer;
-        const quint16 contentLength = QDjangoFastCgiHeader::contentLength(header);
-        const quint16 bodyLength = contentLength + header->paddingLength;
-        const qint64 length = m_device->read(m_inputBuffer + m_inputPos, bodyLength + FCGI_HEADER_LEN - m_inputPos);
+        const int bodyLength = m_inputBuffer.size();
+        const qint64 length = m_device->read(m_inputBuffer.data() + m_inputPos - FCGI_HEADER_LEN, bodyLength + FCGI_HEADER_LEN - m_inputPos);
         if (length < 0) {
             qWarning("Failed to read FastCGI record body from socket");
             m_device->close();
@@ -196,121 +626,98 @@ void QDjangoFastCgiConnection::_q_readyRead()
             return;
         }
         m_inputPos += length;
+        m_metrics->bytesReceived += length;
         if (m_inputPos < FCGI_HEADER_LEN + bodyLength)
-            return;
+            break;
         m_inputPos = 0;
 
         // process record
-#ifdef QDJANGO_DEBUG_FCGI
-        hDebug(header, "received");
-#endif
-        if (header->version != 1) {
-            qWarning("Received FastCGI record with an invalid version %i", header->version);
-            m_device->close();
-            emit closed();
-            return;
-        }
-        const quint16 requestId = QDjangoFastCgiHeader::requestId(header);
-        if (header->type != FCGI_BEGIN_REQUEST && (!m_pendingRequest || requestId != m_pendingRequestId)) {
-            qWarning("Received FastCGI record for an invalid request %i", requestId);
+        const bool ok = processRecord(header, (const quint8*)m_inputBuffer.constData());
+        QDjangoFastCgiBufferPool::release(m_inputBuffer);
+        if (!ok) {
             m_device->close();
             emit closed();
             return;
         }
+    }
 
-        quint8 *d = (quint8*)(m_inputBuffer + FCGI_HEADER_LEN);
-        switch (header->type) {
-        case FCGI_BEGIN_REQUEST: {
-            const quint8 flags = d[2];
-#ifdef QDJANGO_DEBUG_FCGI
-            const quint16 role = (d[0] << 8) | d[1];
-            qDebug("[BEGIN REQUEST]");
-            qDebug("role: %i", role);
-            qDebug("flags: %i", flags);
-#endif
-            // we do not support multiplexing
-            if (m_pendingRequest) {
-                qWarning("Received new FastCGI request %i while already handling request %i", requestId, m_pendingRequestId);
-                m_device->close();
-                emit closed();
-                return;
-            }
-            m_keepConnection = (flags & FCGI_KEEP_CONN);
-            m_pendingRequest = new QDjangoHttpRequest;
-            m_pendingRequestId = requestId;
-            break;
-        }
-        case FCGI_ABORT_REQUEST:
-#ifdef QDJANGO_DEBUG_FCGI
-            qDebug("[ABORT]");
-#endif
-            m_device->close();
-            emit closed();
-            return;
-        case FCGI_PARAMS:
-#ifdef QDJANGO_DEBUG_FCGI
-            qDebug("[PARAMS]");
-#endif
-            while (d < (quint8*)(m_inputBuffer + FCGI_HEADER_LEN + contentLength)) {
-                quint32 nameLength;
-                quint32 valueLength;
-                if (d[0] >> 7) {
-                    nameLength = ((d[0] & 0x7f) << 24) | (d[1] << 16) | (d[2] << 8) | d[3];
-                    d += 4;
-                } else {
-                    nameLength = d[0];
-                    d++;
-                }
-                if (d[0] >> 7) {
-                    valueLength = ((d[0] & 0x7f) << 24) | (d[1] << 16) | (d[2] << 8) | d[3];
-                    d += 4;
-                } else {
-                    valueLength = d[0];
-                    d++;
-                }
-                const QByteArray name((char*)d, nameLength);
-                d += nameLength;
-                const QByteArray value((char*)d, valueLength);
-                d += valueLength;
+    updateTimeout();
+}
 
+/** Closes the connection when it has been idle for too long, or when
+ *  the front-end stops making progress sending a request.
+ */
+void QDjangoFastCgiConnection::timeout()
+{
 #ifdef QDJANGO_DEBUG_FCGI
-                qDebug() << name << ":" << value;
-#endif
-                if (name == "PATH_INFO") {
-                    m_pendingRequest->d->path = QString::fromUtf8(value);
-                } else if (name == "REQUEST_URI") {
-                    m_pendingRequest->d->path = QUrl(QString::fromUtf8(value)).path();
-                } else if (name == "REQUEST_METHOD") {
-                    m_pendingRequest->d->method = QString::fromUtf8(value);
-                }
-                m_pendingRequest->d->meta.insert(QString::fromLatin1(name), QString::fromUtf8(value));
-            }
-            break;
-        case FCGI_STDIN:
-#ifdef QDJANGO_DEBUG_FCGI
-            qDebug("[STDIN]");
+    qDebug("Connection timed out");
 #endif
-            if (contentLength) {
-                m_pendingRequest->d->buffer.append((char*)d, contentLength);
-            } else {
-                // an empty STDIN record signals the end of the request
-                QDjangoHttpRequest *request = m_pendingRequest;
-                const quint16 requestId = m_pendingRequestId;
-
-                m_pendingRequest = 0;
-                m_pendingRequestId = 0;
-
-                QDjangoHttpResponse *response = m_server->urls()->respond(*request, request->path());
-                writeResponse(requestId, response);
-            }
-            break;
-        default:
-            qWarning("Received FastCGI record with an invalid type %i", header->type);
-            m_device->close();
-            emit closed();
-            return;
+    if (m_inputPos || !m_pendingRequests.isEmpty())
+        emit rejected();
+    m_device->close();
+    emit closed();
+}
+
+/** Arms the timeout which matches the state of the connection.
+ *
+ * While a request is being received, each record must follow the
+ * previous one within the body timeout. Once all responses have been
+ * written, the connection may remain idle for the idle timeout.
+ */
+void QDjangoFastCgiConnection::updateTimeout()
+{
+    if (m_inputPos || !m_pendingRequests.isEmpty())
+        startTimeout(m_limits.bodyTimeout());
+    else if (m_pendingJobs.isEmpty())
+        startTimeout(m_limits.idleTimeout());
+    else
+        stopTimeout();
+}
+
+/** Writes the responses which are ready and continues writing the
+ *  bodies of streamed responses.
+ */
+void QDjangoFastCgiConnection::_q_writeResponse()
+{
+    // body devices may signal new data while we are reading from them
+    if (m_writingResponse)
+        return;
+    m_writingResponse = true;
+
+    // write one record of each response in turn so that the responses
+    // are interleaved, until all of them are waiting for data
+    int idleJobs = 0;
+    while (idleJobs < m_pendingJobs.size() && m_device->bytesToWrite() < WRITE_BUFFER_SIZE) {
+        QDjangoFastCgiJob job = m_pendingJobs.takeFirst();
+        bool finished = false;
+        bool written = false;
+
+        // the response to a streamed request waits for the end of its body
+        if (job.headerWritten) {
+            finished = writeBody(job, &written);
+        } else if (job.response->isReady() && !m_pendingRequests.contains(job.requestId)) {
+            job.request->d->timestamps[QDjangoHttpMetrics::ReadyPhase] = QDjangoHttpMetricsPrivate::now();
+            finished = writeResponse(job);
+            job.headerWritten = true;
+            written = true;
+        }
+        if (finished) {
+            job.request->d->timestamps[QDjangoHttpMetrics::WrittenPhase] = QDjangoHttpMetricsPrivate::now();
+            m_metrics->requestFinished(job.request->d->route, job.request->d->timestamps, job.response->statusCode());
+            finishRequest(job.requestId);
+            delete job.request;
+            job.response->deleteLater();
+            idleJobs = 0;
+        } else {
+            m_pendingJobs << job;
+            idleJobs = written ? 0 : idleJobs + 1;
         }
     }
+
+    m_writingResponse = false;
+
+    if (m_pendingJobs.isEmpty() && m_pendingRequests.isEmpty())
+        updateTimeout();
 }
 
 /// \endcond
@@ -319,7 +726,13 @@ class QDjangoFastCgiServerPrivate
 {
 public:
     QDjangoFastCgiServerPrivate(QDjangoFastCgiServer *qq);
+    void addConnection(QIODevice *device);
+
+    bool compressionEnabled;
+    bool etagEnabled;
+    QDjangoHttpLimits limits;
     QLocalServer *localServer;
+    QDjangoHttpMetrics *metrics;
     QTcpServer *tcpServer;
     QDjangoUrlResolver *urlResolver;
 
@@ -328,13 +741,51 @@ private:
 };
 
 QDjangoFastCgiServerPrivate::QDjangoFastCgiServerPrivate(QDjangoFastCgiServer *qq)
-    : localServer(0),
+    : compressionEnabled(false),
+    etagEnabled(false),
+    localServer(0),
     tcpServer(0),
     q(qq)
 {
+    metrics = new QDjangoHttpMetrics(q);
     urlResolver = new QDjangoUrlResolver(q);
 }
 
+/** Handles a new connection on the given \a device, unless the
+ *  maximum number of connections has been reached.
+ */
+void QDjangoFastCgiServerPrivate::addConnection(QIODevice *device)
+{
+    bool check;
+    Q_UNUSED(check);
+
+    if (limits.maximumConnections() > 0 && metrics->d->activeConnections >= limits.maximumConnections()) {
+#ifdef QDJANGO_DEBUG_FCGI
+        qDebug("Rejecting connection");
+#endif
+        metrics->d->rejectedConnections++;
+        device->close();
+        device->deleteLater();
+        return;
+    }
+
+    QDjangoFastCgiConnection *connection = new QDjangoFastCgiConnection(device, q);
+    metrics->d->activeConnections++;
+    metrics->d->connectionCount++;
+
+    check = q->connect(connection, SIGNAL(closed()),
+                       connection, SLOT(deleteLater()));
+    Q_ASSERT(check);
+
+    check = q->connect(connection, SIGNAL(destroyed()),
+                       q, SLOT(_q_connectionDestroyed()));
+    Q_ASSERT(check);
+
+    check = q->connect(connection, SIGNAL(rejected()),
+                       q, SLOT(_q_connectionRejected()));
+    Q_ASSERT(check);
+}
+
 /** Constructs a new FastCGI server.
  */
 QDjangoFastCgiServer::QDjangoFastCgiServer(QObject *parent)
@@ -347,6 +798,8 @@ QDjangoFastCgiServer::QDjangoFastCgiServer(QObject *parent)
  */
 QDjangoFastCgiServer::~QDjangoFastCgiServer()
 {
+    // connections update the metrics until they are destroyed
+    qDeleteAll(findChildren<QDjangoFastCgiConnection*>());
     delete d;
 }
 
@@ -361,6 +814,80 @@ void QDjangoFastCgiServer::close()
         d->tcpServer->close();
 }
 
+/** Returns true if responses are compressed when the client supports it.
+ *
+ * \sa setCompressionEnabled()
+ */
+bool QDjangoFastCgiServer::isCompressionEnabled() const
+{
+    return d->compressionEnabled;
+}
+
+/** Sets whether responses are compressed when the client supports it.
+ *
+ * When enabled, the bodies of textual responses (HTML, CSS, JavaScript,
+ * JSON, XML..) are compressed using gzip or deflate according to the
+ * request's Accept-Encoding header. Streamed bodies are compressed as
+ * they are sent. Compression is disabled by default.
+ *
+ * \param enabled
+ */
+void QDjangoFastCgiServer::setCompressionEnabled(bool enabled)
+{
+    d->compressionEnabled = enabled;
+}
+
+/** Returns true if dynamic responses are tagged with an entity tag
+ *  computed from their body.
+ *
+ * \sa setETagEnabled()
+ */
+bool QDjangoFastCgiServer::isETagEnabled() const
+{
+    return d->etagEnabled;
+}
+
+/** Sets whether dynamic responses are tagged with an entity tag
+ *  computed from their body.
+ *
+ * When enabled, successful responses to GET requests whose body
+ * is held in memory receive a weak ETag header, computed using a
+ * fast non-cryptographic hash of the body. Requests whose If-None-Match
+ * header matches the tag are answered with a bodiless 304 Not Modified
+ * response, so clients which poll a resource do not download it again
+ * until it changes. Responses which already carry an ETag header are
+ * left untouched. Entity tags are disabled by default.
+ *
+ * \param enabled
+ */
+void QDjangoFastCgiServer::setETagEnabled(bool enabled)
+{
+    d->etagEnabled = enabled;
+}
+
+/** Returns the limits which the server enforces on its connections.
+ *
+ * \sa setLimits()
+ */
+QDjangoHttpLimits QDjangoFastCgiServer::limits() const
+{
+    return d->limits;
+}
+
+/** Sets the \a limits which the server enforces on its connections.
+ *
+ * The limits apply to connections which are accepted after the call.
+ * Request parameters are subject to the header limits, and while a
+ * request is being received each of its records must arrive within
+ * the body timeout.
+ *
+ * \param limits
+ */
+void QDjangoFastCgiServer::setLimits(const QDjangoHttpLimits &limits)
+{
+    d->limits = limits;
+}
+
 /** Tells the server to listen for incoming connections on the given
  *  local socket.
  */
@@ -397,6 +924,23 @@ bool QDjangoFastCgiServer::listen(const QHostAddress &address, quint16 port)
     return d->tcpServer->listen(address, port);
 }
 
+/** Returns the metrics of the server.
+ */
+QDjangoHttpMetrics *QDjangoFastCgiServer::metrics() const
+{
+    return d->metrics;
+}
+
+/** Returns the number of connections which were closed because they
+ *  exceeded the server's limits.
+ *
+ * \sa limits()
+ */
+int QDjangoFastCgiServer::rejectedConnections() const
+{
+    return d->metrics->d->rejectedConnections;
+}
+
 /** Returns the root URL resolver for the server, which dispatches
  *  requests to handlers.
  */
@@ -405,35 +949,34 @@ QDjangoUrlResolver* QDjangoFastCgiServer::urls() const
     return d->urlResolver;
 }
 
-void QDjangoFastCgiServer::_q_newLocalConnection()
+void QDjangoFastCgiServer::_q_connectionDestroyed()
 {
-    bool check;
-    Q_UNUSED(check);
+    d->metrics->d->activeConnections--;
+}
+
+void QDjangoFastCgiServer::_q_connectionRejected()
+{
+    d->metrics->d->rejectedConnections++;
+}
 
+void QDjangoFastCgiServer::_q_newLocalConnection()
+{
     QLocalSocket *socket;
     while ((socket = d->localServer->nextPendingConnection()) != 0) {
 #ifdef QDJANGO_DEBUG_FCGI
         qDebug("New local connection");
 #endif
-        QDjangoFastCgiConnection *connection = new QDjangoFastCgiConnection(socket, this);
-        check = connect(connection, SIGNAL(closed()),
-                        connection, SLOT(deleteLater()));
-        Q_ASSERT(check);
+        d->addConnection(socket);
     }
 }
+
 void QDjangoFastCgiServer::_q_newTcpConnection()
 {
-    bool check;
-    Q_UNUSED(check);
-
     QTcpSocket *socket;
     while ((socket = d->tcpServer->nextPendingConnection()) != 0) {
 #ifdef QDJANGO_DEBUG_FCGI
         qDebug("New TCP connection");
 #endif
-        QDjangoFastCgiConnection *connection = new QDjangoFastCgiConnection(socket, this);
-        check = connect(connection, SIGNAL(closed()),
-                        connection, SLOT(deleteLater()));
-        Q_ASSERT(check);
+        d->addConnection(socket);
     }
 }
@@ -22,9 +22,11 @@
 #include <QObject>
 
 #include "QDjangoHttp_p.h"
+#include "QDjangoHttpLimits.h"
 
 class QDjangoFastCgiServerPrivate;
 class QDjangoHttpController;
+class QDjangoHttpMetrics;
 class QDjangoUrlResolver;
 
 /** \brief The QDjangoFastCgiServer class represents a FastCGI server.
@@ -46,11 +48,21 @@ public:
     ~QDjangoFastCgiServer();
 
     void close();
+    bool isCompressionEnabled() const;
+    void setCompressionEnabled(bool enabled);
+    bool isETagEnabled() const;
+    void setETagEnabled(bool enabled);
+    QDjangoHttpLimits limits() const;
+    void setLimits(const QDjangoHttpLimits &limits);
     bool listen(const QString &name);
     bool listen(const QHostAddress &address, quint16 port);
+    QDjangoHttpMetrics *metrics() const;
+    int rejectedConnections() const;
     QDjangoUrlResolver *urls() const;
 
 private slots:
+    void _q_connectionDestroyed();
+    void _q_connectionRejected();
     void _q_newLocalConnection();
     void _q_newTcpConnection();
 
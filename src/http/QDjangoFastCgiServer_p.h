@@ -26,7 +26,13 @@
 //
 
 #include "QDjangoHttp_p.h"
+#include "QDjangoHttpLimits.h"
+#include "QDjangoHttpTimerWheel_p.h"
+#include <QByteArray>
+#include <QList>
+#include <QMap>
 #include <QObject>
+#include <QSet>
 
 #define FCGI_HEADER_LEN  8
 #define FCGI_RECORD_SIZE (255*255 + 255 + 8)
@@ -37,10 +43,17 @@
 #define FCGI_PARAMS              4
 #define FCGI_STDIN               5
 #define FCGI_STDOUT              6
+#define FCGI_GET_VALUES          9
+#define FCGI_GET_VALUES_RESULT  10
+#define FCGI_UNKNOWN_TYPE       11
 
 #define FCGI_KEEP_CONN 1
 
+#define FCGI_REQUEST_COMPLETE 0
+#define FCGI_OVERLOADED       2
+
 class QDjangoFastCgiServer;
+class QDjangoHttpMetricsPrivate;
 class QDjangoHttpRequest;
 class QDjangoHttpResponse;
 class QIODevice;
@@ -65,7 +78,30 @@ public:
     static void setRequestId(FCGI_Header *header, quint16 requestId);
 };
 
-class QDJANGO_HTTP_AUTOTEST_EXPORT QDjangoFastCgiConnection : public QObject
+/** \internal
+ *
+ * A pool of buffers into which FastCGI records are received, so that
+ * idle connections do not hold on to a buffer.
+ */
+class QDJANGO_HTTP_AUTOTEST_EXPORT QDjangoFastCgiBufferPool
+{
+public:
+    static QByteArray acquire(int size);
+    static void release(QByteArray &buffer);
+};
+
+/** \internal
+ */
+class QDjangoFastCgiJob
+{
+public:
+    quint16 requestId;
+    QDjangoHttpRequest *request;
+    QDjangoHttpResponse *response;
+    bool headerWritten;
+};
+
+class QDJANGO_HTTP_AUTOTEST_EXPORT QDjangoFastCgiConnection : public QObject, public QDjangoHttpTimerClient
 {
     Q_OBJECT
 
@@ -75,22 +111,47 @@ public:
 
 signals:
     void closed();
+    void rejected();
+
+protected:
+    void timeout();
 
 private slots:
     void _q_bytesWritten(qint64 bytes);
     void _q_readyRead();
+    void _q_writeResponse();
 
 private:
-    void writeResponse(quint16 requestId, QDjangoHttpResponse *response);
-
+    void abortRequest(quint16 requestId);
+    void dispatchRequest(quint16 requestId, QDjangoHttpRequest *request);
+    void finishRequest(quint16 requestId);
+    int jobIndex(quint16 requestId) const;
+    bool processRecord(FCGI_Header *header, const quint8 *d);
+    bool startRequest(quint16 requestId, QDjangoHttpRequest *request);
+    void updateTimeout();
+    bool writeBody(const QDjangoFastCgiJob &job, bool *written);
+    void writeEndRequest(quint16 requestId, quint8 protocolStatus = FCGI_REQUEST_COMPLETE);
+    void writeRecord(quint16 requestId, quint8 type, const char *data, quint16 length);
+    bool writeResponse(const QDjangoFastCgiJob &job);
+    void writeStdout(quint16 requestId, const QByteArray &data);
+
+    qint64 m_acceptTime;
+    // whether the connection is closed once it has no request in flight,
+    // and the requests in flight which did not ask to keep it open
+    bool m_closing;
+    QSet<quint16> m_closingRequests;
     QIODevice *m_device;
-    char m_inputBuffer[FCGI_RECORD_SIZE];
+    QByteArray m_inputBuffer;
+    char m_inputHeader[FCGI_HEADER_LEN];
     int m_inputPos;
-    bool m_keepConnection;
-    char m_outputBuffer[FCGI_RECORD_SIZE];
-    QDjangoHttpRequest *m_pendingRequest;
-    quint16 m_pendingRequestId;
+    QDjangoHttpLimits m_limits;
+    QDjangoHttpMetricsPrivate *m_metrics;
+    // whether a request was rejected because of too many concurrent requests
+    bool m_overloaded;
+    QList<QDjangoFastCgiJob> m_pendingJobs;
+    QMap<quint16, QDjangoHttpRequest*> m_pendingRequests;
     QDjangoFastCgiServer *m_server;
+    bool m_writingResponse;
 };
 
 #endif
@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <cstring>
+
+#include <QStringList>
+
+#include "QDjangoHttpCompressor_p.h"
+#include "QDjangoHttpRequest.h"
+#include "QDjangoHttpResponse.h"
+#include "QDjangoHttpResponse_p.h"
+
+// size of the blocks read from the source of a compressed stream
+#define COMPRESS_CHUNK_SIZE 16384
+
+static int windowBits(QDjangoHttpCompressor::Encoding encoding)
+{
+    // adding 16 to the window size selects the gzip format
+    return encoding == QDjangoHttpCompressor::Gzip ? (MAX_WBITS + 16) : MAX_WBITS;
+}
+
+/** Compresses \a data using the given content \a encoding.
+ *
+ * Returns an empty array if compression failed.
+ */
+QByteArray QDjangoHttpCompressor::compress(const QByteArray &data, Encoding encoding)
+{
+    if (encoding == Identity)
+        return data;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits(encoding), 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return QByteArray();
+
+    QByteArray output;
+    output.resize(deflateBound(&stream, data.size()));
+    stream.next_in = (Bytef*)data.constData();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef*)output.data();
+    stream.avail_out = output.size();
+    const int ret = deflate(&stream, Z_FINISH);
+    const int length = output.size() - stream.avail_out;
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END)
+        return QByteArray();
+
+    output.resize(length);
+    return output;
+}
+
+/** Compresses the body of a \a response if the \a request accepts a
+ *  supported content encoding.
+ *
+ * Only successful responses whose content type benefits from compression
+ * are considered, and small in-memory bodies are sent as-is. Bodies which
+ * are read from a device are compressed as they are sent.
+ */
+void QDjangoHttpCompressor::compressResponse(const QDjangoHttpRequest &request, QDjangoHttpResponse *response)
+{
+    QDjangoHttpResponsePrivate *d = response->d;
+    if (d->statusCode < 200 || d->statusCode == 204 || d->statusCode == 206 || d->statusCode == 304 ||
+        !response->header(QLatin1String("Content-Encoding")).isEmpty() ||
+        !response->header(QLatin1String("Content-Range")).isEmpty() ||
+        !isCompressible(response->header(QLatin1String("Content-Type"))))
+        return;
+
+    // the response depends on the Accept-Encoding header
+    const QString vary = response->header(QLatin1String("Vary"));
+    if (vary.isEmpty())
+        response->setHeader(QLatin1String("Vary"), QLatin1String("Accept-Encoding"));
+    else if (!vary.contains(QLatin1String("Accept-Encoding"), Qt::CaseInsensitive) && vary != QLatin1String("*"))
+        response->setHeader(QLatin1String("Vary"), vary + QLatin1String(", Accept-Encoding"));
+
+    const Encoding encoding = negotiate(request.meta(QLatin1String("HTTP_ACCEPT_ENCODING")));
+    if (encoding == Identity)
+        return;
+
+    if (d->bodyDevice) {
+        if (!d->bodyDevice->isSequential() && d->bodyEndPosition() - d->bodyDevice->pos() < COMPRESS_MIN_SIZE)
+            return;
+
+        QDjangoHttpCompressorDevice *device = new QDjangoHttpCompressorDevice(d->bodyDevice, encoding, d->bodyFinished);
+        if (!device->isOpen()) {
+            delete device;
+            return;
+        }
+        d->bodyDevice->disconnect(response);
+        d->bodyDevice = 0;
+        response->setBodyDevice(device);
+    } else {
+        if (d->body.size() < COMPRESS_MIN_SIZE)
+            return;
+
+        const QByteArray compressed = compress(d->body, encoding);
+        if (compressed.isEmpty() || compressed.size() >= d->body.size())
+            return;
+        response->setBody(compressed);
+    }
+    response->setHeader(QLatin1String("Content-Encoding"), encodingName(encoding));
+
+    // a strong entity tag must differ between encodings
+    const QString etag = response->header(QLatin1String("ETag"));
+    if (etag.size() >= 2 && etag.startsWith(QLatin1Char('"')) && etag.endsWith(QLatin1Char('"')))
+        response->setHeader(QLatin1String("ETag"), etag.left(etag.size() - 1) + QLatin1Char('-') + encodingName(encoding) + QLatin1Char('"'));
+}
+
+/** Returns the name of the given content \a encoding, as used in the
+ *  Accept-Encoding and Content-Encoding headers.
+ */
+QString QDjangoHttpCompressor::encodingName(Encoding encoding)
+{
+    switch (encoding) {
+    case Deflate:
+        return QLatin1String("deflate");
+    case Gzip:
+        return QLatin1String("gzip");
+    default:
+        return QLatin1String("identity");
+    }
+}
+
+/** Returns true if responses of the given \a contentType benefit from
+ *  being compressed.
+ */
+bool QDjangoHttpCompressor::isCompressible(const QString &contentType)
+{
+    const QString mimeType = contentType.section(QLatin1Char(';'), 0, 0).trimmed().toLower();
+    return mimeType.startsWith(QLatin1String("text/")) ||
+           mimeType == QLatin1String("application/javascript") ||
+           mimeType == QLatin1String("application/json") ||
+           mimeType == QLatin1String("application/xml") ||
+           mimeType == QLatin1String("image/svg+xml");
+}
+
+/** Selects the preferred content encoding from the value of a
+ *  request's Accept-Encoding header.
+ */
+QDjangoHttpCompressor::Encoding QDjangoHttpCompressor::negotiate(const QString &acceptEncoding)
+{
+    double deflateQuality = -1;
+    double gzipQuality = -1;
+    double otherQuality = -1;
+    foreach (const QString &item, acceptEncoding.split(QLatin1Char(','), QString::SkipEmptyParts)) {
+        const QStringList bits = item.split(QLatin1Char(';'));
+        const QString coding = bits[0].trimmed().toLower();
+        double quality = 1;
+        for (int i = 1; i < bits.size(); ++i) {
+            const QString param = bits[i].trimmed();
+            if (param.startsWith(QLatin1String("q=")))
+                quality = param.mid(2).toDouble();
+        }
+        if (coding == QLatin1String("gzip") || coding == QLatin1String("x-gzip"))
+            gzipQuality = quality;
+        else if (coding == QLatin1String("deflate"))
+            deflateQuality = quality;
+        else if (coding == QLatin1String("*"))
+            otherQuality = quality;
+    }
+
+    // codings which are not listed take the quality of "*", if any
+    if (gzipQuality < 0)
+        gzipQuality = qMax(otherQuality, 0.0);
+    if (deflateQuality < 0)
+        deflateQuality = qMax(otherQuality, 0.0);
+
+    if (gzipQuality > 0 && gzipQuality >= deflateQuality)
+        return Gzip;
+    else if (deflateQuality > 0)
+        return Deflate;
+    return Identity;
+}
+
+QDjangoHttpCompressorDevice::QDjangoHttpCompressorDevice(QIODevice *source, QDjangoHttpCompressor::Encoding encoding, bool sourceFinished, QObject *parent)
+    : QIODevice(parent)
+    , m_finished(false)
+    , m_pendingFlush(false)
+    , m_source(source)
+    , m_sourceFinished(sourceFinished)
+{
+    bool check;
+    Q_UNUSED(check);
+
+    // the device is left closed if compression is not available
+    memset(&m_stream, 0, sizeof(m_stream));
+    if (deflateInit2(&m_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits(encoding), 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        qWarning("Could not initialise compression stream");
+        return;
+    }
+
+    m_source->setParent(this);
+    check = connect(m_source, SIGNAL(readyRead()),
+                    this, SIGNAL(readyRead()));
+    Q_ASSERT(check);
+
+    check = connect(m_source, SIGNAL(readChannelFinished()),
+                    this, SLOT(_q_sourceFinished()));
+    Q_ASSERT(check);
+
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+QDjangoHttpCompressorDevice::~QDjangoHttpCompressorDevice()
+{
+    deflateEnd(&m_stream);
+}
+
+bool QDjangoHttpCompressorDevice::atEnd() const
+{
+    return m_finished && m_buffer.isEmpty();
+}
+
+qint64 QDjangoHttpCompressorDevice::bytesAvailable() const
+{
+    return m_buffer.size() + QIODevice::bytesAvailable();
+}
+
+bool QDjangoHttpCompressorDevice::isSequential() const
+{
+    return true;
+}
+
+/** Compresses \a length bytes of \a data into the output buffer.
+ */
+void QDjangoHttpCompressorDevice::deflateData(const char *data, int length, int flush)
+{
+    char output[COMPRESS_CHUNK_SIZE];
+    m_stream.next_in = (Bytef*)data;
+    m_stream.avail_in = length;
+    do {
+        m_stream.next_out = (Bytef*)output;
+        m_stream.avail_out = sizeof(output);
+        deflate(&m_stream, flush);
+        m_buffer.append(output, sizeof(output) - m_stream.avail_out);
+    } while (m_stream.avail_out == 0);
+}
+
+/** Reads the data which is available from the source and compresses it.
+ */
+void QDjangoHttpCompressorDevice::process()
+{
+    char input[COMPRESS_CHUNK_SIZE];
+    while (!m_finished && m_buffer.size() < COMPRESS_CHUNK_SIZE) {
+        const qint64 length = m_source->read(input, sizeof(input));
+        if (length > 0) {
+            deflateData(input, length, Z_NO_FLUSH);
+            m_pendingFlush = true;
+        } else if (length < 0 || sourceAtEnd()) {
+            deflateData(0, 0, Z_FINISH);
+            m_finished = true;
+            emit readChannelFinished();
+        } else {
+            // no more data for now, send what we have
+            if (m_pendingFlush) {
+                deflateData(0, 0, Z_SYNC_FLUSH);
+                m_pendingFlush = false;
+            }
+            break;
+        }
+    }
+}
+
+qint64 QDjangoHttpCompressorDevice::readData(char *data, qint64 maxSize)
+{
+    if (m_buffer.isEmpty())
+        process();
+
+    const qint64 length = qMin(maxSize, qint64(m_buffer.size()));
+    memcpy(data, m_buffer.constData(), length);
+    m_buffer.remove(0, length);
+    return length;
+}
+
+/** Returns true if all the data from the source has been consumed.
+ */
+bool QDjangoHttpCompressorDevice::sourceAtEnd() const
+{
+    if (m_source->isSequential())
+        return (m_sourceFinished || !m_source->isOpen()) && !m_source->bytesAvailable();
+    return m_source->atEnd();
+}
+
+qint64 QDjangoHttpCompressorDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+void QDjangoHttpCompressorDevice::_q_sourceFinished()
+{
+    m_sourceFinished = true;
+    if (m_buffer.isEmpty())
+        process();
+    emit readyRead();
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_HTTP_COMPRESSOR_P_H
+#define QDJANGO_HTTP_COMPRESSOR_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QDjango API.
+//
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+
+#include <zlib.h>
+
+// bodies smaller than this are not worth compressing
+#define COMPRESS_MIN_SIZE 256
+
+class QDjangoHttpRequest;
+class QDjangoHttpResponse;
+
+/** \internal
+ */
+class QDjangoHttpCompressor
+{
+public:
+    enum Encoding {
+        Identity,
+        Deflate,
+        Gzip
+    };
+
+    static QByteArray compress(const QByteArray &data, Encoding encoding);
+    static void compressResponse(const QDjangoHttpRequest &request, QDjangoHttpResponse *response);
+    static QString encodingName(Encoding encoding);
+    static bool isCompressible(const QString &contentType);
+    static Encoding negotiate(const QString &acceptEncoding);
+};
+
+/** \internal
+ *
+ * The QDjangoHttpCompressorDevice class compresses the data read from
+ * a source device as it is consumed. When the source has no more data
+ * available for the time being, the compressed stream is flushed so
+ * that streamed responses reach the client without delay.
+ */
+class QDjangoHttpCompressorDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    QDjangoHttpCompressorDevice(QIODevice *source, QDjangoHttpCompressor::Encoding encoding, bool sourceFinished, QObject *parent = 0);
+    ~QDjangoHttpCompressorDevice();
+
+    bool atEnd() const;
+    qint64 bytesAvailable() const;
+    bool isSequential() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private slots:
+    void _q_sourceFinished();
+
+private:
+    void deflateData(const char *data, int length, int flush);
+    void process();
+    bool sourceAtEnd() const;
+
+    QByteArray m_buffer;
+    bool m_finished;
+    bool m_pendingFlush;
+    QIODevice *m_source;
+    bool m_sourceFinished;
+    z_stream m_stream;
+};
+
+#endif
@@ -15,6 +15,9 @@
  * Lesser General Public License for more details.
  */
 
+#include <cstring>
+#include <ctime>
+
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QFile>
@@ -22,11 +25,337 @@
 #include <QLocale>
 #include <QRegExp>
 #include <QStringList>
+#include <QThreadStorage>
 #include <QUrl>
+#include <QUuid>
 
 #include "QDjangoHttpController.h"
+#include "QDjangoHttpController_p.h"
 #include "QDjangoHttpRequest.h"
 #include "QDjangoHttpResponse.h"
+#include "QDjangoHttpResponse_p.h"
+
+// requests for more ranges are served in full
+#define MAX_RANGES 16
+
+/// \cond
+
+/** \internal
+ */
+class QDjangoHttpDateCache
+{
+public:
+    uint time;
+    QByteArray value;
+};
+
+static QThreadStorage<QDjangoHttpDateCache*> httpDateCache;
+
+/** Returns the current date formatted for the Date header.
+ *
+ * The value is only formatted once per second and per thread.
+ */
+QByteArray QDjangoHttpControllerPrivate::currentHttpDate()
+{
+    const uint now = uint(::time(0));
+    QDjangoHttpDateCache *cache = httpDateCache.localData();
+    if (!cache) {
+        cache = new QDjangoHttpDateCache;
+        cache->time = 0;
+        httpDateCache.setLocalData(cache);
+    }
+    if (cache->value.isEmpty() || cache->time != now) {
+        cache->time = now;
+        cache->value = httpDate(QDateTime::fromTime_t(now));
+    }
+    return cache->value;
+}
+
+/** Formats a QDateTime as an HTTP date, without going through QLocale.
+ */
+QByteArray QDjangoHttpControllerPrivate::httpDate(const QDateTime &dt)
+{
+    static const char days[][4] = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"};
+    static const char months[][4] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+    if (!dt.isValid())
+        return QByteArray();
+
+    const QDateTime utc = dt.toUTC();
+    const QDate date = utc.date();
+    const QTime time = utc.time();
+    char buffer[32];
+    qsnprintf(buffer, sizeof(buffer), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+        days[date.dayOfWeek() - 1], date.day(), months[date.month() - 1], date.year(),
+        time.hour(), time.minute(), time.second());
+    return QByteArray(buffer);
+}
+
+/** Returns true if the value of an If-Match or If-None-Match \a header
+ *  matches the given entity tag.
+ *
+ * Weak tags are compared using the weak comparison function.
+ */
+bool QDjangoHttpControllerPrivate::matchesETag(const QString &header, const QString &etag)
+{
+    if (header.isEmpty() || etag.isEmpty())
+        return false;
+
+    const QString opaqueTag = etag.startsWith(QLatin1String("W/")) ? etag.mid(2) : etag;
+    foreach (const QString &item, header.split(QLatin1Char(','), QString::SkipEmptyParts)) {
+        QString tag = item.trimmed();
+        if (tag == QLatin1String("*"))
+            return true;
+        if (tag.startsWith(QLatin1String("W/")))
+            tag = tag.mid(2);
+        if (tag == opaqueTag)
+            return true;
+    }
+    return false;
+}
+
+/** Returns the MIME type for the given \a fileName.
+ */
+QString QDjangoHttpControllerPrivate::mimeType(const QString &fileName)
+{
+    static const char *types[][2] = {
+        {".css", "text/css"},
+        {".csv", "text/csv"},
+        {".gif", "image/gif"},
+        {".htm", "text/html"},
+        {".html", "text/html"},
+        {".ico", "image/x-icon"},
+        {".jpeg", "image/jpeg"},
+        {".jpg", "image/jpeg"},
+        {".js", "application/javascript"},
+        {".json", "application/json"},
+        {".pdf", "application/pdf"},
+        {".png", "image/png"},
+        {".svg", "image/svg+xml"},
+        {".txt", "text/plain"},
+        {".woff", "application/font-woff"},
+        {".xml", "application/xml"},
+        {".zip", "application/zip"},
+        {0, 0}
+    };
+
+    const QString lowerName = fileName.toLower();
+    for (int i = 0; types[i][0]; ++i) {
+        if (lowerName.endsWith(QLatin1String(types[i][0])))
+            return QLatin1String(types[i][1]);
+    }
+    return QLatin1String("application/octet-stream");
+}
+
+/** Returns a random boundary for a multipart response.
+ */
+QByteArray QDjangoHttpControllerPrivate::multipartBoundary()
+{
+    QByteArray boundary = QUuid::createUuid().toString().toLatin1();
+    return "QDjango" + boundary.mid(1, boundary.size() - 2).replace('-', "");
+}
+
+/** Returns the delimiter and headers which precede a part of a
+ *  multipart/byteranges response.
+ */
+QByteArray QDjangoHttpControllerPrivate::multipartHeader(const QByteArray &boundary, const QString &contentType, const QDjangoHttpByteRange &range, qint64 size, bool first)
+{
+    QByteArray header;
+    if (!first)
+        header += "\r\n";
+    header += "--" + boundary + "\r\n";
+    header += "Content-Type: " + contentType.toLatin1() + "\r\n";
+    header += "Content-Range: bytes " + QByteArray::number(range.first) + "-" + QByteArray::number(range.second) + "/" + QByteArray::number(size) + "\r\n";
+    header += "\r\n";
+    return header;
+}
+
+/** Returns the final delimiter of a multipart/byteranges response.
+ */
+QByteArray QDjangoHttpControllerPrivate::multipartTrailer(const QByteArray &boundary)
+{
+    return "\r\n--" + boundary + "--\r\n";
+}
+
+/** Parses the Range header of a \a request for a representation of the
+ *  given \a size.
+ *
+ * Returns false if the whole representation should be served, either
+ * because no valid Range header was sent or because If-Range does not
+ * match the \a etag or \a lastModified date.
+ *
+ * Otherwise returns true and fills \a ranges with the satisfiable
+ * ranges, sorted and with overlapping ranges merged. If \a ranges is
+ * empty, none of the requested ranges could be satisfied.
+ */
+bool QDjangoHttpControllerPrivate::parseRanges(const QDjangoHttpRequest &request, qint64 size, const QString &etag, const QDateTime &lastModified, QList<QDjangoHttpByteRange> &ranges)
+{
+    ranges.clear();
+    if (request.method() != QLatin1String("GET"))
+        return false;
+
+    const QString header = request.meta(QLatin1String("HTTP_RANGE")).trimmed();
+    if (!header.startsWith(QLatin1String("bytes="), Qt::CaseInsensitive))
+        return false;
+
+    // only honour the range if the representation is unchanged
+    const QString ifRange = request.meta(QLatin1String("HTTP_IF_RANGE")).trimmed();
+    if (!ifRange.isEmpty()) {
+        if (ifRange.startsWith(QLatin1Char('"')) || ifRange.startsWith(QLatin1String("W/"))) {
+            if (etag.isEmpty() || etag.startsWith(QLatin1String("W/")) || ifRange != etag)
+                return false;
+        } else {
+            const QDateTime ifRangeDate = QDjangoHttpController::httpDateTime(ifRange);
+            if (!lastModified.isValid() || !ifRangeDate.isValid() ||
+                QDjangoHttpController::httpDateTime(lastModified) != QDjangoHttpController::httpDateTime(ifRangeDate))
+                return false;
+        }
+    }
+
+    const QStringList specs = header.mid(6).split(QLatin1Char(','), QString::SkipEmptyParts);
+    if (specs.isEmpty() || specs.size() > MAX_RANGES)
+        return false;
+
+    QList<QDjangoHttpByteRange> requested;
+    foreach (const QString &item, specs) {
+        const QString spec = item.trimmed();
+        const int dash = spec.indexOf(QLatin1Char('-'));
+        if (dash < 0)
+            return false;
+
+        bool ok;
+        if (dash == 0) {
+            // suffix range
+            const qint64 length = spec.mid(1).toLongLong(&ok);
+            if (!ok || length < 0)
+                return false;
+            if (length > 0 && size > 0)
+                requested << qMakePair(qMax(qint64(0), size - length), size - 1);
+        } else {
+            const qint64 first = spec.left(dash).toLongLong(&ok);
+            if (!ok || first < 0)
+                return false;
+            qint64 last = size - 1;
+            if (dash < spec.size() - 1) {
+                last = spec.mid(dash + 1).toLongLong(&ok);
+                if (!ok || last < first)
+                    return false;
+                last = qMin(last, size - 1);
+            }
+            if (first < size)
+                requested << qMakePair(first, last);
+        }
+    }
+
+    // coalesce overlapping and adjacent ranges
+    qSort(requested);
+    foreach (const QDjangoHttpByteRange &range, requested) {
+        if (!ranges.isEmpty() && range.first <= ranges.last().second + 1)
+            ranges.last().second = qMax(ranges.last().second, range.second);
+        else
+            ranges << range;
+    }
+    return true;
+}
+
+/** Respond to an HTTP \a request whose ranges cannot be satisfied by a
+ *  representation of the given \a size.
+ */
+QDjangoHttpResponse *QDjangoHttpControllerPrivate::serveRangeNotSatisfiable(const QDjangoHttpRequest &request, qint64 size)
+{
+    QDjangoHttpResponse *response = QDjangoHttpController::serveError(request, QDjangoHttpResponse::RequestedRangeNotSatisfiable,
+        QLatin1String("The requested range is not satisfiable."));
+    response->setHeader(QLatin1String("Content-Range"), QLatin1String("bytes */") + QString::number(size));
+    return response;
+}
+
+QDjangoHttpRangeDevice::QDjangoHttpRangeDevice(QIODevice *source, QObject *parent)
+    : QIODevice(parent)
+    , m_pos(0)
+    , m_size(0)
+    , m_source(source)
+{
+    m_source->setParent(this);
+}
+
+/** Appends in-memory \a data to the device.
+ */
+void QDjangoHttpRangeDevice::addData(const QByteArray &data)
+{
+    if (data.isEmpty())
+        return;
+    Segment segment;
+    segment.data = data;
+    segment.offset = 0;
+    segment.length = data.size();
+    m_segments << segment;
+    m_size += segment.length;
+}
+
+/** Appends \a length bytes of the source device starting at \a offset.
+ */
+void QDjangoHttpRangeDevice::addRange(qint64 offset, qint64 length)
+{
+    if (length <= 0)
+        return;
+    Segment segment;
+    segment.offset = offset;
+    segment.length = length;
+    m_segments << segment;
+    m_size += segment.length;
+}
+
+bool QDjangoHttpRangeDevice::isSequential() const
+{
+    return false;
+}
+
+bool QDjangoHttpRangeDevice::seek(qint64 pos)
+{
+    if (!QIODevice::seek(pos))
+        return false;
+    m_pos = pos;
+    return true;
+}
+
+qint64 QDjangoHttpRangeDevice::size() const
+{
+    return m_size;
+}
+
+qint64 QDjangoHttpRangeDevice::readData(char *data, qint64 maxSize)
+{
+    qint64 bytesRead = 0;
+    qint64 segmentStart = 0;
+    foreach (const Segment &segment, m_segments) {
+        if (bytesRead >= maxSize)
+            break;
+        if (m_pos < segmentStart + segment.length) {
+            const qint64 segmentPos = m_pos - segmentStart;
+            const qint64 length = qMin(segment.length - segmentPos, maxSize - bytesRead);
+            if (!segment.data.isEmpty()) {
+                memcpy(data + bytesRead, segment.data.constData() + segmentPos, length);
+            } else {
+                if (!m_source->seek(segment.offset + segmentPos) ||
+                    m_source->read(data + bytesRead, length) != length)
+                    return bytesRead ? bytesRead : -1;
+            }
+            bytesRead += length;
+            m_pos += length;
+        }
+        segmentStart += segment.length;
+    }
+    return bytesRead;
+}
+
+qint64 QDjangoHttpRangeDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+/// \endcond
 
 /** Extract basic credentials from an HTTP \a request.
  *
@@ -52,9 +381,7 @@ bool QDjangoHttpController::getBasicAuth(const QDjangoHttpRequest &request, QStr
  */
 QString QDjangoHttpController::httpDateTime(const QDateTime &dt)
 {
-    if (dt.isValid())
-        return QLocale("C").toString(dt.toUTC(), QLatin1String("ddd, dd MMM yyyy HH:mm:ss")) + QLatin1String(" GMT");
-    return QString();
+    return QString::fromLatin1(QDjangoHttpControllerPrivate::httpDate(dt));
 }
 
 /** Converts an HTTP datetime string to a QDateTime.
@@ -133,11 +460,28 @@ QDjangoHttpResponse *QDjangoHttpController::serveRedirect(const QDjangoHttpReque
     const QString urlString = url.toString();
     QDjangoHttpResponse *response = serveError(request, permanent ? QDjangoHttpResponse::MovedPermanently : QDjangoHttpResponse::Found,
         QString::fromLatin1("You are being redirect to <a href=\"%1\">%2</a>").arg(urlString, urlString));
-    response->setHeader(QLatin1String("Location"), urlString);
+    // headers are Latin-1, so use the percent-encoded form
+    response->setHeader(QLatin1String("Location"), QString::fromLatin1(url.toEncoded()));
     return response;
 }
 
+/** Respond to an HTTP \a request with a service unavailable error,
+ *  for instance when the server is overloaded.
+ *
+ * \param request
+ */
+QDjangoHttpResponse *QDjangoHttpController::serveServiceUnavailable(const QDjangoHttpRequest &request)
+{
+    return serveError(request, QDjangoHttpResponse::ServiceUnavailable, QLatin1String("The service is temporarily unavailable."));
+}
+
 /** Respond to an HTTP \a request for a static file.
+ *
+ * The file is not loaded into memory, its contents are read as the
+ * client consumes them.
+ *
+ * GET requests carrying a Range header are answered with the requested
+ * byte ranges, subject to the If-Range header.
  *
  * \param request
  * \param docPath The path to the document, such that it can be opened using a QFile.
@@ -173,27 +517,54 @@ QDjangoHttpResponse *QDjangoHttpController::serveStatic(const QDjangoHttpRequest
     }
 
     // determine content type
-    QString mimeType;
-    if (fileName.endsWith(QLatin1String(".css")))
-        mimeType = QLatin1String("text/css");
-    else if (fileName.endsWith(QLatin1String(".html")))
-        mimeType = QLatin1String("text/html");
-    else if (fileName.endsWith(QLatin1String(".js")))
-        mimeType = QLatin1String("application/javascript");
-    else
-        mimeType = QLatin1String("application/octet-stream");
+    const QString mimeType = QDjangoHttpControllerPrivate::mimeType(fileName);
     response->setHeader(QLatin1String("Content-Type"), mimeType);
+    response->setHeader(QLatin1String("Accept-Ranges"), QLatin1String("bytes"));
 
-    // read contents
-    QFile file(docPath);
-    if (!file.open(QIODevice::ReadOnly)) {
+    // open contents, they will be read as the client consumes them
+    QFile *file = new QFile(docPath);
+    if (!file->open(QIODevice::ReadOnly)) {
+        delete file;
         delete response;
         return serveInternalServerError(request);
     }
-    if (request.method() == QLatin1String("HEAD"))
-        response->setHeader(QLatin1String("Content-Length"), QString::number(file.size()));
-    else
-        response->setBody(file.readAll());
+    const qint64 size = file->size();
+    if (request.method() == QLatin1String("HEAD")) {
+        response->setHeader(QLatin1String("Content-Length"), QString::number(size));
+        delete file;
+        return response;
+    }
+
+    // handle range requests
+    QList<QDjangoHttpByteRange> ranges;
+    if (!QDjangoHttpControllerPrivate::parseRanges(request, size, QString(), lastModified, ranges)) {
+        response->setBodyDevice(file);
+    } else if (ranges.isEmpty()) {
+        delete file;
+        delete response;
+        return QDjangoHttpControllerPrivate::serveRangeNotSatisfiable(request, size);
+    } else if (ranges.size() == 1) {
+        const QDjangoHttpByteRange range = ranges.first();
+        file->seek(range.first);
+        response->setStatusCode(QDjangoHttpResponse::PartialContent);
+        response->setBodyDevice(file);
+        response->d->bodyEnd = range.second + 1;
+        response->setHeader(QLatin1String("Content-Length"), QString::number(range.second - range.first + 1));
+        response->setHeader(QLatin1String("Content-Range"), QString::fromLatin1("bytes %1-%2/%3").arg(
+            QString::number(range.first), QString::number(range.second), QString::number(size)));
+    } else {
+        const QByteArray boundary = QDjangoHttpControllerPrivate::multipartBoundary();
+        QDjangoHttpRangeDevice *device = new QDjangoHttpRangeDevice(file);
+        for (int i = 0; i < ranges.size(); ++i) {
+            device->addData(QDjangoHttpControllerPrivate::multipartHeader(boundary, mimeType, ranges[i], size, i == 0));
+            device->addRange(ranges[i].first, ranges[i].second - ranges[i].first + 1);
+        }
+        device->addData(QDjangoHttpControllerPrivate::multipartTrailer(boundary));
+        device->open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+        response->setStatusCode(QDjangoHttpResponse::PartialContent);
+        response->setHeader(QLatin1String("Content-Type"), QLatin1String("multipart/byteranges; boundary=") + QString::fromLatin1(boundary));
+        response->setBodyDevice(device);
+    }
     return response;
 }
 
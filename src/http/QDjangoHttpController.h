@@ -47,10 +47,12 @@ public:
     static QDjangoHttpResponse *serveInternalServerError(const QDjangoHttpRequest &request);
     static QDjangoHttpResponse *serveNotFound(const QDjangoHttpRequest &request);
     static QDjangoHttpResponse *serveRedirect(const QDjangoHttpRequest &request, const QUrl &url, bool permanent = false);
+    static QDjangoHttpResponse *serveServiceUnavailable(const QDjangoHttpRequest &request);
     static QDjangoHttpResponse *serveStatic(const QDjangoHttpRequest &request, const QString &filePath, const QDateTime &expires = QDateTime());
 
 private:
     static QDjangoHttpResponse *serveError(const QDjangoHttpRequest &request, int code, const QString &text);
+    friend class QDjangoHttpControllerPrivate;
 };
 
 #endif
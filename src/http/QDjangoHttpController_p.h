@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_HTTP_CONTROLLER_P_H
+#define QDJANGO_HTTP_CONTROLLER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QDjango API.
+//
+
+#include <QDateTime>
+#include <QIODevice>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+class QDjangoHttpRequest;
+class QDjangoHttpResponse;
+
+/** A byte range, given by the positions of its first and last bytes.
+ */
+typedef QPair<qint64, qint64> QDjangoHttpByteRange;
+
+/** \internal
+ */
+class QDjangoHttpControllerPrivate
+{
+public:
+    static QByteArray currentHttpDate();
+    static QByteArray httpDate(const QDateTime &dt);
+    static bool matchesETag(const QString &header, const QString &etag);
+    static QString mimeType(const QString &fileName);
+
+    static QByteArray multipartBoundary();
+    static QByteArray multipartHeader(const QByteArray &boundary, const QString &contentType, const QDjangoHttpByteRange &range, qint64 size, bool first);
+    static QByteArray multipartTrailer(const QByteArray &boundary);
+    static bool parseRanges(const QDjangoHttpRequest &request, qint64 size, const QString &etag, const QDateTime &lastModified, QList<QDjangoHttpByteRange> &ranges);
+    static QDjangoHttpResponse *serveRangeNotSatisfiable(const QDjangoHttpRequest &request, qint64 size);
+};
+
+/** \internal
+ *
+ * The QDjangoHttpRangeDevice class presents a sequence of in-memory
+ * data and ranges of a source device as a single random-access device.
+ * It is used to serve multipart/byteranges responses without reading
+ * the whole source.
+ */
+class QDjangoHttpRangeDevice : public QIODevice
+{
+public:
+    QDjangoHttpRangeDevice(QIODevice *source, QObject *parent = 0);
+
+    void addData(const QByteArray &data);
+    void addRange(qint64 offset, qint64 length);
+
+    bool isSequential() const;
+    bool seek(qint64 pos);
+    qint64 size() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+    class Segment
+    {
+    public:
+        QByteArray data;
+        qint64 offset;
+        qint64 length;
+    };
+    QList<Segment> m_segments;
+    qint64 m_pos;
+    qint64 m_size;
+    QIODevice *m_source;
+};
+
+#endif
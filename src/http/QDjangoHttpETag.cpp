@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <cstring>
+
+#include <QtEndian>
+
+#include "QDjangoHttpController_p.h"
+#include "QDjangoHttpETag_p.h"
+#include "QDjangoHttpRequest.h"
+#include "QDjangoHttpResponse.h"
+#include "QDjangoHttpResponse_p.h"
+
+// the primes of the XXH64 algorithm
+static const quint64 prime1 = Q_UINT64_C(11400714785074694791);
+static const quint64 prime2 = Q_UINT64_C(14029467366897019727);
+static const quint64 prime3 = Q_UINT64_C(1609587929392839161);
+static const quint64 prime4 = Q_UINT64_C(9650029242287828579);
+static const quint64 prime5 = Q_UINT64_C(2870177450012600261);
+
+static inline quint64 rotateLeft(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline quint64 read64(const uchar *p)
+{
+    quint64 value;
+    memcpy(&value, p, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+static inline quint32 read32(const uchar *p)
+{
+    quint32 value;
+    memcpy(&value, p, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+static inline quint64 xxhRound(quint64 acc, quint64 input)
+{
+    acc += input * prime2;
+    acc = rotateLeft(acc, 31);
+    return acc * prime1;
+}
+
+static inline quint64 mergeRound(quint64 acc, quint64 value)
+{
+    acc ^= xxhRound(0, value);
+    return acc * prime1 + prime4;
+}
+
+/** Returns the XXH64 hash of \a data, with a seed of 0.
+ *
+ * This is a fast non-cryptographic hash, which is only used to detect
+ * changes in a response's body.
+ */
+quint64 QDjangoHttpETag::hash(const QByteArray &data)
+{
+    const uchar *p = reinterpret_cast<const uchar*>(data.constData());
+    const uchar *end = p + data.size();
+    quint64 h;
+
+    if (data.size() >= 32) {
+        // consume the data in stripes of 32 bytes
+        const uchar *limit = end - 32;
+        quint64 v1 = prime1 + prime2;
+        quint64 v2 = prime2;
+        quint64 v3 = 0;
+        quint64 v4 = 0 - prime1;
+        do {
+            v1 = xxhRound(v1, read64(p));
+            v2 = xxhRound(v2, read64(p + 8));
+            v3 = xxhRound(v3, read64(p + 16));
+            v4 = xxhRound(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = prime5;
+    }
+    h += quint64(data.size());
+
+    // consume the remaining bytes
+    while (p + 8 <= end) {
+        h ^= xxhRound(0, read64(p));
+        h = rotateLeft(h, 27) * prime1 + prime4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= quint64(read32(p)) * prime1;
+        h = rotateLeft(h, 23) * prime2 + prime3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * prime5;
+        h = rotateLeft(h, 11) * prime1;
+        p++;
+    }
+
+    // avalanche
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+/** Sets a weak entity tag on a successful response to a GET \a request, and turns the \a response into a bodiless 304 Not
+ *  Modified response if the request's If-None-Match header matches it.
+ *
+ * Responses which already carry an entity tag and responses whose
+ * body is read from a device are left untouched.
+ */
+void QDjangoHttpETag::tagResponse(const QDjangoHttpRequest &request, QDjangoHttpResponse *response)
+{
+    QDjangoHttpResponsePrivate *d = response->d;
+    if (request.method() != QLatin1String("GET") ||
+        d->statusCode != QDjangoHttpResponse::OK ||
+        d->bodyDevice ||
+        !response->header(QLatin1String("ETag")).isEmpty() ||
+        !response->header(QLatin1String("Content-Encoding")).isEmpty())
+        return;
+
+    // the body may not match the length announced by the handler
+    if (response->header(QLatin1String("Content-Length")) != QString::number(d->body.size()))
+        return;
+
+    const QString etag = QLatin1String("W/\"") + QString::number(hash(d->body), 16).rightJustified(16, QLatin1Char('0')) + QLatin1Char('"');
+    response->setHeader(QLatin1String("ETag"), etag);
+
+    if (QDjangoHttpControllerPrivate::matchesETag(request.meta(QLatin1String("HTTP_IF_NONE_MATCH")), etag)) {
+        response->setStatusCode(QDjangoHttpResponse::NotModified);
+        response->setBody(QByteArray());
+        d->removeHeader("Content-Type");
+    }
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_HTTP_ETAG_P_H
+#define QDJANGO_HTTP_ETAG_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QDjango API.
+//
+
+#include <QByteArray>
+#include <QString>
+
+class QDjangoHttpRequest;
+class QDjangoHttpResponse;
+
+/** \internal
+ *
+ * The QDjangoHttpETag class tags dynamic responses with a weak entity
+ * tag computed from their body, and answers conditional requests.
+ */
+class QDjangoHttpETag
+{
+public:
+    static quint64 hash(const QByteArray &data);
+    static void tagResponse(const QDjangoHttpRequest &request, QDjangoHttpResponse *response);
+};
+
+#endif
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include "QDjangoHttpLimits.h"
+
+/// \cond
+
+class QDjangoHttpLimitsPrivate : public QSharedData
+{
+public:
+    QDjangoHttpLimitsPrivate();
+
+    qint64 bodySpoolThreshold;
+    int bodyTimeout;
+    int headerTimeout;
+    int idleTimeout;
+    qint64 maximumBodySize;
+    int maximumConnections;
+    int maximumHeaderCount;
+    int maximumHeaderSize;
+};
+
+QDjangoHttpLimitsPrivate::QDjangoHttpLimitsPrivate()
+    : bodySpoolThreshold(1024 * 1024)
+    , bodyTimeout(60000)
+    , headerTimeout(30000)
+    , idleTimeout(120000)
+    , maximumBodySize(10 * 1024 * 1024)
+    , maximumConnections(0)
+    , maximumHeaderCount(100)
+    , maximumHeaderSize(16384)
+{
+}
+
+/// \endcond
+
+/** Constructs the default limits.
+ *
+ * By default, the number of connections is unlimited, idle connections
+ * are closed after 2 minutes, request headers must be received within
+ * 30 seconds and request bodies must not stall for more than a minute.
+ * Request headers are limited to 100 fields and 16KB, request bodies
+ * are limited to 10MB and bodies larger than 1MB are spooled to a
+ * temporary file.
+ */
+QDjangoHttpLimits::QDjangoHttpLimits()
+{
+    d = new QDjangoHttpLimitsPrivate;
+}
+
+/** Constructs a copy of \a other.
+ */
+QDjangoHttpLimits::QDjangoHttpLimits(const QDjangoHttpLimits &other)
+    : d(other.d)
+{
+}
+
+/** Destroys the limits.
+ */
+QDjangoHttpLimits::~QDjangoHttpLimits()
+{
+}
+
+/** Assigns \a other to these limits.
+ */
+QDjangoHttpLimits& QDjangoHttpLimits::operator=(const QDjangoHttpLimits &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/** Returns the size in bytes above which the body of a request is
+ *  written to a temporary file instead of being held in memory.
+ */
+qint64 QDjangoHttpLimits::bodySpoolThreshold() const
+{
+    return d->bodySpoolThreshold;
+}
+
+/** Sets the size in bytes above which the body of a request is written
+ *  to a temporary file instead of being held in memory. A value of 0
+ *  keeps all bodies in memory.
+ *
+ * Past this size, the raw bytes of a multipart/form-data body are not
+ * kept at all, since its uploaded files are already written to their
+ * own temporary files, unless the route reads the body as it arrives.
+ * The form data of a spooled body is still decoded, but the body is
+ * never loaded back into memory by QDjangoHttpRequest::body().
+ *
+ * \param size
+ */
+void QDjangoHttpLimits::setBodySpoolThreshold(qint64 size)
+{
+    d->bodySpoolThreshold = size;
+}
+
+/** Returns the maximum time in milliseconds during which the body of
+ *  a request may not make any progress.
+ */
+int QDjangoHttpLimits::bodyTimeout() const
+{
+    return d->bodyTimeout;
+}
+
+/** Sets the maximum time in milliseconds during which the body of
+ *  a request may not make any progress.
+ *
+ * \param msecs
+ */
+void QDjangoHttpLimits::setBodyTimeout(int msecs)
+{
+    d->bodyTimeout = msecs;
+}
+
+/** Returns the time in milliseconds within which the header of
+ *  a request must be received, once it has started.
+ */
+int QDjangoHttpLimits::headerTimeout() const
+{
+    return d->headerTimeout;
+}
+
+/** Sets the time in milliseconds within which the header of
+ *  a request must be received, once it has started.
+ *
+ * This protects against clients which send their request header
+ * slowly to tie up connections.
+ *
+ * \param msecs
+ */
+void QDjangoHttpLimits::setHeaderTimeout(int msecs)
+{
+    d->headerTimeout = msecs;
+}
+
+/** Returns the time in milliseconds after which a connection which
+ *  has no request in progress is closed.
+ */
+int QDjangoHttpLimits::idleTimeout() const
+{
+    return d->idleTimeout;
+}
+
+/** Sets the time in milliseconds after which a connection which
+ *  has no request in progress is closed.
+ *
+ * \param msecs
+ */
+void QDjangoHttpLimits::setIdleTimeout(int msecs)
+{
+    d->idleTimeout = msecs;
+}
+
+/** Returns the maximum size in bytes of the body of a request.
+ */
+qint64 QDjangoHttpLimits::maximumBodySize() const
+{
+    return d->maximumBodySize;
+}
+
+/** Sets the maximum size in bytes of the body of a request. Connections
+ *  which announce or send a larger body are closed.
+ *
+ * The limit can be raised or lowered for the routes of a given
+ * resolver using QDjangoUrlResolver::setMaximumBodySize().
+ *
+ * \param size
+ */
+void QDjangoHttpLimits::setMaximumBodySize(qint64 size)
+{
+    d->maximumBodySize = size;
+}
+
+/** Returns the maximum number of concurrent connections.
+ */
+int QDjangoHttpLimits::maximumConnections() const
+{
+    return d->maximumConnections;
+}
+
+/** Sets the maximum number of concurrent \a connections. Connections
+ *  above this number are closed as soon as they are accepted.
+ *
+ * \param connections
+ */
+void QDjangoHttpLimits::setMaximumConnections(int connections)
+{
+    d->maximumConnections = connections;
+}
+
+/** Returns the maximum number of header fields in a request.
+ */
+int QDjangoHttpLimits::maximumHeaderCount() const
+{
+    return d->maximumHeaderCount;
+}
+
+/** Sets the maximum number of header fields in a request. For the
+ *  FastCGI server, this limits the number of parameters.
+ *
+ * \param count
+ */
+void QDjangoHttpLimits::setMaximumHeaderCount(int count)
+{
+    d->maximumHeaderCount = count;
+}
+
+/** Returns the maximum size in bytes of the header of a request.
+ */
+int QDjangoHttpLimits::maximumHeaderSize() const
+{
+    return d->maximumHeaderSize;
+}
+
+/** Sets the maximum size in bytes of the header of a request. For the
+ *  FastCGI server, this limits the size of the parameters.
+ *
+ * \param size
+ */
+void QDjangoHttpLimits::setMaximumHeaderSize(int size)
+{
+    d->maximumHeaderSize = size;
+}
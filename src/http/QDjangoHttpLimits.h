@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_HTTP_LIMITS_H
+#define QDJANGO_HTTP_LIMITS_H
+
+#include <QSharedDataPointer>
+
+#include "QDjangoHttp_p.h"
+
+class QDjangoHttpLimitsPrivate;
+
+/** \brief The QDjangoHttpLimits class holds the limits which a server
+ *  enforces on its connections.
+ *
+ * The limits protect a server against clients which hold on to
+ * connections without making progress, or which send oversized
+ * requests. A connection which exceeds a limit is closed and counted
+ * as rejected.
+ *
+ * Timeouts are expressed in milliseconds, and a value of 0 disables the
+ * corresponding limit.
+ *
+ * \ingroup Http
+ * \sa QDjangoHttpServer::setLimits(), QDjangoFastCgiServer::setLimits()
+ */
+class QDJANGO_HTTP_EXPORT QDjangoHttpLimits
+{
+public:
+    QDjangoHttpLimits();
+    QDjangoHttpLimits(const QDjangoHttpLimits &other);
+    ~QDjangoHttpLimits();
+
+    QDjangoHttpLimits& operator=(const QDjangoHttpLimits &other);
+
+    qint64 bodySpoolThreshold() const;
+    void setBodySpoolThreshold(qint64 size);
+
+    int bodyTimeout() const;
+    void setBodyTimeout(int msecs);
+
+    int headerTimeout() const;
+    void setHeaderTimeout(int msecs);
+
+    int idleTimeout() const;
+    void setIdleTimeout(int msecs);
+
+    qint64 maximumBodySize() const;
+    void setMaximumBodySize(qint64 size);
+
+    int maximumConnections() const;
+    void setMaximumConnections(int connections);
+
+    int maximumHeaderCount() const;
+    void setMaximumHeaderCount(int count);
+
+    int maximumHeaderSize() const;
+    void setMaximumHeaderSize(int size);
+
+private:
+    QSharedDataPointer<QDjangoHttpLimitsPrivate> d;
+};
+
+#endif
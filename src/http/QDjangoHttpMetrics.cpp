@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <QElapsedTimer>
+#include <QList>
+
+#include "QDjangoHttpMetrics.h"
+#include "QDjangoHttpMetrics_p.h"
+#include "QDjangoHttpRequest.h"
+#include "QDjangoHttpResponse.h"
+
+// largest power of two covered by a histogram
+#define HISTOGRAM_MAX_EXPONENT 39
+
+/// \cond
+
+class QDjangoHttpClock
+{
+public:
+    QDjangoHttpClock()
+    {
+        timer.start();
+    }
+
+    QElapsedTimer timer;
+};
+
+static QDjangoHttpClock httpClock;
+
+static const char *phaseNames[QDjangoHttpMetrics::PhaseCount] = {
+    "accept", "header", "route", "handler", "ready", "write"
+};
+
+QDjangoHttpHistogram::QDjangoHttpHistogram()
+    : m_count(0)
+    , m_maximum(0)
+    , m_sum(0)
+{
+    memset(m_buckets, 0, sizeof(m_buckets));
+}
+
+/** Records the given \a value.
+ */
+void QDjangoHttpHistogram::add(qint64 value)
+{
+    m_buckets[bucketIndex(value)]++;
+    m_count++;
+    m_sum += value;
+    if (value > m_maximum)
+        m_maximum = value;
+}
+
+/** Returns the number of recorded values.
+ */
+qint64 QDjangoHttpHistogram::count() const
+{
+    return m_count;
+}
+
+/** Returns the largest recorded value.
+ */
+qint64 QDjangoHttpHistogram::maximum() const
+{
+    return m_maximum;
+}
+
+/** Returns the value below which the given \a fraction of the
+ *  recorded values fall.
+ */
+qint64 QDjangoHttpHistogram::percentile(double fraction) const
+{
+    if (!m_count)
+        return 0;
+
+    const qint64 target = qMax(qint64(1), qint64(fraction * m_count + 0.5));
+    qint64 seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += m_buckets[i];
+        if (seen >= target)
+            return qMin(bucketUpperBound(i), m_maximum);
+    }
+    return m_maximum;
+}
+
+/** Returns the sum of the recorded values.
+ */
+qint64 QDjangoHttpHistogram::sum() const
+{
+    return m_sum;
+}
+
+/** Returns the index of the bucket holding the given \a value.
+ */
+int QDjangoHttpHistogram::bucketIndex(qint64 value)
+{
+    if (value < 16)
+        return value < 0 ? 0 : int(value);
+
+    int exponent = 4;
+    while (exponent < HISTOGRAM_MAX_EXPONENT && (value >> (exponent + 1)))
+        exponent++;
+    if (value >> (exponent + 1))
+        return HISTOGRAM_BUCKETS - 1;
+    return (exponent - 3) * 16 + int((value >> (exponent - 4)) & 15);
+}
+
+/** Returns the largest value held by the bucket with the given \a index.
+ */
+qint64 QDjangoHttpHistogram::bucketUpperBound(int index)
+{
+    if (index < 16)
+        return index;
+
+    const int shift = index / 16 - 1;
+    const qint64 lower = qint64(16 + index % 16) << shift;
+    return lower + (qint64(1) << shift) - 1;
+}
+
+QDjangoHttpMetricsPrivate::QDjangoHttpMetricsPrivate()
+    : activeConnections(0)
+    , activeRequests(0)
+    , bytesReceived(0)
+    , bytesSent(0)
+    , connectionCount(0)
+    , rejectedConnections(0)
+    , requestCount(0)
+{
+}
+
+QDjangoHttpMetricsPrivate::~QDjangoHttpMetricsPrivate()
+{
+    qDeleteAll(routeHistograms);
+}
+
+/** Returns the time elapsed on a monotonic clock, in microseconds.
+ */
+qint64 QDjangoHttpMetricsPrivate::now()
+{
+    return httpClock.timer.nsecsElapsed() / 1000;
+}
+
+/** Records a request which was served by the given \a route, whose
+ *  phases occurred at the given \a timestamps.
+ */
+void QDjangoHttpMetricsPrivate::requestFinished(const QByteArray &route, const qint64 *timestamps, int statusCode)
+{
+    activeRequests--;
+    requestCount++;
+
+    // a phase which did not occur, such as routing a request for an
+    // unknown path, is accounted to the next one
+    qint64 previous = timestamps[QDjangoHttpMetrics::AcceptPhase];
+    for (int i = QDjangoHttpMetrics::HeaderPhase; i < QDjangoHttpMetrics::PhaseCount; ++i) {
+        if (timestamps[i]) {
+            if (previous)
+                phaseHistograms[i].add(timestamps[i] - previous);
+            previous = timestamps[i];
+        }
+    }
+
+    QDjangoHttpHistogram *&histogram = routeHistograms[qMakePair(route, qBound(1, statusCode / 100, 5))];
+    if (!histogram)
+        histogram = new QDjangoHttpHistogram;
+    histogram->add(timestamps[QDjangoHttpMetrics::WrittenPhase] - timestamps[QDjangoHttpMetrics::HeaderPhase]);
+}
+
+static QByteArray seconds(qint64 usecs)
+{
+    return QByteArray::number(usecs / 1000000.0, 'f', 6);
+}
+
+static void writeValue(QByteArray &text, const char *name, const char *type, qint64 value)
+{
+    text += "# TYPE ";
+    text += name;
+    text += ' ';
+    text += type;
+    text += '\n';
+    text += name;
+    text += ' ';
+    text += QByteArray::number(value);
+    text += '\n';
+}
+
+static void writeSummary(QByteArray &text, const char *name, const QByteArray &labels, const QDjangoHttpHistogram &histogram)
+{
+    static const double quantiles[] = {0.5, 0.9, 0.99};
+    for (int i = 0; i < 3; ++i) {
+        text += name;
+        text += '{' + labels + ",quantile=\"" + QByteArray::number(quantiles[i]) + "\"} ";
+        text += seconds(histogram.percentile(quantiles[i])) + '\n';
+    }
+    text += name;
+    text += "_sum{" + labels + "} " + seconds(histogram.sum()) + '\n';
+    text += name;
+    text += "_count{" + labels + "} " + QByteArray::number(histogram.count()) + '\n';
+}
+
+/// \endcond
+
+/** Constructs a new set of metrics.
+ *
+ * \param parent
+ */
+QDjangoHttpMetrics::QDjangoHttpMetrics(QObject *parent)
+    : QObject(parent)
+    , d(new QDjangoHttpMetricsPrivate)
+{
+}
+
+/** Destroys the metrics.
+ */
+QDjangoHttpMetrics::~QDjangoHttpMetrics()
+{
+    delete d;
+}
+
+/** Returns the number of open connections.
+ */
+int QDjangoHttpMetrics::activeConnections() const
+{
+    return d->activeConnections;
+}
+
+/** Returns the number of requests which are being handled, that is
+ *  requests which were dispatched to a handler and whose response
+ *  has not been completely written.
+ */
+int QDjangoHttpMetrics::activeRequests() const
+{
+    return d->activeRequests;
+}
+
+/** Returns the number of bytes received from clients.
+ */
+qint64 QDjangoHttpMetrics::bytesReceived() const
+{
+    return d->bytesReceived;
+}
+
+/** Returns the number of bytes sent to clients.
+ */
+qint64 QDjangoHttpMetrics::bytesSent() const
+{
+    return d->bytesSent;
+}
+
+/** Returns the number of connections which were accepted.
+ */
+qint64 QDjangoHttpMetrics::connectionCount() const
+{
+    return d->connectionCount;
+}
+
+/** Returns the number of connections which were closed because they
+ *  exceeded the server's limits.
+ */
+int QDjangoHttpMetrics::rejectedConnections() const
+{
+    return d->rejectedConnections;
+}
+
+/** Returns the number of requests whose response was completely written.
+ */
+qint64 QDjangoHttpMetrics::requestCount() const
+{
+    return d->requestCount;
+}
+
+/** Returns a snapshot of the metrics in the Prometheus text format.
+ *
+ * Durations are expressed in seconds. The duration of each phase is
+ * measured from the previous phase, and the latency of a route from
+ * the parsing of the request header to the writing of the last byte
+ * of the response.
+ */
+QByteArray QDjangoHttpMetrics::snapshot() const
+{
+    QByteArray text;
+    writeValue(text, "qdjango_connections", "gauge", d->activeConnections);
+    writeValue(text, "qdjango_connections_total", "counter", d->connectionCount);
+    writeValue(text, "qdjango_connections_rejected_total", "counter", d->rejectedConnections);
+    writeValue(text, "qdjango_requests", "gauge", d->activeRequests);
+    writeValue(text, "qdjango_requests_total", "counter", d->requestCount);
+    writeValue(text, "qdjango_received_bytes_total", "counter", d->bytesReceived);
+    writeValue(text, "qdjango_sent_bytes_total", "counter", d->bytesSent);
+
+    text += "# TYPE qdjango_phase_seconds summary\n";
+    for (int i = HeaderPhase; i < PhaseCount; ++i) {
+        const QByteArray labels = QByteArray("phase=\"") + phaseNames[i] + '"';
+        writeSummary(text, "qdjango_phase_seconds", labels, d->phaseHistograms[i]);
+    }
+
+    text += "# TYPE qdjango_request_seconds summary\n";
+    QList<QPair<QByteArray, int> > keys = d->routeHistograms.keys();
+    qSort(keys);
+    foreach (const QPair<QByteArray, int> &key, keys) {
+        const QByteArray labels = "route=\"" + key.first + "\",status=\"" + QByteArray::number(key.second) + "xx\"";
+        writeSummary(text, "qdjango_request_seconds", labels, *d->routeHistograms.value(key));
+    }
+    return text;
+}
+
+/** Serves a snapshot of the metrics.
+ *
+ * The metrics are read without locking, so the handler must run on the
+ * server's thread.
+ *
+ * \param request
+ * \sa snapshot()
+ */
+QDjangoHttpResponse *QDjangoHttpMetrics::serveSnapshot(const QDjangoHttpRequest &request)
+{
+    Q_UNUSED(request);
+
+    QDjangoHttpResponse *response = new QDjangoHttpResponse;
+    response->setStatusCode(QDjangoHttpResponse::OK);
+    response->setHeader(QLatin1String("Content-Type"), QLatin1String("text/plain; version=0.0.4"));
+    response->setHeader(QLatin1String("Cache-Control"), QLatin1String("no-cache"));
+    response->setBody(snapshot());
+    return response;
+}
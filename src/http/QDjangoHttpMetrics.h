@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_HTTP_METRICS_H
+#define QDJANGO_HTTP_METRICS_H
+
+#include <QObject>
+
+#include "QDjangoHttp_p.h"
+
+class QDjangoHttpMetricsPrivate;
+class QDjangoHttpRequest;
+class QDjangoHttpResponse;
+
+/** \brief The QDjangoHttpMetrics class holds the metrics of a server.
+ *
+ * It counts the connections, requests and bytes handled by a
+ * QDjangoHttpServer or QDjangoFastCgiServer, and keeps histograms of
+ * the time spent in each phase of a request as well as of the latency
+ * of each route by class of status code.
+ *
+ * The metrics are updated by the server's thread without locking, so
+ * they should only be read from that thread. The simplest way to expose
+ * them is to register serveSnapshot() with the server:
+ *
+ * \code
+ * server->urls()->set(QRegExp("^metrics$"), server->metrics(), "serveSnapshot");
+ * \endcode
+ *
+ * This route must not run on a thread pool, so do not register it with a
+ * resolver which has one, see QDjangoUrlResolver::setThreadPool().
+ *
+ * \ingroup Http
+ */
+class QDJANGO_HTTP_EXPORT QDjangoHttpMetrics : public QObject
+{
+    Q_OBJECT
+
+public:
+    /** The phases of a request, in the order in which they occur.
+     */
+    enum Phase {
+        AcceptPhase = 0,    ///< the connection was accepted, or for later requests on the connection, the request started arriving
+        HeaderPhase,        ///< the request header was parsed
+        RoutePhase,         ///< the request was routed to a handler
+        HandlerPhase,       ///< the handler returned
+        ReadyPhase,         ///< the response was ready to be written
+        WrittenPhase,       ///< the last byte of the response was handed to the socket
+        PhaseCount
+    };
+
+    QDjangoHttpMetrics(QObject *parent = 0);
+    ~QDjangoHttpMetrics();
+
+    int activeConnections() const;
+    int activeRequests() const;
+    qint64 bytesReceived() const;
+    qint64 bytesSent() const;
+    qint64 connectionCount() const;
+    int rejectedConnections() const;
+    qint64 requestCount() const;
+    QByteArray snapshot() const;
+
+public slots:
+    QDjangoHttpResponse *serveSnapshot(const QDjangoHttpRequest &request);
+
+private:
+    Q_DISABLE_COPY(QDjangoHttpMetrics)
+    QDjangoHttpMetricsPrivate* const d;
+    friend class QDjangoFastCgiConnection;
+    friend class QDjangoFastCgiServer;
+    friend class QDjangoFastCgiServerPrivate;
+    friend class QDjangoHttpConnection;
+    friend class QDjangoHttpServer;
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_HTTP_METRICS_P_H
+#define QDJANGO_HTTP_METRICS_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QDjango API.
+//
+
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+
+#include "QDjangoHttp_p.h"
+#include "QDjangoHttpMetrics.h"
+
+// number of buckets of a histogram, covering values up to 2^40
+#define HISTOGRAM_BUCKETS 592
+
+/** \internal
+ *
+ * A histogram with logarithmic buckets, each power of two being split
+ * into 16 linear sub-buckets, so that values are recorded with a
+ * precision of about 6%.
+ */
+class QDJANGO_HTTP_AUTOTEST_EXPORT QDjangoHttpHistogram
+{
+public:
+    QDjangoHttpHistogram();
+
+    void add(qint64 value);
+    qint64 count() const;
+    qint64 maximum() const;
+    qint64 percentile(double fraction) const;
+    qint64 sum() const;
+
+    static int bucketIndex(qint64 value);
+    static qint64 bucketUpperBound(int index);
+
+private:
+    quint32 m_buckets[HISTOGRAM_BUCKETS];
+    qint64 m_count;
+    qint64 m_maximum;
+    qint64 m_sum;
+};
+
+/** \internal
+ */
+class QDjangoHttpMetricsPrivate
+{
+public:
+    QDjangoHttpMetricsPrivate();
+    ~QDjangoHttpMetricsPrivate();
+
+    static qint64 now();
+    void requestFinished(const QByteArray &route, const qint64 *timestamps, int statusCode);
+
+    int activeConnections;
+    int activeRequests;
+    qint64 bytesReceived;
+    qint64 bytesSent;
+    qint64 connectionCount;
+    int rejectedConnections;
+    qint64 requestCount;
+
+    // the duration of each phase, since the previous one
+    QDjangoHttpHistogram phaseHistograms[QDjangoHttpMetrics::PhaseCount];
+
+    // the latency of each route, by class of status code
+    QHash<QPair<QByteArray, int>, QDjangoHttpHistogram*> routeHistograms;
+};
+
+#endif
@@ -16,14 +16,190 @@
  */
 
 #include <QIODevice>
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
-#include <QUrlQuery>
-#else
-#include <QUrl>
-#endif
+#include <QTemporaryFile>
 
 #include "QDjangoHttpRequest.h"
+#include "QDjangoHttpRequestBody_p.h"
 #include "QDjangoHttpRequest_p.h"
+#include "QDjangoUrlResolver_p.h"
+
+// size of the chunks in which a spooled form is decoded
+#define SPOOLED_CHUNK_SIZE (64 * 1024)
+
+QDjangoHttpRequestPrivate::QDjangoHttpRequestPrivate()
+    : getParsed(false)
+    , postParsed(false)
+{
+    memset(timestamps, 0, sizeof(timestamps));
+}
+
+/** Returns the body of the request, creating it from the buffer if
+ *  it was not received by a server.
+ */
+QDjangoHttpRequestBody *QDjangoHttpRequestPrivate::body() const
+{
+    if (!bodyDevice) {
+        bodyDevice = QSharedPointer<QDjangoHttpRequestBody>(new QDjangoHttpRequestBody(metaValue(QLatin1String("CONTENT_TYPE")).toLatin1(), 0, 0));
+        bodyDevice->append(buffer.constData(), buffer.size());
+        bodyDevice->finish();
+    }
+    return bodyDevice.data();
+}
+
+/** Adds a meta-information pair, which is only decoded when it is
+ *  looked up.
+ *
+ * The \a name is Latin-1 and the \a value is UTF-8 encoded.
+ */
+void QDjangoHttpRequestPrivate::addRawMeta(const QByteArray &name, const QByteArray &value)
+{
+    QDjangoHttpRawMeta item;
+    item.offset = rawMeta.size();
+    item.nameLength = name.size();
+    item.valueLength = value.size();
+    rawMeta.append(name);
+    rawMeta.append(value);
+    rawMetaIndex.append(item);
+}
+
+/** Returns the meta-information for the given \a key, decoding it from
+ *  the raw pairs on first use.
+ */
+QString QDjangoHttpRequestPrivate::metaValue(const QString &key) const
+{
+    QMap<QString, QString>::ConstIterator it = meta.constFind(key);
+    if (it != meta.constEnd())
+        return it.value();
+
+    // the last pair with a given name wins
+    const QByteArray name = key.toLatin1();
+    for (int i = rawMetaIndex.size() - 1; i >= 0; --i) {
+        const QDjangoHttpRawMeta &item = rawMetaIndex.at(i);
+        const char *data = rawMeta.constData() + item.offset;
+        if (item.nameLength == name.size() && !memcmp(data, name.constData(), item.nameLength)) {
+            const QString value = QString::fromUtf8(data + item.nameLength, item.valueLength);
+            meta.insert(key, value);
+            return value;
+        }
+    }
+    return QString();
+}
+
+/** Returns the decoded query string, parsing it on first use.
+ */
+const QHash<QString, QStringList> &QDjangoHttpRequestPrivate::getItems() const
+{
+    if (!getParsed) {
+        parseUrlEncoded(metaValue(QLatin1String("QUERY_STRING")).toUtf8(), getData);
+        getParsed = true;
+    }
+    return getData;
+}
+
+/** Returns the decoded form data, parsing the body on first use.
+ *
+ * Bodies of type multipart/form-data are split into their parts as they
+ * arrive, any other body is decoded as application/x-www-form-urlencoded,
+ * reading it back from its temporary file if it was spooled.
+ * Until the whole body has arrived, no form data is returned.
+ */
+const QHash<QString, QStringList> &QDjangoHttpRequestPrivate::postItems() const
+{
+    if (!postParsed) {
+        QDjangoHttpRequestBody *device = body();
+        if (!device->isFinished())
+            return postData;
+        if (device->multipart()) {
+            postData = device->multipart()->fields;
+        } else if (!device->isSpooled()) {
+            parseUrlEncoded(device->data(), postData);
+        } else {
+            // a spooled body is decoded a chunk at a time, up to the last
+            // separator read so far
+            QByteArray pending;
+            qint64 pos = 0;
+            for (;;) {
+                const QByteArray chunk = device->dataAt(pos, SPOOLED_CHUNK_SIZE);
+                if (chunk.isEmpty())
+                    break;
+                pos += chunk.size();
+                pending += chunk;
+                const int end = pending.lastIndexOf('&');
+                if (end >= 0) {
+                    parseUrlEncoded(pending.left(end), postData);
+                    pending.remove(0, end + 1);
+                }
+            }
+            parseUrlEncoded(pending, postData);
+        }
+        postParsed = true;
+    }
+    return postData;
+}
+
+/** Parses the parameters of a header \a value such as:
+ *
+ * \code
+ * form-data; name="field"; filename="file.txt"
+ * \endcode
+ *
+ * The parameter names are returned in lower case and quoted values are
+ * unquoted.
+ */
+QMap<QByteArray, QByteArray> QDjangoHttpRequestPrivate::parseHeaderParameters(const QByteArray &value)
+{
+    QMap<QByteArray, QByteArray> parameters;
+    int pos = value.indexOf(';');
+    while (pos >= 0 && pos < value.size()) {
+        // read the name
+        const int equals = value.indexOf('=', pos + 1);
+        if (equals < 0)
+            break;
+        const QByteArray name = value.mid(pos + 1, equals - pos - 1).trimmed().toLower();
+
+        // read the value, which may be a quoted string
+        QByteArray parameter;
+        pos = equals + 1;
+        while (pos < value.size() && value.at(pos) == ' ')
+            ++pos;
+        if (pos < value.size() && value.at(pos) == '"') {
+            for (++pos; pos < value.size() && value.at(pos) != '"'; ++pos) {
+                if (value.at(pos) == '\\' && pos + 1 < value.size())
+                    ++pos;
+                parameter += value.at(pos);
+            }
+            pos = value.indexOf(';', pos);
+        } else {
+            const int end = value.indexOf(';', pos);
+            parameter = value.mid(pos, end < 0 ? -1 : end - pos).trimmed();
+            pos = end;
+        }
+        parameters.insert(name, parameter);
+    }
+    return parameters;
+}
+
+/** Decodes application/x-www-form-urlencoded \a data, such as a query
+ *  string, and adds its fields to \a items.
+ */
+void QDjangoHttpRequestPrivate::parseUrlEncoded(const QByteArray &data, QHash<QString, QStringList> &items)
+{
+    int pos = 0;
+    while (pos < data.size()) {
+        int end = data.indexOf('&', pos);
+        if (end < 0)
+            end = data.size();
+        if (end > pos) {
+            QByteArray pair = data.mid(pos, end - pos);
+            pair.replace('+', ' ');
+            const int equals = pair.indexOf('=');
+            const QByteArray key = QByteArray::fromPercentEncoding(equals < 0 ? pair : pair.left(equals));
+            const QByteArray value = equals < 0 ? QByteArray() : QByteArray::fromPercentEncoding(pair.mid(equals + 1));
+            items[QString::fromUtf8(key)] << QString::fromUtf8(value);
+        }
+        pos = end + 1;
+    }
+}
 
 /** Constructs a new HTTP request.
  */
@@ -40,26 +216,87 @@ QDjangoHttpRequest::~QDjangoHttpRequest()
 }
 
 /** Returns the raw body of the HTTP request.
+ *
+ * Bodies which exceed the server's spool threshold are not loaded back
+ * into memory, for those an empty array is returned. Use bodyDevice() to
+ * read such bodies incrementally, or post() and file() for the parts of
+ * a multipart/form-data body.
+ *
+ * \sa QDjangoHttpLimits::setBodySpoolThreshold()
  */
 QByteArray QDjangoHttpRequest::body() const
 {
-    return d->buffer;
+    return d->bodyDevice ? d->bodyDevice->data() : d->buffer;
+}
+
+/** Returns a sequential device from which the raw body of the HTTP
+ *  request can be read.
+ *
+ * For the routes of a resolver with streaming enabled, the handler is
+ * invoked as soon as the request header has been received. The device
+ * then emits readyRead() as the body arrives and readChannelFinished()
+ * once it is complete. Otherwise the whole body is available when the
+ * handler is invoked.
+ *
+ * \sa QDjangoUrlResolver::setStreamingEnabled()
+ */
+QIODevice *QDjangoHttpRequest::bodyDevice() const
+{
+    return d->body();
+}
+
+/** Returns the file uploaded for the given \a key in a
+ *  multipart/form-data body, or 0 if there is no such file.
+ *
+ * The contents of uploaded files are written straight to temporary
+ * files, which are removed along with the request. If several files
+ * were uploaded for the key, the first one is returned.
+ *
+ * \sa fileName()
+ */
+QIODevice *QDjangoHttpRequest::file(const QString &key) const
+{
+    QDjangoHttpRequestBody *device = d->body();
+    if (!device->isFinished() || !device->multipart())
+        return 0;
+    return device->multipart()->files.value(key).data();
+}
+
+/** Returns the name of the file uploaded for the given \a key, as
+ *  given by the client.
+ *
+ * \sa file()
+ */
+QString QDjangoHttpRequest::fileName(const QString &key) const
+{
+    QDjangoHttpRequestBody *device = d->body();
+    if (!device->isFinished() || !device->multipart())
+        return QString();
+    return device->multipart()->fileNames.value(key);
 }
 
 /** Returns the GET data for the given \a key.
+ *
+ * If the key appears several times in the query string, the first
+ * value is returned.
+ *
+ * \sa getList()
  */
 QString QDjangoHttpRequest::get(const QString &key) const
 {
-    QString queryString = d->meta.value(QLatin1String("QUERY_STRING"));
-    queryString.replace('+', ' ');
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
-    QUrlQuery query(queryString);
-    return query.queryItemValue(key, QUrl::FullyDecoded);
-#else
-    QUrl url;
-    url.setEncodedQuery(queryString.toLatin1());
-    return url.queryItemValue(key);
-#endif
+    const QHash<QString, QStringList> &items = d->getItems();
+    QHash<QString, QStringList>::ConstIterator it = items.constFind(key);
+    return it != items.constEnd() ? it.value().first() : QString();
+}
+
+/** Returns all the GET data for the given \a key, in the order in
+ *  which it appears in the query string.
+ *
+ * \sa get()
+ */
+QStringList QDjangoHttpRequest::getList(const QString &key) const
+{
+    return d->getItems().value(key);
 }
 
 /** Returns the specified HTTP request header.
@@ -68,7 +305,7 @@ QString QDjangoHttpRequest::get(const QString &key) const
  */
 QString QDjangoHttpRequest::meta(const QString &key) const
 {
-    return d->meta.value(key);
+    return d->metaValue(key);
 }
 
 /** Returns the HTTP request's method (e.g. GET, POST).
@@ -86,19 +323,28 @@ QString QDjangoHttpRequest::path() const
 }
 
 /** Returns the POST data for the given \a key.
+ *
+ * Both application/x-www-form-urlencoded and multipart/form-data
+ * bodies are supported. If the key appears several times, the first
+ * value is returned.
+ *
+ * \sa postList()
  */
 QString QDjangoHttpRequest::post(const QString &key) const
 {
-    QByteArray buffer = d->buffer;
-    buffer.replace('+', ' ');
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
-    QUrlQuery query(QString::fromUtf8(buffer));
-    return query.queryItemValue(key, QUrl::FullyDecoded);
-#else
-    QUrl url;
-    url.setEncodedQuery(buffer);
-    return url.queryItemValue(key);
-#endif
+    const QHash<QString, QStringList> &items = d->postItems();
+    QHash<QString, QStringList>::ConstIterator it = items.constFind(key);
+    return it != items.constEnd() ? it.value().first() : QString();
+}
+
+/** Returns all the POST data for the given \a key, in the order in
+ *  which it appears in the body.
+ *
+ * \sa post()
+ */
+QStringList QDjangoHttpRequest::postList(const QString &key) const
+{
+    return d->postItems().value(key);
 }
 
 QDjangoHttpTestRequest::QDjangoHttpTestRequest(const QString &method, const QString &path)
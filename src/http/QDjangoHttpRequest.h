@@ -18,11 +18,12 @@
 #ifndef QDJANGO_HTTP_REQUEST_H
 #define QDJANGO_HTTP_REQUEST_H
 
-#include <QString>
+#include <QStringList>
 
 #include "QDjangoHttp_p.h"
 
 class QDjangoHttpRequestPrivate;
+class QIODevice;
 
 /** \brief The QDjangoHttpRequest class represents an HTTP request.
  *
@@ -35,11 +36,16 @@ public:
     ~QDjangoHttpRequest();
 
     QByteArray body() const;
+    QIODevice *bodyDevice() const;
+    QIODevice *file(const QString &key) const;
+    QString fileName(const QString &key) const;
     QString get(const QString &key) const;
+    QStringList getList(const QString &key) const;
     QString meta(const QString &key) const;
     QString method() const;
     QString path() const;
     QString post(const QString &key) const;
+    QStringList postList(const QString &key) const;
 
 private:
     Q_DISABLE_COPY(QDjangoHttpRequest)
@@ -47,8 +53,12 @@ private:
     friend class QDjangoFastCgiConnection;
     friend class QDjangoHttpConnection;
     friend class QDjangoHttpTestRequest;
+    friend class QDjangoUrlResolverPrivate;
     friend class tst_QDjangoHttpController;
     friend class tst_QDjangoHttpRequest;
+    friend class tst_QDjangoHttpResponseCache;
+    friend class tst_QDjangoHttpStaticCache;
+    friend class tst_QDjangoUrlResolver;
 };
 
 /** \cond */
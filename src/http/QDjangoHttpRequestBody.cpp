@@ -0,0 +1,421 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <cstring>
+
+#include <QFile>
+#include <QTemporaryFile>
+
+#include "QDjangoHttpRequestBody_p.h"
+#include "QDjangoHttpRequest_p.h"
+
+// maximum size of the headers of a part
+#define MAX_PART_HEADER_SIZE (16 * 1024)
+
+/// \cond
+
+/** Constructs a parser for a body whose parts are delimited by the
+ *  given \a boundary.
+ *
+ * The line break which precedes a delimiter belongs to the delimiter,
+ * so the body is parsed as if it started with a line break.
+ */
+QDjangoHttpMultipartParser::QDjangoHttpMultipartParser(const QByteArray &boundary)
+    : m_buffer("\r\n")
+    , m_delimiter("\r\n--" + boundary)
+    , m_state(PreambleState)
+    , m_isFile(false)
+{
+}
+
+/** Feeds the next \a size bytes of the body at \a data to the parser.
+ *
+ * Returns false if the body is invalid or a file part could not be
+ * written.
+ */
+bool QDjangoHttpMultipartParser::write(const char *data, qint64 size)
+{
+    if (m_state == EpilogueState)
+        return true;
+    m_buffer.append(data, size);
+
+    for (;;) {
+        switch (m_state) {
+        case PreambleState: {
+            const int pos = m_buffer.indexOf(m_delimiter);
+            if (pos < 0) {
+                // keep what may be the start of a delimiter
+                m_buffer.remove(0, qMax(0, m_buffer.size() - m_delimiter.size() + 1));
+                return true;
+            }
+            m_buffer.remove(0, pos + m_delimiter.size());
+            m_state = DelimiterState;
+            break;
+        }
+        case DelimiterState: {
+            // the close delimiter ends the body, any other delimiter
+            // is followed by a line break
+            if (m_buffer.size() < 2)
+                return true;
+            if (m_buffer.startsWith("--")) {
+                m_buffer.clear();
+                m_state = EpilogueState;
+                return true;
+            }
+            const int pos = m_buffer.indexOf("\r\n");
+            if (pos < 0)
+                return m_buffer.size() <= MAX_PART_HEADER_SIZE;
+            m_buffer.remove(0, pos + 2);
+            m_state = HeaderState;
+            break;
+        }
+        case HeaderState: {
+            int pos = 0;
+            int length = 2;
+            if (!m_buffer.startsWith("\r\n")) {
+                pos = m_buffer.indexOf("\r\n\r\n");
+                length = 4;
+            }
+            if (pos < 0) {
+                if (m_buffer.size() > MAX_PART_HEADER_SIZE) {
+                    qWarning("Multipart body has a part header which is too large");
+                    return false;
+                }
+                return true;
+            }
+            if (!startPart(m_buffer.left(pos)))
+                return false;
+            m_buffer.remove(0, pos + length);
+            m_state = ContentState;
+            break;
+        }
+        case ContentState: {
+            const int pos = m_buffer.indexOf(m_delimiter);
+            if (pos < 0) {
+                // hand over the contents which cannot be part of a delimiter
+                const int length = m_buffer.size() - m_delimiter.size() + 1;
+                if (length > 0) {
+                    if (!writeContent(m_buffer.constData(), length))
+                        return false;
+                    m_buffer.remove(0, length);
+                }
+                return true;
+            }
+            if (!writeContent(m_buffer.constData(), pos))
+                return false;
+            finishPart();
+            m_buffer.remove(0, pos + m_delimiter.size());
+            m_state = DelimiterState;
+            break;
+        }
+        case EpilogueState:
+            return true;
+        }
+    }
+}
+
+/** Starts a part whose headers are given by \a header.
+ *
+ * Parts which carry a filename are written to a temporary file, unless
+ * no file was selected or a file was already received under the same
+ * name, in which case their contents are discarded.
+ */
+bool QDjangoHttpMultipartParser::startPart(const QByteArray &header)
+{
+    m_content.clear();
+    m_fileName.clear();
+    m_isFile = false;
+    m_name.clear();
+
+    foreach (const QByteArray &line, header.split('\n')) {
+        const int colon = line.indexOf(':');
+        if (colon < 0 || line.left(colon).trimmed().toLower() != "content-disposition")
+            continue;
+
+        const QMap<QByteArray, QByteArray> parameters = QDjangoHttpRequestPrivate::parseHeaderParameters(line.mid(colon + 1).trimmed());
+        m_name = QString::fromUtf8(parameters.value("name"));
+        if (parameters.contains("filename")) {
+            m_fileName = QString::fromUtf8(parameters.value("filename"));
+            m_isFile = true;
+        }
+    }
+
+    if (m_isFile && !m_fileName.isEmpty() && !files.contains(m_name)) {
+        m_file = QSharedPointer<QTemporaryFile>(new QTemporaryFile);
+        if (!m_file->open()) {
+            qWarning("Could not create temporary file for uploaded file");
+            m_file.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Stores the part which has been received.
+ */
+void QDjangoHttpMultipartParser::finishPart()
+{
+    if (m_file) {
+        m_file->seek(0);
+        files.insert(m_name, m_file);
+        fileNames.insert(m_name, m_fileName);
+        m_file.clear();
+    } else if (!m_isFile && !m_name.isEmpty()) {
+        fields[m_name] << QString::fromUtf8(m_content);
+        m_content.clear();
+    }
+}
+
+/** Appends \a size bytes at \a data to the contents of the current part.
+ */
+bool QDjangoHttpMultipartParser::writeContent(const char *data, qint64 size)
+{
+    if (m_file) {
+        if (m_file->write(data, size) != size) {
+            qWarning("Could not write uploaded file to temporary file");
+            return false;
+        }
+    } else if (!m_isFile) {
+        m_content.append(data, size);
+    }
+    return true;
+}
+
+/** Constructs a new request body.
+ *
+ * \param contentType the type of the body, multipart/form-data bodies are parsed as they arrive
+ * \param spoolThreshold the size above which the body is written to a temporary file, 0 for no limit
+ * \param maximumSize the maximum size of the body, 0 for no limit
+ * \param streamed true if the raw body is read as it arrives, otherwise the raw bytes of a
+ *                 multipart/form-data body are dropped once they exceed the spool threshold
+ * \param parent
+ */
+QDjangoHttpRequestBody::QDjangoHttpRequestBody(const QByteArray &contentType, qint64 spoolThreshold, qint64 maximumSize, bool streamed, QObject *parent)
+    : QIODevice(parent)
+    , m_dropped(false)
+    , m_file(0)
+    , m_finished(false)
+    , m_maximumSize(maximumSize)
+    , m_multipart(0)
+    , m_readPos(0)
+    , m_size(0)
+    , m_spoolThreshold(spoolThreshold)
+    , m_streamed(streamed)
+{
+    if (contentType.trimmed().toLower().startsWith("multipart/form-data")) {
+        const QByteArray boundary = QDjangoHttpRequestPrivate::parseHeaderParameters(contentType).value("boundary");
+        if (!boundary.isEmpty())
+            m_multipart = new QDjangoHttpMultipartParser(boundary);
+    }
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+QDjangoHttpRequestBody::~QDjangoHttpRequestBody()
+{
+    delete m_multipart;
+}
+
+/** Appends \a size bytes at \a data to the body.
+ *
+ * Returns false if the body exceeds its maximum size or could not be
+ * stored.
+ */
+bool QDjangoHttpRequestBody::append(const char *data, qint64 size)
+{
+    if (m_maximumSize > 0 && m_size + size > m_maximumSize) {
+        qWarning("HTTP request body is too large");
+        return false;
+    }
+
+    // move the body to a temporary file once it exceeds the threshold,
+    // unless the multipart parser already stores its parts and nobody
+    // reads the raw body
+    if (!m_file && !m_dropped && m_spoolThreshold > 0 && m_size + size > m_spoolThreshold) {
+        if (m_multipart && !m_streamed) {
+            m_dropped = true;
+            setErrorString(QLatin1String("The raw body was consumed by the multipart/form-data parser"));
+        } else {
+            QTemporaryFile *file = new QTemporaryFile;
+            m_spool = QSharedPointer<QTemporaryFile>(file);
+            m_file = file;
+            if (!file->open() || file->write(m_buffer) != m_buffer.size()) {
+                qWarning("Could not write HTTP request body to temporary file");
+                return false;
+            }
+        }
+        m_buffer.clear();
+    }
+
+    if (m_file) {
+        if (!m_file->seek(m_size) || m_file->write(data, size) != size) {
+            qWarning("Could not write HTTP request body to temporary file");
+            return false;
+        }
+    } else if (!m_dropped) {
+        m_buffer.append(data, size);
+    }
+    m_size += size;
+
+    if (m_multipart && !m_multipart->write(data, size))
+        return false;
+
+    emit readyRead();
+    return true;
+}
+
+/** Returns a finished copy of the body, which can be used from another
+ *  thread.
+ *
+ * The copy holds the bytes of a body which is kept in memory and shares
+ * the parts of a multipart body. It also shares the temporary file of a
+ * spooled body, which it reads through a file handle of its own.
+ */
+QDjangoHttpRequestBody *QDjangoHttpRequestBody::clone() const
+{
+    QDjangoHttpRequestBody *body = new QDjangoHttpRequestBody(QByteArray(), 0, 0);
+    body->m_buffer = m_buffer;
+    body->m_dropped = m_dropped;
+    body->m_finished = true;
+    body->m_size = m_size;
+    if (m_dropped)
+        body->setErrorString(errorString());
+    if (m_multipart)
+        body->m_multipart = new QDjangoHttpMultipartParser(*m_multipart);
+
+    if (m_spool) {
+        m_spool->flush();
+        body->m_spool = m_spool;
+        body->m_file = new QFile(m_spool->fileName(), body);
+        if (!body->m_file->open(QIODevice::ReadOnly)) {
+            qWarning("Could not read HTTP request body from temporary file");
+            body->m_dropped = true;
+            body->setErrorString(body->m_file->errorString());
+        }
+    }
+    return body;
+}
+
+/** Returns at most \a maxSize bytes of the body received so far, starting
+ *  at position \a pos, which are read back from the temporary file if the
+ *  body is spooled.
+ */
+QByteArray QDjangoHttpRequestBody::dataAt(qint64 pos, qint64 maxSize) const
+{
+    const qint64 length = qMin(m_size - pos, maxSize);
+    if (m_dropped || length <= 0)
+        return QByteArray();
+    if (!m_file)
+        return m_buffer.mid(int(pos), int(length));
+
+    QByteArray chunk;
+    if (!m_file->seek(pos) || (chunk = m_file->read(length)).size() != length) {
+        qWarning("Could not read HTTP request body from temporary file");
+        return QByteArray();
+    }
+    return chunk;
+}
+
+/** Returns the whole body received so far.
+ *
+ * Bodies which exceed the spool threshold are never loaded back into
+ * memory, for those an empty array is returned.
+ */
+QByteArray QDjangoHttpRequestBody::data() const
+{
+    if (m_file || m_dropped) {
+        qWarning("HTTP request body is too large to be held in memory");
+        return QByteArray();
+    }
+    return m_buffer;
+}
+
+/** Signals that the whole body has been received.
+ */
+void QDjangoHttpRequestBody::finish()
+{
+    if (m_finished)
+        return;
+    m_finished = true;
+    emit readChannelFinished();
+}
+
+/** Returns true if the whole body has been received.
+ */
+bool QDjangoHttpRequestBody::isFinished() const
+{
+    return m_finished;
+}
+
+/** Returns true if the body was written to a temporary file.
+ */
+bool QDjangoHttpRequestBody::isSpooled() const
+{
+    return m_file != 0;
+}
+
+/** Returns the parser for a multipart/form-data body, or 0 if the body
+ *  is of another type.
+ */
+QDjangoHttpMultipartParser *QDjangoHttpRequestBody::multipart() const
+{
+    return m_multipart;
+}
+
+bool QDjangoHttpRequestBody::atEnd() const
+{
+    return m_finished && !bytesAvailable();
+}
+
+qint64 QDjangoHttpRequestBody::bytesAvailable() const
+{
+    if (m_dropped)
+        return QIODevice::bytesAvailable();
+    return m_size - m_readPos + QIODevice::bytesAvailable();
+}
+
+bool QDjangoHttpRequestBody::isSequential() const
+{
+    return true;
+}
+
+qint64 QDjangoHttpRequestBody::readData(char *data, qint64 maxSize)
+{
+    if (m_dropped)
+        return -1;
+
+    const qint64 length = qMin(m_size - m_readPos, maxSize);
+    if (length <= 0)
+        return m_finished ? -1 : 0;
+
+    if (m_file) {
+        if (!m_file->seek(m_readPos) || m_file->read(data, length) != length)
+            return -1;
+    } else {
+        memcpy(data, m_buffer.constData() + m_readPos, length);
+    }
+    m_readPos += length;
+    return length;
+}
+
+qint64 QDjangoHttpRequestBody::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+/// \endcond
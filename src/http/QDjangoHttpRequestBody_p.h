@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_HTTP_REQUEST_BODY_P_H
+#define QDJANGO_HTTP_REQUEST_BODY_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QDjango API.
+//
+
+#include <QHash>
+#include <QIODevice>
+#include <QSharedPointer>
+#include <QStringList>
+
+#include "QDjangoHttp_p.h"
+
+class QFile;
+class QTemporaryFile;
+
+/** \internal
+ *
+ * A parser for multipart/form-data bodies, which is fed the body as it
+ * arrives. The contents of file parts are written straight to temporary
+ * files, those of other parts are decoded as text.
+ */
+class QDJANGO_HTTP_AUTOTEST_EXPORT QDjangoHttpMultipartParser
+{
+public:
+    QDjangoHttpMultipartParser(const QByteArray &boundary);
+
+    bool write(const char *data, qint64 size);
+
+    QHash<QString, QStringList> fields;
+    QHash<QString, QString> fileNames;
+    QHash<QString, QSharedPointer<QTemporaryFile> > files;
+
+private:
+    enum State {
+        PreambleState,
+        DelimiterState,
+        HeaderState,
+        ContentState,
+        EpilogueState
+    };
+
+    bool startPart(const QByteArray &header);
+    void finishPart();
+    bool writeContent(const char *data, qint64 size);
+
+    QByteArray m_buffer;
+    QByteArray m_delimiter;
+    State m_state;
+
+    // the part being received
+    QByteArray m_content;
+    QSharedPointer<QTemporaryFile> m_file;
+    QString m_fileName;
+    bool m_isFile;
+    QString m_name;
+};
+
+/** \internal
+ *
+ * The body of a request, which can be read as it arrives. Bodies which
+ * exceed the spool threshold are written to a temporary file instead
+ * of being held in memory. Unless the body is streamed to its handler,
+ * the raw bytes of a multipart body are not kept past the threshold at
+ * all, as the parser stores its parts.
+ */
+class QDJANGO_HTTP_AUTOTEST_EXPORT QDjangoHttpRequestBody : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    QDjangoHttpRequestBody(const QByteArray &contentType, qint64 spoolThreshold, qint64 maximumSize, bool streamed = false, QObject *parent = 0);
+    ~QDjangoHttpRequestBody();
+
+    bool append(const char *data, qint64 size);
+    QDjangoHttpRequestBody *clone() const;
+    QByteArray data() const;
+    QByteArray dataAt(qint64 pos, qint64 maxSize) const;
+    void finish();
+    bool isFinished() const;
+    bool isSpooled() const;
+    QDjangoHttpMultipartParser *multipart() const;
+
+    bool atEnd() const;
+    qint64 bytesAvailable() const;
+    bool isSequential() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+    Q_DISABLE_COPY(QDjangoHttpRequestBody)
+
+    QByteArray m_buffer;
+    bool m_dropped;
+    QFile *m_file;
+    bool m_finished;
+    qint64 m_maximumSize;
+    QDjangoHttpMultipartParser *m_multipart;
+    qint64 m_readPos;
+    qint64 m_size;
+    QSharedPointer<QTemporaryFile> m_spool;
+    qint64 m_spoolThreshold;
+    bool m_streamed;
+};
+
+#endif
@@ -25,17 +25,69 @@
 // This file is not part of the QDjango API.
 //
 
+#include <QHash>
 #include <QMap>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+#include "QDjangoHttpMetrics.h"
+
+class QDjangoHttpRequestBody;
+class QDjangoUrlResolverMatch;
+
+/** \internal
+ *
+ * The location of a raw name-value pair in QDjangoHttpRequestPrivate::rawMeta.
+ */
+class QDjangoHttpRawMeta
+{
+public:
+    int offset;
+    int nameLength;
+    int valueLength;
+};
 
 /** \internal
  */
 class QDjangoHttpRequestPrivate
 {
 public:
+    QDjangoHttpRequestPrivate();
+    QDjangoHttpRequestBody *body() const;
+    void addRawMeta(const QByteArray &name, const QByteArray &value);
+    QString metaValue(const QString &key) const;
+    const QHash<QString, QStringList> &getItems() const;
+    const QHash<QString, QStringList> &postItems() const;
+
+    static QMap<QByteArray, QByteArray> parseHeaderParameters(const QByteArray &value);
+    static void parseUrlEncoded(const QByteArray &data, QHash<QString, QStringList> &items);
+
+    // the body, which is either received by a server as it arrives or
+    // set as a whole
+    mutable QSharedPointer<QDjangoHttpRequestBody> bodyDevice;
     QByteArray buffer;
-    QMap<QString, QString> meta;
+    mutable QMap<QString, QString> meta;
     QString method;
     QString path;
+
+    // decoded query string and form data, parsed on first use
+    mutable QHash<QString, QStringList> getData;
+    mutable bool getParsed;
+    mutable QHash<QString, QStringList> postData;
+    mutable bool postParsed;
+
+    // undecoded meta-information, such as FastCGI parameters
+    QByteArray rawMeta;
+    QVector<QDjangoHttpRawMeta> rawMetaIndex;
+
+    // the route matched when the request's header was received
+    QSharedPointer<QDjangoUrlResolverMatch> match;
+
+    // the handler which served the request and the times at which
+    // its phases occurred, for the server's metrics
+    QByteArray route;
+    qint64 timestamps[QDjangoHttpMetrics::PhaseCount];
 };
 
 #endif
@@ -15,9 +15,156 @@
  * Lesser General Public License for more details.
  */
 
+#include <QFile>
+#include <QIODevice>
+
 #include "QDjangoHttpResponse.h"
 #include "QDjangoHttpResponse_p.h"
 
+/// \cond
+
+#define HTTP_STATUS(code, reason) { code, reason, "HTTP/1.1 " #code " " reason "\r\n", "Status: " #code " " reason "\r\n" }
+
+// status lines of well-known status codes are formatted at compile time
+static const QDjangoHttpStatus httpStatuses[] = {
+    HTTP_STATUS(200, "OK"),
+    HTTP_STATUS(206, "Partial Content"),
+    HTTP_STATUS(301, "Moved Permanently"),
+    HTTP_STATUS(302, "Found"),
+    HTTP_STATUS(304, "Not Modified"),
+    HTTP_STATUS(400, "Bad Request"),
+    HTTP_STATUS(401, "Authorization Required"),
+    HTTP_STATUS(403, "Forbidden"),
+    HTTP_STATUS(404, "Not Found"),
+    HTTP_STATUS(405, "Method Not Allowed"),
+    HTTP_STATUS(416, "Requested Range Not Satisfiable"),
+    HTTP_STATUS(500, "Internal Server Error"),
+    HTTP_STATUS(503, "Service Unavailable"),
+    { 0, 0, 0, 0 }
+};
+
+QDjangoHttpResponsePrivate::QDjangoHttpResponsePrivate()
+    : statusCode(0)
+    , status(0)
+    , bodyDevice(0)
+    , bodyEnd(-1)
+    , bodyFinished(false)
+    , bodyMapping(0)
+    , bodyMappingFailed(false)
+{
+}
+
+/** Returns true if all the data from the body device has been consumed.
+ */
+bool QDjangoHttpResponsePrivate::bodyAtEnd() const
+{
+    if (!bodyDevice)
+        return true;
+    if (bodyDevice->isSequential())
+        return (bodyFinished || !bodyDevice->isOpen()) && !bodyDevice->bytesAvailable();
+    return bodyDevice->atEnd() || bodyDevice->pos() >= bodyEndPosition();
+}
+
+/** Returns the position at which the body stops for a random-access
+ *  body device.
+ *
+ * This is the end of the device, unless only part of it is served.
+ */
+qint64 QDjangoHttpResponsePrivate::bodyEndPosition() const
+{
+    const qint64 size = bodyDevice->size();
+    return bodyEnd >= 0 ? qMin(bodyEnd, size) : size;
+}
+
+/** Reads up to \a maxSize bytes from the body device.
+ *
+ * Files are mapped into memory so that their contents are served
+ * from the page cache without being copied into a read buffer.
+ */
+QByteArray QDjangoHttpResponsePrivate::readBody(qint64 maxSize)
+{
+    if (!bodyDevice->isSequential()) {
+        maxSize = qMin(maxSize, bodyEndPosition() - bodyDevice->pos());
+        if (maxSize <= 0)
+            return QByteArray();
+    }
+
+    QFile *file = qobject_cast<QFile*>(bodyDevice);
+    if (file && !bodyMapping && !bodyMappingFailed) {
+        bodyMapping = reinterpret_cast<const char*>(file->map(0, file->size()));
+        bodyMappingFailed = !bodyMapping;
+    }
+    if (file && bodyMapping) {
+        const qint64 pos = file->pos();
+        file->seek(pos + maxSize);
+        return QByteArray::fromRawData(bodyMapping + pos, maxSize);
+    }
+    return bodyDevice->read(maxSize);
+}
+
+/** Returns the status line and headers of the response, as they
+ *  are sent to the client.
+ *
+ * The data is assembled in a single allocation.
+ */
+QByteArray QDjangoHttpResponsePrivate::headerData(HeaderFormat format) const
+{
+    QByteArray statusLine;
+    if (status) {
+        const char *line = (format == HttpHeader) ? status->httpLine : status->fastCgiLine;
+        statusLine = QByteArray::fromRawData(line, qstrlen(line));
+    } else {
+        statusLine = (format == HttpHeader) ? "HTTP/1.1 " : "Status: ";
+        statusLine += QByteArray::number(statusCode) + " \r\n";
+    }
+
+    int size = statusLine.size() + 2;
+    QList<QPair<QByteArray, QByteArray> >::ConstIterator it;
+    for (it = headers.constBegin(); it != headers.constEnd(); ++it)
+        size += (*it).first.size() + (*it).second.size() + 4;
+
+    QByteArray data;
+    data.reserve(size);
+    data += statusLine;
+    for (it = headers.constBegin(); it != headers.constEnd(); ++it) {
+        data += (*it).first;
+        data += ": ";
+        data += (*it).second;
+        data += "\r\n";
+    }
+    data += "\r\n";
+    return data;
+}
+
+void QDjangoHttpResponsePrivate::removeHeader(const QByteArray &key)
+{
+    QList<QPair<QByteArray, QByteArray> >::Iterator it = headers.begin();
+    while (it != headers.end()) {
+        if (!qstricmp((*it).first.constData(), key.constData()))
+            it = headers.erase(it);
+        else
+            ++it;
+    }
+}
+
+/** Sets the specified header, without any conversion.
+ */
+void QDjangoHttpResponsePrivate::setHeader(const QByteArray &key, const QByteArray &value)
+{
+    QList<QPair<QByteArray, QByteArray> >::Iterator it = headers.begin();
+    while (it != headers.end()) {
+        if (!qstricmp((*it).first.constData(), key.constData())) {
+            (*it).second = value;
+            return;
+        }
+        ++it;
+    }
+    // not found so add
+    headers.append(qMakePair(key, value));
+}
+
+/// \endcond
+
 /** Constructs a new HTTP response.
  */
 QDjangoHttpResponse::QDjangoHttpResponse()
@@ -35,9 +182,24 @@ QDjangoHttpResponse::~QDjangoHttpResponse()
 }
 
 /** Returns the raw body of the HTTP response.
+ *
+ * If the body is provided by a random-access device, its remaining
+ * contents are returned. If it is provided by a sequential device,
+ * an empty array is returned.
+ *
+ * \sa bodyDevice()
  */
 QByteArray QDjangoHttpResponse::body() const
 {
+    if (d->bodyDevice) {
+        QByteArray data;
+        if (!d->bodyDevice->isSequential()) {
+            const qint64 pos = d->bodyDevice->pos();
+            data = d->bodyDevice->read(d->bodyEndPosition() - pos);
+            d->bodyDevice->seek(pos);
+        }
+        return data;
+    }
     return d->body;
 }
 
@@ -49,44 +211,92 @@ QByteArray QDjangoHttpResponse::body() const
  */
 void QDjangoHttpResponse::setBody(const QByteArray &body)
 {
+    setBodyDevice(0);
     d->body = body;
     setHeader(QLatin1String("Content-Length"), QString::number(d->body.size()));
 }
 
+/** Returns the device from which the body of the HTTP response is read,
+ *  or 0 if the body is held in memory.
+ */
+QIODevice *QDjangoHttpResponse::bodyDevice() const
+{
+    return d->bodyDevice;
+}
+
+/** Sets the \a device from which the body of the HTTP response is read.
+ *
+ * Instead of being held in memory, the body is read from the device
+ * in chunks as the client is able to receive it. The response takes
+ * ownership of the device. If the device is not open, it is opened
+ * in read-only mode.
+ *
+ * If the device is random-access, the Content-Length header is set
+ * to the number of bytes between the current position and the end of
+ * the device. If the device is sequential, the Content-Length header
+ * is removed and the body is sent using chunked transfer encoding.
+ * A sequential device signals the end of the body by emitting
+ * QIODevice::readChannelFinished() or by being closed.
+ *
+ * \param device
+ */
+void QDjangoHttpResponse::setBodyDevice(QIODevice *device)
+{
+    if (d->bodyDevice) {
+        d->bodyDevice->disconnect(this);
+        delete d->bodyDevice;
+        d->bodyDevice = 0;
+    }
+    d->bodyEnd = -1;
+    d->bodyFinished = false;
+    d->bodyMapping = 0;
+    d->bodyMappingFailed = false;
+    if (!device)
+        return;
+
+    if (!device->isOpen() && !device->open(QIODevice::ReadOnly)) {
+        qWarning("Could not open response body device");
+        delete device;
+        return;
+    }
+    d->body.clear();
+    d->bodyDevice = device;
+    d->bodyDevice->setParent(this);
+    if (device->isSequential()) {
+        connect(device, SIGNAL(readChannelFinished()),
+                this, SLOT(_q_bodyFinished()));
+        d->removeHeader("Content-Length");
+    } else {
+        setHeader(QLatin1String("Content-Length"), QString::number(device->size() - device->pos()));
+    }
+}
+
 /** Returns the specified HTTP response header.
  *
  * \param key
  */
 QString QDjangoHttpResponse::header(const QString &key) const
 {
-    QString lowercaseKey = key.toLower();
-    QList<QPair<QString, QString> >::ConstIterator it = d->headers.constBegin();
+    const QByteArray latinKey = key.toLatin1();
+    QList<QPair<QByteArray, QByteArray> >::ConstIterator it = d->headers.constBegin();
     while (it != d->headers.constEnd()) {
-        if ((*it).first.toLower() == lowercaseKey)
-            return (*it).second;
+        if (!qstricmp((*it).first.constData(), latinKey.constData()))
+            return QString::fromLatin1((*it).second);
         ++it;
     }
     return QString();
 }
 
 /** Sets the specified HTTP response header.
+ *
+ * Header names and values are sent as Latin-1.
  *
  * \param key
  * \param value
  */
 void QDjangoHttpResponse::setHeader(const QString &key, const QString &value)
 {
-    QString lowercaseKey = key.toLower();
-    QList<QPair<QString, QString> >::Iterator it = d->headers.begin();
-    while (it != d->headers.end()) {
-        if ((*it).first.toLower() == lowercaseKey) {
-            (*it).second = value;
-            return;
-        }
-        ++it;
-    }
-    // not found so add
-    d->headers.append(qMakePair(key, value));
+    d->setHeader(key.toLatin1(), value.toLatin1());
 }
 
 /** Returns true if the response is ready to be sent.
@@ -105,7 +315,7 @@ bool QDjangoHttpResponse::isReady() const
  */
 QString QDjangoHttpResponse::reasonPhrase() const
 {
-    return d->reasonPhrase;
+    return d->status ? QString::fromLatin1(d->status->reasonPhrase) : QString::fromLatin1("");
 }
 
 /** Returns the code for the HTTP response status line.
@@ -122,41 +332,16 @@ int QDjangoHttpResponse::statusCode() const
 void QDjangoHttpResponse::setStatusCode(int code)
 {
     d->statusCode = code;
-    switch(code)
-    {
-    case OK:
-        d->reasonPhrase = QLatin1String("OK");
-        break;
-    case MovedPermanently:
-        d->reasonPhrase = QLatin1String("Moved Permanently");
-        break;
-    case Found:
-        d->reasonPhrase = QLatin1String("Found");
-        break;
-    case NotModified:
-        d->reasonPhrase = QLatin1String("Not Modified");
-        break;
-    case BadRequest:
-        d->reasonPhrase = QLatin1String("Bad Request");
-        break;
-    case AuthorizationRequired:
-        d->reasonPhrase = QLatin1String("Authorization Required");
-        break;
-    case Forbidden:
-        d->reasonPhrase = QLatin1String("Forbidden");
-        break;
-    case NotFound:
-        d->reasonPhrase = QLatin1String("Not Found");
-        break;
-    case MethodNotAllowed:
-        d->reasonPhrase = QLatin1String("Method Not Allowed");
-        break;
-    case InternalServerError:
-        d->reasonPhrase = QLatin1String("Internal Server Error");
-        break;
-    default:
-        d->reasonPhrase = QLatin1String("");
-        break;
+    d->status = 0;
+    for (const QDjangoHttpStatus *status = httpStatuses; status->code; ++status) {
+        if (status->code == code) {
+            d->status = status;
+            break;
+        }
     }
 }
 
+void QDjangoHttpResponse::_q_bodyFinished()
+{
+    d->bodyFinished = true;
+}
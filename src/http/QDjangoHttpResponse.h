@@ -23,6 +23,7 @@
 #include "QDjangoHttp_p.h"
 
 class QDjangoHttpResponsePrivate;
+class QIODevice;
 
 /** \brief The QDjangoHttpResponse class represents an HTTP response.
  *
@@ -37,6 +38,7 @@ public:
      */
     enum HttpStatus {
         OK                      = 200,
+        PartialContent          = 206,
         MovedPermanently        = 301,
         Found                   = 302,
         NotModified             = 304,
@@ -45,7 +47,9 @@ public:
         Forbidden               = 403,
         NotFound                = 404,
         MethodNotAllowed        = 405,
+        RequestedRangeNotSatisfiable = 416,
         InternalServerError     = 500,
+        ServiceUnavailable      = 503,
     };
 
     QDjangoHttpResponse();
@@ -54,6 +58,9 @@ public:
     QByteArray body() const;
     void setBody(const QByteArray &body);
 
+    QIODevice *bodyDevice() const;
+    void setBodyDevice(QIODevice *device);
+
     QString header(const QString &key) const;
     void setHeader(const QString &key, const QString &value);
 
@@ -71,11 +78,19 @@ signals:
      */
     void ready();
 
+private slots:
+    void _q_bodyFinished();
+
 private:
     Q_DISABLE_COPY(QDjangoHttpResponse)
     QDjangoHttpResponsePrivate* const d;
     friend class QDjangoFastCgiConnection;
+    friend class QDjangoHttpCompressor;
+    friend class QDjangoHttpController;
+    friend class QDjangoHttpETag;
     friend class QDjangoHttpConnection;
+    friend class QDjangoHttpResponseCachePrivate;
+    friend class QDjangoUrlResolverResponse;
 };
 
 #endif
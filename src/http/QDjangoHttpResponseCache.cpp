@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <QDateTime>
+#include <QStringList>
+
+#include "QDjangoHttpRequest.h"
+#include "QDjangoHttpResponse.h"
+#include "QDjangoHttpResponse_p.h"
+#include "QDjangoHttpResponseCache.h"
+#include "QDjangoHttpResponseCache_p.h"
+
+/// \cond
+
+/** Parses the caching directives of the \a response to the \a request
+ *  and fills the \a entry.
+ *
+ * Returns false if the response must not be cached.
+ */
+bool QDjangoHttpResponseCachePrivate::prepare(const QDjangoHttpRequest &request, QDjangoHttpResponse *response, QDjangoHttpResponseCacheEntry &entry)
+{
+    // the response to a HEAD request may lack the body a GET expects
+    if (request.method() != QLatin1String("GET"))
+        return false;
+    if (response->d->bodyDevice || response->d->bodyMapping || !response->header(QLatin1String("Set-Cookie")).isEmpty())
+        return false;
+    const int statusCode = response->statusCode();
+    if (statusCode == QDjangoHttpResponse::PartialContent || statusCode == QDjangoHttpResponse::NotModified)
+        return false;
+
+    // determine the lifetime, s-maxage taking precedence over max-age
+    int maxAge = -1;
+    int sharedMaxAge = -1;
+    foreach (const QString &item, response->header(QLatin1String("Cache-Control")).split(QLatin1Char(','))) {
+        const QString directive = item.trimmed().toLower();
+        if (directive == QLatin1String("no-store") ||
+            directive == QLatin1String("no-cache") ||
+            directive == QLatin1String("private"))
+            return false;
+        else if (directive.startsWith(QLatin1String("max-age=")))
+            maxAge = directive.mid(8).toInt();
+        else if (directive.startsWith(QLatin1String("s-maxage=")))
+            sharedMaxAge = directive.mid(9).toInt();
+    }
+    const int lifetime = sharedMaxAge >= 0 ? sharedMaxAge : maxAge;
+    if (lifetime <= 0)
+        return false;
+
+    // record the values of the request headers the response varies on
+    foreach (const QString &item, response->header(QLatin1String("Vary")).split(QLatin1Char(','), QString::SkipEmptyParts)) {
+        const QString name = item.trimmed();
+        if (name == QLatin1String("*"))
+            return false;
+        QString metaKey = QLatin1String("HTTP_") + name.toUpper();
+        metaKey.replace(QLatin1Char('-'), QLatin1Char('_'));
+        entry.varyKeys << metaKey;
+        entry.varyValues << request.meta(metaKey);
+    }
+
+    entry.body = response->d->body;
+    entry.created = QDateTime::currentMSecsSinceEpoch();
+    entry.expires = entry.created + qint64(lifetime) * 1000;
+    entry.headers = response->d->headers;
+    entry.statusCode = statusCode;
+    return true;
+}
+
+int QDjangoHttpResponseCacheEntry::cost() const
+{
+    int cost = body.size();
+    for (int i = 0; i < headers.size(); ++i)
+        cost += headers[i].first.size() + headers[i].second.size();
+    return cost;
+}
+
+/** Returns true if the \a request has the same values as the entry's
+ *  request for the headers listed in the Vary header.
+ */
+bool QDjangoHttpResponseCacheEntry::matches(const QDjangoHttpRequest &request) const
+{
+    for (int i = 0; i < varyKeys.size(); ++i) {
+        if (request.meta(varyKeys[i]) != varyValues[i])
+            return false;
+    }
+    return true;
+}
+
+QDjangoHttpResponseCachePrivate::QDjangoHttpResponseCachePrivate()
+    : hits(0)
+    , misses(0)
+{
+    entries.setMaxCost(32 * 1024 * 1024);
+}
+
+/** Returns the key under which the responses to the \a request are
+ *  cached, which is its path followed by its query string.
+ *
+ * GET and HEAD requests share the same key: only the responses to GET
+ * requests are stored, and they can be served to either method.
+ */
+QString QDjangoHttpResponseCachePrivate::key(const QDjangoHttpRequest &request)
+{
+    const QString query = request.meta(QLatin1String("QUERY_STRING"));
+    if (query.isEmpty())
+        return request.path();
+    return request.path() + QLatin1Char('?') + query;
+}
+
+/** Returns a copy of the cached response to the \a request, or 0 if
+ *  there is no fresh response for it.
+ */
+QDjangoHttpResponse *QDjangoHttpResponseCachePrivate::lookup(const QDjangoHttpRequest &request, const QString &key)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QDjangoHttpResponseCacheEntry entry;
+    bool found = false;
+    {
+        QMutexLocker locker(&mutex);
+        QList<QDjangoHttpResponseCacheEntry> *variants = entries.object(key);
+        if (variants) {
+            foreach (const QDjangoHttpResponseCacheEntry &variant, *variants) {
+                if (variant.expires > now && variant.matches(request)) {
+                    entry = variant;
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (found)
+            hits++;
+        else
+            misses++;
+    }
+    if (!found)
+        return 0;
+
+    QDjangoHttpResponse *response = new QDjangoHttpResponse;
+    response->setStatusCode(entry.statusCode);
+    response->d->headers = entry.headers;
+    response->d->body = entry.body;
+    response->d->setHeader("Age", QByteArray::number((now - entry.created) / 1000));
+    return response;
+}
+
+/** Registers the \a waiter if a request for the \a key is already being
+ *  handled and returns true. Otherwise marks the key as being handled
+ *  and returns false.
+ */
+bool QDjangoHttpResponseCachePrivate::join(const QString &key, QObject *waiter)
+{
+    QMutexLocker locker(&mutex);
+    QHash<QString, QList<QObject*> >::Iterator it = waiters.find(key);
+    if (it == waiters.end()) {
+        waiters.insert(key, QList<QObject*>());
+        return false;
+    }
+    it.value() << waiter;
+    return true;
+}
+
+/** Unregisters a \a waiter which is being destroyed.
+ */
+void QDjangoHttpResponseCachePrivate::leave(const QString &key, QObject *waiter)
+{
+    QMutexLocker locker(&mutex);
+    QHash<QString, QList<QObject*> >::Iterator it = waiters.find(key);
+    if (it != waiters.end())
+        it.value().removeAll(waiter);
+}
+
+/** Stores the \a response to the \a request if it can be cached, then
+ *  lets the requests which were waiting for it proceed.
+ *
+ * A null \a response means the request went away before its response
+ * was ready.
+ */
+void QDjangoHttpResponseCachePrivate::finish(const QString &key, const QDjangoHttpRequest *request, QDjangoHttpResponse *response)
+{
+    QDjangoHttpResponseCacheEntry entry;
+    const bool cacheable = response && prepare(*request, response, entry);
+
+    QMutexLocker locker(&mutex);
+    if (cacheable) {
+        // replace the variant for the same request headers and drop stale ones
+        QList<QDjangoHttpResponseCacheEntry> *variants = new QList<QDjangoHttpResponseCacheEntry>;
+        int cost = entry.cost();
+        QList<QDjangoHttpResponseCacheEntry> *current = entries.object(key);
+        if (current) {
+            foreach (const QDjangoHttpResponseCacheEntry &variant, *current) {
+                if (variant.expires > entry.created && (variant.varyKeys != entry.varyKeys || variant.varyValues != entry.varyValues)) {
+                    *variants << variant;
+                    cost += variant.cost();
+                }
+            }
+        }
+        *variants << entry;
+        entries.insert(key, variants, cost);
+    }
+
+    // waiting requests are served from the cache, or run their handler
+    const QList<QObject*> keyWaiters = waiters.take(key);
+    foreach (QObject *waiter, keyWaiters)
+        QMetaObject::invokeMethod(waiter, cacheable ? "_q_retry" : "_q_bypass", Qt::QueuedConnection);
+}
+
+QDjangoHttpResponseCacheWatcher::QDjangoHttpResponseCacheWatcher(QDjangoHttpResponseCachePrivate *cache, const QString &key,
+                                                                 QDjangoHttpRequest *request, QDjangoHttpResponse *response)
+    : QObject(response)
+    , m_cache(cache)
+    , m_key(key)
+    , m_request(request)
+    , m_response(response)
+{
+    bool check;
+    Q_UNUSED(check);
+
+    check = connect(response, SIGNAL(destroyed()),
+                    this, SLOT(_q_destroyed()));
+    Q_ASSERT(check);
+
+    check = connect(response, SIGNAL(ready()),
+                    this, SLOT(_q_ready()));
+    Q_ASSERT(check);
+}
+
+QDjangoHttpResponseCacheWatcher::~QDjangoHttpResponseCacheWatcher()
+{
+    delete m_request;
+}
+
+void QDjangoHttpResponseCacheWatcher::_q_destroyed()
+{
+    if (m_response) {
+        m_response = 0;
+        m_cache->finish(m_key, 0, 0);
+    }
+}
+
+void QDjangoHttpResponseCacheWatcher::_q_ready()
+{
+    if (m_response) {
+        QDjangoHttpResponse *response = m_response;
+        m_response = 0;
+        m_cache->finish(m_key, m_request, response);
+    }
+}
+
+/// \endcond
+
+/** Constructs a new response cache.
+ *
+ * \param parent
+ */
+QDjangoHttpResponseCache::QDjangoHttpResponseCache(QObject *parent)
+    : QObject(parent)
+    , d(new QDjangoHttpResponseCachePrivate)
+{
+}
+
+/** Destroys the response cache.
+ */
+QDjangoHttpResponseCache::~QDjangoHttpResponseCache()
+{
+    delete d;
+}
+
+/** Returns the maximum amount of memory in bytes used by the cache.
+ */
+int QDjangoHttpResponseCache::maximumSize() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->entries.maxCost();
+}
+
+/** Sets the maximum amount of memory in bytes used by the cache.
+ *
+ * The default value is 32MB.
+ *
+ * \param size
+ */
+void QDjangoHttpResponseCache::setMaximumSize(int size)
+{
+    QMutexLocker locker(&d->mutex);
+    d->entries.setMaxCost(size);
+}
+
+/** Returns the number of requests which were served from the cache.
+ */
+qint64 QDjangoHttpResponseCache::hits() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->hits;
+}
+
+/** Returns the number of requests which could not be served from the cache.
+ */
+qint64 QDjangoHttpResponseCache::misses() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->misses;
+}
+
+/** Returns the amount of memory in bytes currently used by the cache.
+ */
+int QDjangoHttpResponseCache::size() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->entries.totalCost();
+}
+
+/** Removes all the responses from the cache.
+ */
+void QDjangoHttpResponseCache::clear()
+{
+    QMutexLocker locker(&d->mutex);
+    d->entries.clear();
+}
+
+/** Removes the responses whose key starts with the given \a prefix
+ *  from the cache, and returns the number of keys which were removed.
+ *
+ * The key of a response is the path of the request followed, if it is
+ * not empty, by a question mark and the query string. For instance
+ * invalidate("/articles/") removes all the responses for the paths
+ * below /articles/.
+ *
+ * \param prefix
+ */
+int QDjangoHttpResponseCache::invalidate(const QString &prefix)
+{
+    QMutexLocker locker(&d->mutex);
+    int count = 0;
+    foreach (const QString &key, d->entries.keys()) {
+        if (key.startsWith(prefix)) {
+            d->entries.remove(key);
+            count++;
+        }
+    }
+    return count;
+}
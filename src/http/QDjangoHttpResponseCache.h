@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_HTTP_RESPONSE_CACHE_H
+#define QDJANGO_HTTP_RESPONSE_CACHE_H
+
+#include <QObject>
+
+#include "QDjangoHttp_p.h"
+
+class QDjangoHttpResponseCachePrivate;
+
+/** \brief The QDjangoHttpResponseCache class keeps the responses of
+ *  handlers in memory.
+ *
+ * A cache is attached to a QDjangoUrlResolver using
+ * QDjangoUrlResolver::setResponseCache(), and serves the GET and HEAD
+ * requests for that resolver's routes. Only the responses to GET
+ * requests are stored.
+ *
+ * Responses are only cached if the handler allows it by setting a
+ * Cache-Control header with a max-age or s-maxage directive, for
+ * instance:
+ *
+ * \code
+ * response->setHeader("Cache-Control", "public, max-age=60");
+ * \endcode
+ *
+ * Responses marked no-store, no-cache or private, responses which set
+ * a cookie and responses whose body is read from a device are never
+ * cached.
+ *
+ * Entries are keyed by the request's path and query string, and by the
+ * values of the request headers which the response lists in its Vary
+ * header. When several requests for the same key miss the cache at the
+ * same time, the handler only runs once and the other requests wait
+ * for its response.
+ *
+ * When the total size of the cached responses exceeds maximumSize(),
+ * the least recently used entries are evicted. Entries can be removed
+ * explicitly using invalidate().
+ *
+ * \ingroup Http
+ */
+class QDJANGO_HTTP_EXPORT QDjangoHttpResponseCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    QDjangoHttpResponseCache(QObject *parent = 0);
+    ~QDjangoHttpResponseCache();
+
+    int maximumSize() const;
+    void setMaximumSize(int size);
+
+    qint64 hits() const;
+    qint64 misses() const;
+    int size() const;
+
+    void clear();
+    int invalidate(const QString &prefix);
+
+private:
+    Q_DISABLE_COPY(QDjangoHttpResponseCache)
+    QDjangoHttpResponseCachePrivate* const d;
+    friend class QDjangoUrlResolverPrivate;
+    friend class QDjangoUrlResolverRetryResponse;
+};
+
+#endif
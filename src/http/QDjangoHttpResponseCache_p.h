@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_HTTP_RESPONSE_CACHE_P_H
+#define QDJANGO_HTTP_RESPONSE_CACHE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QDjango API.
+//
+
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QStringList>
+
+class QDjangoHttpRequest;
+class QDjangoHttpResponse;
+
+/** \internal
+ *
+ * A cached response, for one combination of the request headers
+ * listed in its Vary header.
+ */
+class QDjangoHttpResponseCacheEntry
+{
+public:
+    int cost() const;
+    bool matches(const QDjangoHttpRequest &request) const;
+
+    QByteArray body;
+    qint64 created;
+    qint64 expires;
+    QList<QPair<QByteArray, QByteArray> > headers;
+    int statusCode;
+    QStringList varyKeys;
+    QStringList varyValues;
+};
+
+/** \internal
+ */
+class QDjangoHttpResponseCachePrivate
+{
+public:
+    QDjangoHttpResponseCachePrivate();
+
+    static QString key(const QDjangoHttpRequest &request);
+    QDjangoHttpResponse *lookup(const QDjangoHttpRequest &request, const QString &key);
+    bool join(const QString &key, QObject *waiter);
+    void leave(const QString &key, QObject *waiter);
+    void finish(const QString &key, const QDjangoHttpRequest *request, QDjangoHttpResponse *response);
+    static bool prepare(const QDjangoHttpRequest &request, QDjangoHttpResponse *response, QDjangoHttpResponseCacheEntry &entry);
+
+    QCache<QString, QList<QDjangoHttpResponseCacheEntry> > entries;
+    qint64 hits;
+    qint64 misses;
+    mutable QMutex mutex;
+
+    // requests waiting for the response to a request which missed the
+    // cache, indexed by key
+    QHash<QString, QList<QObject*> > waiters;
+};
+
+/** \internal
+ *
+ * Stores a response in the cache once it is ready, or lets waiting
+ * requests proceed if it is destroyed before that.
+ */
+class QDjangoHttpResponseCacheWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    QDjangoHttpResponseCacheWatcher(QDjangoHttpResponseCachePrivate *cache, const QString &key,
+                                    QDjangoHttpRequest *request, QDjangoHttpResponse *response);
+    ~QDjangoHttpResponseCacheWatcher();
+
+private slots:
+    void _q_destroyed();
+    void _q_ready();
+
+private:
+    QDjangoHttpResponseCachePrivate *m_cache;
+    QString m_key;
+    QDjangoHttpRequest *m_request;
+    QDjangoHttpResponse *m_response;
+};
+
+#endif
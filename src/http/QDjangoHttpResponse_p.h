@@ -25,18 +25,51 @@
 // This file is not part of the QDjango API.
 //
 
+#include <QByteArray>
+#include <QList>
 #include <QPair>
 #include <QString>
 
+class QIODevice;
+
+/** \internal
+ */
+class QDjangoHttpStatus
+{
+public:
+    int code;
+    const char *reasonPhrase;
+    const char *httpLine;
+    const char *fastCgiLine;
+};
+
 /** \internal
  */
 class QDjangoHttpResponsePrivate
 {
-public:    
+public:
+    enum HeaderFormat {
+        HttpHeader,
+        FastCgiHeader
+    };
+
+    QDjangoHttpResponsePrivate();
+    bool bodyAtEnd() const;
+    qint64 bodyEndPosition() const;
+    QByteArray headerData(HeaderFormat format) const;
+    QByteArray readBody(qint64 maxSize);
+    void removeHeader(const QByteArray &key);
+    void setHeader(const QByteArray &key, const QByteArray &value);
+
     int statusCode;
-    QString reasonPhrase;
-    QList<QPair<QString, QString> > headers;
+    const QDjangoHttpStatus *status;
+    QList<QPair<QByteArray, QByteArray> > headers;
     QByteArray body;
+    QIODevice *bodyDevice;
+    qint64 bodyEnd;
+    bool bodyFinished;
+    const char *bodyMapping;
+    bool bodyMappingFailed;
 };
 
 #endif
@@ -15,15 +15,26 @@
  * Lesser General Public License for more details.
  */
 
+#include <cstring>
+
 #include <QCoreApplication>
 #include <QDateTime>
+#include <QFile>
+#include <QLocalServer>
+#include <QLocalSocket>
 #include <QStringList>
 #include <QTcpServer>
 #include <QTcpSocket>
 #include <QUrl>
 
+#include "QDjangoHttpCompressor_p.h"
+#include "QDjangoHttpETag_p.h"
 #include "QDjangoHttpController.h"
+#include "QDjangoHttpController_p.h"
+#include "QDjangoHttpMetrics.h"
+#include "QDjangoHttpMetrics_p.h"
 #include "QDjangoHttpRequest.h"
+#include "QDjangoHttpRequestBody_p.h"
 #include "QDjangoHttpRequest_p.h"
 #include "QDjangoHttpResponse.h"
 #include "QDjangoHttpResponse_p.h"
@@ -31,46 +42,185 @@
 #include "QDjangoHttpServer_p.h"
 #include "QDjangoUrlResolver.h"
 
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/sendfile.h>
+#endif
+
 //#define QDJANGO_DEBUG_HTTP
 
-// maximum request body size is 10 MB
-#define MAX_BODY_SIZE (10 * 1024 * 1024)
+// size of the chunks read from request and response body devices
+#define BODY_CHUNK_SIZE (32 * 1024)
+
+// amount of data queued on the socket above which we stop reading
+// requests and body devices
+#define WRITE_HIGH_WATERMARK (128 * 1024)
+
+// amount of data queued on the socket below which we resume
+#define WRITE_LOW_WATERMARK (32 * 1024)
+
+// amount of request data buffered by the socket while we are paused
+#define READ_BUFFER_SIZE (64 * 1024)
+
+// maximum amount of data handed to sendfile() in one call
+#define SENDFILE_CHUNK_SIZE (1024 * 1024)
 
 /// \cond
 
+#ifdef Q_OS_LINUX
+/** Sends data from the current position of \a file up to the \a end
+ *  position directly to the socket, without copying it to user space.
+ *
+ * Returns the number of bytes sent, 0 if the socket cannot accept more
+ * data or -1 if an error occurred.
+ */
+static qint64 sendFile(int socketDescriptor, QFile *file, qint64 end)
+{
+    off_t offset = file->pos();
+    const qint64 bytesRemaining = end - offset;
+    const ssize_t sent = ::sendfile(socketDescriptor, file->handle(), &offset, qMin(bytesRemaining, qint64(SENDFILE_CHUNK_SIZE)));
+    if (sent < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    file->seek(offset);
+    return sent;
+}
+#endif
+
+#ifdef Q_OS_UNIX
+/** Writes \a header and \a body to the socket using a single system
+ *  call, without concatenating them.
+ *
+ * Returns the number of bytes written, 0 if the socket cannot accept
+ * data or -1 if an error occurred.
+ */
+static qint64 writeGathered(int socketDescriptor, const QByteArray &header, const QByteArray &body)
+{
+    struct iovec iov[2];
+    iov[0].iov_base = const_cast<char*>(header.constData());
+    iov[0].iov_len = header.size();
+    iov[1].iov_base = const_cast<char*>(body.constData());
+    iov[1].iov_len = body.size();
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = body.isEmpty() ? 1 : 2;
+#ifdef MSG_NOSIGNAL
+    const ssize_t written = ::sendmsg(socketDescriptor, &msg, MSG_NOSIGNAL);
+#else
+    const ssize_t written = ::sendmsg(socketDescriptor, &msg, 0);
+#endif
+    if (written < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    return written;
+}
+#endif
+
+/** Ignores the SIGPIPE signal, unless the application handles it.
+ *
+ * Data is written directly to the sockets' descriptors, bypassing Qt,
+ * which only ignores SIGPIPE once it writes to a socket itself. Without
+ * this, a client closing its connection early would kill the process.
+ */
+static void ignoreSigPipe()
+{
+#ifdef Q_OS_UNIX
+    static bool ignored = false;
+    if (ignored)
+        return;
+    ignored = true;
+
+    struct sigaction action;
+    if (::sigaction(SIGPIPE, 0, &action) == 0 && action.sa_handler == SIG_DFL) {
+        action.sa_handler = SIG_IGN;
+        ::sigaction(SIGPIPE, &action, 0);
+    }
+#endif
+}
+
+/** Returns the descriptor of the socket underlying the \a device,
+ *  or -1 if it has none.
+ */
+static int socketDescriptor(QIODevice *device)
+{
+    if (QAbstractSocket *socket = qobject_cast<QAbstractSocket*>(device))
+        return int(socket->socketDescriptor());
+    if (QLocalSocket *socket = qobject_cast<QLocalSocket*>(device))
+        return int(socket->socketDescriptor());
+    return -1;
+}
+
+/** Sets the size of the read buffer of the socket underlying the
+ *  \a device. A \a size of 0 means an unlimited buffer.
+ */
+static void setReadBufferSize(QIODevice *device, qint64 size)
+{
+    if (QAbstractSocket *socket = qobject_cast<QAbstractSocket*>(device))
+        socket->setReadBufferSize(size);
+    else if (QLocalSocket *socket = qobject_cast<QLocalSocket*>(device))
+        socket->setReadBufferSize(size);
+}
+
 /** Constructs a new HTTP connection.
  */
-QDjangoHttpConnection::QDjangoHttpConnection(QTcpSocket *device, QDjangoHttpServer *server)
+QDjangoHttpConnection::QDjangoHttpConnection(QIODevice *device, QDjangoHttpServer *server)
     : QObject(server),
+    m_acceptTime(QDjangoHttpMetricsPrivate::now()),
     m_closeAfterResponse(false),
+    m_limits(server->limits()),
+    m_metrics(server->metrics()->d),
     m_pendingRequest(0),
     m_requestCount(0),
     m_server(server),
-    m_socket(device)
+    m_device(device),
+    m_responseChunked(false),
+    m_responseHeaderSent(false),
+    m_serverHeader(QString::fromLatin1("%1/%2").arg(qApp->applicationName(), qApp->applicationVersion()).toLatin1()),
+    m_writePaused(false),
+    m_writingResponse(false),
+    m_requestStreamed(false)
 {
     bool check;
     Q_UNUSED(check);
 
-    m_socket->setParent(this);
-    check = connect(m_socket, SIGNAL(bytesWritten(qint64)),
+    // local sockets have no addresses, the client is on the same host
+    if (QTcpSocket *socket = qobject_cast<QTcpSocket*>(m_device)) {
+        m_remoteAddress = socket->peerAddress().toString();
+        m_serverName = socket->localAddress().toString();
+        m_serverPort = QString::number(socket->localPort());
+    } else {
+        m_serverName = QLatin1String("localhost");
+    }
+
+    m_device->setParent(this);
+    check = connect(m_device, SIGNAL(bytesWritten(qint64)),
                     this, SLOT(_q_bytesWritten(qint64)));
     Q_ASSERT(check);
 
-    check = connect(m_socket, SIGNAL(disconnected()),
+    check = connect(m_device, SIGNAL(disconnected()),
                     this, SIGNAL(closed()));
     Q_ASSERT(check);
 
-    check = connect(m_socket, SIGNAL(readyRead()),
+    check = connect(m_device, SIGNAL(readyRead()),
                     this, SLOT(_q_readyRead()));
     Q_ASSERT(check);
+
+    startTimeout(m_limits.idleTimeout());
 }
 
 /** Destroys the HTTP connection.
  */
 QDjangoHttpConnection::~QDjangoHttpConnection()
 {
-    if (m_pendingRequest)
+    // a streamed request is also held by its job
+    if (m_pendingRequest && !m_requestStreamed)
         delete m_pendingRequest;
+    m_metrics->activeRequests -= m_pendingJobs.size();
     foreach (const QDjangoHttpJob &job, m_pendingJobs) {
         delete job.first;
         delete job.second;
@@ -85,22 +235,87 @@ QDjangoHttpConnection::~QDjangoHttpConnection()
 void QDjangoHttpConnection::_q_bytesWritten(qint64 bytes)
 {
     Q_UNUSED(bytes);
-    if (!m_socket->bytesToWrite()) {
+    if (m_writePaused) {
+        if (m_device->bytesToWrite() >= WRITE_LOW_WATERMARK)
+            return;
+
+        // resume writing responses, then reading requests
+        m_writePaused = false;
+        setReadBufferSize(m_device, 0);
+        _q_writeResponse();
+        _q_readyRead();
+    } else if (m_responseHeaderSent) {
+        // resume streaming the current response body
+        _q_writeResponse();
+    } else if (!m_device->bytesToWrite()) {
         if (!m_pendingJobs.isEmpty()) {
             _q_writeResponse();
         } else if (m_closeAfterResponse) {
 #ifdef QDJANGO_DEBUG_HTTP
             qDebug("Closing connection");
 #endif
-            m_socket->close();
+            m_device->close();
             emit closed();
         }
     }
 }
 
+/** Pauses writing responses and reading requests if the data queued
+ *  on the socket exceeds the high watermark.
+ *
+ * Returns true if the connection is paused.
+ */
+bool QDjangoHttpConnection::writeBufferFull()
+{
+    if (!m_writePaused && m_device->bytesToWrite() >= WRITE_HIGH_WATERMARK) {
+        // let the kernel apply flow control to the client's requests
+        m_writePaused = true;
+        setReadBufferSize(m_device, READ_BUFFER_SIZE);
+    }
+    return m_writePaused;
+}
+
+/** Closes the connection because it exceeded the server's limits,
+ *  with the given warning \a message.
+ */
+void QDjangoHttpConnection::reject(const char *message)
+{
+    if (message)
+        qWarning("%s", message);
+    emit rejected();
+    m_device->close();
+}
+
+/** Closes the connection when it has been idle for too long, or when
+ *  the client is too slow sending its request.
+ */
+void QDjangoHttpConnection::timeout()
+{
+#ifdef QDJANGO_DEBUG_HTTP
+    qDebug("Connection timed out");
+#endif
+    if (m_pendingRequest)
+        reject(0);
+    else
+        m_device->close();
+}
+
 /** Handle incoming data on the socket.
  */
 void QDjangoHttpConnection::_q_readyRead()
+{
+    // requests are not read while responses are held up by a slow client
+    while (!m_writePaused && !m_closeAfterResponse && m_device->bytesAvailable()) {
+        if (!readRequest())
+            break;
+    }
+}
+
+/** Reads a request from the socket and dispatches it.
+ *
+ * Returns false if more data is needed or the connection was closed.
+ */
+bool QDjangoHttpConnection::readRequest()
 {
     QDjangoHttpRequest *request = m_pendingRequest;
     if (!request) {
@@ -108,15 +323,34 @@ void QDjangoHttpConnection::_q_readyRead()
         m_requestBytesRemaining = 0;
         m_requestHeaderLine = 0;
         m_requestHeaderReceived = false;
+        m_requestHeaderSize = 0;
         m_requestHeaders.clear();
+        m_requestKeepAlive = false;
         m_requestMajorVersion = 0;
         m_requestMinorVersion = 0;
         m_requestPath.clear();
+        m_requestStreamed = false;
+
+        // the first request of the connection started when it was accepted
+        request->d->timestamps[QDjangoHttpMetrics::AcceptPhase] = m_acceptTime ? m_acceptTime : QDjangoHttpMetricsPrivate::now();
+        m_acceptTime = 0;
+
+        // the whole header must arrive before the deadline
+        startTimeout(m_limits.headerTimeout());
     }
 
     // Read request header
-    while (!m_requestHeaderReceived && m_socket->canReadLine()) {
-        const QString line = QString::fromUtf8(m_socket->readLine());
+    while (!m_requestHeaderReceived && m_device->canReadLine()) {
+        const QByteArray rawLine = m_device->readLine();
+        m_requestHeaderSize += rawLine.size();
+        m_metrics->bytesReceived += rawLine.size();
+        if (m_limits.maximumHeaderSize() > 0 && m_requestHeaderSize > m_limits.maximumHeaderSize()) {
+            delete request;
+            m_pendingRequest = 0;
+            reject("HTTP request header is too large");
+            return false;
+        }
+        const QString line = QString::fromUtf8(rawLine);
 
         if (!m_requestHeaderLine++) {
             bool ok = false;
@@ -139,51 +373,101 @@ void QDjangoHttpConnection::_q_readyRead()
             }
             if (!ok) {
                 qWarning("Invalid HTTP request");
-                m_socket->close();
-                return;
+                m_device->close();
+                return false;
             }
         } else if (line != QLatin1String("\r\n")) {
             int i = line.indexOf(QLatin1Char(':'));
             if (i == -1) {
                 qWarning("Invalid HTTP request header");
-                m_socket->close();
-                return;
+                m_device->close();
+                return false;
+            }
+            if (m_limits.maximumHeaderCount() > 0 && m_requestHeaders.size() >= m_limits.maximumHeaderCount()) {
+                delete request;
+                m_pendingRequest = 0;
+                reject("HTTP request has too many header fields");
+                return false;
             }
             const QString key = line.left(i).trimmed();
             const QString value = line.mid(i + 1).trimmed();
             m_requestHeaders.append(qMakePair(key, value));
 
             if (key.toLower() == QLatin1String("content-length")) {
-                m_requestBytesRemaining = value.toInt();
+                bool ok;
+                m_requestBytesRemaining = value.toLongLong(&ok);
+                if (!ok)
+                    m_requestBytesRemaining = -1;
             }
         } else {
-            if (m_requestBytesRemaining < 0 || m_requestBytesRemaining > MAX_BODY_SIZE) {
+            if (m_requestBytesRemaining < 0) {
                 qWarning("Invalid Content-Length");
-                m_socket->close();
-                return;
+                m_device->close();
+                return false;
             }
             m_requestHeaderReceived = true;
+            request->d->timestamps[QDjangoHttpMetrics::HeaderPhase] = QDjangoHttpMetricsPrivate::now();
+            if (!startRequest(request))
+                return false;
         }
     }
     if (!m_requestHeaderReceived) {
+        // an incomplete line must not exceed the header size either
+        if (m_limits.maximumHeaderSize() > 0 && m_requestHeaderSize + m_device->bytesAvailable() > m_limits.maximumHeaderSize()) {
+            delete request;
+            m_pendingRequest = 0;
+            reject("HTTP request header is too large");
+            return false;
+        }
         m_pendingRequest = request;
-        return;
+        return false;
     }
 
     // Read request body
-    if (m_requestBytesRemaining > 0) {
-        const QByteArray chunk = m_socket->read(m_requestBytesRemaining);
-        request->d->buffer += chunk;
+    QDjangoHttpRequestBody *body = request->d->bodyDevice.data();
+    while (m_requestBytesRemaining > 0 && m_device->bytesAvailable()) {
+        const QByteArray chunk = m_device->read(qMin(m_requestBytesRemaining, qint64(BODY_CHUNK_SIZE)));
+        m_metrics->bytesReceived += chunk.size();
         m_requestBytesRemaining -= chunk.size();
+        if (!body->append(chunk.constData(), chunk.size())) {
+            if (!m_requestStreamed)
+                delete request;
+            m_pendingRequest = 0;
+            reject(0);
+            return false;
+        }
     }
     if (m_requestBytesRemaining) {
+        // the body must keep making progress
         m_pendingRequest = request;
-        return;
+        startTimeout(m_limits.bodyTimeout());
+        return false;
     }
     m_pendingRequest = 0;
+    stopTimeout();
 
+    /* Store keep-alive flag */
+    if (!m_requestKeepAlive)
+        m_closeAfterResponse = true;
+
+    /* Process request */
+    if (body)
+        body->finish();
+    if (!m_requestStreamed)
+        dispatchRequest(request);
+    _q_writeResponse();
+    return true;
+}
+
+/** Prepares the \a request once its header has been received, and
+ *  dispatches it right away if its handler streams the body.
+ *
+ * Returns false if the request was rejected.
+ */
+bool QDjangoHttpConnection::startRequest(QDjangoHttpRequest *request)
+{
 #ifdef QDJANGO_DEBUG_HTTP
-    qDebug("Handling request %i", d->requestCount++);
+    qDebug("Handling request %i", m_requestCount++);
 #endif
 
     /* Map meta-information */
@@ -207,52 +491,181 @@ void QDjangoHttpConnection::_q_readyRead()
 #else
     request->d->meta.insert(QLatin1String("QUERY_STRING"), QString::fromLatin1(QUrl(m_requestPath).encodedQuery()));
 #endif
-    request->d->meta.insert(QLatin1String("REMOTE_ADDR"), m_socket->peerAddress().toString());
+    request->d->meta.insert(QLatin1String("REMOTE_ADDR"), m_remoteAddress);
     request->d->meta.insert(QLatin1String("REQUEST_METHOD"), request->method());
-    request->d->meta.insert(QLatin1String("SERVER_NAME"), m_socket->localAddress().toString());
-    request->d->meta.insert(QLatin1String("SERVER_PORT"), QString::number(m_socket->localPort()));
+    request->d->meta.insert(QLatin1String("SERVER_NAME"), m_serverName);
+    request->d->meta.insert(QLatin1String("SERVER_PORT"), m_serverPort);
+    request->d->meta.insert(QLatin1String("SERVER_PROTOCOL"), QString::fromLatin1("HTTP/%1.%2").arg(m_requestMajorVersion).arg(m_requestMinorVersion));
 
-    /* Process request */
-    bool keepAlive = m_requestMajorVersion >= 1 && m_requestMinorVersion >= 1;
+    m_requestKeepAlive = m_requestMajorVersion >= 1 && m_requestMinorVersion >= 1;
     if (request->d->meta.value(QLatin1String("HTTP_CONNECTION")).toLower() == QLatin1String("keep-alive"))
-        keepAlive = true;
+        m_requestKeepAlive = true;
     else if (request->d->meta.value(QLatin1String("HTTP_CONNECTION")).toLower() == QLatin1String("close"))
-        keepAlive = false;
+        m_requestKeepAlive = false;
+
+    /* Apply the route's policy to the body */
+    qint64 maximumSize;
+    m_requestStreamed = m_server->urls()->bodyPolicy(*request, &maximumSize);
+    if (maximumSize < 0)
+        maximumSize = m_limits.maximumBodySize();
+    if (maximumSize > 0 && m_requestBytesRemaining > maximumSize) {
+        delete request;
+        m_pendingRequest = 0;
+        m_requestStreamed = false;
+        reject("HTTP request body is too large");
+        return false;
+    }
+    if (m_requestBytesRemaining > 0 || m_requestStreamed) {
+        request->d->bodyDevice = QSharedPointer<QDjangoHttpRequestBody>(new QDjangoHttpRequestBody(
+            request->d->meta.value(QLatin1String("CONTENT_TYPE")).toLatin1(), m_limits.bodySpoolThreshold(), maximumSize, m_requestStreamed));
+    }
+
+    /* Dispatch the request, its response is written once the body has arrived */
+    if (m_requestStreamed) {
+        m_pendingRequest = request;
+        dispatchRequest(request);
+    }
+    return true;
+}
 
+/** Invokes the handler for the \a request and queues its response.
+ */
+void QDjangoHttpConnection::dispatchRequest(QDjangoHttpRequest *request)
+{
     QDjangoHttpResponse *response = m_server->urls()->respond(*request, request->path());
+    request->d->timestamps[QDjangoHttpMetrics::HandlerPhase] = QDjangoHttpMetricsPrivate::now();
+    m_metrics->activeRequests++;
     m_pendingJobs << qMakePair(request, response);
 
-    /* Store keep-alive flag */
-    if (!keepAlive)
-        m_closeAfterResponse = true;
-
     connect(response, SIGNAL(ready()), this, SLOT(_q_writeResponse()));
-    _q_writeResponse();
+}
+
+/** Writes the body of the current \a response from its body device.
+ *
+ * Returns true once the whole body has been written.
+ */
+bool QDjangoHttpConnection::writeBody(QDjangoHttpResponse *response)
+{
+#ifdef Q_OS_LINUX
+    QFile *file = m_responseChunked ? 0 : qobject_cast<QFile*>(response->d->bodyDevice);
+    if (file && file->handle() < 0)
+        file = 0;
+#endif
+
+    while (!writeBufferFull()) {
+#ifdef Q_OS_LINUX
+        // once our own buffer is empty, let the kernel send the file
+        if (file && !m_device->bytesToWrite() && !response->d->bodyAtEnd()) {
+            const qint64 sent = sendFile(socketDescriptor(m_device), file, response->d->bodyEndPosition());
+            if (sent > 0) {
+                m_metrics->bytesSent += sent;
+                continue;
+            }
+            else if (sent < 0)
+                file = 0;
+
+            // The socket is full or sendfile() is not supported: queue
+            // a regular chunk so that we are notified when it drains.
+        }
+#endif
+
+        const QByteArray chunk = response->d->readBody(BODY_CHUNK_SIZE);
+        if (!chunk.isEmpty()) {
+            if (m_responseChunked) {
+                const QByteArray chunkSize = QByteArray::number(chunk.size(), 16) + "\r\n";
+                m_device->write(chunkSize);
+                m_device->write(chunk);
+                m_device->write("\r\n");
+                m_metrics->bytesSent += chunkSize.size() + 2;
+            } else {
+                m_device->write(chunk);
+            }
+            m_metrics->bytesSent += chunk.size();
+        } else if (response->d->bodyAtEnd()) {
+            if (m_responseChunked) {
+                m_device->write("0\r\n\r\n");
+                m_metrics->bytesSent += 5;
+            }
+            return true;
+        } else {
+            // wait for the device to provide more data
+            return false;
+        }
+    }
+
+    // wait for the socket to drain below the low watermark
+    return false;
 }
 
 void QDjangoHttpConnection::_q_writeResponse()
 {
-    while (!m_pendingJobs.isEmpty() &&
-            m_pendingJobs.first().second->isReady()) {
-        const QDjangoHttpJob job = m_pendingJobs.takeFirst();
+    // body devices may signal new data while we are reading from them
+    if (m_writingResponse)
+        return;
+    m_writingResponse = true;
+
+    while (!m_pendingJobs.isEmpty() && !writeBufferFull()) {
+        const QDjangoHttpJob job = m_pendingJobs.first();
         QDjangoHttpRequest *request = job.first;
         QDjangoHttpResponse *response = job.second;
-        if (!response->isReady())
-            return;
 
-        /* Finalise response */
-        response->setHeader(QLatin1String("Date"), QDjangoHttpController::httpDateTime(QDateTime::currentDateTime()));
-        response->setHeader(QLatin1String("Server"), QString::fromLatin1("%1/%2").arg(qApp->applicationName(), qApp->applicationVersion()));
-        response->setHeader(QLatin1String("Connection"), QLatin1String(m_closeAfterResponse ? "close" : "keep-alive"));
-
-        /* Send response */
-        QString httpHeader = QString::fromLatin1("HTTP/1.1 %1 %2\r\n").arg(response->d->statusCode).arg(response->d->reasonPhrase);
-        QList<QPair<QString, QString> >::ConstIterator it = response->d->headers.constBegin();
-        while (it != response->d->headers.constEnd()) {
-            httpHeader += (*it).first + QLatin1String(": ") + (*it).second + QLatin1String("\r\n");
-            ++it;
+        // a streamed request's response waits for the end of its body
+        if (request == m_pendingRequest)
+            break;
+
+        // the body is never sent in reply to a HEAD request, but the body
+        // device belongs to the response and may still be fed by its handler
+        const bool skipBody = request->method() == QLatin1String("HEAD");
+
+        if (!m_responseHeaderSent) {
+            if (!response->isReady())
+                break;
+            request->d->timestamps[QDjangoHttpMetrics::ReadyPhase] = QDjangoHttpMetricsPrivate::now();
+
+            /* Tag body, then compress it */
+            if (m_server->isETagEnabled() && !skipBody)
+                QDjangoHttpETag::tagResponse(*request, response);
+            if (m_server->isCompressionEnabled() && !skipBody)
+                QDjangoHttpCompressor::compressResponse(*request, response);
+
+            /* Determine how the body is delimited */
+            m_responseChunked = false;
+            if (response->d->bodyDevice && response->header(QLatin1String("Content-Length")).isEmpty()) {
+                if (request->meta(QLatin1String("SERVER_PROTOCOL")) == QLatin1String("HTTP/1.0")) {
+                    // the end of the body is signaled by closing the connection
+                    m_closeAfterResponse = true;
+                } else {
+                    m_responseChunked = true;
+                    response->setHeader(QLatin1String("Transfer-Encoding"), QLatin1String("chunked"));
+                }
+            }
+
+            /* Finalise response */
+            response->d->setHeader("Date", QDjangoHttpControllerPrivate::currentHttpDate());
+            response->d->setHeader("Server", m_serverHeader);
+            response->d->setHeader("Connection", m_closeAfterResponse ? "close" : "keep-alive");
+
+            /* Send response */
+            const QByteArray httpHeader = response->d->headerData(QDjangoHttpResponsePrivate::HttpHeader);
+            writeData(httpHeader, skipBody ? QByteArray() : response->d->body);
+            m_responseHeaderSent = true;
+
+            /* Watch the body device */
+            if (response->d->bodyDevice && !skipBody) {
+                connect(response->d->bodyDevice, SIGNAL(readyRead()),
+                        this, SLOT(_q_writeResponse()));
+                connect(response->d->bodyDevice, SIGNAL(readChannelFinished()),
+                        this, SLOT(_q_writeResponse()));
+            }
         }
-        m_socket->write(httpHeader.toUtf8() + "\r\n" + response->d->body);
+
+        /* Stream body */
+        if (response->d->bodyDevice && !skipBody && !writeBody(response))
+            break;
+        m_pendingJobs.removeFirst();
+        m_responseHeaderSent = false;
+        request->d->timestamps[QDjangoHttpMetrics::WrittenPhase] = QDjangoHttpMetricsPrivate::now();
+        m_metrics->requestFinished(request->d->route, request->d->timestamps, response->statusCode());
 
         /* Emit signal */
         emit requestFinished(request, response);
@@ -261,6 +674,49 @@ void QDjangoHttpConnection::_q_writeResponse()
         delete request;
         response->deleteLater();
     }
+
+    m_writingResponse = false;
+
+    if (m_pendingJobs.isEmpty()) {
+        if (m_closeAfterResponse) {
+            // data written directly to the socket does not trigger bytesWritten()
+            if (!m_device->bytesToWrite()) {
+#ifdef QDJANGO_DEBUG_HTTP
+                qDebug("Closing connection");
+#endif
+                m_device->close();
+                emit closed();
+            }
+        } else if (!m_pendingRequest) {
+            // wait for the next request
+            startTimeout(m_limits.idleTimeout());
+        }
+    }
+}
+
+/** Writes a response \a header followed by \a body data to the socket.
+ *
+ * When nothing is queued on the socket, both are handed to the kernel
+ * in a single call and only the remainder, if any, is buffered.
+ */
+void QDjangoHttpConnection::writeData(const QByteArray &header, const QByteArray &body)
+{
+    m_metrics->bytesSent += header.size() + body.size();
+
+    qint64 written = 0;
+#ifdef Q_OS_UNIX
+    if (!m_device->bytesToWrite())
+        written = qMax(qint64(0), writeGathered(socketDescriptor(m_device), header, body));
+#endif
+    if (written < header.size()) {
+        m_device->write(header.constData() + written, header.size() - written);
+        if (!body.isEmpty())
+            m_device->write(body);
+    } else {
+        written -= header.size();
+        if (written < body.size())
+            m_device->write(body.constData() + written, body.size() - written);
+    }
 }
 
 /// \endcond
@@ -268,26 +724,88 @@ void QDjangoHttpConnection::_q_writeResponse()
 class QDjangoHttpServerPrivate
 {
 public:
-    int connectionCount;
+    QDjangoHttpServerPrivate(QDjangoHttpServer *qq);
+    void addConnection(QIODevice *device);
+
+    bool compressionEnabled;
+    bool etagEnabled;
+    QDjangoHttpLimits limits;
+    QLocalServer *localServer;
+    QDjangoHttpMetrics *metrics;
     QTcpServer *tcpServer;
     QDjangoUrlResolver *urlResolver;
+
+private:
+    QDjangoHttpServer *q;
 };
 
+QDjangoHttpServerPrivate::QDjangoHttpServerPrivate(QDjangoHttpServer *qq)
+    : compressionEnabled(false),
+    etagEnabled(false),
+    localServer(0),
+    tcpServer(0),
+    q(qq)
+{
+    metrics = new QDjangoHttpMetrics(q);
+    urlResolver = new QDjangoUrlResolver(q);
+}
+
+/** Handles a new connection on the given \a device, unless the
+ *  maximum number of connections has been reached.
+ */
+void QDjangoHttpServerPrivate::addConnection(QIODevice *device)
+{
+    bool check;
+    Q_UNUSED(check);
+
+    if (limits.maximumConnections() > 0 && metrics->d->activeConnections >= limits.maximumConnections()) {
+#ifdef QDJANGO_DEBUG_HTTP
+        qDebug("Rejecting connection");
+#endif
+        metrics->d->rejectedConnections++;
+        device->close();
+        device->deleteLater();
+        return;
+    }
+
+    QDjangoHttpConnection *connection = new QDjangoHttpConnection(device, q);
+    metrics->d->activeConnections++;
+    metrics->d->connectionCount++;
+#ifdef QDJANGO_DEBUG_HTTP
+    qDebug("Handling connection %lld", (long long)metrics->d->connectionCount);
+#endif
+
+    check = q->connect(connection, SIGNAL(closed()),
+                       connection, SLOT(deleteLater()));
+    Q_ASSERT(check);
+
+    check = q->connect(connection, SIGNAL(destroyed()),
+                       q, SLOT(_q_connectionDestroyed()));
+    Q_ASSERT(check);
+
+    check = q->connect(connection, SIGNAL(rejected()),
+                       q, SLOT(_q_connectionRejected()));
+    Q_ASSERT(check);
+
+    check = q->connect(connection, SIGNAL(requestFinished(QDjangoHttpRequest*,QDjangoHttpResponse*)),
+                       q, SIGNAL(requestFinished(QDjangoHttpRequest*,QDjangoHttpResponse*)));
+    Q_ASSERT(check);
+}
+
 /** Constructs a new HTTP server.
  */
 QDjangoHttpServer::QDjangoHttpServer(QObject *parent)
     : QObject(parent),
-    d(new QDjangoHttpServerPrivate)
+    d(new QDjangoHttpServerPrivate(this))
 {
-    d->connectionCount = 0;
-    d->tcpServer = 0;
-    d->urlResolver = new QDjangoUrlResolver(this);
 }
 
 /** Destroys the HTTP server.
  */
 QDjangoHttpServer::~QDjangoHttpServer()
 {
+    // connections update the metrics until they are destroyed
+    qDeleteAll(findChildren<QDjangoHttpConnection*>());
     delete d;
 }
 
@@ -296,10 +814,108 @@ QDjangoHttpServer::~QDjangoHttpServer()
  */
 void QDjangoHttpServer::close()
 {
+    if (d->localServer)
+        d->localServer->close();
     if (d->tcpServer)
         d->tcpServer->close();
 }
 
+/** Returns true if responses are compressed when the client supports it.
+ *
+ * \sa setCompressionEnabled()
+ */
+bool QDjangoHttpServer::isCompressionEnabled() const
+{
+    return d->compressionEnabled;
+}
+
+/** Sets whether responses are compressed when the client supports it.
+ *
+ * When enabled, the bodies of textual responses (HTML, CSS, JavaScript,
+ * JSON, XML..) are compressed using gzip or deflate according to the
+ * request's Accept-Encoding header. Streamed bodies are compressed as
+ * they are sent. Compression is disabled by default.
+ *
+ * \param enabled
+ */
+void QDjangoHttpServer::setCompressionEnabled(bool enabled)
+{
+    d->compressionEnabled = enabled;
+}
+
+/** Returns true if dynamic responses are tagged with an entity tag
+ *  computed from their body.
+ *
+ * \sa setETagEnabled()
+ */
+bool QDjangoHttpServer::isETagEnabled() const
+{
+    return d->etagEnabled;
+}
+
+/** Sets whether dynamic responses are tagged with an entity tag
+ *  computed from their body.
+ *
+ * When enabled, successful responses to GET requests whose body
+ * is held in memory receive a weak ETag header, computed using a
+ * fast non-cryptographic hash of the body. Requests whose If-None-Match
+ * header matches the tag are answered with a bodiless 304 Not Modified
+ * response, so clients which poll a resource do not download it again
+ * until it changes. Responses which already carry an ETag header are
+ * left untouched. Entity tags are disabled by default.
+ *
+ * \param enabled
+ */
+void QDjangoHttpServer::setETagEnabled(bool enabled)
+{
+    d->etagEnabled = enabled;
+}
+
+/** Returns the limits which the server enforces on its connections.
+ *
+ * \sa setLimits()
+ */
+QDjangoHttpLimits QDjangoHttpServer::limits() const
+{
+    return d->limits;
+}
+
+/** Sets the \a limits which the server enforces on its connections.
+ *
+ * The limits apply to connections which are accepted after the call.
+ *
+ * \param limits
+ */
+void QDjangoHttpServer::setLimits(const QDjangoHttpLimits &limits)
+{
+    d->limits = limits;
+}
+
+/** Tells the server to listen for incoming connections on the given
+ *  local socket, for instance a Unix domain socket for a reverse proxy
+ *  running on the same host.
+ *
+ * Requests received on a local socket have an empty REMOTE_ADDR and
+ * SERVER_PORT, and a SERVER_NAME of "localhost".
+ *
+ * \param name
+ */
+bool QDjangoHttpServer::listen(const QString &name)
+{
+    if (!d->localServer) {
+        bool check;
+        Q_UNUSED(check);
+
+        d->localServer = new QLocalServer(this);
+        check = connect(d->localServer, SIGNAL(newConnection()),
+                        this, SLOT(_q_newLocalConnection()));
+        Q_ASSERT(check);
+    }
+
+    ignoreSigPipe();
+    return d->localServer->listen(name);
+}
+
 /** Tells the server to listen for incoming TCP connections on the given
  *  \a address and \a port.
  */
@@ -315,9 +931,27 @@ bool QDjangoHttpServer::listen(const QHostAddress &address, quint16 port)
         Q_ASSERT(check);
     }
 
+    ignoreSigPipe();
     return d->tcpServer->listen(address, port);
 }
 
+/** Returns the metrics of the server.
+ */
+QDjangoHttpMetrics *QDjangoHttpServer::metrics() const
+{
+    return d->metrics;
+}
+
+/** Returns the number of connections which were closed because they
+ *  exceeded the server's limits.
+ *
+ * \sa limits()
+ */
+int QDjangoHttpServer::rejectedConnections() const
+{
+    return d->metrics->d->rejectedConnections;
+}
+
 /** Returns the server's address if the server is listening for connections;
  *  otherwise returns QHostAddress::Null.
  */
@@ -346,26 +980,30 @@ QDjangoUrlResolver* QDjangoHttpServer::urls() const
     return d->urlResolver;
 }
 
-/** Handles the creation of new HTTP connections.
- */
-void QDjangoHttpServer::_q_newTcpConnection()
+void QDjangoHttpServer::_q_connectionDestroyed()
 {
-    bool check;
-    Q_UNUSED(check);
+    d->metrics->d->activeConnections--;
+}
 
-    QTcpSocket *socket;
-    while ((socket = d->tcpServer->nextPendingConnection()) != 0) {
-        QDjangoHttpConnection *connection = new QDjangoHttpConnection(socket, this);
-#ifdef QDJANGO_DEBUG_HTTP
-        qDebug("Handling connection %i", d->connectionCount++);
-#endif
+void QDjangoHttpServer::_q_connectionRejected()
+{
+    d->metrics->d->rejectedConnections++;
+}
 
-        check = connect(connection, SIGNAL(closed()),
-                        connection, SLOT(deleteLater()));
-        Q_ASSERT(check);
+/** Handles the creation of new HTTP connections on the local socket.
+ */
+void QDjangoHttpServer::_q_newLocalConnection()
+{
+    QLocalSocket *socket;
+    while ((socket = d->localServer->nextPendingConnection()) != 0)
+        d->addConnection(socket);
+}
 
-        check = connect(connection, SIGNAL(requestFinished(QDjangoHttpRequest*,QDjangoHttpResponse*)),
-                        this, SIGNAL(requestFinished(QDjangoHttpRequest*,QDjangoHttpResponse*)));
-        Q_ASSERT(check);
-    }
+/** Handles the creation of new HTTP connections over TCP.
+ */
+void QDjangoHttpServer::_q_newTcpConnection()
+{
+    QTcpSocket *socket;
+    while ((socket = d->tcpServer->nextPendingConnection()) != 0)
+        d->addConnection(socket);
 }
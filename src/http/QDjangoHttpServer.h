@@ -22,7 +22,9 @@
 #include <QObject>
 
 #include "QDjangoHttp_p.h"
+#include "QDjangoHttpLimits.h"
 
+class QDjangoHttpMetrics;
 class QDjangoHttpRequest;
 class QDjangoHttpResponse;
 class QDjangoHttpServer;
@@ -48,7 +50,16 @@ public:
     ~QDjangoHttpServer();
 
     void close();
+    bool isCompressionEnabled() const;
+    void setCompressionEnabled(bool enabled);
+    bool isETagEnabled() const;
+    void setETagEnabled(bool enabled);
+    QDjangoHttpLimits limits() const;
+    void setLimits(const QDjangoHttpLimits &limits);
+    bool listen(const QString &name);
     bool listen(const QHostAddress &address, quint16 port);
+    QDjangoHttpMetrics *metrics() const;
+    int rejectedConnections() const;
     QHostAddress serverAddress() const;
     quint16 serverPort() const;
     QDjangoUrlResolver *urls() const;
@@ -59,6 +70,9 @@ signals:
     void requestFinished(QDjangoHttpRequest *request, QDjangoHttpResponse *response);
 
 private slots:
+    void _q_connectionDestroyed();
+    void _q_connectionRejected();
+    void _q_newLocalConnection();
     void _q_newTcpConnection();
 
 private:
@@ -30,21 +30,25 @@
 #include <QPair>
 #include <QString>
 
+#include "QDjangoHttpLimits.h"
+#include "QDjangoHttpTimerWheel_p.h"
+
+class QDjangoHttpMetricsPrivate;
 class QDjangoHttpRequest;
 class QDjangoHttpResponse;
 class QDjangoHttpServer;
-class QTcpSocket;
+class QIODevice;
 
 typedef QPair<QDjangoHttpRequest*,QDjangoHttpResponse*> QDjangoHttpJob;
 
 /** \internal
  */
-class QDjangoHttpConnection : public QObject
+class QDjangoHttpConnection : public QObject, public QDjangoHttpTimerClient
 {
     Q_OBJECT
 
 public:
-    QDjangoHttpConnection(QTcpSocket *device, QDjangoHttpServer *server);
+    QDjangoHttpConnection(QIODevice *device, QDjangoHttpServer *server);
     ~QDjangoHttpConnection();
 
 signals:
@@ -52,10 +56,18 @@ signals:
      */
     void closed();
 
+    /** This signal is emitted when the connection is closed because
+     *  it exceeded the server's limits.
+     */
+    void rejected();
+
     /** This signal is emitted when a request completes.
      */
     void requestFinished(QDjangoHttpRequest *request, QDjangoHttpResponse *response);
 
+protected:
+    void timeout();
+
 private slots:
     void _q_bytesWritten(qint64 bytes);
     void _q_readyRead();
@@ -63,21 +75,47 @@ private slots:
 
 private:
     Q_DISABLE_COPY(QDjangoHttpConnection)
+    void dispatchRequest(QDjangoHttpRequest *request);
+    bool readRequest();
+    bool startRequest(QDjangoHttpRequest *request);
+    bool writeBody(QDjangoHttpResponse *response);
+    bool writeBufferFull();
+    void reject(const char *message);
+    void writeData(const QByteArray &header, const QByteArray &body);
+
+    qint64 m_acceptTime;
     bool m_closeAfterResponse;
+    QDjangoHttpLimits m_limits;
+    QDjangoHttpMetricsPrivate *m_metrics;
     QList<QDjangoHttpJob> m_pendingJobs;
     QDjangoHttpRequest *m_pendingRequest;
     int m_requestCount;
     QDjangoHttpServer *m_server;
-    QTcpSocket *m_socket;
+    QIODevice *m_device;
+
+    // request meta-information which depends on the connection
+    QString m_remoteAddress;
+    QString m_serverName;
+    QString m_serverPort;
+
+    // response writing
+    bool m_responseChunked;
+    bool m_responseHeaderSent;
+    QByteArray m_serverHeader;
+    bool m_writePaused;
+    bool m_writingResponse;
 
     // request parsing
     qint64 m_requestBytesRemaining;
     int m_requestHeaderLine;
     bool m_requestHeaderReceived;
+    int m_requestHeaderSize;
     QList<QPair<QString, QString> > m_requestHeaders;
+    bool m_requestKeepAlive;
     int m_requestMajorVersion;
     int m_requestMinorVersion;
     QString m_requestPath;
+    bool m_requestStreamed;
 };
 
 #endif
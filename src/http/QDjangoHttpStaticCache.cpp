@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <QCache>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QMutex>
+#include <QStringList>
+
+#include "QDjangoHttpCompressor_p.h"
+#include "QDjangoHttpController.h"
+#include "QDjangoHttpController_p.h"
+#include "QDjangoHttpRequest.h"
+#include "QDjangoHttpResponse.h"
+#include "QDjangoHttpStaticCache.h"
+
+/// \cond
+
+class QDjangoHttpStaticCacheEntry
+{
+public:
+    int cost() const;
+
+    QByteArray data;
+    QByteArray deflateData;
+    QByteArray gzipData;
+    QString etag;
+    QDateTime lastModified;
+    QString mimeType;
+};
+
+int QDjangoHttpStaticCacheEntry::cost() const
+{
+    return data.size() + deflateData.size() + gzipData.size();
+}
+
+class QDjangoHttpStaticCachePrivate
+{
+public:
+    QDjangoHttpStaticCachePrivate(QDjangoHttpStaticCache *qq);
+    bool load(const QString &docPath, const QFileInfo &info, QDjangoHttpStaticCacheEntry &entry) const;
+
+    QCache<QString, QDjangoHttpStaticCacheEntry> entries;
+    qint64 hits;
+    int maximumFileSize;
+    qint64 misses;
+    mutable QMutex mutex;
+    QFileSystemWatcher *watcher;
+
+private:
+    QDjangoHttpStaticCache *q;
+};
+
+QDjangoHttpStaticCachePrivate::QDjangoHttpStaticCachePrivate(QDjangoHttpStaticCache *qq)
+    : hits(0)
+    , maximumFileSize(1024 * 1024)
+    , misses(0)
+    , q(qq)
+{
+    entries.setMaxCost(32 * 1024 * 1024);
+    watcher = new QFileSystemWatcher(q);
+}
+
+/** Reads the file at \a docPath and prepares its variants.
+ */
+bool QDjangoHttpStaticCachePrivate::load(const QString &docPath, const QFileInfo &info, QDjangoHttpStaticCacheEntry &entry) const
+{
+    QFile file(docPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    entry.data = file.readAll();
+    entry.etag = QString::fromLatin1(QCryptographicHash::hash(entry.data, QCryptographicHash::Md5).toHex());
+    entry.mimeType = QDjangoHttpControllerPrivate::mimeType(info.fileName());
+    if (docPath.startsWith(QLatin1String(":/")))
+        entry.lastModified = QFileInfo(qApp->applicationFilePath()).lastModified();
+    else
+        entry.lastModified = info.lastModified();
+
+    // precompress text-based formats
+    if (entry.data.size() >= COMPRESS_MIN_SIZE && QDjangoHttpCompressor::isCompressible(entry.mimeType)) {
+        entry.gzipData = QDjangoHttpCompressor::compress(entry.data, QDjangoHttpCompressor::Gzip);
+        if (entry.gzipData.size() >= entry.data.size())
+            entry.gzipData.clear();
+        entry.deflateData = QDjangoHttpCompressor::compress(entry.data, QDjangoHttpCompressor::Deflate);
+        if (entry.deflateData.size() >= entry.data.size())
+            entry.deflateData.clear();
+    }
+    return true;
+}
+
+/// \endcond
+
+/** Constructs a new static file cache.
+ *
+ * \param parent
+ */
+QDjangoHttpStaticCache::QDjangoHttpStaticCache(QObject *parent)
+    : QObject(parent)
+    , d(new QDjangoHttpStaticCachePrivate(this))
+{
+    bool check;
+    Q_UNUSED(check);
+
+    check = connect(d->watcher, SIGNAL(fileChanged(QString)),
+                    this, SLOT(_q_fileChanged(QString)));
+    Q_ASSERT(check);
+}
+
+/** Destroys the static file cache.
+ */
+QDjangoHttpStaticCache::~QDjangoHttpStaticCache()
+{
+    delete d;
+}
+
+/** Returns the size in bytes above which files are not cached.
+ */
+int QDjangoHttpStaticCache::maximumFileSize() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->maximumFileSize;
+}
+
+/** Sets the size in bytes above which files are not cached.
+ *
+ * The default value is 1MB.
+ *
+ * \param size
+ */
+void QDjangoHttpStaticCache::setMaximumFileSize(int size)
+{
+    QMutexLocker locker(&d->mutex);
+    d->maximumFileSize = size;
+}
+
+/** Returns the maximum amount of memory in bytes used by the cache.
+ */
+int QDjangoHttpStaticCache::maximumSize() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->entries.maxCost();
+}
+
+/** Sets the maximum amount of memory in bytes used by the cache.
+ *
+ * The default value is 32MB.
+ *
+ * \param size
+ */
+void QDjangoHttpStaticCache::setMaximumSize(int size)
+{
+    QMutexLocker locker(&d->mutex);
+    d->entries.setMaxCost(size);
+}
+
+/** Returns the number of requests which were served from the cache.
+ */
+qint64 QDjangoHttpStaticCache::hits() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->hits;
+}
+
+/** Returns the number of requests which could not be served from the cache.
+ */
+qint64 QDjangoHttpStaticCache::misses() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->misses;
+}
+
+/** Returns the amount of memory in bytes currently used by the cache.
+ */
+int QDjangoHttpStaticCache::size() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->entries.totalCost();
+}
+
+/** Removes all the files from the cache.
+ */
+void QDjangoHttpStaticCache::clear()
+{
+    QMutexLocker locker(&d->mutex);
+    d->entries.clear();
+    const QStringList files = d->watcher->files();
+    if (!files.isEmpty())
+        d->watcher->removePaths(files);
+}
+
+/** Respond to an HTTP \a request for a static file.
+ *
+ * This method is thread-safe and can be used in place of
+ * QDjangoHttpController::serveStatic().
+ *
+ * \param request
+ * \param docPath The path to the document, such that it can be opened using a QFile.
+ * \param expires An optional expiry date.
+ */
+QDjangoHttpResponse *QDjangoHttpStaticCache::serveStatic(const QDjangoHttpRequest &request, const QString &docPath, const QDateTime &expires)
+{
+    QDjangoHttpStaticCacheEntry entry;
+    bool found = false;
+    int maximumFileSize;
+    {
+        QMutexLocker locker(&d->mutex);
+        QDjangoHttpStaticCacheEntry *cached = d->entries.object(docPath);
+        if (cached) {
+            entry = *cached;
+            d->hits++;
+            found = true;
+        } else {
+            d->misses++;
+        }
+        maximumFileSize = d->maximumFileSize;
+    }
+
+    if (!found) {
+        QFileInfo info(docPath);
+        if (!info.isFile() || info.size() > maximumFileSize)
+            return QDjangoHttpController::serveStatic(request, docPath, expires);
+        if (!d->load(docPath, info, entry))
+            return QDjangoHttpController::serveInternalServerError(request);
+
+        QMutexLocker locker(&d->mutex);
+        d->entries.insert(docPath, new QDjangoHttpStaticCacheEntry(entry), entry.cost());
+        locker.unlock();
+
+        // resources cannot change, files on disk are watched
+        if (!docPath.startsWith(QLatin1String(":/")))
+            QMetaObject::invokeMethod(this, "_q_watchFile", Q_ARG(QString, docPath));
+    }
+
+    // select the representation
+    QDjangoHttpCompressor::Encoding encoding = QDjangoHttpCompressor::Identity;
+    const bool hasVariants = !entry.gzipData.isEmpty() || !entry.deflateData.isEmpty();
+    if (hasVariants) {
+        encoding = QDjangoHttpCompressor::negotiate(request.meta(QLatin1String("HTTP_ACCEPT_ENCODING")));
+        if ((encoding == QDjangoHttpCompressor::Gzip && entry.gzipData.isEmpty()) ||
+            (encoding == QDjangoHttpCompressor::Deflate && entry.deflateData.isEmpty()))
+            encoding = QDjangoHttpCompressor::Identity;
+    }
+    QString etag = entry.etag;
+    if (encoding != QDjangoHttpCompressor::Identity)
+        etag += QLatin1Char('-') + QDjangoHttpCompressor::encodingName(encoding);
+    etag = QLatin1Char('"') + etag + QLatin1Char('"');
+
+    QDjangoHttpResponse *response = new QDjangoHttpResponse;
+    response->setStatusCode(QDjangoHttpResponse::OK);
+    if (entry.lastModified.isValid())
+        response->setHeader(QLatin1String("Last-Modified"), QDjangoHttpController::httpDateTime(entry.lastModified));
+    if (expires.isValid())
+        response->setHeader(QLatin1String("Expires"), QDjangoHttpController::httpDateTime(expires));
+    response->setHeader(QLatin1String("ETag"), etag);
+    if (hasVariants)
+        response->setHeader(QLatin1String("Vary"), QLatin1String("Accept-Encoding"));
+
+    // handle if-none-match, then if-modified-since
+    const QString ifNoneMatch = request.meta(QLatin1String("HTTP_IF_NONE_MATCH"));
+    if (!ifNoneMatch.isEmpty()) {
+        if (QDjangoHttpControllerPrivate::matchesETag(ifNoneMatch, etag)) {
+            response->setStatusCode(QDjangoHttpResponse::NotModified);
+            return response;
+        }
+    } else {
+        const QDateTime ifModifiedSince = QDjangoHttpController::httpDateTime(request.meta(QLatin1String("HTTP_IF_MODIFIED_SINCE")));
+        if (entry.lastModified.isValid() && ifModifiedSince.isValid() && entry.lastModified <= ifModifiedSince) {
+            response->setStatusCode(QDjangoHttpResponse::NotModified);
+            return response;
+        }
+    }
+
+    response->setHeader(QLatin1String("Content-Type"), entry.mimeType);
+    response->setHeader(QLatin1String("Accept-Ranges"), QLatin1String("bytes"));
+
+    // ranges are served from the identity representation
+    QList<QDjangoHttpByteRange> ranges;
+    const QString identityETag = QLatin1Char('"') + entry.etag + QLatin1Char('"');
+    const qint64 size = entry.data.size();
+    if (QDjangoHttpControllerPrivate::parseRanges(request, size, identityETag, entry.lastModified, ranges)) {
+        if (ranges.isEmpty()) {
+            delete response;
+            return QDjangoHttpControllerPrivate::serveRangeNotSatisfiable(request, size);
+        }
+        response->setStatusCode(QDjangoHttpResponse::PartialContent);
+        response->setHeader(QLatin1String("ETag"), identityETag);
+        if (ranges.size() == 1) {
+            const QDjangoHttpByteRange range = ranges.first();
+            response->setHeader(QLatin1String("Content-Range"), QString::fromLatin1("bytes %1-%2/%3").arg(
+                QString::number(range.first), QString::number(range.second), QString::number(size)));
+            response->setBody(entry.data.mid(range.first, range.second - range.first + 1));
+        } else {
+            const QByteArray boundary = QDjangoHttpControllerPrivate::multipartBoundary();
+            QByteArray body;
+            for (int i = 0; i < ranges.size(); ++i) {
+                body += QDjangoHttpControllerPrivate::multipartHeader(boundary, entry.mimeType, ranges[i], size, i == 0);
+                body += entry.data.mid(ranges[i].first, ranges[i].second - ranges[i].first + 1);
+            }
+            body += QDjangoHttpControllerPrivate::multipartTrailer(boundary);
+            response->setHeader(QLatin1String("Content-Type"), QLatin1String("multipart/byteranges; boundary=") + QString::fromLatin1(boundary));
+            response->setBody(body);
+        }
+        return response;
+    }
+
+    if (encoding == QDjangoHttpCompressor::Gzip) {
+        response->setHeader(QLatin1String("Content-Encoding"), QDjangoHttpCompressor::encodingName(encoding));
+        response->setBody(entry.gzipData);
+    } else if (encoding == QDjangoHttpCompressor::Deflate) {
+        response->setHeader(QLatin1String("Content-Encoding"), QDjangoHttpCompressor::encodingName(encoding));
+        response->setBody(entry.deflateData);
+    } else {
+        response->setBody(entry.data);
+    }
+    return response;
+}
+
+void QDjangoHttpStaticCache::_q_fileChanged(const QString &path)
+{
+    QMutexLocker locker(&d->mutex);
+    d->entries.remove(path);
+    if (d->watcher->files().contains(path))
+        d->watcher->removePath(path);
+}
+
+void QDjangoHttpStaticCache::_q_watchFile(const QString &path)
+{
+    QMutexLocker locker(&d->mutex);
+    QDjangoHttpStaticCacheEntry *cached = d->entries.object(path);
+    if (!cached || d->watcher->files().contains(path))
+        return;
+    d->watcher->addPath(path);
+
+    // the file may have changed before we started watching it
+    if (QFileInfo(path).lastModified() != cached->lastModified)
+        d->entries.remove(path);
+}
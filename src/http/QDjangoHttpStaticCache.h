@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_HTTP_STATIC_CACHE_H
+#define QDJANGO_HTTP_STATIC_CACHE_H
+
+#include <QDateTime>
+#include <QObject>
+
+#include "QDjangoHttp_p.h"
+
+class QDjangoHttpRequest;
+class QDjangoHttpResponse;
+class QDjangoHttpStaticCachePrivate;
+
+/** \brief The QDjangoHttpStaticCache class serves static files from memory.
+ *
+ * Files, including Qt resources, are loaded the first time they are
+ * requested and kept in memory along with a strong entity tag derived
+ * from their contents and, for text-based formats, precompressed gzip
+ * and deflate variants.
+ *
+ * Requests carrying If-None-Match or If-Modified-Since headers are
+ * answered with a 304 response when possible, and the Accept-Encoding
+ * header is used to select a compressed variant. Range requests are
+ * served from the uncompressed contents.
+ *
+ * Files on disk are evicted from the cache as soon as they are modified.
+ * When the total size of the cached files exceeds maximumSize(), the
+ * least recently used entries are evicted. Files larger than
+ * maximumFileSize() are never cached and are served by
+ * QDjangoHttpController::serveStatic().
+ *
+ * \ingroup Http
+ */
+class QDJANGO_HTTP_EXPORT QDjangoHttpStaticCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    QDjangoHttpStaticCache(QObject *parent = 0);
+    ~QDjangoHttpStaticCache();
+
+    int maximumFileSize() const;
+    void setMaximumFileSize(int size);
+
+    int maximumSize() const;
+    void setMaximumSize(int size);
+
+    qint64 hits() const;
+    qint64 misses() const;
+    int size() const;
+
+    void clear();
+    QDjangoHttpResponse *serveStatic(const QDjangoHttpRequest &request, const QString &docPath, const QDateTime &expires = QDateTime());
+
+private slots:
+    void _q_fileChanged(const QString &path);
+    void _q_watchFile(const QString &path);
+
+private:
+    Q_DISABLE_COPY(QDjangoHttpStaticCache)
+    QDjangoHttpStaticCachePrivate* const d;
+    friend class QDjangoHttpStaticCachePrivate;
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <cstring>
+
+#include <QIODevice>
+#include <QPointer>
+
+#include "QDjangoHttpStreamResponse.h"
+
+/// \cond
+
+class QDjangoHttpStreamDevice : public QIODevice
+{
+public:
+    QDjangoHttpStreamDevice(QDjangoHttpStreamResponse *response);
+
+    bool atEnd() const;
+    qint64 bytesAvailable() const;
+    bool isSequential() const;
+    void notifyFinished();
+    void notifyReadyRead();
+
+    QByteArray buffer;
+    bool fetching;
+    bool finished;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+    QPointer<QDjangoHttpStreamResponse> q;
+};
+
+class QDjangoHttpStreamResponsePrivate
+{
+public:
+    QDjangoHttpStreamResponsePrivate();
+
+    QPointer<QDjangoHttpStreamDevice> device;
+    bool finished;
+};
+
+QDjangoHttpStreamDevice::QDjangoHttpStreamDevice(QDjangoHttpStreamResponse *response)
+    : fetching(false)
+    , finished(false)
+    , q(response)
+{
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+bool QDjangoHttpStreamDevice::atEnd() const
+{
+    return finished && buffer.isEmpty();
+}
+
+qint64 QDjangoHttpStreamDevice::bytesAvailable() const
+{
+    return buffer.size() + QIODevice::bytesAvailable();
+}
+
+bool QDjangoHttpStreamDevice::isSequential() const
+{
+    return true;
+}
+
+void QDjangoHttpStreamDevice::notifyFinished()
+{
+    emit readChannelFinished();
+}
+
+void QDjangoHttpStreamDevice::notifyReadyRead()
+{
+    emit readyRead();
+}
+
+qint64 QDjangoHttpStreamDevice::readData(char *data, qint64 maxSize)
+{
+    // ask the producer for more data, unless it has gone away
+    if (buffer.isEmpty() && !finished && !fetching && q) {
+        fetching = true;
+        q->fetchMore();
+        fetching = false;
+    }
+
+    const qint64 length = qMin(qint64(buffer.size()), maxSize);
+    if (length > 0) {
+        memcpy(data, buffer.constData(), length);
+        buffer.remove(0, length);
+    }
+    return length;
+}
+
+qint64 QDjangoHttpStreamDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+QDjangoHttpStreamResponsePrivate::QDjangoHttpStreamResponsePrivate()
+    : finished(false)
+{
+}
+
+/// \endcond
+
+/** Constructs a new streaming HTTP response.
+ */
+QDjangoHttpStreamResponse::QDjangoHttpStreamResponse()
+    : d(new QDjangoHttpStreamResponsePrivate)
+{
+    d->device = new QDjangoHttpStreamDevice(this);
+    setBodyDevice(d->device);
+}
+
+/** Destroys the streaming HTTP response.
+ */
+QDjangoHttpStreamResponse::~QDjangoHttpStreamResponse()
+{
+    delete d;
+}
+
+/** Returns the number of bytes which have been written to the
+ *  response but not yet consumed by the server.
+ *
+ * Producers which push data can use this to avoid buffering
+ * more data than the client is able to receive.
+ */
+qint64 QDjangoHttpStreamResponse::bufferedBytes() const
+{
+    return d->device ? d->device->buffer.size() : 0;
+}
+
+/** Returns true if finish() has been called.
+ */
+bool QDjangoHttpStreamResponse::isFinished() const
+{
+    return d->finished;
+}
+
+/** Signals that the body is complete.
+ */
+void QDjangoHttpStreamResponse::finish()
+{
+    if (d->finished)
+        return;
+    d->finished = true;
+    if (d->device) {
+        d->device->finished = true;
+        d->device->notifyFinished();
+    }
+}
+
+/** Appends \a data to the body of the response.
+ *
+ * If the body has been replaced using setBody() or setBodyDevice(),
+ * the data is discarded.
+ *
+ * \param data
+ */
+void QDjangoHttpStreamResponse::write(const QByteArray &data)
+{
+    if (d->finished) {
+        qWarning("Cannot write to a finished stream response");
+        return;
+    }
+    if (data.isEmpty() || !d->device)
+        return;
+    d->device->buffer += data;
+    if (!d->device->fetching)
+        d->device->notifyReadyRead();
+}
+
+/** This method is called each time the server is ready to send
+ *  more data and no data is buffered.
+ *
+ * Reimplement it to produce data on demand by calling write(),
+ * and finish() once the body is complete. The default implementation
+ * does nothing.
+ */
+void QDjangoHttpStreamResponse::fetchMore()
+{
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_HTTP_STREAM_RESPONSE_H
+#define QDJANGO_HTTP_STREAM_RESPONSE_H
+
+#include "QDjangoHttpResponse.h"
+
+class QDjangoHttpStreamResponsePrivate;
+
+/** \brief The QDjangoHttpStreamResponse class represents an HTTP response
+ *  whose body is produced incrementally.
+ *
+ * Rather than building the whole body in memory, a streaming response
+ * lets the controller hand over data as it becomes available, for
+ * instance while iterating over a QDjangoQuerySet. The data is sent to
+ * the client using chunked transfer encoding (or FastCGI STDOUT records)
+ * and is only requested as fast as the client consumes it.
+ *
+ * There are two ways of providing data:
+ *
+ * \li push: call write() whenever data is available and finish() once
+ *     the body is complete.
+ * \li pull: reimplement fetchMore(), which is called each time the
+ *     server is ready to send more data, and call write() and finish()
+ *     from there.
+ *
+ * \ingroup Http
+ */
+class QDJANGO_HTTP_EXPORT QDjangoHttpStreamResponse : public QDjangoHttpResponse
+{
+    Q_OBJECT
+
+public:
+    QDjangoHttpStreamResponse();
+    ~QDjangoHttpStreamResponse();
+
+    qint64 bufferedBytes() const;
+    bool isFinished() const;
+
+public slots:
+    void finish();
+    void write(const QByteArray &data);
+
+protected:
+    virtual void fetchMore();
+
+private:
+    Q_DISABLE_COPY(QDjangoHttpStreamResponse)
+    QDjangoHttpStreamResponsePrivate* const d;
+    friend class QDjangoHttpStreamDevice;
+};
+
+#endif
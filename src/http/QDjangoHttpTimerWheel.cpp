@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <QThreadStorage>
+#include <QTimerEvent>
+
+#include "QDjangoHttpTimerWheel_p.h"
+
+// duration of a tick of the wheel in milliseconds
+#define WHEEL_TICK 250
+
+// number of buckets in the wheel
+#define WHEEL_SIZE 256
+
+static QThreadStorage<QDjangoHttpTimerWheel*> timerWheels;
+
+/// \cond
+
+QDjangoHttpTimerClient::QDjangoHttpTimerClient()
+    : m_timeoutRounds(0)
+    , m_timeoutSlot(-1)
+    , m_timeoutWheel(0)
+{
+}
+
+QDjangoHttpTimerClient::~QDjangoHttpTimerClient()
+{
+    stopTimeout();
+}
+
+/** Schedules a call to timeout() in \a msecs milliseconds, replacing
+ *  any pending timeout. A value of 0 cancels the timeout.
+ */
+void QDjangoHttpTimerClient::startTimeout(int msecs)
+{
+    stopTimeout();
+    if (msecs > 0)
+        QDjangoHttpTimerWheel::instance()->schedule(this, msecs);
+}
+
+/** Cancels the pending timeout, if any.
+ */
+void QDjangoHttpTimerClient::stopTimeout()
+{
+    if (m_timeoutWheel)
+        m_timeoutWheel->unschedule(this);
+}
+
+QDjangoHttpTimerWheel::QDjangoHttpTimerWheel()
+    : m_count(0)
+    , m_position(0)
+    , m_buckets(WHEEL_SIZE)
+    , m_timerId(0)
+{
+}
+
+QDjangoHttpTimerWheel::~QDjangoHttpTimerWheel()
+{
+    for (int i = 0; i < m_buckets.size(); ++i) {
+        foreach (QDjangoHttpTimerClient *client, m_buckets[i]) {
+            client->m_timeoutSlot = -1;
+            client->m_timeoutWheel = 0;
+        }
+    }
+}
+
+/** Returns the timer wheel for the current thread.
+ */
+QDjangoHttpTimerWheel *QDjangoHttpTimerWheel::instance()
+{
+    if (!timerWheels.hasLocalData())
+        timerWheels.setLocalData(new QDjangoHttpTimerWheel);
+    return timerWheels.localData();
+}
+
+/** Schedules a call to the \a client's timeout() in \a msecs
+ *  milliseconds, rounded up to the next tick.
+ */
+void QDjangoHttpTimerWheel::schedule(QDjangoHttpTimerClient *client, int msecs)
+{
+    Q_ASSERT(!client->m_timeoutWheel);
+
+    const int ticks = qMax(1, (msecs + WHEEL_TICK - 1) / WHEEL_TICK);
+    client->m_timeoutRounds = (ticks - 1) / WHEEL_SIZE;
+    client->m_timeoutSlot = (m_position + ticks) % WHEEL_SIZE;
+    client->m_timeoutWheel = this;
+    m_buckets[client->m_timeoutSlot].insert(client);
+
+    // the timer only runs while there are timeouts
+    if (!m_count++)
+        m_timerId = startTimer(WHEEL_TICK);
+}
+
+/** Cancels the \a client's pending timeout.
+ */
+void QDjangoHttpTimerWheel::unschedule(QDjangoHttpTimerClient *client)
+{
+    Q_ASSERT(client->m_timeoutWheel == this);
+
+    m_buckets[client->m_timeoutSlot].remove(client);
+    client->m_timeoutSlot = -1;
+    client->m_timeoutWheel = 0;
+
+    if (!--m_count) {
+        killTimer(m_timerId);
+        m_timerId = 0;
+    }
+}
+
+/** Advances the wheel by one tick and fires the timeouts which expire.
+ */
+void QDjangoHttpTimerWheel::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != m_timerId) {
+        QObject::timerEvent(event);
+        return;
+    }
+
+    m_position = (m_position + 1) % WHEEL_SIZE;
+    QList<QDjangoHttpTimerClient*> expired;
+    foreach (QDjangoHttpTimerClient *client, m_buckets[m_position]) {
+        if (client->m_timeoutRounds > 0)
+            client->m_timeoutRounds--;
+        else
+            expired << client;
+    }
+
+    // timeouts are removed first, as handlers may schedule new ones
+    foreach (QDjangoHttpTimerClient *client, expired)
+        unschedule(client);
+    foreach (QDjangoHttpTimerClient *client, expired)
+        client->timeout();
+}
+
+/// \endcond
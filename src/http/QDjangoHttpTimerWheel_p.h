@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_HTTP_TIMER_WHEEL_P_H
+#define QDJANGO_HTTP_TIMER_WHEEL_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QDjango API.
+//
+
+#include <QObject>
+#include <QSet>
+#include <QVector>
+
+#include "QDjangoHttp_p.h"
+
+class QDjangoHttpTimerWheel;
+
+/** \internal
+ *
+ * An object which can be given a timeout on its thread's timer wheel.
+ */
+class QDJANGO_HTTP_AUTOTEST_EXPORT QDjangoHttpTimerClient
+{
+public:
+    QDjangoHttpTimerClient();
+    virtual ~QDjangoHttpTimerClient();
+
+    void startTimeout(int msecs);
+    void stopTimeout();
+
+protected:
+    virtual void timeout() = 0;
+
+private:
+    int m_timeoutRounds;
+    int m_timeoutSlot;
+    QDjangoHttpTimerWheel *m_timeoutWheel;
+    friend class QDjangoHttpTimerWheel;
+};
+
+/** \internal
+ *
+ * A hashed timer wheel, which lets many connections have a timeout
+ * at the cost of a single timer per thread.
+ */
+class QDJANGO_HTTP_AUTOTEST_EXPORT QDjangoHttpTimerWheel : public QObject
+{
+public:
+    ~QDjangoHttpTimerWheel();
+
+    static QDjangoHttpTimerWheel *instance();
+    void schedule(QDjangoHttpTimerClient *client, int msecs);
+    void unschedule(QDjangoHttpTimerClient *client);
+
+protected:
+    void timerEvent(QTimerEvent *event);
+
+private:
+    QDjangoHttpTimerWheel();
+
+    int m_count;
+    int m_position;
+    QVector<QSet<QDjangoHttpTimerClient*> > m_buckets;
+    int m_timerId;
+};
+
+#endif
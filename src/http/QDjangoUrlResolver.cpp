@@ -15,20 +15,37 @@
  * Lesser General Public License for more details.
  */
 
+#include <QAtomicInt>
+#include <QHash>
+#include <QIODevice>
 #include <QMetaMethod>
 #include <QMetaObject>
+#include <QMutex>
 #include <QRegExp>
+#include <QSharedPointer>
 #include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QVarLengthArray>
 
 #include "QDjangoHttpController.h"
+#include "QDjangoHttpMetrics_p.h"
 #include "QDjangoHttpRequest.h"
+#include "QDjangoHttpRequestBody_p.h"
+#include "QDjangoHttpRequest_p.h"
 #include "QDjangoHttpResponse.h"
+#include "QDjangoHttpResponseCache.h"
+#include "QDjangoHttpResponseCache_p.h"
+#include "QDjangoHttpResponse_p.h"
 #include "QDjangoUrlResolver.h"
+#include "QDjangoUrlResolver_p.h"
 
 class QDjangoUrlResolverRoute {
 public:
     QDjangoUrlResolverRoute()
         : receiver(0)
+        , methodIndex(-1)
+        , argumentCount(0)
         , urls(0)
     {
     }
@@ -36,103 +53,598 @@ public:
     QRegExp path;
     QObject *receiver;
     QByteArray member;
+    int methodIndex;
+    QByteArray name;
+    int argumentCount;
     QDjangoUrlResolver *urls;
 };
 
+/** A node of the literal prefix trie.
+ */
+class QDjangoUrlResolverNode
+{
+public:
+    ~QDjangoUrlResolverNode();
+
+    QHash<ushort, QDjangoUrlResolverNode*> children;
+    QList<int> routes;
+};
+
+QDjangoUrlResolverNode::~QDjangoUrlResolverNode()
+{
+    qDeleteAll(children);
+}
+
+/** The compiled form of a resolver's routes.
+ *
+ * Each route is stored in a trie under the literal prefix of its
+ * pattern, so that only the routes whose prefix matches the path
+ * need to have their regular expression evaluated.
+ */
+class QDjangoUrlResolverTable
+{
+public:
+    QDjangoUrlResolverTable(const QList<QDjangoUrlResolverRoute> &routes);
+    QList<int> candidates(const QString &path) const;
+
+    QDjangoUrlResolverNode root;
+    QList<QDjangoUrlResolverRoute> routes;
+
+private:
+    static QString literalPrefix(const QRegExp &rx);
+};
+
+QDjangoUrlResolverTable::QDjangoUrlResolverTable(const QList<QDjangoUrlResolverRoute> &routes)
+    : routes(routes)
+{
+    for (int i = 0; i < routes.size(); ++i) {
+        QDjangoUrlResolverNode *node = &root;
+        const QString prefix = literalPrefix(routes[i].path);
+        for (int j = 0; j < prefix.size(); ++j) {
+            QDjangoUrlResolverNode *&child = node->children[prefix[j].unicode()];
+            if (!child)
+                child = new QDjangoUrlResolverNode;
+            node = child;
+        }
+        node->routes << i;
+    }
+}
+
+/** Returns the indices of the routes which may match \a path,
+ *  in the order in which they were registered.
+ */
+QList<int> QDjangoUrlResolverTable::candidates(const QString &path) const
+{
+    const QDjangoUrlResolverNode *node = &root;
+    QList<int> indices = node->routes;
+    for (int i = 0; i < path.size(); ++i) {
+        node = node->children.value(path[i].unicode());
+        if (!node)
+            break;
+        indices += node->routes;
+    }
+    qSort(indices);
+    return indices;
+}
+
+/** Returns the literal text which any string matched by \a rx
+ *  starts with.
+ *
+ * Routes are always matched from the start of the path, so a leading
+ * caret is skipped. The result is conservative: whenever the pattern
+ * is not fully understood, an empty prefix is returned.
+ */
+QString QDjangoUrlResolverTable::literalPrefix(const QRegExp &rx)
+{
+    if ((rx.patternSyntax() != QRegExp::RegExp && rx.patternSyntax() != QRegExp::RegExp2) ||
+        rx.caseSensitivity() != Qt::CaseSensitive)
+        return QString();
+
+    const QString pattern = rx.pattern();
+    if (pattern.contains(QLatin1Char('|')))
+        return QString();
+
+    const QString special = QLatin1String("$()*+.?[]^{}");
+    QString prefix;
+    int pos = pattern.startsWith(QLatin1Char('^')) ? 1 : 0;
+    while (pos < pattern.size()) {
+        QChar c = pattern[pos];
+        int next = pos + 1;
+        if (c == QLatin1Char('\\')) {
+            // only escaped punctuation stands for itself
+            if (next >= pattern.size() || pattern[next].isLetterOrNumber())
+                break;
+            c = pattern[next++];
+        } else if (special.contains(c)) {
+            break;
+        }
+
+        // a quantifier can make the character optional
+        if (next < pattern.size() && (pattern[next] == QLatin1Char('*') ||
+            pattern[next] == QLatin1Char('?') || pattern[next] == QLatin1Char('{')))
+            break;
+
+        prefix += c;
+        pos = next;
+    }
+    return prefix;
+}
+
+/** Invokes the handler with the given \a methodIndex on the \a receiver,
+ *  passing it the \a request and the texts captured from its path.
+ */
+static QDjangoHttpResponse *invokeHandler(QObject *receiver, int methodIndex, const QDjangoHttpRequest &request, const QStringList &caps)
+{
+    // invoke the method by index, the first slot holds the return value
+    QDjangoHttpResponse *response = 0;
+    QVarLengthArray<void*, 10> argv(caps.size() + 1);
+    argv[0] = &response;
+    argv[1] = const_cast<QDjangoHttpRequest*>(&request);
+    for (int i = 1; i < caps.size(); ++i)
+        argv[i + 1] = const_cast<QString*>(&caps[i]);
+    QMetaObject::metacall(receiver, QMetaObject::InvokeMetaMethod, methodIndex, argv.data());
+    return response;
+}
+
+QDjangoUrlResolverMatch::QDjangoUrlResolverMatch()
+    : resolver(0)
+    , generation(0)
+    , owner(0)
+    , receiver(0)
+    , methodIndex(-1)
+    , argumentCount(0)
+{
+}
+
+QDjangoUrlResolverTaskState::QDjangoUrlResolverTaskState()
+    : response(0)
+    , result(0)
+    , thread(0)
+{
+}
+
+QDjangoUrlResolverTask::QDjangoUrlResolverTask(const QSharedPointer<QDjangoUrlResolverTaskState> &state, QDjangoHttpRequest *request,
+                                               QObject *receiver, int methodIndex, const QStringList &arguments, QAtomicInt *queued)
+    : m_arguments(arguments)
+    , m_methodIndex(methodIndex)
+    , m_queued(queued)
+    , m_receiver(receiver)
+    , m_request(request)
+    , m_state(state)
+{
+}
+
+QDjangoUrlResolverTask::~QDjangoUrlResolverTask()
+{
+    delete m_request;
+}
+
+/** Runs the handler, then hands its response over to the thread
+ *  which waits for it.
+ */
+void QDjangoUrlResolverTask::run()
+{
+    m_queued->deref();
+
+    // the handler is skipped if the client went away in the meantime
+    m_state->mutex.lock();
+    const bool discarded = !m_state->response;
+    m_state->mutex.unlock();
+
+    QDjangoHttpResponse *result = 0;
+    if (!discarded) {
+        result = invokeHandler(m_receiver, m_methodIndex, *m_request, m_arguments);
+        if (!result)
+            result = QDjangoHttpController::serveInternalServerError(*m_request);
+    }
+
+    QMutexLocker locker(&m_state->mutex);
+    if (m_state->response) {
+        result->moveToThread(m_state->thread);
+        m_state->result = result;
+        QMetaObject::invokeMethod(m_state->response, "_q_finished", Qt::QueuedConnection);
+    } else {
+        delete result;
+    }
+}
+
+QDjangoUrlResolverResponse::QDjangoUrlResolverResponse()
+    : m_pending(0)
+    , m_ready(false)
+{
+}
+
+/** Takes over the status, headers and body of the given \a response,
+ *  waiting for it to be ready if needed.
+ */
+void QDjangoUrlResolverResponse::adopt(QDjangoHttpResponse *response)
+{
+    if (!response->isReady()) {
+        bool check;
+        Q_UNUSED(check);
+
+        response->setParent(this);
+        m_pending = response;
+        check = connect(response, SIGNAL(ready()),
+                        this, SLOT(_q_adopt()));
+        Q_ASSERT(check);
+        return;
+    }
+
+    QIODevice *device = response->d->bodyDevice;
+    *d = *response->d;
+    response->d->bodyDevice = 0;
+    if (device) {
+        device->disconnect(response);
+        device->setParent(this);
+        if (device->isSequential())
+            connect(device, SIGNAL(readChannelFinished()), this, SLOT(_q_bodyFinished()));
+    }
+
+    // the response may be emitting a signal, and the body device may still
+    // refer to it, as a stream response's does, so it lives as long as we do
+    response->disconnect(this);
+    if (device)
+        response->setParent(this);
+    else
+        response->deleteLater();
+
+    m_ready = true;
+    emit ready();
+}
+
+bool QDjangoUrlResolverResponse::isReady() const
+{
+    return m_ready;
+}
+
+void QDjangoUrlResolverResponse::_q_adopt()
+{
+    QDjangoHttpResponse *response = m_pending;
+    m_pending = 0;
+    if (response)
+        adopt(response);
+}
+
+QDjangoUrlResolverTaskResponse::QDjangoUrlResolverTaskResponse(const QSharedPointer<QDjangoUrlResolverTaskState> &state)
+    : m_state(state)
+{
+    m_state->response = this;
+    m_state->thread = thread();
+}
+
+QDjangoUrlResolverTaskResponse::~QDjangoUrlResolverTaskResponse()
+{
+    QMutexLocker locker(&m_state->mutex);
+    m_state->response = 0;
+    delete m_state->result;
+    m_state->result = 0;
+}
+
+/** Takes over the handler's response.
+ */
+void QDjangoUrlResolverTaskResponse::_q_finished()
+{
+    m_state->mutex.lock();
+    QDjangoHttpResponse *result = m_state->result;
+    m_state->result = 0;
+    m_state->mutex.unlock();
+    if (result)
+        adopt(result);
+}
+
+// reverse URL templates, indexed by receiver and member
+typedef QHash<QPair<QObject*, QByteArray>, QStringList> QDjangoUrlResolverTemplates;
+
+// incremented whenever a route is added to any resolver
+static QAtomicInt routesGeneration(1);
+
 class QDjangoUrlResolverPrivate
 {
 public:
+    QDjangoUrlResolverPrivate();
+    void addTemplates(const QString &prefix, QDjangoUrlResolverTemplates &templates) const;
+    QDjangoHttpResponse* dispatch(QObject *receiver, int methodIndex, const QDjangoHttpRequest &request,
+                                  const QStringList &caps, bool useCache) const;
+    bool find(const QString &path, QDjangoUrlResolverMatch *match) const;
     QDjangoHttpResponse* respond(const QDjangoHttpRequest &request, const QString &path) const;
     QString reverse(QObject *receiver, const char *member, const QVariantList &args = QVariantList()) const;
+    QSharedPointer<QDjangoUrlResolverTable> table() const;
+
+    static QDjangoHttpRequest *copyRequest(const QDjangoHttpRequest &request);
+    static QString stripAnchors(const QString &pattern);
 
     QList<QDjangoUrlResolverRoute> routes;
+
+    // execution policy for the handlers
+    QDjangoHttpResponseCache *cache;
+    qint64 maximumBodySize;
+    int maximumQueued;
+    mutable QAtomicInt queued;
+    bool streaming;
+    QThreadPool *threadPool;
+
+    // compiled routes, built on first dispatch
+    mutable QMutex mutex;
+    mutable QSharedPointer<QDjangoUrlResolverTable> compiledTable;
+
+    // compiled reverse templates, built on first reverse()
+    mutable QDjangoUrlResolverTemplates reverseTemplates;
+    mutable int reverseGeneration;
 };
 
-QDjangoHttpResponse* QDjangoUrlResolverPrivate::respond(const QDjangoHttpRequest &request, const QString &path) const
+QDjangoUrlResolverPrivate::QDjangoUrlResolverPrivate()
+    : cache(0)
+    , maximumBodySize(-1)
+    , maximumQueued(0)
+    , queued(0)
+    , streaming(false)
+    , threadPool(0)
+    , reverseGeneration(0)
 {
-    QList<QDjangoUrlResolverRoute>::const_iterator it;
-    for (it = routes.constBegin(); it != routes.constEnd(); ++it) {
-        if (it->urls && it->path.indexIn(path) == 0) {
-            // try recursing
-            QString subPath = path.mid(it->path.capturedTexts().first().size());
-            QDjangoHttpResponse *response = it->urls->d->respond(request, subPath);
-            if (response)
-                return response;
-        } else if (it->receiver && it->path.exactMatch(path)) {
-            // collect arguments
-            QStringList caps = it->path.capturedTexts();
-            caps.takeFirst();
-            QList<QGenericArgument> args;
-            args << Q_ARG(QDjangoHttpRequest, request);
-            for (int i = 0; i < caps.size(); ++i) {
-                args << Q_ARG(QString, caps[i]);
-            }
-            while (args.size() < 10) {
-                args << QGenericArgument();
-            }
+}
+
+QDjangoUrlResolverRetryResponse::QDjangoUrlResolverRetryResponse(const QDjangoUrlResolverPrivate *resolver, QDjangoHttpRequest *request,
+                                                                 QObject *receiver, int methodIndex, const QStringList &arguments, const QString &key)
+    : m_arguments(arguments)
+    , m_key(key)
+    , m_methodIndex(methodIndex)
+    , m_receiver(receiver)
+    , m_request(request)
+    , m_resolver(resolver)
+{
+}
+
+QDjangoUrlResolverRetryResponse::~QDjangoUrlResolverRetryResponse()
+{
+    if (m_resolver->cache)
+        m_resolver->cache->d->leave(m_key, this);
+    delete m_request;
+}
+
+/** Runs the handler, as the response which was waited for cannot
+ *  be cached.
+ */
+void QDjangoUrlResolverRetryResponse::_q_bypass()
+{
+    adopt(m_resolver->dispatch(m_receiver, m_methodIndex, *m_request, m_arguments, false));
+}
+
+/** Dispatches the request again, now that the response which was
+ *  waited for is in the cache.
+ */
+void QDjangoUrlResolverRetryResponse::_q_retry()
+{
+    adopt(m_resolver->dispatch(m_receiver, m_methodIndex, *m_request, m_arguments, true));
+}
+
+/** Compiles the reverse templates of this resolver's routes, including
+ *  those of included resolvers, and adds them to \a templates.
+ *
+ * A template is the list of literal parts of a pattern, which surround
+ * its placeholders. Routes registered first take precedence.
+ */
+void QDjangoUrlResolverPrivate::addTemplates(const QString &prefix, QDjangoUrlResolverTemplates &templates) const
+{
+    mutex.lock();
+    const QList<QDjangoUrlResolverRoute> routes = this->routes;
+    mutex.unlock();
+
+    QRegExp placeholder(QLatin1String("\\([^)]+\\)"));
+    foreach (const QDjangoUrlResolverRoute &route, routes) {
+        const QString path = stripAnchors(route.path.pattern());
+        if (route.urls) {
+            route.urls->d->addTemplates(prefix + path, templates);
+        } else {
+            const QPair<QObject*, QByteArray> key = qMakePair(route.receiver, route.member);
+            if (templates.contains(key))
+                continue;
 
-            QDjangoHttpResponse *response = 0;
-            if (!QMetaObject::invokeMethod(it->receiver, it->member.constData(), Qt::DirectConnection,
-                    Q_RETURN_ARG(QDjangoHttpResponse*, response),
-                    args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7], args[8], args[9])
-                || !response) {
-                return QDjangoHttpController::serveInternalServerError(request);
+            QStringList parts;
+            int last = 0;
+            int pos;
+            while ((pos = placeholder.indexIn(path, last)) != -1) {
+                parts << path.mid(last, pos - last);
+                last = pos + placeholder.matchedLength();
             }
+            parts << path.mid(last);
+            parts[0].prepend(prefix);
+            templates.insert(key, parts);
+        }
+    }
+}
+
+/** Returns a copy of the \a request, which outlives the original and
+ *  may be used from another thread.
+ */
+QDjangoHttpRequest *QDjangoUrlResolverPrivate::copyRequest(const QDjangoHttpRequest &request)
+{
+    // decode the form data while the body is at hand
+    request.d->postItems();
+
+    QDjangoHttpRequest *copy = new QDjangoHttpRequest;
+    *copy->d = *request.d;
+
+    // the body device lives in the connection's thread, so the copy
+    // gets a finished body of its own
+    if (copy->d->bodyDevice)
+        copy->d->bodyDevice = QSharedPointer<QDjangoHttpRequestBody>(copy->d->bodyDevice->clone());
+    return copy;
+}
+
+/** Runs the handler with the given \a methodIndex on the \a receiver,
+ *  unless the response to the \a request can be served from the cache.
+ */
+QDjangoHttpResponse* QDjangoUrlResolverPrivate::dispatch(QObject *receiver, int methodIndex, const QDjangoHttpRequest &request,
+                                                         const QStringList &caps, bool useCache) const
+{
+    // look up the cache, only the responses to GET requests are stored
+    QDjangoHttpResponseCachePrivate *store = 0;
+    QString key;
+    const QString method = request.method();
+    if (cache && useCache && !streaming && (method == QLatin1String("GET") || method == QLatin1String("HEAD"))) {
+        key = QDjangoHttpResponseCachePrivate::key(request);
+        QDjangoHttpResponse *response = cache->d->lookup(request, key);
+        if (response)
             return response;
+
+        if (method == QLatin1String("GET")) {
+            // only one request per key runs the handler, the others wait for its response
+            QDjangoUrlResolverRetryResponse *waiter = new QDjangoUrlResolverRetryResponse(this, copyRequest(request), receiver, methodIndex, caps, key);
+            if (cache->d->join(key, waiter))
+                return waiter;
+            delete waiter;
+            store = cache->d;
+        }
+    }
+
+    QDjangoHttpResponse *response = 0;
+    if (threadPool && !streaming) {
+        // run the handler on the thread pool, with its own copy of the request
+        if (maximumQueued > 0 && queued.fetchAndAddOrdered(0) >= maximumQueued) {
+            response = QDjangoHttpController::serveServiceUnavailable(request);
+        } else {
+            QSharedPointer<QDjangoUrlResolverTaskState> state(new QDjangoUrlResolverTaskState);
+            response = new QDjangoUrlResolverTaskResponse(state);
+            queued.ref();
+            threadPool->start(new QDjangoUrlResolverTask(state, copyRequest(request), receiver, methodIndex, caps, &queued));
         }
+    } else {
+        response = invokeHandler(receiver, methodIndex, request, caps);
+        if (!response)
+            response = QDjangoHttpController::serveInternalServerError(request);
+    }
+
+    // store the response once it is ready
+    if (store) {
+        if (response->isReady())
+            store->finish(key, &request, response);
+        else
+            new QDjangoHttpResponseCacheWatcher(store, key, copyRequest(request), response);
     }
-    return 0;
+    return response;
 }
 
-QString QDjangoUrlResolverPrivate::reverse(QObject *receiver, const char *member, const QVariantList &args) const
+/** Removes the leading caret and trailing dollar from a \a pattern.
+ */
+QString QDjangoUrlResolverPrivate::stripAnchors(const QString &pattern)
 {
-    QList<QDjangoUrlResolverRoute>::const_iterator it;
-    for (it = routes.constBegin(); it != routes.constEnd(); ++it) {
-        // recurse
-        if (it->urls) {
-            QString path = it->urls->d->reverse(receiver, member, args);
-            if (!path.isNull()) {
-                QString prefix = it->path.pattern();
-                if (prefix.startsWith(QLatin1Char('^')))
-                    prefix.remove(0, 1);
-                if (prefix.endsWith(QLatin1Char('$')))
-                    prefix.chop(1);
-
-                return prefix + path;
-            }
-        } else if (it->receiver == receiver && it->member == member) {
-            QString path = it->path.pattern();
-            if (path.startsWith(QLatin1Char('^')))
-                path.remove(0, 1);
-            if (path.endsWith(QLatin1Char('$')))
-                path.chop(1);
-
-            // replace parameters
-            QVariantList arguments(args);
-            int pos = 0;
-            QRegExp rx(QLatin1String("\\([^)]+\\)"));
-            while ((pos = rx.indexIn(path, pos)) != -1) {
-                if (arguments.isEmpty()) {
-                    qWarning("Too few arguments for '%s'", member);
-                    return QString();
-                }
-                const QString str = arguments.takeFirst().toString();
-                path.replace(pos, rx.matchedLength(), str);
-                pos += str.size();
-            }
-            if (!arguments.isEmpty()) {
-                qWarning("Too many arguments for '%s'", member);
-                return QString();
-            }
-            if (path.isEmpty())
-                return QLatin1String("");
-            else
-                return path;
+    QString path = pattern;
+    if (path.startsWith(QLatin1Char('^')))
+        path.remove(0, 1);
+    if (path.endsWith(QLatin1Char('$')))
+        path.chop(1);
+    return path;
+}
+
+/** Returns the compiled routes, compiling them if needed.
+ */
+QSharedPointer<QDjangoUrlResolverTable> QDjangoUrlResolverPrivate::table() const
+{
+    QMutexLocker locker(&mutex);
+    if (!compiledTable)
+        compiledTable = QSharedPointer<QDjangoUrlResolverTable>(new QDjangoUrlResolverTable(routes));
+    return compiledTable;
+}
+
+/** Looks up the route which matches \a path among the routes of this
+ *  resolver and of the resolvers it includes, and stores it in \a match.
+ *
+ * Returns false if no route matches.
+ */
+bool QDjangoUrlResolverPrivate::find(const QString &path, QDjangoUrlResolverMatch *match) const
+{
+    const QSharedPointer<QDjangoUrlResolverTable> table = this->table();
+    foreach (int index, table->candidates(path)) {
+        const QDjangoUrlResolverRoute &route = table->routes[index];
+
+        // QRegExp holds the match state, so each lookup uses its own copy
+        QRegExp rx(route.path);
+        if (route.urls && rx.indexIn(path) == 0) {
+            // try recursing
+            if (route.urls->d->find(path.mid(rx.matchedLength()), match))
+                return true;
+        } else if (route.receiver && rx.exactMatch(path)) {
+            match->owner = this;
+            match->receiver = route.receiver;
+            match->methodIndex = route.methodIndex;
+            match->member = route.member;
+            match->name = route.name;
+            match->argumentCount = route.argumentCount;
+            match->arguments = rx.capturedTexts();
+            return true;
         }
     }
+    return false;
+}
+
+QDjangoHttpResponse* QDjangoUrlResolverPrivate::respond(const QDjangoHttpRequest &request, const QString &path) const
+{
+    // reuse the route looked up when the request's header was received,
+    // unless it was looked up for another path or the routes changed
+    QDjangoUrlResolverMatch lookup;
+    const QDjangoUrlResolverMatch *match = request.d->match.data();
+    if (!match || match->resolver != this || match->path != path ||
+        match->generation != routesGeneration.fetchAndAddOrdered(0)) {
+        find(path, &lookup);
+        match = &lookup;
+    }
+    if (!match->owner)
+        return 0;
+
+    // check arguments
+    if (match->arguments.size() != match->argumentCount) {
+        qWarning("Wrong number of arguments for '%s'", match->member.constData());
+        return QDjangoHttpController::serveInternalServerError(request);
+    }
+
+    // record which handler serves the request
+    request.d->route = match->name;
+    request.d->timestamps[QDjangoHttpMetrics::RoutePhase] = QDjangoHttpMetricsPrivate::now();
+
+    return match->owner->dispatch(match->receiver, match->methodIndex, request, match->arguments, true);
+}
+
+QString QDjangoUrlResolverPrivate::reverse(QObject *receiver, const char *member, const QVariantList &args) const
+{
+    // look up the template, compiling the templates if any route changed
+    QStringList parts;
+    const int generation = routesGeneration.fetchAndAddOrdered(0);
+    mutex.lock();
+    if (reverseGeneration != generation) {
+        mutex.unlock();
+        QDjangoUrlResolverTemplates templates;
+        addTemplates(QString(), templates);
+        mutex.lock();
+        reverseTemplates = templates;
+        reverseGeneration = generation;
+    }
+    QDjangoUrlResolverTemplates::const_iterator it = reverseTemplates.constFind(qMakePair(receiver, QByteArray(member)));
+    if (it != reverseTemplates.constEnd())
+        parts = it.value();
+    mutex.unlock();
 
     // not found
-    return QString();
+    if (parts.isEmpty())
+        return QString();
+
+    // replace parameters
+    if (args.size() < parts.size() - 1) {
+        qWarning("Too few arguments for '%s'", member);
+        return QString();
+    } else if (args.size() > parts.size() - 1) {
+        qWarning("Too many arguments for '%s'", member);
+        return QString();
+    }
+    QString path = parts[0];
+    for (int i = 1; i < parts.size(); ++i) {
+        path += args[i - 1].toString();
+        path += parts[i];
+    }
+    if (path.isEmpty())
+        return QLatin1String("");
+    else
+        return path;
 }
 
 /** Constructs a new URL resolver with the given \a parent.
@@ -148,6 +660,141 @@ QDjangoUrlResolver::~QDjangoUrlResolver()
     delete d;
 }
 
+/** Returns the maximum size in bytes of the body of the requests
+ *  handled by this resolver's routes, or -1 if the server's limit
+ *  applies.
+ *
+ * \sa setMaximumBodySize()
+ */
+qint64 QDjangoUrlResolver::maximumBodySize() const
+{
+    return d->maximumBodySize;
+}
+
+/** Sets the maximum size in bytes of the body of the requests handled
+ *  by the routes registered with set(), overriding the server's limit,
+ *  see QDjangoHttpLimits::setMaximumBodySize(). A value of 0 means no
+ *  limit, -1, the default, means the server's limit applies.
+ *
+ * Like the thread pool, the limit applies to this resolver's own routes.
+ * To accept large uploads on a single route, register it with a
+ * separate resolver and include() that resolver.
+ *
+ * \param size
+ */
+void QDjangoUrlResolver::setMaximumBodySize(qint64 size)
+{
+    d->maximumBodySize = size;
+}
+
+/** Returns the maximum number of requests which may wait for a thread
+ *  of the thread pool.
+ *
+ * \sa setMaximumQueued()
+ */
+int QDjangoUrlResolver::maximumQueued() const
+{
+    return d->maximumQueued;
+}
+
+/** Sets the maximum number of requests which may wait for a thread of
+ *  the thread pool. Further requests are answered with a 503 Service
+ *  Unavailable error. A value of 0, the default, means no limit.
+ *
+ * \param count
+ * \sa setThreadPool()
+ */
+void QDjangoUrlResolver::setMaximumQueued(int count)
+{
+    d->maximumQueued = count;
+}
+
+/** Returns the cache which serves the responses of the handlers, or 0
+ *  if the responses are not cached.
+ *
+ * \sa setResponseCache()
+ */
+QDjangoHttpResponseCache *QDjangoUrlResolver::responseCache() const
+{
+    return d->cache;
+}
+
+/** Sets the \a cache which serves the responses of the handlers
+ *  registered with set(). Only the handlers' responses which carry a
+ *  Cache-Control header with a lifetime are stored, see
+ *  QDjangoHttpResponseCache for details.
+ *
+ * Like the thread pool, the cache applies to this resolver's own routes,
+ * and a cache may be shared by several resolvers. The cache must outlive
+ * the resolver.
+ *
+ * \param cache
+ */
+void QDjangoUrlResolver::setResponseCache(QDjangoHttpResponseCache *cache)
+{
+    d->cache = cache;
+}
+
+/** Returns true if the handlers are invoked before the body of the
+ *  request has arrived.
+ *
+ * \sa setStreamingEnabled()
+ */
+bool QDjangoUrlResolver::isStreamingEnabled() const
+{
+    return d->streaming;
+}
+
+/** Sets whether the handlers registered with set() are invoked as soon
+ *  as the request header has been received, so that they can process
+ *  the body as it arrives using QDjangoHttpRequest::bodyDevice().
+ *
+ * The form data and uploaded files are only available once the whole
+ * body has arrived, so a streaming handler usually returns a response
+ * which becomes ready once the body device emits readChannelFinished().
+ * The response is written after the whole body has been received.
+ *
+ * Streaming handlers always run on the thread which dispatches the
+ * request and their responses are not cached.
+ *
+ * \param enabled
+ */
+void QDjangoUrlResolver::setStreamingEnabled(bool enabled)
+{
+    d->streaming = enabled;
+}
+
+/** Returns the thread pool on which the handlers are run, or 0 if they
+ *  are run on the thread which dispatches the request.
+ *
+ * \sa setThreadPool()
+ */
+QThreadPool *QDjangoUrlResolver::threadPool() const
+{
+    return d->threadPool;
+}
+
+/** Sets the thread \a pool on which the handlers registered with set()
+ *  are run, so that slow handlers do not hold up the server's other
+ *  clients. The server writes the response once the handler returns.
+ *
+ * The policy applies to this resolver's own routes, not to those of the
+ * resolvers it includes. To run a single route on the pool, register it
+ * with a separate resolver and include() that resolver.
+ *
+ * The handlers run on the pool with their own copy of the request,
+ * so they must be thread-safe and return a complete response: deferred
+ * and streamed responses are not supported. The receivers must outlive
+ * the handlers, see QThreadPool::waitForDone().
+ *
+ * \param pool
+ * \sa setMaximumQueued()
+ */
+void QDjangoUrlResolver::setThreadPool(QThreadPool *pool)
+{
+    d->threadPool = pool;
+}
+
 /** Adds a URL mapping for the given \a path.
  */
 bool QDjangoUrlResolver::set(const QRegExp &path, QObject *receiver, const char *member)
@@ -167,18 +814,35 @@ bool QDjangoUrlResolver::set(const QRegExp &path, QObject *receiver, const char
 #endif
 
             // check parameter types
-            const QList<QByteArray> ptypes = metaObject->method(i).parameterTypes();
+            const QMetaMethod method = metaObject->method(i);
+            const QList<QByteArray> ptypes = method.parameterTypes();
             if (ptypes.isEmpty() || ptypes[0] != "QDjangoHttpRequest") {
                 qWarning("First argument of '%s' should be a QDjangoHttpRequest", member);
                 return false;
             }
+            for (int j = 1; j < ptypes.size(); ++j) {
+                if (ptypes[j] != "QString") {
+                    qWarning("Arguments of '%s' following the request should be QStrings", member);
+                    return false;
+                }
+            }
+            if (qstrcmp(method.typeName(), "QDjangoHttpResponse*")) {
+                qWarning("'%s' should return a QDjangoHttpResponse*", member);
+                return false;
+            }
 
             // register route
             QDjangoUrlResolverRoute route;
             route.path = path;
             route.receiver = receiver;
             route.member = member;
+            route.methodIndex = i;
+            route.name = QByteArray(metaObject->className()) + "::" + member;
+            route.argumentCount = ptypes.size();
+            QMutexLocker locker(&d->mutex);
             d->routes << route;
+            d->compiledTable.clear();
+            routesGeneration.fetchAndAddOrdered(1);
             return true;
         }
     }
@@ -197,11 +861,19 @@ bool QDjangoUrlResolver::include(const QRegExp &path, QDjangoUrlResolver *urls)
     QDjangoUrlResolverRoute route;
     route.path = path;
     route.urls = urls;
+    QMutexLocker locker(&d->mutex);
     d->routes << route;
+    d->compiledTable.clear();
+    routesGeneration.fetchAndAddOrdered(1);
     return true;
 }
 
 /** Responds to the given HTTP \a request for the given \a path.
+ *
+ * Routes are tried in the order in which they were registered. They are
+ * compiled on first use into a table which only evaluates the patterns
+ * whose literal prefix matches the path, and this method can safely be
+ * called from several threads at once.
  */
 QDjangoHttpResponse* QDjangoUrlResolver::respond(const QDjangoHttpRequest &request, const QString &path) const
 {
@@ -216,8 +888,38 @@ QDjangoHttpResponse* QDjangoUrlResolver::respond(const QDjangoHttpRequest &reque
         return QDjangoHttpController::serveNotFound(request);
 }
 
+/** Looks up the route for the \a request once its header has been
+ *  received, and sets \a maximumSize to the route's maximum body size,
+ *  or -1 if the server's limit applies.
+ *
+ * The route is stored with the request, so that respond() does not
+ * need to look it up again.
+ *
+ * Returns true if the route's handler is invoked before the body has
+ * arrived.
+ */
+bool QDjangoUrlResolver::bodyPolicy(const QDjangoHttpRequest &request, qint64 *maximumSize) const
+{
+    QString fixedPath(request.path());
+    if (fixedPath.startsWith(QLatin1Char('/')))
+        fixedPath.remove(0, 1);
+
+    QDjangoUrlResolverMatch *match = new QDjangoUrlResolverMatch;
+    match->resolver = d;
+    match->path = fixedPath;
+    match->generation = routesGeneration.fetchAndAddOrdered(0);
+    d->find(fixedPath, match);
+    request.d->match = QSharedPointer<QDjangoUrlResolverMatch>(match);
+
+    *maximumSize = match->owner ? match->owner->maximumBodySize : -1;
+    return match->owner && match->owner->streaming;
+}
+
 /** Returns the URL for the member \a member of \a receiver with
  *  \a args as arguments.
+ *
+ * The patterns of all the routes, including those of included resolvers,
+ * are compiled once into templates indexed by receiver and member.
  */
 QString QDjangoUrlResolver::reverse(QObject *receiver, const char *member, const QVariantList &args) const
 {
@@ -25,8 +25,10 @@
 
 class QDjangoHttpRequest;
 class QDjangoHttpResponse;
+class QDjangoHttpResponseCache;
 class QDjangoUrlResolverPrivate;
 class QRegExp;
+class QThreadPool;
 
 /** \brief The QDjangoUrlResolver class maps incoming HTTP requests to handlers.
  *
@@ -44,11 +46,26 @@ public:
     bool set(const QRegExp &path, QObject *receiver, const char *member);
     QString reverse(QObject *receiver, const char *member, const QVariantList &args = QVariantList()) const;
 
+    qint64 maximumBodySize() const;
+    void setMaximumBodySize(qint64 size);
+    int maximumQueued() const;
+    void setMaximumQueued(int count);
+    QDjangoHttpResponseCache *responseCache() const;
+    void setResponseCache(QDjangoHttpResponseCache *cache);
+    bool isStreamingEnabled() const;
+    void setStreamingEnabled(bool enabled);
+    QThreadPool *threadPool() const;
+    void setThreadPool(QThreadPool *pool);
+
 public slots:
     QDjangoHttpResponse* respond(const QDjangoHttpRequest &request, const QString &path) const;
 
 private:
+    bool bodyPolicy(const QDjangoHttpRequest &request, qint64 *maximumSize) const;
+
     QDjangoUrlResolverPrivate *d;
+    friend class QDjangoFastCgiConnection;
+    friend class QDjangoHttpConnection;
     friend class QDjangoUrlResolverPrivate;
 };
 
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_URL_RESOLVER_P_H
+#define QDJANGO_URL_RESOLVER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QDjango API.
+//
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QStringList>
+
+#include "QDjangoHttpResponse.h"
+
+class QDjangoHttpRequest;
+class QDjangoUrlResolverPrivate;
+class QDjangoUrlResolverTaskResponse;
+class QThread;
+
+/** \internal
+ *
+ * The route which matches the path of a request. It is looked up once
+ * the request's header has been received, and reused to dispatch the
+ * request.
+ */
+class QDjangoUrlResolverMatch
+{
+public:
+    QDjangoUrlResolverMatch();
+
+    // the resolver and path for which the route was looked up, and the
+    // generation of the routes at the time
+    const QDjangoUrlResolverPrivate *resolver;
+    QString path;
+    int generation;
+
+    // the resolver which owns the matching route, or 0 if none matches
+    const QDjangoUrlResolverPrivate *owner;
+    QObject *receiver;
+    int methodIndex;
+    QByteArray member;
+    QByteArray name;
+    int argumentCount;
+    QStringList arguments;
+};
+
+/** \internal
+ *
+ * A response which takes over the status, headers and body of another
+ * response once that response is ready.
+ */
+class QDjangoUrlResolverResponse : public QDjangoHttpResponse
+{
+    Q_OBJECT
+
+public:
+    QDjangoUrlResolverResponse();
+
+    void adopt(QDjangoHttpResponse *response);
+    bool isReady() const;
+
+private slots:
+    void _q_adopt();
+
+private:
+    QDjangoHttpResponse *m_pending;
+    bool m_ready;
+};
+
+/** \internal
+ *
+ * The state shared by a handler running on a thread pool and the
+ * response which waits for its result.
+ */
+class QDjangoUrlResolverTaskState
+{
+public:
+    QDjangoUrlResolverTaskState();
+
+    QMutex mutex;
+    QDjangoUrlResolverTaskResponse *response;
+    QDjangoHttpResponse *result;
+    QThread *thread;
+};
+
+/** \internal
+ *
+ * A handler invocation which runs on a thread pool.
+ */
+class QDjangoUrlResolverTask : public QRunnable
+{
+public:
+    QDjangoUrlResolverTask(const QSharedPointer<QDjangoUrlResolverTaskState> &state, QDjangoHttpRequest *request,
+                           QObject *receiver, int methodIndex, const QStringList &arguments, QAtomicInt *queued);
+    ~QDjangoUrlResolverTask();
+
+    void run();
+
+private:
+    QStringList m_arguments;
+    int m_methodIndex;
+    QAtomicInt *m_queued;
+    QObject *m_receiver;
+    QDjangoHttpRequest *m_request;
+    QSharedPointer<QDjangoUrlResolverTaskState> m_state;
+};
+
+/** \internal
+ *
+ * A response which becomes ready once the handler running on a thread
+ * pool has returned, and takes over the handler's response.
+ */
+class QDjangoUrlResolverTaskResponse : public QDjangoUrlResolverResponse
+{
+    Q_OBJECT
+
+public:
+    QDjangoUrlResolverTaskResponse(const QSharedPointer<QDjangoUrlResolverTaskState> &state);
+    ~QDjangoUrlResolverTaskResponse();
+
+private slots:
+    void _q_finished();
+
+private:
+    QSharedPointer<QDjangoUrlResolverTaskState> m_state;
+};
+
+/** \internal
+ *
+ * A response which waits for another request for the same resource to
+ * complete, then dispatches its own request again.
+ */
+class QDjangoUrlResolverRetryResponse : public QDjangoUrlResolverResponse
+{
+    Q_OBJECT
+
+public:
+    QDjangoUrlResolverRetryResponse(const QDjangoUrlResolverPrivate *resolver, QDjangoHttpRequest *request,
+                                    QObject *receiver, int methodIndex, const QStringList &arguments, const QString &key);
+    ~QDjangoUrlResolverRetryResponse();
+
+private slots:
+    void _q_bypass();
+    void _q_retry();
+
+private:
+    QStringList m_arguments;
+    QString m_key;
+    int m_methodIndex;
+    QObject *m_receiver;
+    QDjangoHttpRequest *m_request;
+    const QDjangoUrlResolverPrivate *m_resolver;
+};
+
+#endif
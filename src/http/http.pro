@@ -5,6 +5,9 @@ QT += network
 
 DEFINES += QDJANGO_HTTP_BUILD
 
+# zlib is used to compress responses
+LIBS += -lz
+
 TARGET = qdjango-http
 win32 {
     DESTDIR = $$OUT_PWD
@@ -14,18 +17,40 @@ HEADERS += \
     QDjangoFastCgiServer.h \
     QDjangoFastCgiServer_p.h \
     QDjangoHttp_p.h \
+    QDjangoHttpCompressor_p.h \
     QDjangoHttpController.h \
+    QDjangoHttpController_p.h \
+    QDjangoHttpETag_p.h \
+    QDjangoHttpLimits.h \
+    QDjangoHttpMetrics.h \
+    QDjangoHttpMetrics_p.h \
     QDjangoHttpRequest.h \
+    QDjangoHttpRequestBody_p.h \
     QDjangoHttpResponse.h \
+    QDjangoHttpResponseCache.h \
+    QDjangoHttpResponseCache_p.h \
     QDjangoHttpServer.h \
     QDjangoHttpServer_p.h \
-    QDjangoUrlResolver.h
+    QDjangoHttpStaticCache.h \
+    QDjangoHttpStreamResponse.h \
+    QDjangoHttpTimerWheel_p.h \
+    QDjangoUrlResolver.h \
+    QDjangoUrlResolver_p.h
 SOURCES += \
     QDjangoFastCgiServer.cpp \
+    QDjangoHttpCompressor.cpp \
     QDjangoHttpController.cpp \
+    QDjangoHttpETag.cpp \
+    QDjangoHttpLimits.cpp \
+    QDjangoHttpMetrics.cpp \
     QDjangoHttpRequest.cpp \
+    QDjangoHttpRequestBody.cpp \
     QDjangoHttpResponse.cpp \
+    QDjangoHttpResponseCache.cpp \
     QDjangoHttpServer.cpp \
+    QDjangoHttpStaticCache.cpp \
+    QDjangoHttpStreamResponse.cpp \
+    QDjangoHttpTimerWheel.cpp \
     QDjangoUrlResolver.cpp
 
 # Installation
@@ -1,5 +1,5 @@
 TEMPLATE = subdirs
 
-SUBDIRS = db http
+SUBDIRS = db http template
 
 CONFIG += ordered
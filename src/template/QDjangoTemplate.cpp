@@ -0,0 +1,650 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <QObject>
+
+#include "QDjangoTemplate.h"
+#include "QDjangoTemplateEngine.h"
+#include "QDjangoTemplateEngine_p.h"
+
+// maximum number of nested includes, to stop recursive includes
+static const int MAX_INCLUDE_DEPTH = 16;
+
+/// \cond
+
+class QDjangoTemplateBlock
+{
+public:
+    QDjangoTemplateBlock(const QString &tag, int index, bool autoEscape)
+        : tag(tag)
+        , index(index)
+        , autoEscape(autoEscape)
+    {
+    }
+
+    QString tag;
+    int index;
+    bool autoEscape;
+};
+
+static void appendEscaped(QByteArray &output, const QByteArray &data)
+{
+    const char *ptr = data.constData();
+    const char *end = ptr + data.size();
+    const char *start = ptr;
+    for (; ptr < end; ++ptr) {
+        const char *entity;
+        switch (*ptr) {
+        case '&': entity = "&amp;"; break;
+        case '<': entity = "&lt;"; break;
+        case '>': entity = "&gt;"; break;
+        case '"': entity = "&quot;"; break;
+        case '\'': entity = "&#39;"; break;
+        default: continue;
+        }
+        output.append(start, ptr - start);
+        output.append(entity);
+        start = ptr + 1;
+    }
+    output.append(start, ptr - start);
+}
+
+static bool isIdentifier(const QString &token)
+{
+    if (token.isEmpty())
+        return false;
+    for (int i = 0; i < token.size(); ++i) {
+        const QChar c = token.at(i);
+        if (!c.isLetterOrNumber() && c != QLatin1Char('_'))
+            return false;
+    }
+    return true;
+}
+
+static bool isTrue(const QVariant &value)
+{
+    switch (value.userType()) {
+    case QMetaType::Bool:
+        return value.toBool();
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Double:
+        return value.toDouble() != 0;
+    case QMetaType::QStringList:
+    case QMetaType::QVariantList:
+        return !value.toList().isEmpty();
+    case QMetaType::QVariantMap:
+        return !value.toMap().isEmpty();
+    case QMetaType::QVariantHash:
+        return !value.toHash().isEmpty();
+    case QMetaType::QObjectStar:
+        return qvariant_cast<QObject*>(value) != 0;
+    default:
+        return !value.toString().isEmpty();
+    }
+}
+
+/** Returns the item of \a value whose key or index is \a key.
+ */
+static QVariant lookup(const QVariant &value, const QString &key)
+{
+    switch (value.userType()) {
+    case QMetaType::QVariantMap:
+        return static_cast<const QVariantMap*>(value.constData())->value(key);
+    case QMetaType::QVariantHash:
+        return static_cast<const QVariantHash*>(value.constData())->value(key);
+    case QMetaType::QStringList:
+    case QMetaType::QVariantList: {
+        bool ok;
+        const int index = key.toInt(&ok);
+        const QVariantList list = value.toList();
+        if (ok && index >= 0 && index < list.size())
+            return list.at(index);
+        return QVariant();
+    }
+    case QMetaType::QObjectStar: {
+        const QObject *object = qvariant_cast<QObject*>(value);
+        if (object)
+            return object->property(key.toLatin1());
+        return QVariant();
+    }
+    default:
+        return QVariant();
+    }
+}
+
+/** Splits the arguments of a tag on whitespace, keeping quoted strings
+ *  together.
+ */
+static QStringList splitArguments(const QString &content)
+{
+    QStringList args;
+    QString current;
+    QChar quote;
+    for (int i = 0; i < content.size(); ++i) {
+        const QChar c = content.at(i);
+        if (!quote.isNull()) {
+            current += c;
+            if (c == quote)
+                quote = QChar();
+        } else if (c == QLatin1Char('"') || c == QLatin1Char('\'')) {
+            quote = c;
+            current += c;
+        } else if (c.isSpace()) {
+            if (!current.isEmpty()) {
+                args << current;
+                current.clear();
+            }
+        } else {
+            current += c;
+        }
+    }
+    if (!current.isEmpty())
+        args << current;
+    return args;
+}
+
+/** Parses a string or number literal, or the dotted path of a variable.
+ *
+ * Returns false if the token is not a valid expression.
+ */
+bool QDjangoTemplateExpression::parse(const QString &token)
+{
+    literal = QVariant();
+    path.clear();
+    if (token.isEmpty())
+        return false;
+
+    // string literal
+    const QChar first = token.at(0);
+    if (first == QLatin1Char('"') || first == QLatin1Char('\'')) {
+        if (token.size() < 2 || token.at(token.size() - 1) != first)
+            return false;
+        literal = token.mid(1, token.size() - 2);
+        return true;
+    }
+
+    // number literal
+    if (first.isDigit() || first == QLatin1Char('-')) {
+        bool ok;
+        if (token.contains(QLatin1Char('.')))
+            literal = token.toDouble(&ok);
+        else
+            literal = token.toLongLong(&ok);
+        return ok;
+    }
+
+    // variable
+    path = token.split(QLatin1Char('.'));
+    foreach (const QString &bit, path) {
+        if (!isIdentifier(bit))
+            return false;
+    }
+    return true;
+}
+
+QDjangoTemplateNode::QDjangoTemplateNode(Type type)
+    : type(type)
+    , escape(false)
+    , negate(false)
+    , op(NoOperator)
+    , elseIndex(-1)
+    , endIndex(-1)
+{
+}
+
+/** Returns the value of the \a key attribute of the forloop variable.
+ */
+QVariant QDjangoTemplateLoop::forloop(const QString &key) const
+{
+    if (key == QLatin1String("counter"))
+        return index + 1;
+    else if (key == QLatin1String("counter0"))
+        return index;
+    else if (key == QLatin1String("revcounter"))
+        return length - index;
+    else if (key == QLatin1String("revcounter0"))
+        return length - index - 1;
+    else if (key == QLatin1String("first"))
+        return index == 0;
+    else if (key == QLatin1String("last"))
+        return index == length - 1;
+    return QVariant();
+}
+
+QDjangoTemplateContext::QDjangoTemplateContext(const QVariantMap &variables)
+    : variables(variables)
+    , depth(0)
+{
+}
+
+/** Evaluates the \a expression.
+ *
+ * Loop variables shadow the variables of the context, and the innermost
+ * loop provides the forloop variable.
+ */
+QVariant QDjangoTemplateContext::value(const QDjangoTemplateExpression &expression) const
+{
+    if (expression.path.isEmpty())
+        return expression.literal;
+
+    const QString &name = expression.path.at(0);
+    int start = 1;
+    QVariant value;
+    bool found = false;
+    for (int i = loops.size() - 1; i >= 0; --i) {
+        if (loops.at(i).name == name) {
+            value = loops.at(i).value;
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        if (name == QLatin1String("forloop") && !loops.isEmpty()) {
+            const QDjangoTemplateLoop &loop = loops.last();
+            if (expression.path.size() > 1) {
+                value = loop.forloop(expression.path.at(1));
+                start = 2;
+            } else {
+                static const char *keys[] = {"counter", "counter0", "revcounter", "revcounter0", "first", "last"};
+                QVariantMap map;
+                for (unsigned int i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i)
+                    map.insert(QLatin1String(keys[i]), loop.forloop(QLatin1String(keys[i])));
+                value = map;
+            }
+        } else {
+            value = variables.value(name);
+        }
+    }
+
+    for (int i = start; i < expression.path.size(); ++i)
+        value = lookup(value, expression.path.at(i));
+    return value;
+}
+
+QDjangoTemplatePrivate::QDjangoTemplatePrivate()
+    : valid(false)
+    , sizeHint(0)
+{
+}
+
+/** Compiles the template \a source to a list of nodes.
+ *
+ * Returns false and sets errorString if the source is invalid.
+ */
+bool QDjangoTemplatePrivate::compile(const QString &source)
+{
+    QList<QDjangoTemplateBlock> blocks;
+    bool autoEscape = true;
+    int commentDepth = 0;
+    int staticSize = 0;
+    int line = 1;
+    int linePos = 0;
+    int pos = 0;
+    const int length = source.size();
+
+    nodes.clear();
+    valid = false;
+    while (pos < length) {
+        // find the next tag
+        int start = pos;
+        QChar kind;
+        for (; start < length - 1; ++start) {
+            if (source.at(start) == QLatin1Char('{')) {
+                const QChar next = source.at(start + 1);
+                if (next == QLatin1Char('{') || next == QLatin1Char('%') || next == QLatin1Char('#')) {
+                    kind = next;
+                    break;
+                }
+            }
+        }
+        if (kind.isNull())
+            start = length;
+
+        // store the text before the tag
+        if (start > pos && !commentDepth) {
+            QDjangoTemplateNode node(QDjangoTemplateNode::TextNode);
+            node.text = source.mid(pos, start - pos).toUtf8();
+            staticSize += node.text.size();
+            nodes << node;
+        }
+        if (kind.isNull())
+            break;
+
+        for (; linePos < start; ++linePos) {
+            if (source.at(linePos) == QLatin1Char('\n'))
+                line++;
+        }
+        const QString closing = (kind == QLatin1Char('{')) ? QString(QLatin1String("}}")) : QString(kind) + QLatin1Char('}');
+        const int end = source.indexOf(closing, start + 2);
+        if (end < 0) {
+            errorString = QString::fromLatin1("Unterminated tag at line %1").arg(line);
+            return false;
+        }
+        const QString content = source.mid(start + 2, end - start - 2).trimmed();
+        pos = end + 2;
+
+        if (kind == QLatin1Char('#'))
+            continue;
+
+        // skip the contents of comment blocks
+        if (commentDepth) {
+            if (kind == QLatin1Char('%')) {
+                const QString tag = content.section(QLatin1Char(' '), 0, 0);
+                if (tag == QLatin1String("comment"))
+                    commentDepth++;
+                else if (tag == QLatin1String("endcomment"))
+                    commentDepth--;
+            }
+            continue;
+        }
+
+        if (kind == QLatin1Char('{')) {
+            // variable
+            QStringList bits = content.split(QLatin1Char('|'));
+            QDjangoTemplateNode node(QDjangoTemplateNode::VariableNode);
+            if (!node.expression.parse(bits.takeFirst().trimmed())) {
+                errorString = QString::fromLatin1("Invalid variable '%1' at line %2").arg(content, QString::number(line));
+                return false;
+            }
+            node.escape = autoEscape;
+            foreach (const QString &bit, bits) {
+                const QString filter = bit.trimmed();
+                if (filter == QLatin1String("escape")) {
+                    node.escape = true;
+                } else if (filter == QLatin1String("safe")) {
+                    node.escape = false;
+                } else {
+                    errorString = QString::fromLatin1("Unknown filter '%1' at line %2").arg(filter, QString::number(line));
+                    return false;
+                }
+            }
+            nodes << node;
+            continue;
+        }
+
+        // tag
+        const QStringList args = splitArguments(content);
+        const QString tag = args.value(0);
+        bool ok = true;
+        if (tag == QLatin1String("for")) {
+            QDjangoTemplateNode node(QDjangoTemplateNode::ForNode);
+            ok = args.size() == 4 &&
+                 isIdentifier(args[1]) &&
+                 args[2] == QLatin1String("in") &&
+                 node.expression.parse(args[3]);
+            node.name = args.value(1);
+            if (ok) {
+                blocks << QDjangoTemplateBlock(tag, nodes.size(), autoEscape);
+                nodes << node;
+            }
+        } else if (tag == QLatin1String("if")) {
+            QDjangoTemplateNode node(QDjangoTemplateNode::IfNode);
+            int i = 1;
+            if (args.value(i) == QLatin1String("not")) {
+                node.negate = true;
+                i++;
+            }
+            ok = node.expression.parse(args.value(i++));
+            if (ok && i < args.size()) {
+                const QString op = args[i++];
+                if (op == QLatin1String("=="))
+                    node.op = QDjangoTemplateNode::EqualOperator;
+                else if (op == QLatin1String("!="))
+                    node.op = QDjangoTemplateNode::NotEqualOperator;
+                ok = node.op != QDjangoTemplateNode::NoOperator &&
+                     node.operand.parse(args.value(i++)) &&
+                     i == args.size();
+            }
+            if (ok) {
+                blocks << QDjangoTemplateBlock(tag, nodes.size(), autoEscape);
+                nodes << node;
+            }
+        } else if (tag == QLatin1String("else")) {
+            if (blocks.isEmpty() || blocks.last().tag != QLatin1String("if") ||
+                nodes[blocks.last().index].elseIndex >= 0) {
+                errorString = QString::fromLatin1("Unexpected tag 'else' at line %1").arg(line);
+                return false;
+            }
+            ok = args.size() == 1;
+            nodes[blocks.last().index].elseIndex = nodes.size();
+        } else if (tag == QLatin1String("include")) {
+            QDjangoTemplateNode node(QDjangoTemplateNode::IncludeNode);
+            ok = args.size() == 2 && node.expression.parse(args[1]);
+            if (ok)
+                nodes << node;
+        } else if (tag == QLatin1String("comment")) {
+            commentDepth = 1;
+        } else if (tag == QLatin1String("autoescape")) {
+            ok = args.size() == 2 &&
+                 (args[1] == QLatin1String("on") || args[1] == QLatin1String("off"));
+            if (ok) {
+                blocks << QDjangoTemplateBlock(tag, -1, autoEscape);
+                autoEscape = (args[1] == QLatin1String("on"));
+            }
+        } else if (tag == QLatin1String("endfor") ||
+                   tag == QLatin1String("endif") ||
+                   tag == QLatin1String("endautoescape")) {
+            if (blocks.isEmpty() || QLatin1String("end") + blocks.last().tag != tag) {
+                errorString = QString::fromLatin1("Unexpected tag '%1' at line %2").arg(tag, QString::number(line));
+                return false;
+            }
+            const QDjangoTemplateBlock block = blocks.takeLast();
+            if (block.index >= 0)
+                nodes[block.index].endIndex = nodes.size();
+            autoEscape = block.autoEscape;
+            ok = args.size() == 1;
+        } else {
+            errorString = QString::fromLatin1("Unknown tag '%1' at line %2").arg(tag, QString::number(line));
+            return false;
+        }
+        if (!ok) {
+            errorString = QString::fromLatin1("Invalid tag '%1' at line %2").arg(content, QString::number(line));
+            return false;
+        }
+    }
+
+    if (commentDepth) {
+        errorString = QLatin1String("Unclosed tag 'comment'");
+        return false;
+    }
+    if (!blocks.isEmpty()) {
+        errorString = QString::fromLatin1("Unclosed tag '%1'").arg(blocks.last().tag);
+        return false;
+    }
+
+    sizeHint.fetchAndStoreRelaxed(staticSize);
+    valid = true;
+    return true;
+}
+
+/** Renders the template with the given \a context, appending the result
+ *  to \a output.
+ */
+void QDjangoTemplatePrivate::render(QDjangoTemplateContext &context, QByteArray &output) const
+{
+    renderNodes(0, nodes.size(), context, output);
+}
+
+/** Renders the nodes from \a begin up to, but excluding, \a end.
+ */
+void QDjangoTemplatePrivate::renderNodes(int begin, int end, QDjangoTemplateContext &context, QByteArray &output) const
+{
+    int i = begin;
+    while (i < end) {
+        const QDjangoTemplateNode &node = nodes.at(i);
+        switch (node.type) {
+        case QDjangoTemplateNode::TextNode:
+            output += node.text;
+            i++;
+            break;
+
+        case QDjangoTemplateNode::VariableNode: {
+            const QByteArray data = context.value(node.expression).toString().toUtf8();
+            if (node.escape)
+                appendEscaped(output, data);
+            else
+                output += data;
+            i++;
+            break;
+        }
+
+        case QDjangoTemplateNode::ForNode: {
+            const QVariantList list = context.value(node.expression).toList();
+            if (!list.isEmpty()) {
+                QDjangoTemplateLoop loop;
+                loop.name = node.name;
+                loop.length = list.size();
+                context.loops << loop;
+                for (int j = 0; j < list.size(); ++j) {
+                    QDjangoTemplateLoop &current = context.loops.last();
+                    current.index = j;
+                    current.value = list.at(j);
+                    renderNodes(i + 1, node.endIndex, context, output);
+                }
+                context.loops.removeLast();
+            }
+            i = node.endIndex;
+            break;
+        }
+
+        case QDjangoTemplateNode::IfNode: {
+            bool condition;
+            const QVariant value = context.value(node.expression);
+            if (node.op == QDjangoTemplateNode::NoOperator) {
+                condition = isTrue(value);
+            } else {
+                const bool equal = value.toString() == context.value(node.operand).toString();
+                condition = (node.op == QDjangoTemplateNode::EqualOperator) ? equal : !equal;
+            }
+            if (node.negate)
+                condition = !condition;
+
+            if (condition)
+                renderNodes(i + 1, node.elseIndex >= 0 ? node.elseIndex : node.endIndex, context, output);
+            else if (node.elseIndex >= 0)
+                renderNodes(node.elseIndex, node.endIndex, context, output);
+            i = node.endIndex;
+            break;
+        }
+
+        case QDjangoTemplateNode::IncludeNode: {
+            const QString name = context.value(node.expression).toString();
+            QDjangoTemplateEngine *templateEngine = engine.data();
+            if (!templateEngine) {
+                qWarning("Could not include template '%s' without a template engine", qPrintable(name));
+            } else if (context.depth >= MAX_INCLUDE_DEPTH) {
+                qWarning("Could not include template '%s', too many nested includes", qPrintable(name));
+            } else {
+                const QDjangoTemplate included = templateEngine->loadTemplate(name);
+                if (included.isValid()) {
+                    context.depth++;
+                    included.d->render(context, output);
+                    context.depth--;
+                }
+            }
+            i++;
+            break;
+        }
+        }
+    }
+}
+
+/// \endcond
+
+/** Constructs an invalid template.
+ */
+QDjangoTemplate::QDjangoTemplate()
+    : d(new QDjangoTemplatePrivate)
+{
+}
+
+/** Constructs a template by compiling the given \a source.
+ *
+ * If the source is invalid, isValid() returns false and errorString()
+ * describes the error.
+ *
+ * \param source
+ */
+QDjangoTemplate::QDjangoTemplate(const QString &source)
+    : d(new QDjangoTemplatePrivate)
+{
+    d->compile(source);
+}
+
+/** Constructs a copy of \a other.
+ *
+ * \param other
+ */
+QDjangoTemplate::QDjangoTemplate(const QDjangoTemplate &other)
+    : d(other.d)
+{
+}
+
+/** Destroys the template.
+ */
+QDjangoTemplate::~QDjangoTemplate()
+{
+}
+
+/** Assigns \a other to this template.
+ *
+ * \param other
+ */
+QDjangoTemplate &QDjangoTemplate::operator=(const QDjangoTemplate &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/** Returns a description of the error which occured when compiling the
+ *  template.
+ */
+QString QDjangoTemplate::errorString() const
+{
+    return d->errorString;
+}
+
+/** Returns true if the template was successfully compiled.
+ */
+bool QDjangoTemplate::isValid() const
+{
+    return d->valid;
+}
+
+/** Renders the template with the given \a context and returns the UTF-8
+ *  encoded result.
+ *
+ * The output buffer is sized using the size of the previous rendering of
+ * the template, so that it is only allocated once in the common case.
+ *
+ * \param context
+ */
+QByteArray QDjangoTemplate::render(const QVariantMap &context) const
+{
+    QByteArray output;
+    if (!d->valid)
+        return output;
+
+    output.reserve(d->sizeHint.fetchAndAddRelaxed(0));
+    QDjangoTemplateContext templateContext(context);
+    d->render(templateContext, output);
+    d->sizeHint.fetchAndStoreRelaxed(output.size());
+    return output;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_TEMPLATE_H
+#define QDJANGO_TEMPLATE_H
+
+#include <QByteArray>
+#include <QExplicitlySharedDataPointer>
+#include <QString>
+#include <QVariantMap>
+
+#include "QDjangoTemplate_p.h"
+
+class QDjangoTemplateEngine;
+class QDjangoTemplatePrivate;
+
+/** \brief The QDjangoTemplate class represents a compiled template.
+ *
+ * The template's source is parsed once, when the QDjangoTemplate is
+ * constructed, and can then be rendered any number of times with
+ * different contexts. QDjangoTemplate objects are implicitly shared
+ * and can be rendered from several threads at once.
+ *
+ * The supported syntax is a subset of django's template language:
+ *
+ * \li <tt>{{ variable }}</tt> outputs a variable from the context. Dots
+ * look up keys in maps and indices in lists, for instance
+ * <tt>{{ user.email }}</tt>. The <tt>escape</tt> and <tt>safe</tt>
+ * filters turn HTML escaping on or off for a single variable.
+ * \li <tt>{% for item in list %} ... {% endfor %}</tt> repeats a block for
+ * each item in a list. Inside the block, <tt>forloop.counter</tt>,
+ * <tt>forloop.counter0</tt>, <tt>forloop.revcounter</tt>,
+ * <tt>forloop.revcounter0</tt>, <tt>forloop.first</tt> and
+ * <tt>forloop.last</tt> describe the current iteration.
+ * \li <tt>{% if value %} ... {% else %} ... {% endif %}</tt> renders a block
+ * if a value is true. The condition can be negated using <tt>not</tt>
+ * and can compare two values using <tt>==</tt> or <tt>!=</tt>, for
+ * instance <tt>{% if forloop.counter == "1" %}</tt>.
+ * \li <tt>{% include "name.html" %}</tt> renders another template with the
+ * same context. Includes are resolved by the QDjangoTemplateEngine which
+ * loaded the template.
+ * \li <tt>{% autoescape off %} ... {% endautoescape %}</tt> turns HTML
+ * escaping on or off for a block.
+ * \li <tt>{# ... #}</tt> and <tt>{% comment %} ... {% endcomment %}</tt>
+ * are comments.
+ *
+ * Variables are HTML escaped unless escaping is turned off.
+ *
+ * \ingroup Template
+ */
+class QDJANGO_TEMPLATE_EXPORT QDjangoTemplate
+{
+public:
+    QDjangoTemplate();
+    QDjangoTemplate(const QString &source);
+    QDjangoTemplate(const QDjangoTemplate &other);
+    ~QDjangoTemplate();
+
+    QDjangoTemplate &operator=(const QDjangoTemplate &other);
+
+    QString errorString() const;
+    bool isValid() const;
+    QByteArray render(const QVariantMap &context) const;
+
+private:
+    QExplicitlySharedDataPointer<QDjangoTemplatePrivate> d;
+    friend class QDjangoTemplateEngine;
+    friend class QDjangoTemplatePrivate;
+};
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRegExp>
+
+#include "QDjangoTemplateEngine.h"
+#include "QDjangoTemplateEngine_p.h"
+
+/// \cond
+
+/** Returns the path of the file for the template called \a name, or an
+ *  empty string if it could not be found.
+ *
+ * Names may come from a template's context, so they are only ever looked
+ * up inside the search paths: absolute names and names containing ".."
+ * segments are rejected.
+ */
+QString QDjangoTemplateEnginePrivate::findTemplate(const QString &name) const
+{
+    if (name.isEmpty() || QDir::isAbsolutePath(name) || name.split(QRegExp(QLatin1String("[/\\\\]"))).contains(QLatin1String("..")))
+        return QString();
+
+    foreach (const QString &searchPath, searchPaths) {
+        const QString path = searchPath + QLatin1Char('/') + name;
+        if (QFileInfo(path).isFile())
+            return path;
+    }
+    return QString();
+}
+
+/// \endcond
+
+/** Constructs a new template engine.
+ *
+ * \param parent
+ */
+QDjangoTemplateEngine::QDjangoTemplateEngine(QObject *parent)
+    : QObject(parent)
+    , d(new QDjangoTemplateEnginePrivate)
+{
+}
+
+/** Destroys the template engine.
+ */
+QDjangoTemplateEngine::~QDjangoTemplateEngine()
+{
+    delete d;
+}
+
+/** Returns the list of directories in which templates are looked up.
+ *
+ * Template names are always relative to one of these directories, so if
+ * the list is empty no template can be found.
+ */
+QStringList QDjangoTemplateEngine::searchPaths() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->searchPaths;
+}
+
+/** Sets the list of directories in which templates are looked up.
+ *
+ * This clears the cache of compiled templates.
+ *
+ * \param paths
+ */
+void QDjangoTemplateEngine::setSearchPaths(const QStringList &paths)
+{
+    QMutexLocker locker(&d->mutex);
+    d->searchPaths = paths;
+    d->cache.clear();
+}
+
+/** Removes all the compiled templates from the cache.
+ */
+void QDjangoTemplateEngine::clearCache()
+{
+    QMutexLocker locker(&d->mutex);
+    d->cache.clear();
+}
+
+/** Returns the compiled template called \a name.
+ *
+ * The template is read and compiled the first time it is requested, or
+ * if its file was modified since it was last compiled. If the template
+ * cannot be found or compiled, a warning is emitted and an invalid
+ * template is returned.
+ *
+ * \param name
+ */
+QDjangoTemplate QDjangoTemplateEngine::loadTemplate(const QString &name)
+{
+    QMutexLocker locker(&d->mutex);
+
+    // check whether the cached template is still up to date
+    QHash<QString, QDjangoTemplateCacheEntry>::const_iterator it = d->cache.constFind(name);
+    if (it != d->cache.constEnd()) {
+        const QFileInfo info(it->path);
+        if (info.exists() && info.lastModified() == it->modified)
+            return it->compiled;
+    }
+
+    QDjangoTemplateCacheEntry entry;
+    entry.path = d->findTemplate(name);
+    if (entry.path.isEmpty()) {
+        qWarning("Could not find template '%s'", qPrintable(name));
+        d->cache.remove(name);
+        return QDjangoTemplate();
+    }
+
+    QFile file(entry.path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning("Could not open template '%s'", qPrintable(entry.path));
+        d->cache.remove(name);
+        return QDjangoTemplate();
+    }
+    entry.modified = QFileInfo(file).lastModified();
+    entry.compiled = QDjangoTemplate(QString::fromUtf8(file.readAll()));
+    if (!entry.compiled.isValid())
+        qWarning("Could not compile template '%s': %s", qPrintable(entry.path), qPrintable(entry.compiled.errorString()));
+    entry.compiled.d->engine = this;
+
+    // invalid templates are cached too, so that the warning is only
+    // emitted once
+    d->cache.insert(name, entry);
+    return entry.compiled;
+}
+
+/** Renders the template called \a name with the given \a context and
+ *  returns the UTF-8 encoded result.
+ *
+ * \param name
+ * \param context
+ */
+QByteArray QDjangoTemplateEngine::render(const QString &name, const QVariantMap &context)
+{
+    return loadTemplate(name).render(context);
+}
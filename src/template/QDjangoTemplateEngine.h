@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_TEMPLATE_ENGINE_H
+#define QDJANGO_TEMPLATE_ENGINE_H
+
+#include <QObject>
+#include <QStringList>
+#include <QVariantMap>
+
+#include "QDjangoTemplate.h"
+
+class QDjangoTemplateEnginePrivate;
+
+/** \brief The QDjangoTemplateEngine class loads, compiles and caches
+ *  templates.
+ *
+ * Templates are looked up by name in the engine's searchPaths(), which
+ * may be directories or Qt resource prefixes:
+ *
+ * \code
+ * QDjangoTemplateEngine engine;
+ * engine.setSearchPaths(QStringList() << ":/templates");
+ *
+ * QVariantMap context;
+ * context.insert("title", "Administration");
+ * response->setBody(engine.render("index.html", context));
+ * \endcode
+ *
+ * A template is only compiled the first time it is loaded, later calls
+ * to loadTemplate() return the cached QDjangoTemplate for as long as the
+ * modification time of its file does not change.
+ *
+ * The engine's methods can be called from several threads at once.
+ *
+ * \ingroup Template
+ */
+class QDJANGO_TEMPLATE_EXPORT QDjangoTemplateEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    QDjangoTemplateEngine(QObject *parent = 0);
+    ~QDjangoTemplateEngine();
+
+    QStringList searchPaths() const;
+    void setSearchPaths(const QStringList &paths);
+
+    QDjangoTemplate loadTemplate(const QString &name);
+    QByteArray render(const QString &name, const QVariantMap &context);
+
+    void clearCache();
+
+private:
+    Q_DISABLE_COPY(QDjangoTemplateEngine)
+    QDjangoTemplateEnginePrivate* const d;
+};
+
+#endif
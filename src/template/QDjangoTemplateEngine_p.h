@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef QDJANGO_TEMPLATE_ENGINE_P_H
+#define QDJANGO_TEMPLATE_ENGINE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QDjango API.
+//
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPointer>
+#include <QSharedData>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+#include "QDjangoTemplate.h"
+
+class QDjangoTemplateEngine;
+
+/** \internal
+ *
+ * A value in a template, either a literal or the dotted path of a
+ * variable in the context.
+ */
+class QDjangoTemplateExpression
+{
+public:
+    bool parse(const QString &token);
+
+    QVariant literal;
+    QStringList path;
+};
+
+/** \internal
+ *
+ * A compiled template is a flat list of nodes. Blocks store the index
+ * of the node which follows them, so rendering only walks index ranges.
+ */
+class QDjangoTemplateNode
+{
+public:
+    enum Type {
+        TextNode,
+        VariableNode,
+        ForNode,
+        IfNode,
+        IncludeNode
+    };
+
+    enum Operator {
+        NoOperator,
+        EqualOperator,
+        NotEqualOperator
+    };
+
+    QDjangoTemplateNode(Type type = TextNode);
+
+    Type type;
+
+    // TextNode: the UTF-8 encoded text
+    QByteArray text;
+
+    // VariableNode: the value, ForNode: the list, IfNode: the left operand,
+    // IncludeNode: the template name
+    QDjangoTemplateExpression expression;
+
+    // VariableNode: whether the value is HTML escaped
+    bool escape;
+
+    // ForNode: the name of the loop variable
+    QString name;
+
+    // IfNode: the condition
+    bool negate;
+    Operator op;
+    QDjangoTemplateExpression operand;
+
+    // IfNode: the index of the first node of the else branch, or -1
+    int elseIndex;
+
+    // ForNode, IfNode: the index of the node following the block
+    int endIndex;
+};
+
+/** \internal
+ *
+ * The state of a for loop being rendered.
+ */
+class QDjangoTemplateLoop
+{
+public:
+    QVariant forloop(const QString &key) const;
+
+    QString name;
+    QVariant value;
+    int index;
+    int length;
+};
+
+/** \internal
+ *
+ * The context of a template being rendered.
+ */
+class QDjangoTemplateContext
+{
+public:
+    QDjangoTemplateContext(const QVariantMap &variables);
+
+    QVariant value(const QDjangoTemplateExpression &expression) const;
+
+    const QVariantMap &variables;
+    QList<QDjangoTemplateLoop> loops;
+    int depth;
+};
+
+/** \internal
+ */
+class QDjangoTemplatePrivate : public QSharedData
+{
+public:
+    QDjangoTemplatePrivate();
+
+    bool compile(const QString &source);
+    void render(QDjangoTemplateContext &context, QByteArray &output) const;
+    void renderNodes(int begin, int end, QDjangoTemplateContext &context, QByteArray &output) const;
+
+    QPointer<QDjangoTemplateEngine> engine;
+    QString errorString;
+    QVector<QDjangoTemplateNode> nodes;
+    bool valid;
+
+    // the size of the last rendered output, used to size the buffer
+    mutable QAtomicInt sizeHint;
+};
+
+/** \internal
+ */
+class QDjangoTemplateCacheEntry
+{
+public:
+    QDjangoTemplate compiled;
+    QDateTime modified;
+    QString path;
+};
+
+/** \internal
+ */
+class QDjangoTemplateEnginePrivate
+{
+public:
+    QString findTemplate(const QString &name) const;
+
+    QHash<QString, QDjangoTemplateCacheEntry> cache;
+    QMutex mutex;
+    QStringList searchPaths;
+};
+
+#endif
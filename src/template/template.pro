@@ -0,0 +1,24 @@
+include(../../qdjango.pri)
+
+QT -= gui
+
+DEFINES += QDJANGO_TEMPLATE_BUILD
+
+TARGET = qdjango-template
+win32 {
+    DESTDIR = $$OUT_PWD
+}
+
+HEADERS += \
+    QDjangoTemplate.h \
+    QDjangoTemplate_p.h \
+    QDjangoTemplateEngine.h \
+    QDjangoTemplateEngine_p.h
+SOURCES += \
+    QDjangoTemplate.cpp \
+    QDjangoTemplateEngine.cpp
+
+# Installation
+include(../src.pri)
+headers.path = $$PREFIX/include/qdjango/template
+QMAKE_PKGCONFIG_INCDIR = $$headers.path
@@ -2,6 +2,7 @@ TEMPLATE = subdirs
 SUBDIRS = \
     qdjango \
     qdjangocompiler \
+    qdjangojsonserializer \
     qdjangometamodel \
     qdjangomodel \
     qdjangoqueryset \
@@ -0,0 +1,5 @@
+include(../db.pri)
+
+TARGET = tst_qdjangojsonserializer
+HEADERS += ../auth-models.h
+SOURCES += ../auth-models.cpp tst_qdjangojsonserializer.cpp
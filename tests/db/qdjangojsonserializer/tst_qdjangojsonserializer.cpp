@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include "QDjangoJsonSerializer.h"
+#include "QDjangoMetaModel.h"
+#include "QDjangoQuerySet.h"
+#include "QDjangoWhere.h"
+
+#include "auth-models.h"
+#include "util.h"
+
+/** Test QDjangoJsonSerializer class.
+ */
+class tst_QDjangoJsonSerializer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void testEmpty();
+    void testError();
+    void testEscape();
+    void testFields();
+    void testModelFields();
+    void testRelated();
+    void testStreaming();
+    void testUnknownField();
+    void cleanup();
+    void cleanupTestCase();
+
+private:
+    void createUser(const QString &username, bool active, const QDateTime &lastLogin);
+};
+
+void tst_QDjangoJsonSerializer::initTestCase()
+{
+    QVERIFY(initialiseDatabase());
+    QDjango::registerModel<User>();
+    QDjango::registerModel<Group>();
+    QDjango::registerModel<Message>();
+    QDjango::registerModel<UserGroups>();
+    QVERIFY(QDjango::createTables());
+}
+
+void tst_QDjangoJsonSerializer::createUser(const QString &username, bool active, const QDateTime &lastLogin)
+{
+    User user;
+    user.setUsername(username);
+    user.setPassword(username + QLatin1String("pass"));
+    user.setIsActive(active);
+    user.setLastLogin(lastLogin);
+    QCOMPARE(user.save(), true);
+}
+
+void tst_QDjangoJsonSerializer::testEmpty()
+{
+    const QDjangoQuerySet<User> users;
+
+    QDjangoJsonSerializer empty(users, QStringList() << "username");
+    QCOMPARE(empty.readAll(), QByteArray("[]"));
+    QVERIFY(empty.atEnd());
+
+    createUser("foouser", true, QDateTime(QDate(2010, 6, 1), QTime(10, 5, 14)));
+    QDjangoJsonSerializer none(users.none(), QStringList() << "username");
+    QCOMPARE(none.readAll(), QByteArray("[]"));
+    QVERIFY(none.atEnd());
+}
+
+void tst_QDjangoJsonSerializer::testError()
+{
+    const QDjangoMetaModel metaModel = QDjango::metaModel("Message");
+    QCOMPARE(metaModel.dropTable(), true);
+
+    // the array is left unterminated
+    QDjangoJsonSerializer serializer(QDjangoQuerySet<Message>(), QStringList() << "message");
+    QSignalSpy finishedSpy(&serializer, SIGNAL(readChannelFinished()));
+    QCOMPARE(serializer.readAll(), QByteArray("["));
+    QVERIFY(serializer.atEnd());
+    QVERIFY(!serializer.errorString().isEmpty());
+    QCOMPARE(finishedSpy.size(), 1);
+
+    QCOMPARE(metaModel.createTable(), true);
+}
+
+void tst_QDjangoJsonSerializer::testEscape()
+{
+    createUser(QString::fromUtf8("a\"b\\c\nd\x01 \xc3\xa9t\xc3\xa9"), true, QDateTime(QDate(2010, 6, 1), QTime(10, 5, 14)));
+
+    QDjangoJsonSerializer serializer(QDjangoQuerySet<User>(), QStringList() << "username");
+    QCOMPARE(serializer.readAll(), QByteArray("[{\"username\":\"a\\\"b\\\\c\\nd\\u0001 \xc3\xa9t\xc3\xa9\"}]"));
+}
+
+void tst_QDjangoJsonSerializer::testFields()
+{
+    createUser("foouser", true, QDateTime(QDate(2010, 6, 1), QTime(10, 5, 14)));
+    createUser("baruser", false, QDateTime(QDate(2010, 6, 1), QTime(10, 6, 31)));
+
+    const QDjangoQuerySet<User> users = QDjangoQuerySet<User>().orderBy(QStringList() << "username");
+    QDjangoJsonSerializer serializer(users, QStringList() << "username" << "is_active" << "last_login");
+    QCOMPARE(serializer.readAll(), QByteArray(
+        "[{\"username\":\"baruser\",\"is_active\":false,\"last_login\":\"2010-06-01T10:06:31\"},"
+        "{\"username\":\"foouser\",\"is_active\":true,\"last_login\":\"2010-06-01T10:05:14\"}]"));
+
+    // filters and limits apply
+    QDjangoJsonSerializer filtered(users.filter(QDjangoWhere("is_active", QDjangoWhere::Equals, true)), QStringList() << "username");
+    QCOMPARE(filtered.readAll(), QByteArray("[{\"username\":\"foouser\"}]"));
+
+    QDjangoJsonSerializer limited(users.limit(1, 1), QStringList() << "username");
+    QCOMPARE(limited.readAll(), QByteArray("[{\"username\":\"foouser\"}]"));
+}
+
+void tst_QDjangoJsonSerializer::testModelFields()
+{
+    Group group;
+    group.setName("admins");
+    QCOMPARE(group.save(), true);
+
+    // all local fields are written when no fields are given
+    QDjangoJsonSerializer serializer(QDjangoQuerySet<Group>(), QStringList());
+    QCOMPARE(serializer.readAll(), QByteArray("[{\"id\":") + QByteArray::number(group.pk().toInt()) + QByteArray(",\"name\":\"admins\"}]"));
+}
+
+void tst_QDjangoJsonSerializer::testRelated()
+{
+    createUser("foouser", true, QDateTime(QDate(2010, 6, 1), QTime(10, 5, 14)));
+    User *user = QDjangoQuerySet<User>().get(QDjangoWhere("username", QDjangoWhere::Equals, "foouser"));
+    QVERIFY(user != 0);
+
+    Message message;
+    message.setUser(user);
+    message.setMessage("hello");
+    QCOMPARE(message.save(), true);
+    delete user;
+
+    const QDjangoQuerySet<Message> messages;
+
+    // fields of the related model are nested
+    QDjangoJsonSerializer nested(messages, QStringList() << "message" << "user__username" << "user__is_active");
+    QCOMPARE(nested.readAll(), QByteArray("[{\"message\":\"hello\",\"user\":{\"username\":\"foouser\",\"is_active\":true}}]"));
+
+    // fields are grouped by model
+    QDjangoJsonSerializer grouped(messages, QStringList() << "user__username" << "message" << "user__is_active");
+    QCOMPARE(grouped.readAll(), QByteArray("[{\"user\":{\"username\":\"foouser\",\"is_active\":true},\"message\":\"hello\"}]"));
+
+    // a foreign key selects all the fields of the related model
+    QDjangoJsonSerializer expanded(messages, QStringList() << "message" << "user");
+    const QByteArray data = expanded.readAll();
+    QVERIFY(data.startsWith("[{\"message\":\"hello\",\"user\":{\"id\":"));
+    QVERIFY(data.contains(",\"username\":\"foouser\","));
+    QVERIFY(data.contains(",\"password\":\"foouserpass\","));
+    QVERIFY(data.endsWith("\"last_login\":\"2010-06-01T10:05:14\"}}]"));
+}
+
+void tst_QDjangoJsonSerializer::testStreaming()
+{
+    for (int i = 0; i < 200; ++i)
+        createUser(QString("user%1").arg(i, 3, 10, QLatin1Char('0')), true, QDateTime(QDate(2010, 6, 1), QTime(10, 5, 14)));
+
+    const QDjangoQuerySet<User> users = QDjangoQuerySet<User>().orderBy(QStringList() << "username");
+    QByteArray expected("[");
+    for (int i = 0; i < 200; ++i) {
+        if (i)
+            expected += ',';
+        expected += "{\"username\":\"user" + QString("%1").arg(i, 3, 10, QLatin1Char('0')).toLatin1() + "\"}";
+    }
+    expected += ']';
+
+    // rows are fetched as the data is read
+    QDjangoJsonSerializer serializer(users, QStringList() << "username");
+    QSignalSpy finishedSpy(&serializer, SIGNAL(readChannelFinished()));
+    QVERIFY(serializer.isSequential());
+    QCOMPARE(serializer.bytesAvailable(), qint64(0));
+
+    QByteArray data = serializer.read(16);
+    QCOMPARE(data, QByteArray("[{\"username\":\"us"));
+    QVERIFY(serializer.bytesAvailable() < 64);
+    QCOMPARE(finishedSpy.size(), 0);
+    while (!serializer.atEnd()) {
+        const QByteArray chunk = serializer.read(100);
+        QVERIFY(chunk.size() > 0);
+        data += chunk;
+    }
+    QCOMPARE(data, expected);
+    QCOMPARE(finishedSpy.size(), 1);
+    QCOMPARE(serializer.read(100), QByteArray());
+}
+
+void tst_QDjangoJsonSerializer::testUnknownField()
+{
+    createUser("foouser", true, QDateTime(QDate(2010, 6, 1), QTime(10, 5, 14)));
+
+    QTest::ignoreMessage(QtWarningMsg, "Unknown field 'missing' for model 'User'");
+    QDjangoJsonSerializer serializer(QDjangoQuerySet<User>(), QStringList() << "username" << "missing");
+    QCOMPARE(serializer.readAll(), QByteArray("[{\"username\":\"foouser\"}]"));
+}
+
+void tst_QDjangoJsonSerializer::cleanup()
+{
+    QCOMPARE(QDjangoQuerySet<UserGroups>().remove(), true);
+    QCOMPARE(QDjangoQuerySet<Message>().remove(), true);
+    QCOMPARE(QDjangoQuerySet<Group>().remove(), true);
+    QCOMPARE(QDjangoQuerySet<User>().remove(), true);
+}
+
+void tst_QDjangoJsonSerializer::cleanupTestCase()
+{
+    QVERIFY(QDjango::dropTables());
+}
+
+QTEST_MAIN(tst_QDjangoJsonSerializer)
+#include "tst_qdjangojsonserializer.moc"
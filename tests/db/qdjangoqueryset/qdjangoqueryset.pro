@@ -1,4 +1,5 @@
 include(../db.pri)
 
 TARGET = tst_qdjangoqueryset
-SOURCES += tst_qdjangoqueryset.cpp
+HEADERS += ../auth-models.h
+SOURCES += ../auth-models.cpp tst_qdjangoqueryset.cpp
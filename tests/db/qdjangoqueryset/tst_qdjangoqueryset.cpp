@@ -58,10 +58,13 @@ private slots:
     void insertQuery();
     void selectQuery();
     void updateQuery();
+    void valuesList();
     void cleanupTestCase();
 
 private:
     QDjangoMetaModel metaModel;
+    QDjangoMetaModel messageModel;
+    QDjangoMetaModel userModel;
 };
 
 void tst_QDjangoQuerySetPrivate::initTestCase()
@@ -70,6 +73,10 @@ void tst_QDjangoQuerySetPrivate::initTestCase()
 
     metaModel = QDjango::registerModel<Object>();
     QCOMPARE(metaModel.createTable(), true);
+    userModel = QDjango::registerModel<User>();
+    QCOMPARE(userModel.createTable(), true);
+    messageModel = QDjango::registerModel<Message>();
+    QCOMPARE(messageModel.createTable(), true);
 }
 
 void tst_QDjangoQuerySetPrivate::countQuery()
@@ -185,8 +192,50 @@ void tst_QDjangoQuerySetPrivate::updateQuery()
     }
 }
 
+void tst_QDjangoQuerySetPrivate::valuesList()
+{
+    User user;
+    user.setUsername("foouser");
+    user.setPassword("foopass");
+    QCOMPARE(user.save(), true);
+
+    Message message;
+    message.setUser(&user);
+    message.setMessage("hello");
+    QCOMPARE(message.save(), true);
+
+    // the same fields give the same columns, whether or not the results are cached
+    for (int cached = 0; cached < 2; ++cached) {
+        QDjangoQuerySetPrivate qs("Message");
+        if (cached)
+            QCOMPARE(qs.sqlFetch(), true);
+
+        QList<QVariantList> values = qs.sqlValuesList(QStringList() << "message" << "user__username" << "user_id");
+        QCOMPARE(values.size(), 1);
+        QCOMPARE(values[0].size(), 3);
+        QCOMPARE(values[0][0].toString(), QLatin1String("hello"));
+        QCOMPARE(values[0][1].toString(), QLatin1String("foouser"));
+        QCOMPARE(values[0][2].toInt(), user.pk().toInt());
+
+        // all the local fields
+        values = qs.sqlValuesList(QStringList());
+        QCOMPARE(values.size(), 1);
+        QCOMPARE(values[0].size(), messageModel.localFields().size());
+
+        // a foreign key is not expanded
+        QTest::ignoreMessage(QtWarningMsg, "Unknown field 'user' for model 'Message'");
+        QVERIFY(qs.sqlValuesList(QStringList() << "message" << "user").isEmpty());
+
+        // an unknown field does not shift the other columns
+        QTest::ignoreMessage(QtWarningMsg, "Unknown field 'missing' for model 'Message'");
+        QVERIFY(qs.sqlValuesList(QStringList() << "missing" << "message").isEmpty());
+    }
+}
+
 void tst_QDjangoQuerySetPrivate::cleanupTestCase()
 {
+    messageModel.dropTable();
+    userModel.dropTable();
     metaModel.dropTable();
 }
 
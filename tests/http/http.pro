@@ -2,7 +2,10 @@ TEMPLATE = subdirs
 SUBDIRS = \
     qdjangofastcgiserver \
     qdjangohttpcontroller \
+    qdjangohttpmetrics \
     qdjangohttprequest \
     qdjangohttpresponse \
+    qdjangohttpresponsecache \
     qdjangohttpserver \
+    qdjangohttpstaticcache \
     qdjangourlresolver
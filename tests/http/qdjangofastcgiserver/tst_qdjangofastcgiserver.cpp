@@ -25,9 +25,16 @@
 #include "QDjangoHttpController.h"
 #include "QDjangoHttpRequest.h"
 #include "QDjangoHttpResponse.h"
+#include "QDjangoHttpStreamResponse.h"
 #include "QDjangoFastCgiServer.h"
 #include "QDjangoUrlResolver.h"
 
+#define DEFERRED_DATA QByteArray("Status: 200 OK\r\n" \
+    "Content-Length: 8\r\n" \
+    "Content-Type: text/plain\r\n" \
+    "\r\n" \
+    "deferred")
+
 #define ERROR_DATA QByteArray("Status: 500 Internal Server Error\r\n" \
     "Content-Length: 107\r\n" \
     "Content-Type: text/html; charset=utf-8\r\n" \
@@ -72,6 +79,35 @@ static QByteArray encodeSize(quint32 size)
     return ba;
 }
 
+/** A response which only becomes ready once its timer fires.
+ */
+class QDjangoDeferredResponse : public QDjangoHttpResponse
+{
+    Q_OBJECT
+
+public:
+    QDjangoDeferredResponse()
+        : m_ready(false)
+    {
+        QTimer::singleShot(50, this, SLOT(_q_ready()));
+    }
+
+    bool isReady() const
+    {
+        return m_ready;
+    }
+
+private slots:
+    void _q_ready()
+    {
+        m_ready = true;
+        emit ready();
+    }
+
+private:
+    bool m_ready;
+};
+
 class QDjangoFastCgiReply : public QObject
 {
     Q_OBJECT
@@ -91,20 +127,23 @@ class QDjangoFastCgiClient : public QObject
     Q_OBJECT
 
 public:
-    QDjangoFastCgiClient(QIODevice *socket);
+    QDjangoFastCgiClient(QIODevice *socket, bool keepConnection = false);
     QDjangoFastCgiReply* request(const QString &method, const QUrl &url, const QByteArray &data);
+    void setKeepConnection(bool keepConnection) { m_keepConnection = keepConnection; }
 
 private slots:
     void _q_readyRead();
 
 private:
     QIODevice *m_device;
+    bool m_keepConnection;
     QMap<quint16, QDjangoFastCgiReply*> m_replies;
     quint16 m_requestId;
 };
 
-QDjangoFastCgiClient::QDjangoFastCgiClient(QIODevice *socket)
+QDjangoFastCgiClient::QDjangoFastCgiClient(QIODevice *socket, bool keepConnection)
     : m_device(socket)
+    , m_keepConnection(keepConnection)
     , m_requestId(0)
 {
     connect(socket, SIGNAL(readyRead()), this, SLOT(_q_readyRead()));
@@ -123,6 +162,8 @@ QDjangoFastCgiReply* QDjangoFastCgiClient::request(const QString &method, const
 
     // BEGIN REQUEST
     ba = QByteArray("\x01\x00\x00\x00\x00\x00\x00\x00", 8);
+    if (m_keepConnection)
+        ba[2] = FCGI_KEEP_CONN;
     header->version = 1;
     QDjangoFastCgiHeader::setRequestId(header, requestId);
     header->type = FCGI_BEGIN_REQUEST;
@@ -210,17 +251,28 @@ private slots:
     void cleanup();
     void init();
     void testAbort();
+    void testAbortEnded();
     void testBadBegin();
     void testBadRequestId();
     void testBadRequestType();
     void testBadVersion();
+    void testBufferPool();
+    void testDeferred();
+    void testGetValues();
+    void testKeepConnection();
     void testLocal_data();
+    void testLimits();
     void testLocal();
+    void testMultiplex();
+    void testOverloaded();
+    void testStreamHead();
     void testTcp_data();
     void testTcp();
 
+    QDjangoHttpResponse* _q_deferred(const QDjangoHttpRequest &request);
     QDjangoHttpResponse* _q_index(const QDjangoHttpRequest &request);
     QDjangoHttpResponse* _q_error(const QDjangoHttpRequest &request);
+    QDjangoHttpResponse* _q_stream(const QDjangoHttpRequest &request);
 
 private:
     QDjangoFastCgiServer *server;
@@ -237,6 +289,8 @@ void tst_QDjangoFastCgiServer::init()
     server = new QDjangoFastCgiServer;
     server->urls()->set(QRegExp(QLatin1String(QLatin1String("^$"))), this, "_q_index");
     server->urls()->set(QRegExp(QLatin1String("^internal-server-error$")), this, "_q_error");
+    server->urls()->set(QRegExp(QLatin1String("^deferred$")), this, "_q_deferred");
+    server->urls()->set(QRegExp(QLatin1String("^stream$")), this, "_q_stream");
 }
 
 void tst_QDjangoFastCgiServer::testAbort()
@@ -274,6 +328,37 @@ void tst_QDjangoFastCgiServer::testAbort()
     QCOMPARE(socket.state(), QLocalSocket::UnconnectedState);
 }
 
+void tst_QDjangoFastCgiServer::testAbortEnded()
+{
+    const QString name("/tmp/qdjangofastcgi.socket");
+    QCOMPARE(server->listen(name), true);
+
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
+
+    QEventLoop loop;
+    QDjangoFastCgiClient client(&socket, true);
+
+    // the request has ended by the time its abort is received
+    QDjangoFastCgiReply *reply1 = client.request("GET", QUrl("/"), QByteArray());
+    QByteArray headerBuffer(FCGI_HEADER_LEN, '\0');
+    FCGI_Header *header = (FCGI_Header*)headerBuffer.data();
+    header->version = 1;
+    header->type = FCGI_ABORT_REQUEST;
+    QDjangoFastCgiHeader::setRequestId(header, 1);
+    socket.write(headerBuffer);
+
+    // the other requests on the connection are served
+    QDjangoFastCgiReply *reply2 = client.request("GET", QUrl("/"), QByteArray());
+    QObject::connect(reply2, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+
+    QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
+    QCOMPARE(reply1->data, ROOT_DATA);
+    QCOMPARE(reply2->data, ROOT_DATA);
+}
+
 void tst_QDjangoFastCgiServer::testBadBegin()
 {
     const QString name("/tmp/qdjangofastcgi.socket");
@@ -289,7 +374,7 @@ void tst_QDjangoFastCgiServer::testBadBegin()
 
     // check socket is connected
     QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
-    QTest::ignoreMessage(QtWarningMsg, "Received new FastCGI request 2 while already handling request 1");
+    QTest::ignoreMessage(QtWarningMsg, "Received new FastCGI request 1 which is already being handled");
 
     // BEGIN REQUEST
     const QByteArray ba("\x01\x00\x00\x00\x00\x00\x00\x00", 8);
@@ -298,7 +383,6 @@ void tst_QDjangoFastCgiServer::testBadBegin()
     socket.write(headerBuffer + ba);
 
     // BEGIN REQUEST again
-    QDjangoFastCgiHeader::setRequestId(header, 2);
     QDjangoFastCgiHeader::setContentLength(header, ba.size());
     socket.write(headerBuffer + ba);
 
@@ -327,8 +411,8 @@ void tst_QDjangoFastCgiServer::testBadRequestId()
     QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
     QTest::ignoreMessage(QtWarningMsg, "Received FastCGI record for an invalid request 1");
 
-    // ABORT REQUEST
-    header->type = FCGI_ABORT_REQUEST;
+    // PARAMS without BEGIN REQUEST
+    header->type = FCGI_PARAMS;
     QDjangoFastCgiHeader::setContentLength(header, 0);
     socket.write(headerBuffer);
 
@@ -407,6 +491,195 @@ void tst_QDjangoFastCgiServer::testBadVersion()
     QCOMPARE(socket.state(), QLocalSocket::UnconnectedState);
 }
 
+void tst_QDjangoFastCgiServer::testBufferPool()
+{
+    QByteArray buffer = QDjangoFastCgiBufferPool::acquire(60000);
+    QCOMPARE(buffer.size(), 60000);
+    const char *data = buffer.constData();
+
+    QDjangoFastCgiBufferPool::release(buffer);
+    QCOMPARE(buffer.size(), 0);
+
+    // a smaller buffer reuses the released one
+    buffer = QDjangoFastCgiBufferPool::acquire(50000);
+    QCOMPARE(buffer.size(), 50000);
+    QVERIFY(buffer.constData() == data);
+    QDjangoFastCgiBufferPool::release(buffer);
+
+    // empty records do not need a buffer
+    buffer = QDjangoFastCgiBufferPool::acquire(0);
+    QCOMPARE(buffer.size(), 0);
+    QCOMPARE(buffer.capacity(), 0);
+}
+
+void tst_QDjangoFastCgiServer::testDeferred()
+{
+    const QString name("/tmp/qdjangofastcgi.socket");
+    QCOMPARE(server->listen(name), true);
+
+    QLocalSocket socket;
+    socket.connectToServer(name);
+
+    QEventLoop loop;
+    QDjangoFastCgiClient client(&socket);
+
+    // check socket is connected
+    QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
+
+    // the second request is aborted before its response is ready
+    QDjangoFastCgiReply *reply1 = client.request("GET", QUrl("/deferred"), QByteArray());
+    QDjangoFastCgiReply *reply2 = client.request("GET", QUrl("/deferred"), QByteArray());
+
+    QByteArray headerBuffer(FCGI_HEADER_LEN, '\0');
+    FCGI_Header *header = (FCGI_Header*)headerBuffer.data();
+    header->version = 1;
+    header->type = FCGI_ABORT_REQUEST;
+    QDjangoFastCgiHeader::setRequestId(header, 2);
+    QDjangoFastCgiHeader::setContentLength(header, 0);
+    socket.write(headerBuffer);
+
+    // wait for the aborted request to end
+    QObject::connect(reply2, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+    QCOMPARE(reply1->data, QByteArray());
+    QCOMPARE(reply2->data, QByteArray());
+
+    // wait for the deferred response
+    QObject::connect(reply1, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+    QCOMPARE(reply1->data, DEFERRED_DATA);
+    QCOMPARE(reply2->data, QByteArray());
+
+    // wait for connection to close
+    QObject::connect(&socket, SIGNAL(disconnected()), &loop, SLOT(quit()));
+    loop.exec();
+
+    QCOMPARE(socket.state(), QLocalSocket::UnconnectedState);
+}
+
+void tst_QDjangoFastCgiServer::testGetValues()
+{
+    const QString name("/tmp/qdjangofastcgi.socket");
+    QCOMPARE(server->listen(name), true);
+
+    QLocalSocket socket;
+    socket.connectToServer(name);
+
+    QByteArray headerBuffer(FCGI_HEADER_LEN, '\0');
+    FCGI_Header *header = (FCGI_Header*)headerBuffer.data();
+    header->version = 1;
+    QDjangoFastCgiHeader::setRequestId(header, 0);
+
+    // check socket is connected
+    QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
+
+    // GET VALUES
+    QByteArray ba;
+    foreach (const QByteArray &key, QList<QByteArray>() << "FCGI_MAX_CONNS" << "FCGI_MAX_REQS" << "FCGI_MPXS_CONNS") {
+        ba.append(encodeSize(key.size()));
+        ba.append(encodeSize(0));
+        ba.append(key);
+    }
+    header->type = FCGI_GET_VALUES;
+    QDjangoFastCgiHeader::setContentLength(header, ba.size());
+    socket.write(headerBuffer + ba);
+
+    // read GET VALUES RESULT
+    QVERIFY(socket.waitForReadyRead());
+    QByteArray reply = socket.readAll();
+    QVERIFY(reply.size() >= FCGI_HEADER_LEN);
+    header = (FCGI_Header*)reply.data();
+    QCOMPARE(int(header->type), FCGI_GET_VALUES_RESULT);
+    QCOMPARE(QDjangoFastCgiHeader::requestId(header), quint16(0));
+    QCOMPARE(int(QDjangoFastCgiHeader::contentLength(header)), reply.size() - FCGI_HEADER_LEN);
+    QCOMPARE(reply.mid(FCGI_HEADER_LEN), QByteArray("\x0d\x02" "FCGI_MAX_REQS" "32"
+                                                    "\x0f\x01" "FCGI_MPXS_CONNS" "1"));
+
+    // unknown management record
+    header = (FCGI_Header*)headerBuffer.data();
+    header->type = 12;
+    QDjangoFastCgiHeader::setContentLength(header, 0);
+    socket.write(headerBuffer);
+
+    QVERIFY(socket.waitForReadyRead());
+    reply = socket.readAll();
+    QCOMPARE(reply.size(), FCGI_HEADER_LEN + 8);
+    header = (FCGI_Header*)reply.data();
+    QCOMPARE(int(header->type), FCGI_UNKNOWN_TYPE);
+    QCOMPARE(int(reply.at(FCGI_HEADER_LEN)), 12);
+}
+
+void tst_QDjangoFastCgiServer::testKeepConnection()
+{
+    const QString name("/tmp/qdjangofastcgi.socket");
+    QCOMPARE(server->listen(name), true);
+
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
+
+    QEventLoop loop;
+    QDjangoFastCgiClient client(&socket);
+
+    // the first request does not keep the connection, the second does
+    QDjangoFastCgiReply *reply1 = client.request("GET", QUrl("/"), QByteArray());
+    client.setKeepConnection(true);
+    QDjangoFastCgiReply *reply2 = client.request("GET", QUrl("/deferred"), QByteArray());
+
+    // the connection stays open while the second request is in flight
+    QObject::connect(reply1, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+    QCOMPARE(reply1->data, ROOT_DATA);
+    QCOMPARE(reply2->data, QByteArray());
+    QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
+
+    QObject::connect(reply2, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+    QCOMPARE(reply2->data, DEFERRED_DATA);
+
+    // the connection is closed once both requests have ended
+    QObject::connect(&socket, SIGNAL(disconnected()), &loop, SLOT(quit()));
+    loop.exec();
+
+    QCOMPARE(socket.state(), QLocalSocket::UnconnectedState);
+}
+
+void tst_QDjangoFastCgiServer::testLimits()
+{
+    QDjangoHttpLimits limits;
+    limits.setIdleTimeout(500);
+    limits.setMaximumHeaderCount(2);
+    server->setLimits(limits);
+
+    const QString name("/tmp/qdjangofastcgi.socket");
+    QCOMPARE(server->listen(name), true);
+
+    QEventLoop loop;
+
+    // idle connections are closed
+    QLocalSocket socket1;
+    socket1.connectToServer(name);
+    QCOMPARE(socket1.state(), QLocalSocket::ConnectedState);
+    QObject::connect(&socket1, SIGNAL(disconnected()), &loop, SLOT(quit()));
+    QTimer::singleShot(5000, &loop, SLOT(quit()));
+    loop.exec();
+    QCOMPARE(socket1.state(), QLocalSocket::UnconnectedState);
+    QCOMPARE(server->rejectedConnections(), 0);
+
+    // requests with too many parameters are rejected
+    QLocalSocket socket2;
+    socket2.connectToServer(name);
+    QDjangoFastCgiClient client(&socket2);
+    QCOMPARE(socket2.state(), QLocalSocket::ConnectedState);
+    QTest::ignoreMessage(QtWarningMsg, "FastCGI request parameters are too large");
+    client.request("GET", QUrl("/"), QByteArray());
+    QObject::connect(&socket2, SIGNAL(disconnected()), &loop, SLOT(quit()));
+    QTimer::singleShot(5000, &loop, SLOT(quit()));
+    loop.exec();
+    QCOMPARE(socket2.state(), QLocalSocket::UnconnectedState);
+    QCOMPARE(server->rejectedConnections(), 1);
+}
+
 void tst_QDjangoFastCgiServer::testLocal_data()
 {
     QTest::addColumn<QString>("method");
@@ -454,6 +727,118 @@ void tst_QDjangoFastCgiServer::testLocal()
     QCOMPARE(socket.state(), QLocalSocket::UnconnectedState);
 }
 
+void tst_QDjangoFastCgiServer::testMultiplex()
+{
+    const QString name("/tmp/qdjangofastcgi.socket");
+    QCOMPARE(server->listen(name), true);
+
+    QLocalSocket socket;
+    socket.connectToServer(name);
+
+    QEventLoop loop;
+    QDjangoFastCgiClient client(&socket);
+
+    // check socket is connected
+    QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
+
+    // send several requests on the same connection
+    QDjangoFastCgiReply *reply1 = client.request("GET", QUrl("/"), QByteArray());
+    QDjangoFastCgiReply *reply2 = client.request("GET", QUrl("/not-found"), QByteArray());
+    QDjangoFastCgiReply *reply3 = client.request("POST", QUrl("/"), QByteArray("message=bar"));
+
+    // wait for the last reply
+    QObject::connect(reply3, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+
+    QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
+    QCOMPARE(reply1->data, ROOT_DATA);
+    QCOMPARE(reply2->data, NOT_FOUND_DATA);
+    QCOMPARE(reply3->data, POST_DATA);
+}
+
+void tst_QDjangoFastCgiServer::testOverloaded()
+{
+    const QString name("/tmp/qdjangofastcgi.socket");
+    QCOMPARE(server->listen(name), true);
+
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
+
+    QByteArray headerBuffer(FCGI_HEADER_LEN, '\0');
+    FCGI_Header *header = (FCGI_Header*)headerBuffer.data();
+    header->version = 1;
+
+    // fill the connection with requests, the last one is rejected
+    const QByteArray ba("\x00\x01\x01\x00\x00\x00\x00\x00", 8);
+    header->type = FCGI_BEGIN_REQUEST;
+    QDjangoFastCgiHeader::setContentLength(header, ba.size());
+    for (int i = 1; i <= 33; ++i) {
+        QDjangoFastCgiHeader::setRequestId(header, i);
+        socket.write(headerBuffer + ba);
+    }
+
+    // the records of the rejected request are ignored
+    QDjangoFastCgiHeader::setContentLength(header, 0);
+    header->type = FCGI_PARAMS;
+    socket.write(headerBuffer);
+    header->type = FCGI_STDIN;
+    socket.write(headerBuffer);
+
+    // the connection still serves the other requests
+    QDjangoFastCgiHeader::setRequestId(header, 1);
+    header->type = FCGI_ABORT_REQUEST;
+    socket.write(headerBuffer);
+
+    QEventLoop loop;
+    QObject::connect(&socket, SIGNAL(readyRead()), &loop, SLOT(quit()));
+    QByteArray reply;
+    while (reply.size() < 32) {
+        QTimer::singleShot(1000, &loop, SLOT(quit()));
+        loop.exec();
+        const QByteArray data = socket.readAll();
+        if (data.isEmpty())
+            break;
+        reply += data;
+    }
+    QCOMPARE(reply.size(), 32);
+
+    FCGI_Header *replyHeader = (FCGI_Header*)reply.data();
+    QCOMPARE(int(replyHeader->type), FCGI_END_REQUEST);
+    QCOMPARE(int(QDjangoFastCgiHeader::requestId(replyHeader)), 33);
+    QCOMPARE(int(reply.at(FCGI_HEADER_LEN + 4)), FCGI_OVERLOADED);
+
+    replyHeader = (FCGI_Header*)(reply.data() + 16);
+    QCOMPARE(int(replyHeader->type), FCGI_END_REQUEST);
+    QCOMPARE(int(QDjangoFastCgiHeader::requestId(replyHeader)), 1);
+    QCOMPARE(int(reply.at(16 + FCGI_HEADER_LEN + 4)), FCGI_REQUEST_COMPLETE);
+    QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
+}
+
+void tst_QDjangoFastCgiServer::testStreamHead()
+{
+    // the stream is neither read nor compressed, but must not be destroyed
+    server->setCompressionEnabled(true);
+    QCOMPARE(server->listen(QHostAddress::LocalHost, 8123), true);
+
+    QTcpSocket socket;
+    socket.connectToHost("127.0.0.1", 8123);
+
+    QEventLoop loop;
+    QDjangoFastCgiClient client(&socket);
+    QObject::connect(&socket, SIGNAL(connected()), &loop, SLOT(quit()));
+    loop.exec();
+    QCOMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QDjangoFastCgiReply *reply = client.request("HEAD", QUrl("/stream"), QByteArray());
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+
+    QCOMPARE(reply->data, QByteArray("Status: 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "\r\n"));
+}
+
 void tst_QDjangoFastCgiServer::testTcp_data()
 {
     QTest::addColumn<QString>("method");
@@ -503,6 +888,27 @@ void tst_QDjangoFastCgiServer::testTcp()
     QCOMPARE(socket.state(), QAbstractSocket::UnconnectedState);
 }
 
+QDjangoHttpResponse *tst_QDjangoFastCgiServer::_q_deferred(const QDjangoHttpRequest &request)
+{
+    Q_UNUSED(request);
+
+    QDjangoHttpResponse *response = new QDjangoDeferredResponse;
+    response->setHeader(QLatin1String("Content-Type"), QLatin1String("text/plain"));
+    response->setBody("deferred");
+    return response;
+}
+
+QDjangoHttpResponse *tst_QDjangoFastCgiServer::_q_stream(const QDjangoHttpRequest &request)
+{
+    Q_UNUSED(request);
+
+    // the body is never finished
+    QDjangoHttpStreamResponse *response = new QDjangoHttpStreamResponse;
+    response->setHeader(QLatin1String("Content-Type"), QLatin1String("text/plain"));
+    response->write("stream");
+    return response;
+}
+
 QDjangoHttpResponse *tst_QDjangoFastCgiServer::_q_index(const QDjangoHttpRequest &request)
 {
     QDjangoHttpResponse *response = new QDjangoHttpResponse;
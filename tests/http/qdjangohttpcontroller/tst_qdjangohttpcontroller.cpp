@@ -40,6 +40,9 @@ private slots:
     void testServeStatic();
     void testServeStaticHead();
     void testServeStaticIfModifiedSince();
+    void testServeStaticRange_data();
+    void testServeStaticRange();
+    void testServeStaticMultipleRanges();
 };
 
 void tst_QDjangoHttpController::testBasicAuth()
@@ -67,6 +70,10 @@ void tst_QDjangoHttpController::testDateTime()
     const QDateTime dt(QDate(2014, 7, 14), QTime(11, 22, 33), Qt::UTC);
     QCOMPARE(QDjangoHttpController::httpDateTime(dt), QString("Mon, 14 Jul 2014 11:22:33 GMT"));
     QCOMPARE(QDjangoHttpController::httpDateTime("Mon, 14 Jul 2014 11:22:33 GMT"), dt);
+
+    const QDateTime dt2(QDate(2015, 1, 4), QTime(1, 2, 3), Qt::UTC);
+    QCOMPARE(QDjangoHttpController::httpDateTime(dt2), QString("Sun, 04 Jan 2015 01:02:03 GMT"));
+    QCOMPARE(QDjangoHttpController::httpDateTime(QDateTime()), QString());
 }
 
 void tst_QDjangoHttpController::testServeAuthorizationRequired()
@@ -209,5 +216,91 @@ void tst_QDjangoHttpController::testServeStaticIfModifiedSince()
     delete response;
 }
 
+void tst_QDjangoHttpController::testServeStaticRange_data()
+{
+    QTest::addColumn<QString>("method");
+    QTest::addColumn<QString>("range");
+    QTest::addColumn<QString>("ifRange");
+    QTest::addColumn<int>("statusCode");
+    QTest::addColumn<QString>("contentRange");
+    QTest::addColumn<QByteArray>("body");
+
+    const QByteArray full("<html>\n<body>\n    <p>Hello!</p>\n</body>\n</html>\n");
+    QTest::newRow("first") << "GET" << "bytes=0-5" << "" << 206 << "bytes 0-5/48" << QByteArray("<html>");
+    QTest::newRow("middle") << "GET" << "bytes=18-30" << "" << 206 << "bytes 18-30/48" << QByteArray("<p>Hello!</p>");
+    QTest::newRow("open") << "GET" << "bytes=40-" << "" << 206 << "bytes 40-47/48" << QByteArray("</html>\n");
+    QTest::newRow("suffix") << "GET" << "bytes=-8" << "" << 206 << "bytes 40-47/48" << QByteArray("</html>\n");
+    QTest::newRow("clamped") << "GET" << "bytes=40-100" << "" << 206 << "bytes 40-47/48" << QByteArray("</html>\n");
+    QTest::newRow("merged") << "GET" << "bytes=0-2,3-5" << "" << 206 << "bytes 0-5/48" << QByteArray("<html>");
+    QTest::newRow("unsatisfiable") << "GET" << "bytes=48-" << "" << 416 << "bytes */48" << QByteArray();
+    QTest::newRow("invalid") << "GET" << "bytes=5-0" << "" << 200 << "" << full;
+    QTest::newRow("unit") << "GET" << "lines=0-5" << "" << 200 << "" << full;
+    QTest::newRow("head") << "HEAD" << "bytes=0-5" << "" << 200 << "" << QByteArray();
+    QTest::newRow("if-range-etag") << "GET" << "bytes=0-5" << "\"foo\"" << 200 << "" << full;
+    QTest::newRow("if-range-date") << "GET" << "bytes=0-5" << "Mon, 14 Jul 2014 11:22:33 GMT" << 200 << "" << full;
+}
+
+void tst_QDjangoHttpController::testServeStaticRange()
+{
+    QFETCH(QString, method);
+    QFETCH(QString, range);
+    QFETCH(QString, ifRange);
+    QFETCH(int, statusCode);
+    QFETCH(QString, contentRange);
+    QFETCH(QByteArray, body);
+
+    QDjangoHttpRequest request;
+    request.d->method = method;
+    request.d->meta.insert("HTTP_RANGE", range);
+    if (!ifRange.isEmpty())
+        request.d->meta.insert("HTTP_IF_RANGE", ifRange);
+
+    QDjangoHttpResponse *response = QDjangoHttpController::serveStatic(request, ":/test.html");
+    QCOMPARE(response->statusCode(), statusCode);
+    QCOMPARE(response->header("content-range"), contentRange);
+    if (statusCode != 416) {
+        QCOMPARE(response->body(), body);
+        QCOMPARE(response->header("accept-ranges"), QString("bytes"));
+        if (method == "GET")
+            QCOMPARE(response->header("content-length"), QString::number(body.size()));
+    }
+    delete response;
+}
+
+void tst_QDjangoHttpController::testServeStaticMultipleRanges()
+{
+    QDjangoHttpRequest request;
+    request.d->method = "GET";
+
+    // matching if-range date
+    QDjangoHttpResponse *response = QDjangoHttpController::serveStatic(request, ":/test.html");
+    const QString lastModified = response->header("last-modified");
+    delete response;
+    request.d->meta.insert("HTTP_IF_RANGE", lastModified);
+    request.d->meta.insert("HTTP_RANGE", "bytes=0-5, -8");
+
+    response = QDjangoHttpController::serveStatic(request, ":/test.html");
+    QCOMPARE(response->statusCode(), 206);
+    QCOMPARE(response->header("content-range"), QString());
+
+    const QString contentType = response->header("content-type");
+    QVERIFY(contentType.startsWith("multipart/byteranges; boundary="));
+    const QByteArray boundary = contentType.mid(31).toLatin1();
+    const QByteArray expected = "--" + boundary + "\r\n"
+        "Content-Type: text/html\r\n"
+        "Content-Range: bytes 0-5/48\r\n"
+        "\r\n"
+        "<html>\r\n"
+        "--" + boundary + "\r\n"
+        "Content-Type: text/html\r\n"
+        "Content-Range: bytes 40-47/48\r\n"
+        "\r\n"
+        "</html>\n\r\n"
+        "--" + boundary + "--\r\n";
+    QCOMPARE(response->header("content-length"), QString::number(expected.size()));
+    QCOMPARE(response->body(), expected);
+    delete response;
+}
+
 QTEST_MAIN(tst_QDjangoHttpController)
 #include "tst_qdjangohttpcontroller.moc"
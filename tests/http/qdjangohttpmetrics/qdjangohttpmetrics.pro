@@ -0,0 +1,4 @@
+include(../http.pri)
+
+TARGET = tst_qdjangohttpmetrics
+SOURCES += tst_qdjangohttpmetrics.cpp
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QtTest>
+#include <QUrl>
+
+#include "QDjangoHttpMetrics.h"
+#include "QDjangoHttpMetrics_p.h"
+#include "QDjangoHttpRequest.h"
+#include "QDjangoHttpResponse.h"
+#include "QDjangoHttpServer.h"
+#include "QDjangoUrlResolver.h"
+
+/** Test QDjangoHttpMetrics class.
+ */
+class tst_QDjangoHttpMetrics : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testBuckets();
+    void testHistogram();
+    void testServer();
+
+    QDjangoHttpResponse* _q_index(const QDjangoHttpRequest &request);
+
+private:
+    QByteArray get(const QString &path);
+};
+
+QByteArray tst_QDjangoHttpMetrics::get(const QString &path)
+{
+    QNetworkAccessManager network;
+    QNetworkReply *reply = network.get(QNetworkRequest(QUrl(QLatin1String("http://127.0.0.1:8125") + path)));
+
+    QEventLoop loop;
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+
+    const QByteArray body = reply->readAll();
+    delete reply;
+    return body;
+}
+
+void tst_QDjangoHttpMetrics::testBuckets()
+{
+    // each value falls between the bounds of its bucket
+    for (qint64 value = 0; value < 100000; value += 1 + value / 64) {
+        const int index = QDjangoHttpHistogram::bucketIndex(value);
+        QVERIFY(value <= QDjangoHttpHistogram::bucketUpperBound(index));
+        if (index > 0)
+            QVERIFY(value > QDjangoHttpHistogram::bucketUpperBound(index - 1));
+    }
+
+    QCOMPARE(QDjangoHttpHistogram::bucketIndex(-1), 0);
+    QCOMPARE(QDjangoHttpHistogram::bucketIndex(15), 15);
+    QCOMPARE(QDjangoHttpHistogram::bucketIndex(16), 16);
+    QCOMPARE(QDjangoHttpHistogram::bucketIndex(Q_INT64_C(1) << 50), HISTOGRAM_BUCKETS - 1);
+}
+
+void tst_QDjangoHttpMetrics::testHistogram()
+{
+    QDjangoHttpHistogram histogram;
+    QCOMPARE(histogram.count(), qint64(0));
+    QCOMPARE(histogram.percentile(0.5), qint64(0));
+
+    for (int i = 1; i <= 1000; ++i)
+        histogram.add(i);
+    QCOMPARE(histogram.count(), qint64(1000));
+    QCOMPARE(histogram.maximum(), qint64(1000));
+    QCOMPARE(histogram.sum(), qint64(500500));
+
+    // percentiles are exact to within the precision of a bucket
+    const qint64 median = histogram.percentile(0.5);
+    QVERIFY(median >= 500 && median <= 532);
+    const qint64 p99 = histogram.percentile(0.99);
+    QVERIFY(p99 >= 990 && p99 <= 1000);
+    QCOMPARE(histogram.percentile(1.0), qint64(1000));
+}
+
+void tst_QDjangoHttpMetrics::testServer()
+{
+    QDjangoHttpServer server;
+    server.urls()->set(QRegExp(QLatin1String("^$")), this, "_q_index");
+    server.urls()->set(QRegExp(QLatin1String("^metrics$")), server.metrics(), "serveSnapshot");
+    QCOMPARE(server.listen(QHostAddress::LocalHost, 8125), true);
+
+    QDjangoHttpMetrics *metrics = server.metrics();
+    QCOMPARE(metrics->activeRequests(), 0);
+    QCOMPARE(metrics->bytesReceived(), qint64(0));
+    QCOMPARE(metrics->bytesSent(), qint64(0));
+    QCOMPARE(metrics->requestCount(), qint64(0));
+
+    QCOMPARE(get(QLatin1String("/")), QByteArray("hello"));
+    QCOMPARE(metrics->activeRequests(), 0);
+    QCOMPARE(metrics->requestCount(), qint64(1));
+    QVERIFY(metrics->bytesReceived() > 0);
+    QVERIFY(metrics->bytesSent() > 0);
+    QVERIFY(metrics->connectionCount() >= 1);
+
+    // the snapshot is taken while its own request is being handled
+    const QByteArray snapshot = get(QLatin1String("/metrics"));
+    QVERIFY(snapshot.contains("\nqdjango_requests 1\n"));
+    QVERIFY(snapshot.contains("\nqdjango_requests_total 1\n"));
+    QVERIFY(snapshot.contains("qdjango_phase_seconds_count{phase=\"handler\"} 1\n"));
+    QVERIFY(snapshot.contains("qdjango_request_seconds_count{route=\"tst_QDjangoHttpMetrics::_q_index\",status=\"2xx\"} 1\n"));
+    QCOMPARE(metrics->requestCount(), qint64(2));
+
+    // unknown paths are not attributed to a route
+    get(QLatin1String("/unknown"));
+    QVERIFY(metrics->snapshot().contains("qdjango_request_seconds_count{route=\"\",status=\"4xx\"} 1\n"));
+
+    server.close();
+}
+
+QDjangoHttpResponse *tst_QDjangoHttpMetrics::_q_index(const QDjangoHttpRequest &request)
+{
+    Q_UNUSED(request);
+
+    QDjangoHttpResponse *response = new QDjangoHttpResponse;
+    response->setHeader(QLatin1String("Content-Type"), QLatin1String("text/plain"));
+    response->setBody("hello");
+    return response;
+}
+
+QTEST_MAIN(tst_QDjangoHttpMetrics)
+#include "tst_qdjangohttpmetrics.moc"
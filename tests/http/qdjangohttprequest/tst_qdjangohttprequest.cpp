@@ -18,8 +18,40 @@
 #include <QtTest>
 
 #include "QDjangoHttpRequest.h"
+#include "QDjangoHttpRequestBody_p.h"
 #include "QDjangoHttpRequest_p.h"
 
+static const char multipartBody[] =
+    "preamble\r\n"
+    "----frontier\r\n"
+    "Content-Disposition: form-data; name=\"title\"\r\n"
+    "\r\n"
+    "Hello, world\r\n"
+    "----frontier\r\n"
+    "Content-Disposition: form-data; name=\"choice\"\r\n"
+    "\r\n"
+    "1\r\n"
+    "----frontier\r\n"
+    "content-disposition: form-data; name=\"choice\"\r\n"
+    "Content-Type: text/plain; charset=utf-8\r\n"
+    "\r\n"
+    "caf\xc3\xa9\r\n"
+    "----frontier\r\n"
+    "Content-Disposition: form-data; name=\"text\"\r\n"
+    "\r\n"
+    "line 1\r\nline 2\r\n"
+    "----frontier\r\n"
+    "Content-Disposition: form-data; name=\"upload\"; filename=\"foo.txt\"\r\n"
+    "Content-Type: text/plain\r\n"
+    "\r\n"
+    "file contents\r\n----frontie\r\n"
+    "----frontier\r\n"
+    "Content-Disposition: form-data; name=\"empty\"; filename=\"\"\r\n"
+    "\r\n"
+    "\r\n"
+    "----frontier--\r\n"
+    "epilogue";
+
 /** Test QDjangoHttpServer class.
  */
 class tst_QDjangoHttpRequest : public QObject
@@ -28,8 +60,19 @@ class tst_QDjangoHttpRequest : public QObject
 
 private slots:
     void testBody();
+    void testBodyDevice_data();
+    void testBodyDevice();
+    void testGet_data();
     void testGet();
+    void testGetList();
+    void testMeta();
+    void testPost_data();
     void testPost();
+    void testPostList();
+    void testPostSpooled();
+    void testPostMultipart();
+    void testPostMultipartChunks();
+    void testPostMultipartSpooled();
 };
 
 void tst_QDjangoHttpRequest::testBody()
@@ -42,64 +85,253 @@ void tst_QDjangoHttpRequest::testBody()
     QCOMPARE(request.body(), QByteArray("foo=bar"));
 }
 
+void tst_QDjangoHttpRequest::testBodyDevice_data()
+{
+    QTest::addColumn<qint64>("spoolThreshold");
+    QTest::addColumn<bool>("spooled");
+
+    QTest::newRow("memory") << qint64(0) << false;
+    QTest::newRow("below threshold") << qint64(1024) << false;
+    QTest::newRow("spooled") << qint64(8) << true;
+}
+
+void tst_QDjangoHttpRequest::testBodyDevice()
+{
+    QFETCH(qint64, spoolThreshold);
+    QFETCH(bool, spooled);
+
+    QDjangoHttpRequestBody body(QByteArray("text/plain"), spoolThreshold, 0);
+    QSignalSpy readySpy(&body, SIGNAL(readyRead()));
+    QSignalSpy finishedSpy(&body, SIGNAL(readChannelFinished()));
+    QVERIFY(body.isSequential());
+    QVERIFY(!body.atEnd());
+
+    // the body can be read as it arrives
+    QVERIFY(body.append("hello ", 6));
+    QCOMPARE(readySpy.count(), 1);
+    QCOMPARE(body.bytesAvailable(), qint64(6));
+    QCOMPARE(body.read(3), QByteArray("hel"));
+    QVERIFY(body.append("world", 5));
+    QCOMPARE(readySpy.count(), 2);
+    QCOMPARE(body.isSpooled(), spooled);
+    QCOMPARE(body.readAll(), QByteArray("lo world"));
+    QVERIFY(!body.atEnd());
+
+    body.finish();
+    QCOMPARE(finishedSpy.count(), 1);
+    QVERIFY(body.atEnd());
+
+    // spooled bodies are not loaded back into memory
+    if (spooled) {
+        QTest::ignoreMessage(QtWarningMsg, "HTTP request body is too large to be held in memory");
+        QCOMPARE(body.data(), QByteArray());
+    } else {
+        QCOMPARE(body.data(), QByteArray("hello world"));
+    }
+
+    // the maximum size is enforced
+    QDjangoHttpRequestBody limited(QByteArray(), spoolThreshold, 10);
+    QVERIFY(limited.append("hello", 5));
+    QTest::ignoreMessage(QtWarningMsg, "HTTP request body is too large");
+    QVERIFY(!limited.append(" world", 6));
+}
+
+void tst_QDjangoHttpRequest::testGet_data()
+{
+    QTest::addColumn<QString>("query");
+    QTest::addColumn<QString>("foo");
+
+    QTest::newRow("plain") << "foo=bar&baz=qux" << "bar";
+    QTest::newRow("space encoded as plus") << "foo=bar+more&baz=qux" << "bar more";
+    QTest::newRow("plus encoded as %2B") << "foo=bar%2Bmore&baz=qux" << "bar+more";
+    QTest::newRow("plus encoded as %2b") << "foo=bar%2bmore&baz=qux" << "bar+more";
+    QTest::newRow("at encoded as %40") << "foo=bar%40example.com&baz=qux" << "bar@example.com";
+}
+
 void tst_QDjangoHttpRequest::testGet()
+{
+    QFETCH(QString, query);
+    QFETCH(QString, foo);
+
+    QDjangoHttpRequest request;
+    request.d->meta.insert("QUERY_STRING", query);
+    QCOMPARE(request.get(QLatin1String("foo")), foo);
+    QCOMPARE(request.get(QLatin1String("baz")), QLatin1String("qux"));
+    QCOMPARE(request.get(QLatin1String("missing")), QString());
+}
+
+void tst_QDjangoHttpRequest::testGetList()
+{
+    QDjangoHttpRequest request;
+    request.d->meta.insert("QUERY_STRING", "tag=a&empty=&tag=b%20c&flag&caf%C3%A9=th%C3%A9");
+    QCOMPARE(request.getList(QLatin1String("tag")), QStringList() << "a" << "b c");
+    QCOMPARE(request.get(QLatin1String("tag")), QLatin1String("a"));
+    QCOMPARE(request.getList(QLatin1String("empty")), QStringList() << "");
+    QCOMPARE(request.getList(QLatin1String("flag")), QStringList() << "");
+    QCOMPARE(request.get(QString::fromUtf8("caf\xc3\xa9")), QString::fromUtf8("th\xc3\xa9"));
+    QCOMPARE(request.getList(QLatin1String("missing")), QStringList());
+}
+
+void tst_QDjangoHttpRequest::testMeta()
 {
     QDjangoHttpRequest request;
+    QCOMPARE(request.meta(QLatin1String("HTTP_HOST")), QString());
 
-    // plain
-    request.d->meta.insert("QUERY_STRING", "foo=bar&baz=qux");
+    // raw pairs are decoded on lookup
+    request.d->addRawMeta("HTTP_HOST", "example.com");
+    request.d->addRawMeta("HTTP_X_NAME", "caf\xc3\xa9");
+    request.d->addRawMeta("QUERY_STRING", "foo=bar");
+    QCOMPARE(request.meta(QLatin1String("HTTP_HOST")), QLatin1String("example.com"));
+    QCOMPARE(request.meta(QLatin1String("HTTP_X_NAME")), QString::fromUtf8("caf\xc3\xa9"));
+    QCOMPARE(request.meta(QLatin1String("HTTP_HOS")), QString());
     QCOMPARE(request.get(QLatin1String("foo")), QLatin1String("bar"));
-    QCOMPARE(request.get(QLatin1String("baz")), QLatin1String("qux"));
 
-    // space encoded as plus
-    request.d->meta.insert("QUERY_STRING", "foo=bar+more&baz=qux");
-    QCOMPARE(request.get(QLatin1String("foo")), QLatin1String("bar more"));
-    QCOMPARE(request.get(QLatin1String("baz")), QLatin1String("qux"));
+    // the last pair with a given name wins
+    request.d->addRawMeta("HTTP_ACCEPT", "text/plain");
+    request.d->addRawMeta("HTTP_ACCEPT", "text/html");
+    QCOMPARE(request.meta(QLatin1String("HTTP_ACCEPT")), QLatin1String("text/html"));
 
-    // plus encoded as %2B
-    request.d->meta.insert("QUERY_STRING", "foo=bar%2Bmore&baz=qux");
-    QCOMPARE(request.get(QLatin1String("foo")), QLatin1String("bar+more"));
-    QCOMPARE(request.get(QLatin1String("baz")), QLatin1String("qux"));
+    // decoded values take precedence
+    request.d->meta.insert("HTTP_HOST", "example.org");
+    QCOMPARE(request.meta(QLatin1String("HTTP_HOST")), QLatin1String("example.org"));
+}
 
-    // plus encoded as %2b
-    request.d->meta.insert("QUERY_STRING", "foo=bar%2bmore&baz=qux");
-    QCOMPARE(request.get(QLatin1String("foo")), QLatin1String("bar+more"));
-    QCOMPARE(request.get(QLatin1String("baz")), QLatin1String("qux"));
+void tst_QDjangoHttpRequest::testPost_data()
+{
+    QTest::addColumn<QByteArray>("body");
+    QTest::addColumn<QString>("foo");
 
-    // at encoded as %40
-    request.d->meta.insert("QUERY_STRING", "foo=bar%40example.com&baz=qux");
-    QCOMPARE(request.get(QLatin1String("foo")), QLatin1String("bar@example.com"));
-    QCOMPARE(request.get(QLatin1String("baz")), QLatin1String("qux"));
+    QTest::newRow("plain") << QByteArray("foo=bar&baz=qux") << "bar";
+    QTest::newRow("space encoded as plus") << QByteArray("foo=bar+more&baz=qux") << "bar more";
+    QTest::newRow("plus encoded as %2B") << QByteArray("foo=bar%2Bmore&baz=qux") << "bar+more";
+    QTest::newRow("plus encoded as %2b") << QByteArray("foo=bar%2bmore&baz=qux") << "bar+more";
+    QTest::newRow("at encoded as %40") << QByteArray("foo=bar%40example.com&baz=qux") << "bar@example.com";
 }
 
 void tst_QDjangoHttpRequest::testPost()
 {
-    QDjangoHttpRequest request;
+    QFETCH(QByteArray, body);
+    QFETCH(QString, foo);
 
-    // plain
-    request.d->buffer = QByteArray("foo=bar&baz=qux");
-    QCOMPARE(request.post(QLatin1String("foo")), QLatin1String("bar"));
+    QDjangoHttpRequest request;
+    request.d->buffer = body;
+    QCOMPARE(request.post(QLatin1String("foo")), foo);
     QCOMPARE(request.post(QLatin1String("baz")), QLatin1String("qux"));
+    QCOMPARE(request.post(QLatin1String("missing")), QString());
+}
 
-    // space encoded as plus
-    request.d->buffer = QByteArray("foo=bar+more&baz=qux");
-    QCOMPARE(request.post(QLatin1String("foo")), QLatin1String("bar more"));
-    QCOMPARE(request.post(QLatin1String("baz")), QLatin1String("qux"));
+void tst_QDjangoHttpRequest::testPostList()
+{
+    QDjangoHttpRequest request;
+    request.d->meta.insert("CONTENT_TYPE", "application/x-www-form-urlencoded");
+    request.d->buffer = QByteArray("choice=1&choice=3&name=foo");
+    QCOMPARE(request.postList(QLatin1String("choice")), QStringList() << "1" << "3");
+    QCOMPARE(request.post(QLatin1String("choice")), QLatin1String("1"));
+    QCOMPARE(request.postList(QLatin1String("name")), QStringList() << "foo");
+    QCOMPARE(request.postList(QLatin1String("missing")), QStringList());
+}
 
-    // plus encoded as %2B
-    request.d->buffer = QByteArray("foo=bar%2Bmore&baz=qux");
-    QCOMPARE(request.post(QLatin1String("foo")), QLatin1String("bar+more"));
-    QCOMPARE(request.post(QLatin1String("baz")), QLatin1String("qux"));
+void tst_QDjangoHttpRequest::testPostSpooled()
+{
+    // the body is just above the threshold, and spans several chunks
+    const QByteArray data = "choice=1&text=" + QByteArray(100000, 'x') + "&choice=3&name=foo%20bar";
+    QDjangoHttpRequestBody *body = new QDjangoHttpRequestBody(QByteArray("application/x-www-form-urlencoded"), data.size() - 1, 0);
+    QVERIFY(body->append(data.constData(), 8));
+    QVERIFY(body->append(data.constData() + 8, data.size() - 8));
+    body->finish();
+    QVERIFY(body->isSpooled());
 
-    // plus encoded as %2b
-    request.d->buffer = QByteArray("foo=bar%2bmore&baz=qux");
-    QCOMPARE(request.post(QLatin1String("foo")), QLatin1String("bar+more"));
-    QCOMPARE(request.post(QLatin1String("baz")), QLatin1String("qux"));
+    QDjangoHttpRequest request;
+    request.d->meta.insert("CONTENT_TYPE", "application/x-www-form-urlencoded");
+    request.d->bodyDevice = QSharedPointer<QDjangoHttpRequestBody>(body);
+    QCOMPARE(request.postList(QLatin1String("choice")), QStringList() << "1" << "3");
+    QCOMPARE(request.post(QLatin1String("text")), QString(100000, QLatin1Char('x')));
+    QCOMPARE(request.post(QLatin1String("name")), QLatin1String("foo bar"));
 
-    // at encoded as %40
-    request.d->buffer = QByteArray("foo=bar%40example.com&baz=qux");
-    QCOMPARE(request.post(QLatin1String("foo")), QLatin1String("bar@example.com"));
-    QCOMPARE(request.post(QLatin1String("baz")), QLatin1String("qux"));
+    // a copy shares the temporary file, which outlives the original
+    QDjangoHttpRequestBody *copy = body->clone();
+    request.d->bodyDevice.clear();
+    QDjangoHttpRequest other;
+    other.d->meta.insert("CONTENT_TYPE", "application/x-www-form-urlencoded");
+    other.d->bodyDevice = QSharedPointer<QDjangoHttpRequestBody>(copy);
+    QVERIFY(copy->isSpooled());
+    QCOMPARE(other.post(QLatin1String("name")), QLatin1String("foo bar"));
+    QCOMPARE(copy->readAll(), data);
+
+    // the body itself is not loaded into memory
+    QTest::ignoreMessage(QtWarningMsg, "HTTP request body is too large to be held in memory");
+    QCOMPARE(other.body(), QByteArray());
+}
+
+void tst_QDjangoHttpRequest::testPostMultipart()
+{
+    QDjangoHttpRequest request;
+    request.d->meta.insert("CONTENT_TYPE", "multipart/form-data; boundary=\"--frontier\"");
+    request.d->buffer = QByteArray(multipartBody);
+    QCOMPARE(request.post(QLatin1String("title")), QLatin1String("Hello, world"));
+    QCOMPARE(request.postList(QLatin1String("choice")), QStringList() << "1" << QString::fromUtf8("caf\xc3\xa9"));
+    QCOMPARE(request.post(QLatin1String("text")), QLatin1String("line 1\r\nline 2"));
+    QCOMPARE(request.post(QLatin1String("upload")), QString());
+
+    // uploaded files are written to disk
+    QIODevice *file = request.file(QLatin1String("upload"));
+    QVERIFY(file);
+    QCOMPARE(file->readAll(), QByteArray("file contents\r\n----frontie"));
+    QCOMPARE(request.fileName(QLatin1String("upload")), QLatin1String("foo.txt"));
+    QVERIFY(!request.file(QLatin1String("empty")));
+    QVERIFY(!request.file(QLatin1String("title")));
+}
+
+void tst_QDjangoHttpRequest::testPostMultipartChunks()
+{
+    const QByteArray data(multipartBody);
+
+    // the parser is fed one byte at a time
+    QDjangoHttpMultipartParser parser("--frontier");
+    for (int i = 0; i < data.size(); ++i)
+        QVERIFY(parser.write(data.constData() + i, 1));
+
+    QCOMPARE(parser.fields.value(QLatin1String("title")), QStringList() << "Hello, world");
+    QCOMPARE(parser.fields.value(QLatin1String("choice")), QStringList() << "1" << QString::fromUtf8("caf\xc3\xa9"));
+    QCOMPARE(parser.fields.value(QLatin1String("text")), QStringList() << "line 1\r\nline 2");
+    QCOMPARE(parser.files.size(), 1);
+    QVERIFY(parser.files.contains(QLatin1String("upload")));
+    QCOMPARE(parser.files.value(QLatin1String("upload"))->readAll(), QByteArray("file contents\r\n----frontie"));
+    QCOMPARE(parser.fileNames.value(QLatin1String("upload")), QLatin1String("foo.txt"));
+}
+
+void tst_QDjangoHttpRequest::testPostMultipartSpooled()
+{
+    const QByteArray data(multipartBody);
+
+    // the raw body is dropped instead of being spooled
+    QDjangoHttpRequestBody body(QByteArray("multipart/form-data; boundary=\"--frontier\""), 64, 0);
+    QVERIFY(body.append(data.constData(), data.size()));
+    body.finish();
+    QVERIFY(!body.isSpooled());
+    QVERIFY(body.atEnd());
+    QTest::ignoreMessage(QtWarningMsg, "HTTP request body is too large to be held in memory");
+    QCOMPARE(body.data(), QByteArray());
+    QCOMPARE(body.read(16), QByteArray());
+    QCOMPARE(body.errorString(), QLatin1String("The raw body was consumed by the multipart/form-data parser"));
+
+    // the parts are still available
+    QCOMPARE(body.multipart()->fields.value(QLatin1String("title")), QStringList() << "Hello, world");
+    QVERIFY(body.multipart()->files.contains(QLatin1String("upload")));
+
+    // a copy shares the parts
+    QScopedPointer<QDjangoHttpRequestBody> copy(body.clone());
+    QVERIFY(copy->isFinished());
+    QCOMPARE(copy->multipart()->fields.value(QLatin1String("text")), QStringList() << "line 1\r\nline 2");
+    QCOMPARE(copy->multipart()->files.value(QLatin1String("upload"))->readAll(), QByteArray("file contents\r\n----frontie"));
+
+    // a streamed body keeps its raw bytes
+    QDjangoHttpRequestBody streamed(QByteArray("multipart/form-data; boundary=\"--frontier\""), 64, 0, true);
+    QVERIFY(streamed.append(data.constData(), data.size()));
+    streamed.finish();
+    QVERIFY(streamed.isSpooled());
+    QCOMPARE(streamed.readAll(), data);
+    QCOMPARE(streamed.multipart()->fields.value(QLatin1String("title")), QStringList() << "Hello, world");
 }
 
 QTEST_MAIN(tst_QDjangoHttpRequest)
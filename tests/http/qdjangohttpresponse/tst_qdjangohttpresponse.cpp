@@ -15,9 +15,11 @@
  * Lesser General Public License for more details.
  */
 
+#include <QBuffer>
 #include <QtTest>
 
 #include "QDjangoHttpResponse.h"
+#include "QDjangoHttpStreamResponse.h"
 
 /** Test QDjangoHttpServer class.
  */
@@ -27,9 +29,12 @@ class tst_QDjangoHttpResponse : public QObject
 
 private slots:
     void testBody();
+    void testBodyDevice();
     void testHeader();
     void testStatusCode_data();
     void testStatusCode();
+    void testStream();
+    void testStreamDropped();
 };
 
 void tst_QDjangoHttpResponse::testBody()
@@ -41,6 +46,25 @@ void tst_QDjangoHttpResponse::testBody()
     QCOMPARE(response.body(), QByteArray("foo=bar"));
 }
 
+void tst_QDjangoHttpResponse::testBodyDevice()
+{
+    QDjangoHttpResponse response;
+    QCOMPARE(response.bodyDevice(), (QIODevice*)0);
+
+    QBuffer *buffer = new QBuffer;
+    buffer->setData("foo=bar");
+    response.setBodyDevice(buffer);
+    QCOMPARE(response.bodyDevice(), (QIODevice*)buffer);
+    QCOMPARE(response.header("Content-Length"), QString("7"));
+    QCOMPARE(response.body(), QByteArray("foo=bar"));
+    QCOMPARE(buffer->pos(), qint64(0));
+
+    response.setBody("wiz");
+    QCOMPARE(response.bodyDevice(), (QIODevice*)0);
+    QCOMPARE(response.header("Content-Length"), QString("3"));
+    QCOMPARE(response.body(), QByteArray("wiz"));
+}
+
 void tst_QDjangoHttpResponse::testHeader()
 {
     QDjangoHttpResponse response;
@@ -57,6 +81,7 @@ void tst_QDjangoHttpResponse::testStatusCode_data()
     QTest::addColumn<QString>("reasonPhrase");
 
     QTest::newRow("200") << int(200) << QString("OK");
+    QTest::newRow("206") << int(206) << QString("Partial Content");
     QTest::newRow("301") << int(301) << QString("Moved Permanently");
     QTest::newRow("302") << int(302) << QString("Found");
     QTest::newRow("304") << int(304) << QString("Not Modified");
@@ -65,8 +90,10 @@ void tst_QDjangoHttpResponse::testStatusCode_data()
     QTest::newRow("403") << int(403) << QString("Forbidden");
     QTest::newRow("403") << int(404) << QString("Not Found");
     QTest::newRow("405") << int(405) << QString("Method Not Allowed");
+    QTest::newRow("416") << int(416) << QString("Requested Range Not Satisfiable");
     QTest::newRow("500") << int(500) << QString("Internal Server Error");
     QTest::newRow("501") << int(501) << QString();
+    QTest::newRow("503") << int(503) << QString("Service Unavailable");
 }
 
 void tst_QDjangoHttpResponse::testStatusCode()
@@ -80,5 +107,55 @@ void tst_QDjangoHttpResponse::testStatusCode()
     QCOMPARE(response.reasonPhrase(), reasonPhrase);
 }
 
+void tst_QDjangoHttpResponse::testStream()
+{
+    QDjangoHttpStreamResponse response;
+    QVERIFY(response.bodyDevice() != 0);
+    QVERIFY(response.bodyDevice()->isSequential());
+    QCOMPARE(response.header("Content-Length"), QString());
+    QCOMPARE(response.body(), QByteArray());
+    QCOMPARE(response.isFinished(), false);
+
+    response.write("foo");
+    response.write("bar");
+    QCOMPARE(response.bufferedBytes(), qint64(6));
+    QCOMPARE(response.bodyDevice()->read(4), QByteArray("foob"));
+    QCOMPARE(response.bufferedBytes(), qint64(2));
+    QCOMPARE(response.bodyDevice()->atEnd(), false);
+
+    response.finish();
+    QCOMPARE(response.isFinished(), true);
+    QCOMPARE(response.bodyDevice()->read(4), QByteArray("ar"));
+    QCOMPARE(response.bodyDevice()->atEnd(), true);
+}
+
+void tst_QDjangoHttpResponse::testStreamDropped()
+{
+    QDjangoHttpStreamResponse response;
+    response.write("foo");
+    QCOMPARE(response.bufferedBytes(), qint64(3));
+
+    // replacing the body destroys the stream's device
+    response.setBody("bar");
+    QCOMPARE(response.bodyDevice(), (QIODevice*)0);
+    QCOMPARE(response.bufferedBytes(), qint64(0));
+
+    // further data is discarded
+    response.write("wiz");
+    QCOMPARE(response.bufferedBytes(), qint64(0));
+    QCOMPARE(response.isFinished(), false);
+    response.finish();
+    QCOMPARE(response.isFinished(), true);
+    QCOMPARE(response.body(), QByteArray("bar"));
+
+    // same when the body device is removed
+    QDjangoHttpStreamResponse other;
+    other.setBodyDevice(0);
+    other.write("foo");
+    other.finish();
+    QCOMPARE(other.bufferedBytes(), qint64(0));
+    QCOMPARE(other.isFinished(), true);
+}
+
 QTEST_MAIN(tst_QDjangoHttpResponse)
 #include "tst_qdjangohttpresponse.moc"
@@ -0,0 +1,4 @@
+include(../http.pri)
+
+TARGET = tst_qdjangohttpresponsecache
+SOURCES += tst_qdjangohttpresponsecache.cpp
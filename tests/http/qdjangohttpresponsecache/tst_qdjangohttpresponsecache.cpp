@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <QtTest>
+
+#include "QDjangoHttpRequest.h"
+#include "QDjangoHttpRequest_p.h"
+#include "QDjangoHttpResponse.h"
+#include "QDjangoHttpResponseCache.h"
+#include "QDjangoUrlResolver.h"
+
+/** A response which becomes ready when told to.
+ */
+class tst_QDjangoDeferredResponse : public QDjangoHttpResponse
+{
+    Q_OBJECT
+
+public:
+    tst_QDjangoDeferredResponse()
+        : m_ready(false)
+    {
+    }
+
+    bool isReady() const
+    {
+        return m_ready;
+    }
+
+    void finish()
+    {
+        m_ready = true;
+        emit ready();
+    }
+
+private:
+    bool m_ready;
+};
+
+/** Views which count how many times they are called.
+ */
+class tst_QDjangoCacheViews : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_QDjangoCacheViews()
+        : calls(0)
+    {
+    }
+
+    QString cacheControl;
+    int calls;
+    QList<tst_QDjangoDeferredResponse*> deferred;
+
+private slots:
+    QDjangoHttpResponse* _q_counter(const QDjangoHttpRequest &request)
+    {
+        Q_UNUSED(request);
+
+        QDjangoHttpResponse *response = new QDjangoHttpResponse;
+        if (!cacheControl.isEmpty())
+            response->setHeader(QLatin1String("Cache-Control"), cacheControl);
+        response->setBody(QByteArray::number(++calls));
+        return response;
+    }
+
+    QDjangoHttpResponse* _q_cookie(const QDjangoHttpRequest &request)
+    {
+        QDjangoHttpResponse *response = _q_counter(request);
+        response->setHeader(QLatin1String("Set-Cookie"), QLatin1String("sessionid=1234"));
+        return response;
+    }
+
+    QDjangoHttpResponse* _q_deferred(const QDjangoHttpRequest &request)
+    {
+        Q_UNUSED(request);
+
+        calls++;
+        tst_QDjangoDeferredResponse *response = new tst_QDjangoDeferredResponse;
+        deferred << response;
+        return response;
+    }
+
+    QDjangoHttpResponse* _q_head(const QDjangoHttpRequest &request)
+    {
+        // the body is omitted for HEAD requests
+        QDjangoHttpResponse *response = _q_counter(request);
+        if (request.method() == QLatin1String("HEAD"))
+            response->setBody(QByteArray());
+        return response;
+    }
+
+    QDjangoHttpResponse* _q_vary(const QDjangoHttpRequest &request)
+    {
+        QDjangoHttpResponse *response = _q_counter(request);
+        response->setHeader(QLatin1String("Vary"), QLatin1String("Accept-Language"));
+        response->setBody(request.meta(QLatin1String("HTTP_ACCEPT_LANGUAGE")).toLatin1() + "-" + response->body());
+        return response;
+    }
+};
+
+/** Test QDjangoHttpResponseCache class.
+ */
+class tst_QDjangoHttpResponseCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void testCacheable();
+    void testCoalescing();
+    void testHead();
+    void testInvalidate();
+    void testMethod();
+    void testNotCacheable_data();
+    void testNotCacheable();
+    void testVary();
+
+private:
+    QByteArray fetch(const QString &path, const QString &method = QLatin1String("GET"), const QString &language = QString());
+
+    QDjangoHttpResponseCache *m_cache;
+    QDjangoUrlResolver *m_urls;
+    tst_QDjangoCacheViews *m_views;
+};
+
+QByteArray tst_QDjangoHttpResponseCache::fetch(const QString &path, const QString &method, const QString &language)
+{
+    QDjangoHttpTestRequest request(method, path);
+    if (!language.isEmpty())
+        request.d->meta.insert(QLatin1String("HTTP_ACCEPT_LANGUAGE"), language);
+    QDjangoHttpResponse *response = m_urls->respond(request, request.path());
+    if (!response)
+        return QByteArray();
+    const QByteArray body = response->body();
+    delete response;
+    return body;
+}
+
+void tst_QDjangoHttpResponseCache::init()
+{
+    m_cache = new QDjangoHttpResponseCache;
+    m_views = new tst_QDjangoCacheViews;
+    m_urls = new QDjangoUrlResolver;
+    QCOMPARE(m_urls->responseCache(), (QDjangoHttpResponseCache*)0);
+    m_urls->setResponseCache(m_cache);
+    QCOMPARE(m_urls->responseCache(), m_cache);
+    QVERIFY(m_urls->set(QRegExp(QLatin1String("^articles/([0-9]+)/$")), m_views, "_q_counter"));
+    QVERIFY(m_urls->set(QRegExp(QLatin1String("^cookie/$")), m_views, "_q_cookie"));
+    QVERIFY(m_urls->set(QRegExp(QLatin1String("^deferred/$")), m_views, "_q_deferred"));
+    QVERIFY(m_urls->set(QRegExp(QLatin1String("^head/$")), m_views, "_q_head"));
+    QVERIFY(m_urls->set(QRegExp(QLatin1String("^vary/$")), m_views, "_q_vary"));
+}
+
+void tst_QDjangoHttpResponseCache::cleanup()
+{
+    delete m_urls;
+    delete m_views;
+    delete m_cache;
+}
+
+void tst_QDjangoHttpResponseCache::testCacheable()
+{
+    m_views->cacheControl = QLatin1String("public, max-age=60");
+    QCOMPARE(fetch(QLatin1String("/articles/1/")), QByteArray("1"));
+    QCOMPARE(fetch(QLatin1String("/articles/1/")), QByteArray("1"));
+    QCOMPARE(fetch(QLatin1String("/articles/2/")), QByteArray("2"));
+    QCOMPARE(m_views->calls, 2);
+    QCOMPARE(m_cache->hits(), qint64(1));
+    QCOMPARE(m_cache->misses(), qint64(2));
+    QVERIFY(m_cache->size() > 0);
+
+    // cached responses carry their age
+    QDjangoHttpTestRequest request(QLatin1String("GET"), QLatin1String("/articles/1/"));
+    QDjangoHttpResponse *response = m_urls->respond(request, request.path());
+    QVERIFY(response->isReady());
+    QCOMPARE(response->header(QLatin1String("Cache-Control")), QLatin1String("public, max-age=60"));
+    QCOMPARE(response->header(QLatin1String("Age")), QLatin1String("0"));
+    delete response;
+
+    // s-maxage takes precedence over max-age
+    m_cache->clear();
+    QCOMPARE(m_cache->size(), 0);
+    m_views->cacheControl = QLatin1String("max-age=60, s-maxage=0");
+    QCOMPARE(fetch(QLatin1String("/articles/1/")), QByteArray("3"));
+    QCOMPARE(fetch(QLatin1String("/articles/1/")), QByteArray("4"));
+}
+
+void tst_QDjangoHttpResponseCache::testCoalescing()
+{
+    QDjangoHttpTestRequest request(QLatin1String("GET"), QLatin1String("/deferred/"));
+    QDjangoHttpResponse *first = m_urls->respond(request, request.path());
+    QDjangoHttpResponse *second = m_urls->respond(request, request.path());
+    QVERIFY(!first->isReady());
+    QVERIFY(!second->isReady());
+    QCOMPARE(m_views->calls, 1);
+
+    // the second request is served the response to the first
+    tst_QDjangoDeferredResponse *deferred = m_views->deferred.takeFirst();
+    deferred->setHeader(QLatin1String("Cache-Control"), QLatin1String("max-age=60"));
+    deferred->setBody("deferred");
+    deferred->finish();
+    QVERIFY(first->isReady());
+    QVERIFY(!second->isReady());
+    QCoreApplication::processEvents();
+    QVERIFY(second->isReady());
+    QCOMPARE(second->body(), QByteArray("deferred"));
+    QCOMPARE(m_views->calls, 1);
+    QCOMPARE(m_cache->hits(), qint64(1));
+    delete first;
+    delete second;
+
+    // the waiting request runs the handler if the response cannot be cached
+    m_cache->clear();
+    first = m_urls->respond(request, request.path());
+    second = m_urls->respond(request, request.path());
+    QCOMPARE(m_views->calls, 2);
+    m_views->deferred.takeFirst()->finish();
+    QCoreApplication::processEvents();
+    QCOMPARE(m_views->calls, 3);
+    QVERIFY(!second->isReady());
+    m_views->deferred.takeFirst()->finish();
+    QVERIFY(second->isReady());
+    delete first;
+    delete second;
+
+    // the waiting request runs the handler if the first request goes away
+    first = m_urls->respond(request, request.path());
+    second = m_urls->respond(request, request.path());
+    QCOMPARE(m_views->calls, 4);
+    m_views->deferred.clear();
+    delete first;
+    QCoreApplication::processEvents();
+    QCOMPARE(m_views->calls, 5);
+    m_views->deferred.takeFirst()->finish();
+    QVERIFY(second->isReady());
+    delete second;
+}
+
+void tst_QDjangoHttpResponseCache::testHead()
+{
+    m_views->cacheControl = QLatin1String("max-age=60");
+
+    // a GET following a HEAD receives the full body
+    QCOMPARE(fetch(QLatin1String("/head/"), QLatin1String("HEAD")), QByteArray());
+    QCOMPARE(fetch(QLatin1String("/head/")), QByteArray("2"));
+    QCOMPARE(fetch(QLatin1String("/head/")), QByteArray("2"));
+    QCOMPARE(m_views->calls, 2);
+}
+
+void tst_QDjangoHttpResponseCache::testInvalidate()
+{
+    m_views->cacheControl = QLatin1String("max-age=60");
+    QCOMPARE(fetch(QLatin1String("/articles/1/")), QByteArray("1"));
+    QCOMPARE(fetch(QLatin1String("/articles/1/?page=2")), QByteArray("2"));
+    QCOMPARE(fetch(QLatin1String("/articles/2/")), QByteArray("3"));
+
+    QCOMPARE(m_cache->invalidate(QLatin1String("/articles/1/")), 2);
+    QCOMPARE(m_cache->invalidate(QLatin1String("/articles/1/")), 0);
+    QCOMPARE(fetch(QLatin1String("/articles/1/")), QByteArray("4"));
+    QCOMPARE(fetch(QLatin1String("/articles/2/")), QByteArray("3"));
+}
+
+void tst_QDjangoHttpResponseCache::testMethod()
+{
+    m_views->cacheControl = QLatin1String("max-age=60");
+
+    // responses to HEAD requests are not stored, but can be served from the cache
+    QCOMPARE(fetch(QLatin1String("/articles/1/"), QLatin1String("HEAD")), QByteArray("1"));
+    QCOMPARE(fetch(QLatin1String("/articles/1/")), QByteArray("2"));
+    QCOMPARE(fetch(QLatin1String("/articles/1/"), QLatin1String("HEAD")), QByteArray("2"));
+
+    // other methods bypass the cache
+    QCOMPARE(fetch(QLatin1String("/articles/1/"), QLatin1String("POST")), QByteArray("3"));
+    QCOMPARE(fetch(QLatin1String("/articles/1/")), QByteArray("2"));
+}
+
+void tst_QDjangoHttpResponseCache::testNotCacheable_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<QString>("cacheControl");
+
+    QTest::newRow("none") << "/articles/1/" << "";
+    QTest::newRow("no-cache") << "/articles/1/" << "no-cache, max-age=60";
+    QTest::newRow("no-store") << "/articles/1/" << "no-store, max-age=60";
+    QTest::newRow("private") << "/articles/1/" << "private, max-age=60";
+    QTest::newRow("zero") << "/articles/1/" << "max-age=0";
+    QTest::newRow("cookie") << "/cookie/" << "max-age=60";
+}
+
+void tst_QDjangoHttpResponseCache::testNotCacheable()
+{
+    QFETCH(QString, path);
+    QFETCH(QString, cacheControl);
+
+    m_views->cacheControl = cacheControl;
+    QCOMPARE(fetch(path), QByteArray("1"));
+    QCOMPARE(fetch(path), QByteArray("2"));
+    QCOMPARE(m_cache->hits(), qint64(0));
+    QCOMPARE(m_cache->size(), 0);
+}
+
+void tst_QDjangoHttpResponseCache::testVary()
+{
+    m_views->cacheControl = QLatin1String("max-age=60");
+    QCOMPARE(fetch(QLatin1String("/vary/"), QLatin1String("GET"), QLatin1String("en")), QByteArray("en-1"));
+    QCOMPARE(fetch(QLatin1String("/vary/"), QLatin1String("GET"), QLatin1String("fr")), QByteArray("fr-2"));
+    QCOMPARE(fetch(QLatin1String("/vary/"), QLatin1String("GET"), QLatin1String("en")), QByteArray("en-1"));
+    QCOMPARE(fetch(QLatin1String("/vary/"), QLatin1String("GET"), QLatin1String("fr")), QByteArray("fr-2"));
+    QCOMPARE(m_views->calls, 2);
+}
+
+QTEST_MAIN(tst_QDjangoHttpResponseCache)
+#include "tst_qdjangohttpresponsecache.moc"
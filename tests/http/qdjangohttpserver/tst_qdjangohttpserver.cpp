@@ -15,9 +15,12 @@
  * Lesser General Public License for more details.
  */
 
+#include <QLocalServer>
+#include <QLocalSocket>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QTcpSocket>
 #include <QtTest>
 #include <QUrl>
 
@@ -25,8 +28,94 @@
 #include "QDjangoHttpRequest.h"
 #include "QDjangoHttpResponse.h"
 #include "QDjangoHttpServer.h"
+#include "QDjangoHttpStreamResponse.h"
 #include "QDjangoUrlResolver.h"
 
+/** A streaming response which produces its body on demand.
+ */
+class tst_QDjangoHttpCountResponse : public QDjangoHttpStreamResponse
+{
+public:
+    tst_QDjangoHttpCountResponse(int count)
+        : m_count(count)
+        , m_current(0)
+    {
+        setHeader(QLatin1String("Content-Type"), QLatin1String("text/plain"));
+    }
+
+protected:
+    void fetchMore()
+    {
+        if (m_current < m_count)
+            write(QByteArray::number(m_current++) + "\n");
+        else
+            finish();
+    }
+
+private:
+    int m_count;
+    int m_current;
+};
+
+/** A response which reads the body of a streamed request as it
+ *  arrives, and becomes ready once the whole body has been received.
+ */
+class tst_QDjangoHttpBodyResponse : public QDjangoHttpResponse
+{
+    Q_OBJECT
+
+public:
+    tst_QDjangoHttpBodyResponse(QIODevice *device)
+        : m_device(device)
+        , m_ready(false)
+        , m_size(0)
+    {
+        setHeader(QLatin1String("Content-Type"), QLatin1String("text/plain"));
+        connect(device, SIGNAL(readyRead()), this, SLOT(_q_readyRead()));
+        connect(device, SIGNAL(readChannelFinished()), this, SLOT(_q_finished()));
+        if (device->atEnd())
+            _q_finished();
+    }
+
+    bool isReady() const
+    {
+        return m_ready;
+    }
+
+private slots:
+    void _q_finished()
+    {
+        _q_readyRead();
+        setBody("size=" + QByteArray::number(m_size));
+        m_ready = true;
+        emit ready();
+    }
+
+    void _q_readyRead()
+    {
+        m_size += m_device->readAll().size();
+    }
+
+private:
+    QIODevice *m_device;
+    bool m_ready;
+    qint64 m_size;
+};
+
+/** Waits for the \a socket to be disconnected, for at most \a msecs
+ *  milliseconds.
+ */
+static bool waitForDisconnected(QTcpSocket *socket, int msecs)
+{
+    if (socket->state() != QAbstractSocket::UnconnectedState) {
+        QEventLoop loop;
+        QObject::connect(socket, SIGNAL(disconnected()), &loop, SLOT(quit()));
+        QTimer::singleShot(msecs, &loop, SLOT(quit()));
+        loop.exec();
+    }
+    return socket->state() == QAbstractSocket::UnconnectedState;
+}
+
 /** Test QDjangoHttpServer class.
  */
 class tst_QDjangoHttpServer : public QObject
@@ -36,17 +125,42 @@ class tst_QDjangoHttpServer : public QObject
 private slots:
     void cleanupTestCase();
     void initTestCase();
+    void testBackpressure();
     void testCloseConnection();
+    void testCompression_data();
+    void testCompression();
+    void testETag();
     void testGet_data();
     void testGet();
+    void testLimitBody();
+    void testLimitConnections();
+    void testLimitHeader_data();
+    void testLimitHeader();
+    void testLimitTimeout_data();
+    void testLimitTimeout();
+    void testLocal();
     void testPost_data();
     void testPost();
-
+    void testStatic_data();
+    void testStatic();
+    void testStaticRange();
+    void testStream();
+    void testStreamHead();
+    void testStreamedBody();
+    void testUpload();
+
+    QDjangoHttpResponse* _q_body(const QDjangoHttpRequest &request);
     QDjangoHttpResponse* _q_index(const QDjangoHttpRequest &request);
     QDjangoHttpResponse* _q_error(const QDjangoHttpRequest &request);
+    QDjangoHttpResponse* _q_static(const QDjangoHttpRequest &request);
+    QDjangoHttpResponse* _q_stream(const QDjangoHttpRequest &request);
+    QDjangoHttpResponse* _q_upload(const QDjangoHttpRequest &request);
 
 private:
     QDjangoHttpServer *httpServer;
+    int staticCount;
+    QByteArray staticData;
+    QString staticPath;
 };
 
 
@@ -54,13 +168,34 @@ void tst_QDjangoHttpServer::cleanupTestCase()
 {
     httpServer->close();
     delete httpServer;
+    QFile::remove(staticPath);
 }
 
 void tst_QDjangoHttpServer::initTestCase()
 {
+    staticCount = 0;
     httpServer = new QDjangoHttpServer;
     httpServer->urls()->set(QRegExp(QLatin1String("^$")), this, "_q_index");
     httpServer->urls()->set(QRegExp(QLatin1String("^internal-server-error$")), this, "_q_error");
+    httpServer->urls()->set(QRegExp(QLatin1String("^static$")), this, "_q_static");
+    httpServer->urls()->set(QRegExp(QLatin1String("^stream$")), this, "_q_stream");
+    httpServer->urls()->set(QRegExp(QLatin1String("^upload$")), this, "_q_upload");
+
+    // a route which accepts large bodies and reads them as they arrive
+    QDjangoUrlResolver *streamed = new QDjangoUrlResolver(httpServer);
+    streamed->setMaximumBodySize(0);
+    streamed->setStreamingEnabled(true);
+    streamed->set(QRegExp(QLatin1String("^body$")), this, "_q_body");
+    httpServer->urls()->include(QRegExp(QLatin1String("^streamed/")), streamed);
+
+    // create a static file which is too large to be sent in one go
+    for (int i = 0; i < 4 * 1024 * 1024; ++i)
+        staticData.append(char(i % 251));
+    staticPath = QDir::temp().filePath(QLatin1String("tst_qdjangohttpserver.bin"));
+    QFile staticFile(staticPath);
+    QVERIFY(staticFile.open(QIODevice::WriteOnly));
+    QCOMPARE(staticFile.write(staticData), qint64(staticData.size()));
+    staticFile.close();
     QCOMPARE(httpServer->serverAddress(), QHostAddress(QHostAddress::Null));
     QCOMPARE(httpServer->serverPort(), quint16(0));
     QCOMPARE(httpServer->listen(QHostAddress::LocalHost, 8123), true);
@@ -68,6 +203,34 @@ void tst_QDjangoHttpServer::initTestCase()
     QCOMPARE(httpServer->serverPort(), quint16(8123));
 }
 
+void tst_QDjangoHttpServer::testBackpressure()
+{
+    const int requestCount = 5;
+
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, 8123);
+    QVERIFY(socket.waitForConnected());
+
+    // pipeline requests without reading the responses
+    staticCount = 0;
+    for (int i = 0; i < requestCount; ++i)
+        socket.write("GET /static HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n");
+    QTest::qWait(500);
+    QVERIFY(staticCount < requestCount);
+
+    // reading the responses lets the server resume
+    const qint64 expected = requestCount * qint64(staticData.size());
+    qint64 received = 0;
+    QTime timer;
+    timer.start();
+    while (received < expected && timer.elapsed() < 30000) {
+        QTest::qWait(10);
+        received += socket.readAll().size();
+    }
+    QCOMPARE(staticCount, requestCount);
+    QVERIFY(received > expected);
+}
+
 void tst_QDjangoHttpServer::testCloseConnection()
 {
     QNetworkAccessManager network;
@@ -88,6 +251,120 @@ void tst_QDjangoHttpServer::testCloseConnection()
 
 }
 
+void tst_QDjangoHttpServer::testCompression_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<QByteArray>("acceptEncoding");
+    QTest::addColumn<QByteArray>("contentEncoding");
+    QTest::addColumn<QByteArray>("vary");
+
+    QTest::newRow("small") << "/" << QByteArray("deflate") << QByteArray() << QByteArray("Accept-Encoding");
+    QTest::newRow("binary") << "/static" << QByteArray("deflate") << QByteArray() << QByteArray();
+    QTest::newRow("stream-identity") << "/stream" << QByteArray("identity") << QByteArray() << QByteArray("Accept-Encoding");
+    QTest::newRow("stream-deflate") << "/stream" << QByteArray("deflate") << QByteArray("deflate") << QByteArray("Accept-Encoding");
+}
+
+void tst_QDjangoHttpServer::testCompression()
+{
+    QFETCH(QString, path);
+    QFETCH(QByteArray, acceptEncoding);
+    QFETCH(QByteArray, contentEncoding);
+    QFETCH(QByteArray, vary);
+
+    QByteArray expected;
+    if (path == "/") {
+        expected = "method=GET|path=/";
+    } else if (path == "/static") {
+        expected = staticData;
+    } else {
+        for (int i = 0; i < 20000; ++i)
+            expected += QByteArray::number(i) + "\n";
+    }
+
+    httpServer->setCompressionEnabled(true);
+    QCOMPARE(httpServer->isCompressionEnabled(), true);
+
+    QNetworkAccessManager network;
+    QNetworkRequest req(QUrl(QLatin1String("http://127.0.0.1:8123") + path));
+    req.setRawHeader("Accept-Encoding", acceptEncoding);
+    QNetworkReply *reply = network.get(req);
+
+    QEventLoop loop;
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+
+    httpServer->setCompressionEnabled(false);
+
+    QVERIFY(reply);
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QCOMPARE(reply->rawHeader("Content-Encoding"), contentEncoding);
+    QCOMPARE(reply->rawHeader("Vary"), vary);
+    QByteArray body = reply->readAll();
+    if (!contentEncoding.isEmpty()) {
+        QVERIFY(body.size() < expected.size());
+
+        // qUncompress() expects the zlib stream to be preceded by its size
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << quint32(expected.size());
+        body = qUncompress(data + body);
+    }
+    QVERIFY(body == expected);
+    delete reply;
+}
+
+void tst_QDjangoHttpServer::testETag()
+{
+    httpServer->setETagEnabled(true);
+    QCOMPARE(httpServer->isETagEnabled(), true);
+
+    QNetworkAccessManager network;
+    QEventLoop loop;
+
+    // the response is tagged
+    QNetworkRequest req(QUrl(QLatin1String("http://127.0.0.1:8123/")));
+    QNetworkReply *reply = network.get(req);
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    const QByteArray etag = reply->rawHeader("ETag");
+    QVERIFY(etag.startsWith("W/\""));
+    QCOMPARE(reply->readAll(), QByteArray("method=GET|path=/"));
+    delete reply;
+
+    // an unchanged response is not sent again
+    req.setRawHeader("If-None-Match", etag);
+    reply = network.get(req);
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 304);
+    QCOMPARE(reply->rawHeader("ETag"), etag);
+    QCOMPARE(reply->readAll(), QByteArray());
+    delete reply;
+
+    // a different body has a different tag
+    req.setUrl(QUrl(QLatin1String("http://127.0.0.1:8123/?message=bar")));
+    reply = network.get(req);
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QVERIFY(reply->rawHeader("ETag") != etag);
+    QCOMPARE(reply->readAll(), QByteArray("method=GET|path=/|get=bar"));
+    delete reply;
+
+    // errors are not tagged
+    req.setUrl(QUrl(QLatin1String("http://127.0.0.1:8123/internal-server-error")));
+    reply = network.get(req);
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 500);
+    QCOMPARE(reply->rawHeader("ETag"), QByteArray());
+    delete reply;
+
+    httpServer->setETagEnabled(false);
+}
+
 void tst_QDjangoHttpServer::testGet_data()
 {
     QTest::addColumn<QString>("path");
@@ -129,6 +406,152 @@ void tst_QDjangoHttpServer::testGet()
     delete reply;
 }
 
+void tst_QDjangoHttpServer::testLimitBody()
+{
+    QDjangoHttpLimits limits;
+    limits.setMaximumBodySize(1000);
+
+    QDjangoHttpServer server;
+    server.setLimits(limits);
+    QCOMPARE(server.listen(QHostAddress::LocalHost, 8124), true);
+
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, 8124);
+    QVERIFY(socket.waitForConnected());
+
+    QTest::ignoreMessage(QtWarningMsg, "HTTP request body is too large");
+    socket.write("POST / HTTP/1.1\r\nContent-Length: 1001\r\n\r\n");
+    QVERIFY(waitForDisconnected(&socket, 5000));
+    QCOMPARE(server.rejectedConnections(), 1);
+}
+
+void tst_QDjangoHttpServer::testLimitConnections()
+{
+    QDjangoHttpLimits limits;
+    limits.setMaximumConnections(1);
+
+    QDjangoHttpServer server;
+    server.setLimits(limits);
+    QCOMPARE(server.limits().maximumConnections(), 1);
+    QCOMPARE(server.listen(QHostAddress::LocalHost, 8124), true);
+
+    QTcpSocket socket1;
+    socket1.connectToHost(QHostAddress::LocalHost, 8124);
+    QVERIFY(socket1.waitForConnected());
+    QTest::qWait(100);
+
+    // the second connection is closed straight away
+    QTcpSocket socket2;
+    socket2.connectToHost(QHostAddress::LocalHost, 8124);
+    QVERIFY(waitForDisconnected(&socket2, 5000));
+    QCOMPARE(socket1.state(), QAbstractSocket::ConnectedState);
+    QCOMPARE(server.rejectedConnections(), 1);
+
+    // once the first connection is closed, connections are accepted again
+    socket1.disconnectFromHost();
+    QTest::qWait(100);
+
+    QTcpSocket socket3;
+    socket3.connectToHost(QHostAddress::LocalHost, 8124);
+    QVERIFY(socket3.waitForConnected());
+    QVERIFY(!waitForDisconnected(&socket3, 500));
+    QCOMPARE(server.rejectedConnections(), 1);
+}
+
+void tst_QDjangoHttpServer::testLimitHeader_data()
+{
+    QTest::addColumn<int>("maximumCount");
+    QTest::addColumn<int>("maximumSize");
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<QString>("warning");
+
+    QTest::newRow("count") << 2 << 0 << QByteArray("GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\n\r\n") << "HTTP request has too many header fields";
+    QTest::newRow("size") << 0 << 64 << QByteArray("GET / HTTP/1.1\r\nA: ") + QByteArray(64, 'a') + QByteArray("\r\n\r\n") << "HTTP request header is too large";
+    QTest::newRow("size-incomplete") << 0 << 64 << QByteArray("GET / HTTP/1.1\r\nA: ") + QByteArray(64, 'a') << "HTTP request header is too large";
+}
+
+void tst_QDjangoHttpServer::testLimitHeader()
+{
+    QFETCH(int, maximumCount);
+    QFETCH(int, maximumSize);
+    QFETCH(QByteArray, data);
+    QFETCH(QString, warning);
+
+    QDjangoHttpLimits limits;
+    limits.setMaximumHeaderCount(maximumCount);
+    limits.setMaximumHeaderSize(maximumSize);
+
+    QDjangoHttpServer server;
+    server.setLimits(limits);
+    QCOMPARE(server.listen(QHostAddress::LocalHost, 8124), true);
+
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, 8124);
+    QVERIFY(socket.waitForConnected());
+
+    QTest::ignoreMessage(QtWarningMsg, warning.toLatin1());
+    socket.write(data);
+    QVERIFY(waitForDisconnected(&socket, 5000));
+    QCOMPARE(server.rejectedConnections(), 1);
+}
+
+void tst_QDjangoHttpServer::testLimitTimeout_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<int>("rejected");
+
+    QTest::newRow("idle") << QByteArray() << 0;
+    QTest::newRow("header") << QByteArray("GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n") << 1;
+    QTest::newRow("body") << QByteArray("POST / HTTP/1.1\r\nContent-Length: 10\r\n\r\nabc") << 1;
+}
+
+void tst_QDjangoHttpServer::testLimitTimeout()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(int, rejected);
+
+    QDjangoHttpLimits limits;
+    limits.setBodyTimeout(500);
+    limits.setHeaderTimeout(500);
+    limits.setIdleTimeout(500);
+
+    QDjangoHttpServer server;
+    server.setLimits(limits);
+    QCOMPARE(server.listen(QHostAddress::LocalHost, 8124), true);
+
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, 8124);
+    QVERIFY(socket.waitForConnected());
+    if (!data.isEmpty())
+        socket.write(data);
+
+    QVERIFY(waitForDisconnected(&socket, 5000));
+    QCOMPARE(server.rejectedConnections(), rejected);
+}
+
+void tst_QDjangoHttpServer::testLocal()
+{
+    const QString name("/tmp/qdjangohttp.socket");
+    QLocalServer::removeServer(name);
+    QCOMPARE(httpServer->listen(name), true);
+
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    QVERIFY(socket.waitForConnected());
+    socket.write("GET /?message=bar HTTP/1.0\r\n\r\n");
+
+    // the connection is closed once the response is sent
+    QEventLoop loop;
+    QObject::connect(&socket, SIGNAL(disconnected()), &loop, SLOT(quit()));
+    QTimer::singleShot(5000, &loop, SLOT(quit()));
+    loop.exec();
+    QCOMPARE(socket.state(), QLocalSocket::UnconnectedState);
+
+    const QByteArray data = socket.readAll();
+    QVERIFY(data.startsWith("HTTP/1.1 200 OK\r\n"));
+    QVERIFY(data.endsWith("\r\n\r\nmethod=GET|path=/|get=bar"));
+}
+
 void tst_QDjangoHttpServer::testPost_data()
 {
     QTest::addColumn<QString>("path");
@@ -163,6 +586,163 @@ void tst_QDjangoHttpServer::testPost()
     delete reply;
 }
 
+void tst_QDjangoHttpServer::testStatic_data()
+{
+    QTest::addColumn<QByteArray>("method");
+
+    QTest::newRow("get") << QByteArray("GET");
+    QTest::newRow("head") << QByteArray("HEAD");
+}
+
+void tst_QDjangoHttpServer::testStatic()
+{
+    QFETCH(QByteArray, method);
+
+    QNetworkAccessManager network;
+    QNetworkRequest req(QUrl(QLatin1String("http://127.0.0.1:8123/static")));
+    QNetworkReply *reply = (method == "HEAD") ? network.head(req) : network.get(req);
+
+    QEventLoop loop;
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+
+    QVERIFY(reply);
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QCOMPARE(reply->rawHeader("Content-Length"), QByteArray::number(staticData.size()));
+    if (method == "HEAD")
+        QCOMPARE(reply->readAll(), QByteArray());
+    else
+        QVERIFY(reply->readAll() == staticData);
+    delete reply;
+}
+
+void tst_QDjangoHttpServer::testStaticRange()
+{
+    QNetworkAccessManager network;
+    QNetworkRequest req(QUrl(QLatin1String("http://127.0.0.1:8123/static")));
+    req.setRawHeader("Range", "bytes=1000000-2999999");
+    QNetworkReply *reply = network.get(req);
+
+    QEventLoop loop;
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+
+    QVERIFY(reply);
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 206);
+    QCOMPARE(reply->rawHeader("Content-Length"), QByteArray("2000000"));
+    QCOMPARE(reply->rawHeader("Content-Range"), QByteArray("bytes 1000000-2999999/") + QByteArray::number(staticData.size()));
+    QVERIFY(reply->readAll() == staticData.mid(1000000, 2000000));
+    delete reply;
+}
+
+void tst_QDjangoHttpServer::testStream()
+{
+    QByteArray expected;
+    for (int i = 0; i < 20000; ++i)
+        expected += QByteArray::number(i) + "\n";
+
+    QNetworkAccessManager network;
+    QNetworkReply *reply = network.get(QNetworkRequest(QUrl(QLatin1String("http://127.0.0.1:8123/stream"))));
+
+    QEventLoop loop;
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+
+    QVERIFY(reply);
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QCOMPARE(reply->rawHeader("Transfer-Encoding"), QByteArray("chunked"));
+    QCOMPARE(reply->readAll(), expected);
+    delete reply;
+}
+void tst_QDjangoHttpServer::testStreamHead()
+{
+    // the stream is neither read nor compressed, but must not be destroyed
+    httpServer->setCompressionEnabled(true);
+
+    QNetworkAccessManager network;
+    QNetworkRequest req(QUrl(QLatin1String("http://127.0.0.1:8123/stream")));
+    req.setRawHeader("Accept-Encoding", "deflate");
+    QNetworkReply *reply = network.head(req);
+
+    QEventLoop loop;
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+
+    QVERIFY(reply);
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QCOMPARE(reply->rawHeader("Content-Encoding"), QByteArray());
+    QCOMPARE(reply->readAll(), QByteArray());
+    delete reply;
+
+    // the connection is still usable
+    reply = network.get(QNetworkRequest(QUrl(QLatin1String("http://127.0.0.1:8123/"))));
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+
+    httpServer->setCompressionEnabled(false);
+
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QCOMPARE(reply->readAll(), QByteArray("method=GET|path=/"));
+    delete reply;
+}
+
+void tst_QDjangoHttpServer::testStreamedBody()
+{
+    // the body exceeds the server's limit, but not the route's
+    const QByteArray data(12 * 1024 * 1024, 'x');
+
+    QNetworkAccessManager network;
+    QNetworkRequest req(QUrl(QLatin1String("http://127.0.0.1:8123/streamed/body")));
+    req.setRawHeader("Content-Type", "application/octet-stream");
+    QNetworkReply *reply = network.post(req, data);
+
+    QEventLoop loop;
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+
+    QCOMPARE(int(reply->error()), int(QNetworkReply::NoError));
+    QCOMPARE(reply->readAll(), QByteArray("size=") + QByteArray::number(data.size()));
+    delete reply;
+}
+
+void tst_QDjangoHttpServer::testUpload()
+{
+    // the file is large enough for the body to be spooled to disk
+    QByteArray contents;
+    for (int i = 0; i < 2 * 1024 * 1024; ++i)
+        contents.append(char(i % 251));
+
+    const QByteArray data = QByteArray(
+        "--frontier\r\n"
+        "Content-Disposition: form-data; name=\"message\"\r\n"
+        "\r\n"
+        "bar\r\n"
+        "--frontier\r\n"
+        "Content-Disposition: form-data; name=\"upload\"; filename=\"foo.bin\"\r\n"
+        "Content-Type: application/octet-stream\r\n"
+        "\r\n") + contents + QByteArray("\r\n"
+        "--frontier--\r\n");
+
+    QNetworkAccessManager network;
+    QNetworkRequest req(QUrl(QLatin1String("http://127.0.0.1:8123/upload")));
+    req.setRawHeader("Content-Type", "multipart/form-data; boundary=frontier");
+    QNetworkReply *reply = network.post(req, data);
+
+    QEventLoop loop;
+    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+
+    QCOMPARE(int(reply->error()), int(QNetworkReply::NoError));
+    QCOMPARE(reply->readAll(), QByteArray("message=bar|file=foo.bin|match=1"));
+    delete reply;
+}
+
+QDjangoHttpResponse *tst_QDjangoHttpServer::_q_body(const QDjangoHttpRequest &request)
+{
+    return new tst_QDjangoHttpBodyResponse(request.bodyDevice());
+}
+
 QDjangoHttpResponse *tst_QDjangoHttpServer::_q_index(const QDjangoHttpRequest &request)
 {
     QDjangoHttpResponse *response = new QDjangoHttpResponse;
@@ -190,5 +770,36 @@ QDjangoHttpResponse *tst_QDjangoHttpServer::_q_error(const QDjangoHttpRequest &r
     return QDjangoHttpController::serveInternalServerError(request);
 }
 
+QDjangoHttpResponse *tst_QDjangoHttpServer::_q_static(const QDjangoHttpRequest &request)
+{
+    staticCount++;
+    return QDjangoHttpController::serveStatic(request, staticPath);
+}
+
+QDjangoHttpResponse *tst_QDjangoHttpServer::_q_stream(const QDjangoHttpRequest &request)
+{
+    Q_UNUSED(request);
+
+    return new tst_QDjangoHttpCountResponse(20000);
+}
+
+QDjangoHttpResponse *tst_QDjangoHttpServer::_q_upload(const QDjangoHttpRequest &request)
+{
+    QDjangoHttpResponse *response = new QDjangoHttpResponse;
+    response->setHeader(QLatin1String("Content-Type"), QLatin1String("text/plain"));
+
+    QByteArray contents;
+    for (int i = 0; i < 2 * 1024 * 1024; ++i)
+        contents.append(char(i % 251));
+
+    QIODevice *file = request.file(QLatin1String("upload"));
+    QString output = QLatin1String("message=") + request.post(QLatin1String("message"));
+    output += QLatin1String("|file=") + request.fileName(QLatin1String("upload"));
+    output += QLatin1String("|match=") + QString::number(file && file->readAll() == contents);
+
+    response->setBody(output.toUtf8());
+    return response;
+}
+
 QTEST_MAIN(tst_QDjangoHttpServer)
 #include "tst_qdjangohttpserver.moc"
@@ -0,0 +1,4 @@
+include(../http.pri)
+
+TARGET = tst_qdjangohttpstaticcache
+SOURCES += tst_qdjangohttpstaticcache.cpp
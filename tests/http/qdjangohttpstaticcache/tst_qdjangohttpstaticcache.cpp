@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <QDir>
+#include <QtTest>
+
+#include "QDjangoHttpController.h"
+#include "QDjangoHttpRequest.h"
+#include "QDjangoHttpRequest_p.h"
+#include "QDjangoHttpResponse.h"
+#include "QDjangoHttpStaticCache.h"
+
+/** Test QDjangoHttpStaticCache class.
+ */
+class tst_QDjangoHttpStaticCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void testCompression();
+    void testETag();
+    void testEviction();
+    void testHitsAndMisses();
+    void testModified();
+    void testRange();
+    void testTooLarge();
+
+private:
+    QString writeFile(const QString &name, const QByteArray &data);
+
+    QString m_dirPath;
+    QStringList m_files;
+};
+
+void tst_QDjangoHttpStaticCache::init()
+{
+    m_dirPath = QDir::tempPath();
+}
+
+void tst_QDjangoHttpStaticCache::cleanup()
+{
+    foreach (const QString &path, m_files)
+        QFile::remove(path);
+    m_files.clear();
+}
+
+QString tst_QDjangoHttpStaticCache::writeFile(const QString &name, const QByteArray &data)
+{
+    const QString path = m_dirPath + QLatin1String("/tst_qdjangohttpstaticcache_") + name;
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return QString();
+    file.write(data);
+    file.close();
+    if (!m_files.contains(path))
+        m_files << path;
+    return path;
+}
+
+void tst_QDjangoHttpStaticCache::testCompression()
+{
+    const QByteArray data = QByteArray("body { color: red; }\n").repeated(100);
+    const QString path = writeFile("style.css", data);
+    QVERIFY(!path.isEmpty());
+
+    QDjangoHttpStaticCache cache;
+    QDjangoHttpRequest request;
+    QDjangoHttpResponse *response;
+    request.d->method = "GET";
+
+    // no accept-encoding
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 200);
+    QCOMPARE(response->header("content-type"), QString("text/css"));
+    QCOMPARE(response->header("content-encoding"), QString());
+    QCOMPARE(response->header("vary"), QString("Accept-Encoding"));
+    QCOMPARE(response->body(), data);
+    const QString identityETag = response->header("etag");
+    delete response;
+
+    // gzip
+    request.d->meta.insert("HTTP_ACCEPT_ENCODING", "gzip, deflate");
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 200);
+    QCOMPARE(response->header("content-encoding"), QString("gzip"));
+    QVERIFY(response->body().size() < data.size());
+    QVERIFY(response->body().startsWith("\x1f\x8b"));
+    QVERIFY(response->header("etag") != identityETag);
+    delete response;
+
+    // deflate
+    request.d->meta.insert("HTTP_ACCEPT_ENCODING", "deflate");
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 200);
+    QCOMPARE(response->header("content-encoding"), QString("deflate"));
+    QVERIFY(response->body().size() < data.size());
+    delete response;
+
+    // gzip refused
+    request.d->meta.insert("HTTP_ACCEPT_ENCODING", "gzip;q=0");
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 200);
+    QCOMPARE(response->header("content-encoding"), QString());
+    QCOMPARE(response->body(), data);
+    delete response;
+
+    // binary files are not compressed
+    const QString binPath = writeFile("data.bin", QByteArray(4096, '\0'));
+    request.d->meta.insert("HTTP_ACCEPT_ENCODING", "gzip");
+    response = cache.serveStatic(request, binPath);
+    QCOMPARE(response->statusCode(), 200);
+    QCOMPARE(response->header("content-type"), QString("application/octet-stream"));
+    QCOMPARE(response->header("content-encoding"), QString());
+    QCOMPARE(response->header("vary"), QString());
+    QCOMPARE(response->body().size(), 4096);
+    delete response;
+}
+
+void tst_QDjangoHttpStaticCache::testETag()
+{
+    const QString path = writeFile("page.html", "<html><body>hello</body></html>");
+    QVERIFY(!path.isEmpty());
+
+    QDjangoHttpStaticCache cache;
+    QDjangoHttpRequest request;
+    QDjangoHttpResponse *response;
+    request.d->method = "GET";
+
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 200);
+    const QString etag = response->header("etag");
+    QVERIFY(etag.startsWith('"'));
+    QVERIFY(!response->header("last-modified").isEmpty());
+    delete response;
+
+    // matching etag
+    request.d->meta.insert("HTTP_IF_NONE_MATCH", "\"foo\", " + etag);
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 304);
+    QCOMPARE(response->header("etag"), etag);
+    QCOMPARE(response->body(), QByteArray());
+    delete response;
+
+    // weak comparison
+    request.d->meta.insert("HTTP_IF_NONE_MATCH", "W/" + etag);
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 304);
+    delete response;
+
+    // wildcard
+    request.d->meta.insert("HTTP_IF_NONE_MATCH", "*");
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 304);
+    delete response;
+
+    // other etag, if-modified-since is ignored
+    request.d->meta.insert("HTTP_IF_NONE_MATCH", "\"foo\"");
+    request.d->meta.insert("HTTP_IF_MODIFIED_SINCE", "Tue, 14 Jul 2054 11:22:33 GMT");
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 200);
+    delete response;
+
+    // if-modified-since
+    request.d->meta.remove("HTTP_IF_NONE_MATCH");
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 304);
+    delete response;
+}
+
+void tst_QDjangoHttpStaticCache::testEviction()
+{
+    const QString path1 = writeFile("file1.bin", QByteArray(600, 'a'));
+    const QString path2 = writeFile("file2.bin", QByteArray(600, 'b'));
+
+    QDjangoHttpStaticCache cache;
+    cache.setMaximumSize(1000);
+    QCOMPARE(cache.maximumSize(), 1000);
+
+    QDjangoHttpRequest request;
+    request.d->method = "GET";
+
+    delete cache.serveStatic(request, path1);
+    QCOMPARE(cache.size(), 600);
+    delete cache.serveStatic(request, path2);
+    QCOMPARE(cache.size(), 600);
+    QCOMPARE(cache.misses(), qint64(2));
+
+    // file1 was evicted
+    delete cache.serveStatic(request, path1);
+    QCOMPARE(cache.misses(), qint64(3));
+    QCOMPARE(cache.hits(), qint64(0));
+
+    cache.clear();
+    QCOMPARE(cache.size(), 0);
+}
+
+void tst_QDjangoHttpStaticCache::testHitsAndMisses()
+{
+    QDjangoHttpStaticCache cache;
+    QDjangoHttpRequest request;
+    QDjangoHttpResponse *response;
+    request.d->method = "GET";
+
+    const QString path = writeFile("hits.js", "var a = 1;\n");
+    for (int i = 0; i < 3; ++i) {
+        response = cache.serveStatic(request, path);
+        QCOMPARE(response->statusCode(), 200);
+        QCOMPARE(response->header("content-type"), QString("application/javascript"));
+        QCOMPARE(response->body(), QByteArray("var a = 1;\n"));
+        delete response;
+    }
+    QCOMPARE(cache.misses(), qint64(1));
+    QCOMPARE(cache.hits(), qint64(2));
+    QCOMPARE(cache.size(), 11);
+
+    // missing files are not cached
+    response = cache.serveStatic(request, m_dirPath + "/tst_qdjangohttpstaticcache_missing");
+    QCOMPARE(response->statusCode(), 404);
+    delete response;
+    QCOMPARE(cache.misses(), qint64(2));
+    QCOMPARE(cache.size(), 11);
+}
+
+void tst_QDjangoHttpStaticCache::testModified()
+{
+    QDjangoHttpStaticCache cache;
+    QDjangoHttpRequest request;
+    QDjangoHttpResponse *response;
+    request.d->method = "GET";
+
+    const QString path = writeFile("modified.txt", "first version");
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->body(), QByteArray("first version"));
+    delete response;
+
+    // let the file watcher pick up the file, then modify it
+    QTest::qWait(100);
+    writeFile("modified.txt", "second version");
+    QTRY_COMPARE(cache.size(), 0);
+
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->body(), QByteArray("second version"));
+    delete response;
+}
+
+void tst_QDjangoHttpStaticCache::testRange()
+{
+    const QByteArray data = QByteArray("body { color: red; }\n").repeated(100);
+    const QString path = writeFile("range.css", data);
+
+    QDjangoHttpStaticCache cache;
+    QDjangoHttpRequest request;
+    QDjangoHttpResponse *response;
+    request.d->method = "GET";
+    request.d->meta.insert("HTTP_ACCEPT_ENCODING", "gzip");
+
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->header("content-encoding"), QString("gzip"));
+    const QString gzipETag = response->header("etag");
+    delete response;
+
+    // ranges apply to the uncompressed file
+    request.d->meta.insert("HTTP_RANGE", "bytes=0-3");
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 206);
+    QCOMPARE(response->header("content-encoding"), QString());
+    QCOMPARE(response->header("content-range"), QString("bytes 0-3/2100"));
+    QCOMPARE(response->body(), QByteArray("body"));
+    const QString etag = response->header("etag");
+    QVERIFY(etag != gzipETag);
+    delete response;
+
+    // if-range
+    request.d->meta.insert("HTTP_IF_RANGE", etag);
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 206);
+    delete response;
+
+    request.d->meta.insert("HTTP_IF_RANGE", gzipETag);
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 200);
+    QCOMPARE(response->header("content-encoding"), QString("gzip"));
+    delete response;
+    request.d->meta.remove("HTTP_IF_RANGE");
+
+    // multiple ranges
+    request.d->meta.insert("HTTP_RANGE", "bytes=0-3,-2");
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 206);
+    QVERIFY(response->header("content-type").startsWith("multipart/byteranges; boundary="));
+    QVERIFY(response->body().contains("Content-Range: bytes 0-3/2100\r\n\r\nbody\r\n"));
+    QVERIFY(response->body().contains("Content-Range: bytes 2098-2099/2100\r\n\r\n}\n\r\n"));
+    delete response;
+
+    // unsatisfiable
+    request.d->meta.insert("HTTP_RANGE", "bytes=3000-");
+    response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 416);
+    QCOMPARE(response->header("content-range"), QString("bytes */2100"));
+    delete response;
+}
+
+void tst_QDjangoHttpStaticCache::testTooLarge()
+{
+    QDjangoHttpStaticCache cache;
+    cache.setMaximumFileSize(100);
+    QCOMPARE(cache.maximumFileSize(), 100);
+
+    const QString path = writeFile("large.txt", QByteArray(200, 'x'));
+    QDjangoHttpRequest request;
+    request.d->method = "GET";
+
+    QDjangoHttpResponse *response = cache.serveStatic(request, path);
+    QCOMPARE(response->statusCode(), 200);
+    QCOMPARE(response->header("content-length"), QString("200"));
+    QCOMPARE(response->header("etag"), QString());
+    QCOMPARE(response->body().size(), 200);
+    delete response;
+    QCOMPARE(cache.size(), 0);
+}
+
+QTEST_MAIN(tst_QDjangoHttpStaticCache)
+#include "tst_qdjangohttpstaticcache.moc"
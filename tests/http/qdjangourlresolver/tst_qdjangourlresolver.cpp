@@ -18,12 +18,17 @@
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
 #include <QtTest>
 #include <QUrl>
 
 #include "QDjangoHttpController.h"
 #include "QDjangoHttpRequest.h"
+#include "QDjangoHttpRequest_p.h"
 #include "QDjangoHttpResponse.h"
+#include "QDjangoHttpStreamResponse.h"
 #include "QDjangoUrlResolver.h"
 
 class tst_QDjangoUrlHelper : public QObject
@@ -31,10 +36,153 @@ class tst_QDjangoUrlHelper : public QObject
     Q_OBJECT
 
 private slots:
+    QDjangoHttpResponse* _q_badArgument(const QDjangoHttpRequest &request, int id);
+    void _q_badReturn(const QDjangoHttpRequest &request);
     QDjangoHttpResponse* _q_index(const QDjangoHttpRequest &request);
+    QDjangoHttpResponse* _q_named(const QDjangoHttpRequest &request, const QString &name);
     QDjangoHttpResponse* _q_test(const QDjangoHttpRequest &request);
 };
 
+/** A view which responds with its object name.
+ */
+class tst_QDjangoUrlNamed : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_QDjangoUrlNamed(const char *name, QObject *parent)
+        : QObject(parent)
+    {
+        setObjectName(QLatin1String(name));
+    }
+
+private slots:
+    QDjangoHttpResponse* _q_respond(const QDjangoHttpRequest &request)
+    {
+        Q_UNUSED(request);
+
+        QDjangoHttpResponse *response = new QDjangoHttpResponse;
+        response->setBody(objectName().toLatin1());
+        return response;
+    }
+};
+
+/** A view which blocks until it is told to proceed, then responds
+ *  with the kind of thread it ran on.
+ */
+class tst_QDjangoUrlBlocking : public QObject
+{
+    Q_OBJECT
+
+public:
+    QSemaphore proceed;
+    QSemaphore started;
+
+private slots:
+    QDjangoHttpResponse* _q_respond(const QDjangoHttpRequest &request)
+    {
+        Q_UNUSED(request);
+
+        started.release();
+        proceed.acquire();
+        QDjangoHttpResponse *response = new QDjangoHttpResponse;
+        response->setBody(QThread::currentThread() == qApp->thread() ? "inline" : "pool");
+        return response;
+    }
+};
+
+/** A streaming response which produces its body on demand.
+ */
+class tst_QDjangoUrlCountResponse : public QDjangoHttpStreamResponse
+{
+public:
+    tst_QDjangoUrlCountResponse(int count)
+        : m_count(count)
+        , m_current(0)
+    {
+    }
+
+protected:
+    void fetchMore()
+    {
+        if (m_current < m_count)
+            write(QByteArray::number(m_current++) + "\n");
+        else
+            finish();
+    }
+
+private:
+    int m_count;
+    int m_current;
+};
+
+/** A view which echoes the body of the request, or streams its
+ *  response.
+ */
+class tst_QDjangoUrlEcho : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    QDjangoHttpResponse* _q_echo(const QDjangoHttpRequest &request)
+    {
+        QDjangoHttpResponse *response = new QDjangoHttpResponse;
+        response->setBody(request.post(QLatin1String("message")).toUtf8() + "|" + request.body());
+        return response;
+    }
+
+    QDjangoHttpResponse* _q_stream(const QDjangoHttpRequest &request)
+    {
+        Q_UNUSED(request);
+
+        return new tst_QDjangoUrlCountResponse(100);
+    }
+};
+
+/** Waits for the \a response to be ready, for at most 5 seconds.
+ */
+static bool waitForReady(QDjangoHttpResponse *response)
+{
+    if (!response->isReady()) {
+        QEventLoop loop;
+        QObject::connect(response, SIGNAL(ready()), &loop, SLOT(quit()));
+        QTimer::singleShot(5000, &loop, SLOT(quit()));
+        loop.exec();
+    }
+    return response->isReady();
+}
+
+/** A thread which dispatches requests through a resolver.
+ */
+class tst_QDjangoUrlThread : public QThread
+{
+public:
+    tst_QDjangoUrlThread(QDjangoUrlResolver *urls)
+        : errors(0)
+        , m_urls(urls)
+    {
+    }
+
+    int errors;
+
+protected:
+    void run()
+    {
+        for (int i = 0; i < 1000; ++i) {
+            const QString name = QString::number(i % 50);
+            const QString path = QLatin1String("/route") + name + QLatin1String("/") + name;
+            QDjangoHttpTestRequest request(QLatin1String("GET"), path);
+            QDjangoHttpResponse *response = m_urls->respond(request, path);
+            if (response->statusCode() != 200 || response->body() != name.toLatin1())
+                errors++;
+            delete response;
+        }
+    }
+
+private:
+    QDjangoUrlResolver *m_urls;
+};
+
 class tst_QDjangoUrlResolver : public QObject
 {
     Q_OBJECT
@@ -44,8 +192,17 @@ private slots:
     void initTestCase();
     void testRespond_data();
     void testRespond();
+    void testRespondConcurrent();
+    void testRespondOrder_data();
+    void testRespondOrder();
     void testReverse_data();
     void testReverse();
+    void testReverseUpdated();
+    void testSet();
+    void testThreadPool();
+    void testThreadPoolBody();
+    void testThreadPoolQueue();
+    void testThreadPoolStream();
 
     QDjangoHttpResponse* _q_index(const QDjangoHttpRequest &request);
     QDjangoHttpResponse* _q_noArgs(const QDjangoHttpRequest &request);
@@ -58,6 +215,19 @@ private:
     QDjangoUrlResolver *urlSub;
 };
 
+QDjangoHttpResponse* tst_QDjangoUrlHelper::_q_badArgument(const QDjangoHttpRequest &request, int id)
+{
+    Q_UNUSED(request);
+    Q_UNUSED(id);
+
+    return 0;
+}
+
+void tst_QDjangoUrlHelper::_q_badReturn(const QDjangoHttpRequest &request)
+{
+    Q_UNUSED(request);
+}
+
 QDjangoHttpResponse* tst_QDjangoUrlHelper::_q_index(const QDjangoHttpRequest &request)
 {
     Q_UNUSED(request);
@@ -68,6 +238,16 @@ QDjangoHttpResponse* tst_QDjangoUrlHelper::_q_index(const QDjangoHttpRequest &re
     return response;
 }
 
+QDjangoHttpResponse* tst_QDjangoUrlHelper::_q_named(const QDjangoHttpRequest &request, const QString &name)
+{
+    Q_UNUSED(request);
+
+    QDjangoHttpResponse *response = new QDjangoHttpResponse;
+    response->setHeader(QLatin1String("Content-Type"), QLatin1String("text/plain"));
+    response->setBody(name.toUtf8());
+    return response;
+}
+
 QDjangoHttpResponse* tst_QDjangoUrlHelper::_q_test(const QDjangoHttpRequest &request)
 {
     Q_UNUSED(request);
@@ -127,6 +307,74 @@ void tst_QDjangoUrlResolver::testRespond()
     QCOMPARE(int(response->statusCode()), err);
 }
 
+void tst_QDjangoUrlResolver::testRespondConcurrent()
+{
+    QDjangoUrlResolver urls;
+    for (int i = 0; i < 50; ++i) {
+        const QString name = QString::number(i);
+        QVERIFY(urls.set(QRegExp(QLatin1String("^route") + name + QLatin1String("/(") + name + QLatin1String(")$")), urlHelper, "_q_named"));
+    }
+
+    QList<tst_QDjangoUrlThread*> threads;
+    for (int i = 0; i < 4; ++i)
+        threads << new tst_QDjangoUrlThread(&urls);
+    foreach (tst_QDjangoUrlThread *thread, threads)
+        thread->start();
+    foreach (tst_QDjangoUrlThread *thread, threads) {
+        QVERIFY(thread->wait());
+        QCOMPARE(thread->errors, 0);
+    }
+    qDeleteAll(threads);
+}
+
+void tst_QDjangoUrlResolver::testRespondOrder_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<QString>("body");
+
+    QTest::newRow("early") << "/early" << "early";
+    QTest::newRow("literal") << "/foo/" << "literal";
+    QTest::newRow("plus") << "/fooo/" << "plus";
+    QTest::newRow("optional") << "/ac" << "optional";
+    QTest::newRow("optional-present") << "/abc" << "optional";
+    QTest::newRow("alternative") << "/bar" << "alternative";
+    QTest::newRow("escaped") << "/a.b" << "escaped";
+    QTest::newRow("digit") << "/d5" << "digit";
+    QTest::newRow("class") << "/yz" << "class";
+    QTest::newRow("recurse") << "/sub/x" << "sub";
+    QTest::newRow("fallback") << "/zzz" << "fallback";
+}
+
+void tst_QDjangoUrlResolver::testRespondOrder()
+{
+    QFETCH(QString, path);
+    QFETCH(QString, body);
+
+    QObject parent;
+    QDjangoUrlResolver sub;
+    QVERIFY(sub.set(QRegExp(QLatin1String("^x$")), new tst_QDjangoUrlNamed("sub", &parent), "_q_respond"));
+
+    // the first registered route which matches wins
+    QDjangoUrlResolver urls;
+    QVERIFY(urls.set(QRegExp(QLatin1String("^(early)$")), new tst_QDjangoUrlNamed("early", &parent), "_q_respond"));
+    QVERIFY(urls.set(QRegExp(QLatin1String("^foo/$")), new tst_QDjangoUrlNamed("literal", &parent), "_q_respond"));
+    QVERIFY(urls.set(QRegExp(QLatin1String("^fo+/$")), new tst_QDjangoUrlNamed("plus", &parent), "_q_respond"));
+    QVERIFY(urls.set(QRegExp(QLatin1String("^ab?c$")), new tst_QDjangoUrlNamed("optional", &parent), "_q_respond"));
+    QVERIFY(urls.set(QRegExp(QLatin1String("^foo|bar$")), new tst_QDjangoUrlNamed("alternative", &parent), "_q_respond"));
+    QVERIFY(urls.set(QRegExp(QLatin1String("^a\\.b$")), new tst_QDjangoUrlNamed("escaped", &parent), "_q_respond"));
+    QVERIFY(urls.set(QRegExp(QLatin1String("^d\\d$")), new tst_QDjangoUrlNamed("digit", &parent), "_q_respond"));
+    QVERIFY(urls.set(QRegExp(QLatin1String("^[xy]z$")), new tst_QDjangoUrlNamed("class", &parent), "_q_respond"));
+    QVERIFY(urls.set(QRegExp(QLatin1String("^early$")), new tst_QDjangoUrlNamed("late", &parent), "_q_respond"));
+    QVERIFY(urls.include(QRegExp(QLatin1String("^sub/")), &sub));
+    QVERIFY(urls.set(QRegExp(QLatin1String("^.*$")), new tst_QDjangoUrlNamed("fallback", &parent), "_q_respond"));
+
+    QDjangoHttpTestRequest request(QLatin1String("GET"), path);
+    QDjangoHttpResponse *response = urls.respond(request, path);
+    QCOMPARE(response->statusCode(), 200);
+    QCOMPARE(response->body(), body.toLatin1());
+    delete response;
+}
+
 void tst_QDjangoUrlResolver::testReverse_data()
 {
     QTest::addColumn<QString>("path");
@@ -166,6 +414,169 @@ void tst_QDjangoUrlResolver::testReverse()
     QCOMPARE(urlResolver->reverse(receiver, member.toLatin1(), varArgs), path);
 }
 
+void tst_QDjangoUrlResolver::testReverseUpdated()
+{
+    QDjangoUrlResolver sub;
+    QDjangoUrlResolver urls;
+    QVERIFY(urls.include(QRegExp(QLatin1String("^sub/")), &sub));
+    QCOMPARE(urls.reverse(urlHelper, "_q_named", QVariantList() << "foo"), QString());
+
+    // routes added to an included resolver are picked up
+    QVERIFY(sub.set(QRegExp(QLatin1String("^item/([0-9]+)/$")), urlHelper, "_q_named"));
+    QCOMPARE(urls.reverse(urlHelper, "_q_named", QVariantList() << 123), QString("/sub/item/123/"));
+
+    // the first route registered wins
+    QVERIFY(urls.set(QRegExp(QLatin1String("^other/([0-9]+)$")), urlHelper, "_q_named"));
+    QCOMPARE(urls.reverse(urlHelper, "_q_named", QVariantList() << 123), QString("/sub/item/123/"));
+    QCOMPARE(sub.reverse(urlHelper, "_q_named", QVariantList() << 456), QString("/item/456/"));
+}
+
+void tst_QDjangoUrlResolver::testSet()
+{
+    QDjangoUrlResolver urls;
+
+    QTest::ignoreMessage(QtWarningMsg, "Could not find '_q_missing' in receiver");
+    QCOMPARE(urls.set(QRegExp(QLatin1String("^$")), urlHelper, "_q_missing"), false);
+
+    QTest::ignoreMessage(QtWarningMsg, "Arguments of '_q_badArgument' following the request should be QStrings");
+    QCOMPARE(urls.set(QRegExp(QLatin1String("^([0-9]+)$")), urlHelper, "_q_badArgument"), false);
+
+    QTest::ignoreMessage(QtWarningMsg, "'_q_badReturn' should return a QDjangoHttpResponse*");
+    QCOMPARE(urls.set(QRegExp(QLatin1String("^$")), urlHelper, "_q_badReturn"), false);
+
+    // the number of captures must match the number of arguments
+    QCOMPARE(urls.set(QRegExp(QLatin1String("^([a-z]+)/([0-9]+)$")), urlHelper, "_q_named"), true);
+    QDjangoHttpTestRequest request(QLatin1String("GET"), QLatin1String("/foo/123"));
+    QTest::ignoreMessage(QtWarningMsg, "Wrong number of arguments for '_q_named'");
+    QDjangoHttpResponse *response = urls.respond(request, request.path());
+    QCOMPARE(response->statusCode(), 500);
+    delete response;
+}
+
+void tst_QDjangoUrlResolver::testThreadPool()
+{
+    QThreadPool pool;
+    tst_QDjangoUrlBlocking view;
+    QDjangoUrlResolver urls;
+    QDjangoUrlResolver *reports = new QDjangoUrlResolver(&urls);
+    QCOMPARE(reports->threadPool(), (QThreadPool*)0);
+    reports->setThreadPool(&pool);
+    QCOMPARE(reports->threadPool(), &pool);
+    QVERIFY(reports->set(QRegExp(QLatin1String("^slow$")), &view, "_q_respond"));
+    QVERIFY(urls.set(QRegExp(QLatin1String("^fast$")), &view, "_q_respond"));
+    QVERIFY(urls.include(QRegExp(QLatin1String("^reports/")), reports));
+
+    // light routes run inline
+    view.proceed.release();
+    QDjangoHttpTestRequest fastRequest(QLatin1String("GET"), QLatin1String("/fast"));
+    QDjangoHttpResponse *response = urls.respond(fastRequest, fastRequest.path());
+    QVERIFY(response->isReady());
+    QCOMPARE(response->body(), QByteArray("inline"));
+    delete response;
+
+    // routes of the included resolver run on the pool
+    view.proceed.release();
+    QDjangoHttpTestRequest slowRequest(QLatin1String("GET"), QLatin1String("/reports/slow"));
+    response = urls.respond(slowRequest, slowRequest.path());
+    QVERIFY(waitForReady(response));
+    QCOMPARE(response->statusCode(), 200);
+    QCOMPARE(response->body(), QByteArray("pool"));
+    delete response;
+
+    pool.waitForDone();
+}
+
+void tst_QDjangoUrlResolver::testThreadPoolBody()
+{
+    QThreadPool pool;
+    tst_QDjangoUrlEcho view;
+    QDjangoUrlResolver urls;
+    urls.setThreadPool(&pool);
+    QVERIFY(urls.set(QRegExp(QLatin1String("^echo$")), &view, "_q_echo"));
+
+    // the body device is not handed over to the pool
+    QDjangoHttpTestRequest request(QLatin1String("POST"), QLatin1String("/echo"));
+    request.d->meta.insert(QLatin1String("CONTENT_TYPE"), QLatin1String("application/x-www-form-urlencoded"));
+    request.d->buffer = QByteArray("message=bar");
+    QVERIFY(request.bodyDevice() != 0);
+
+    QDjangoHttpResponse *response = urls.respond(request, request.path());
+    QVERIFY(waitForReady(response));
+    QCOMPARE(response->statusCode(), 200);
+    QCOMPARE(response->body(), QByteArray("bar|message=bar"));
+    delete response;
+
+    pool.waitForDone();
+}
+
+void tst_QDjangoUrlResolver::testThreadPoolQueue()
+{
+    QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    tst_QDjangoUrlBlocking view;
+    QDjangoUrlResolver urls;
+    urls.setThreadPool(&pool);
+    QCOMPARE(urls.maximumQueued(), 0);
+    urls.setMaximumQueued(1);
+    QCOMPARE(urls.maximumQueued(), 1);
+    QVERIFY(urls.set(QRegExp(QLatin1String("^slow$")), &view, "_q_respond"));
+
+    // the first request occupies the only thread
+    QDjangoHttpTestRequest request(QLatin1String("GET"), QLatin1String("/slow"));
+    QDjangoHttpResponse *first = urls.respond(request, request.path());
+    view.started.acquire();
+    QVERIFY(!first->isReady());
+
+    // the second request waits for a thread
+    QDjangoHttpResponse *second = urls.respond(request, request.path());
+    QVERIFY(!second->isReady());
+
+    // the third request overflows the queue
+    QDjangoHttpResponse *third = urls.respond(request, request.path());
+    QVERIFY(third->isReady());
+    QCOMPARE(third->statusCode(), 503);
+    delete third;
+
+    view.proceed.release(2);
+    QVERIFY(waitForReady(first));
+    QVERIFY(waitForReady(second));
+    QCOMPARE(first->body(), QByteArray("pool"));
+    QCOMPARE(second->body(), QByteArray("pool"));
+    delete first;
+    delete second;
+
+    pool.waitForDone();
+}
+
+void tst_QDjangoUrlResolver::testThreadPoolStream()
+{
+    QThreadPool pool;
+    tst_QDjangoUrlEcho view;
+    QDjangoUrlResolver urls;
+    urls.setThreadPool(&pool);
+    QVERIFY(urls.set(QRegExp(QLatin1String("^stream$")), &view, "_q_stream"));
+
+    QByteArray expected;
+    for (int i = 0; i < 100; ++i)
+        expected += QByteArray::number(i) + "\n";
+
+    // the stream response's device keeps pulling data from it
+    QDjangoHttpTestRequest request(QLatin1String("GET"), QLatin1String("/stream"));
+    QDjangoHttpResponse *response = urls.respond(request, request.path());
+    QVERIFY(waitForReady(response));
+    QIODevice *device = response->bodyDevice();
+    QVERIFY(device != 0);
+    QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+
+    QByteArray data;
+    while (!device->atEnd())
+        data += device->readAll();
+    QCOMPARE(data, expected);
+    delete response;
+
+    pool.waitForDone();
+}
+
 QDjangoHttpResponse* tst_QDjangoUrlResolver::_q_index(const QDjangoHttpRequest &request)
 {
     Q_UNUSED(request);
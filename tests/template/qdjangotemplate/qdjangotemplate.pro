@@ -0,0 +1,4 @@
+include(../template.pri)
+
+TARGET = tst_qdjangotemplate
+SOURCES += tst_qdjangotemplate.cpp
@@ -0,0 +1,599 @@
+/*
+ * Copyright (C) 2010-2015 Jeremy Lainé
+ * Contact: https://github.com/jlaine/qdjango
+ *
+ * This file is part of the QDjango Library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <QDir>
+#include <QtTest>
+
+#include "QDjangoTemplate.h"
+#include "QDjangoTemplateEngine.h"
+
+/*
+ * The renderer of the http-server example which QDjangoTemplate replaced,
+ * kept as a baseline for the benchmark.
+ */
+static QVariant legacyEvaluate(const QString &input, const QVariantMap &context)
+{
+    const QStringList bits = input.split(".");
+    QVariant value = context;
+    foreach (const QString &bit, bits) {
+        value = value.toMap().value(bit);
+    }
+    return value;
+}
+
+static QString legacySubstitute(const QString &input, const QVariantMap &context)
+{
+    QRegExp valRx("\\{\\{ +([a-z_\\.]+) +\\}\\}");
+
+    QString output;
+    int pos = 0;
+    int lastPos = 0;
+    while ((pos = valRx.indexIn(input, lastPos)) != -1) {
+        output += input.mid(lastPos, pos - lastPos);
+        lastPos = pos + valRx.matchedLength();
+        output += legacyEvaluate(valRx.cap(1), context).toString();
+    }
+    output += input.mid(lastPos);
+    return output;
+}
+
+typedef QPair<bool, QString> LegacyNode;
+
+static QList<LegacyNode> legacyTokenize(const QString &input)
+{
+    QList<LegacyNode> output;
+    QRegExp tagRx("\\{% +([^%]+) +%\\}");
+    int pos = 0;
+    int lastPos = 0;
+    while ((pos = tagRx.indexIn(input, lastPos)) != -1) {
+        if (pos > lastPos)
+            output << qMakePair(false, input.mid(lastPos, pos - lastPos));
+
+        lastPos = pos + tagRx.matchedLength();
+        output << qMakePair(true, tagRx.cap(1));
+    }
+    output << qMakePair(false, input.mid(lastPos));
+    return output;
+}
+
+static int legacyFindBalancing(const QList<LegacyNode> nodes, const QString &closeTag, int pos, int *elsePos = 0)
+{
+    const QString openTag = nodes[pos].second.split(" ").first();
+    int level = 0;
+    if (elsePos)
+        *elsePos = -1;
+    for (pos = pos + 1; pos < nodes.size(); ++pos) {
+        if (nodes[pos].first && nodes[pos].second.startsWith(openTag)) {
+            level++;
+        }
+        else if (nodes[pos].first && nodes[pos].second == closeTag) {
+            if (!level)
+                return pos;
+            level--;
+        } else if (!level && nodes[pos].second == "else") {
+            if (elsePos)
+                *elsePos = pos;
+        }
+    }
+    return -1;
+}
+
+static QString legacyRenderTemplate(const QString &dirPath, const QString &name, const QVariantMap &context);
+
+static QString legacyRender(const QString &dirPath, const QList<LegacyNode> &nodes, const QVariantMap &context)
+{
+    QRegExp forRx("for ([a-z_]+) in ([a-z_\\.]+)");
+    QRegExp includeRx("include \"([^\"]+)\"");
+
+    QString output;
+    for (int i = 0; i < nodes.size(); ++i) {
+        const LegacyNode &node = nodes[i];
+        if (node.first) {
+            QStringList tagArgs = node.second.split(" ");
+            const QString tagName = tagArgs.takeFirst();
+            if (node.second == "comment") {
+                const int endPos = legacyFindBalancing(nodes, "endcomment", i++);
+                if (endPos < 0)
+                    return output;
+                i = endPos;
+            } else if (forRx.exactMatch(node.second)) {
+                const int endPos = legacyFindBalancing(nodes, "endfor", i++);
+                if (endPos < 0)
+                    return output;
+
+                const QVariantList list = legacyEvaluate(forRx.cap(2), context).toList();
+                QVariantMap forLoop;
+                int counter0 = 0;
+                foreach (const QVariant &val, list) {
+                    forLoop.insert("counter", counter0 + 1);
+                    forLoop.insert("counter0", counter0);
+                    if (!counter0)
+                        forLoop.insert("first", true);
+
+                    QVariantMap subContext = context;
+                    subContext.insert(forRx.cap(1), val);
+                    subContext.insert("forloop", forLoop);
+                    output += legacyRender(dirPath, nodes.mid(i, endPos - i), subContext);
+                    counter0++;
+                }
+                i = endPos;
+            } else if (tagName == "if") {
+                int elsePos = -1;
+                const int endPos = legacyFindBalancing(nodes, "endif", i++, &elsePos);
+                if (endPos < 0)
+                    return output;
+
+                bool isTrue = false;
+                QRegExp ifRx("if ([a-z_\\.]+) (!=|==) \"([^\"]*)\"");
+                if (ifRx.exactMatch(node.second)) {
+                    const QVariant value = legacyEvaluate(ifRx.cap(1), context);
+                    const QString op = ifRx.cap(2);
+                    const QString opValue = ifRx.cap(3);
+                    if ((op == "==" && value.toString() == opValue) ||
+                        (op == "!=" && value.toString() != opValue)) {
+                        isTrue = true;
+                    }
+                } else if (tagArgs.size() == 1) {
+                    const QVariant value = legacyEvaluate(tagArgs[0], context);
+                    if (value.toList().size() || value.toMap().size() || value.toString().size())
+                        isTrue = true;
+                }
+                if (isTrue) {
+                    output += legacyRender(dirPath, nodes.mid(i, (elsePos > 0 ? elsePos : endPos) - i), context);
+                } else if (elsePos > 0) {
+                    output += legacyRender(dirPath, nodes.mid(elsePos, endPos - elsePos), context);
+                }
+                i = endPos;
+            } else if (includeRx.exactMatch(node.second)) {
+                output += legacyRenderTemplate(dirPath, includeRx.cap(1), context);
+            }
+        } else {
+            output += legacySubstitute(node.second, context);
+        }
+    }
+    return output;
+}
+
+static QString legacyRenderTemplate(const QString &dirPath, const QString &name, const QVariantMap &context)
+{
+    QFile templ(dirPath + QLatin1Char('/') + name);
+    if (templ.open(QIODevice::ReadOnly)) {
+        const QString data = QString::fromUtf8(templ.readAll());
+        return legacyRender(dirPath, legacyTokenize(data), context);
+    }
+    return QString();
+}
+
+/** Test QDjangoTemplate and QDjangoTemplateEngine classes.
+ */
+class tst_QDjangoTemplate : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+    void cleanupTestCase();
+    void testCompileErrors_data();
+    void testCompileErrors();
+    void testEscape();
+    void testFor();
+    void testIf_data();
+    void testIf();
+    void testIncludeLoop();
+    void testLoadTemplate();
+    void testModified();
+    void testVariable_data();
+    void testVariable();
+    void benchmarkRender_data();
+    void benchmarkRender();
+
+private:
+    QString writeFile(const QString &name, const QByteArray &data);
+
+    QString m_dirPath;
+    QStringList m_files;
+};
+
+void tst_QDjangoTemplate::initTestCase()
+{
+    m_dirPath = QDir::temp().filePath(QLatin1String("tst_qdjangotemplate"));
+    QVERIFY(QDir().mkpath(m_dirPath));
+}
+
+void tst_QDjangoTemplate::cleanup()
+{
+    foreach (const QString &path, m_files)
+        QFile::remove(path);
+    m_files.clear();
+}
+
+void tst_QDjangoTemplate::cleanupTestCase()
+{
+    QDir().rmdir(m_dirPath);
+}
+
+QString tst_QDjangoTemplate::writeFile(const QString &name, const QByteArray &data)
+{
+    const QString path = m_dirPath + QLatin1Char('/') + name;
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return QString();
+    file.write(data);
+    file.close();
+    if (!m_files.contains(path))
+        m_files << path;
+    return path;
+}
+
+void tst_QDjangoTemplate::testCompileErrors_data()
+{
+    QTest::addColumn<QString>("source");
+    QTest::addColumn<QString>("error");
+
+    QTest::newRow("unterminated variable") << "a {{ b" << "Unterminated tag at line 1";
+    QTest::newRow("unterminated tag") << "a\nb {% if c" << "Unterminated tag at line 2";
+    QTest::newRow("invalid variable") << "{{ a b }}" << "Invalid variable 'a b' at line 1";
+    QTest::newRow("unknown filter") << "{{ a|upper }}" << "Unknown filter 'upper' at line 1";
+    QTest::newRow("unknown tag") << "{% cycle a b %}" << "Unknown tag 'cycle' at line 1";
+    QTest::newRow("invalid for") << "{% for a b %}{% endfor %}" << "Invalid tag 'for a b' at line 1";
+    QTest::newRow("invalid if") << "{% if a < b %}{% endif %}" << "Invalid tag 'if a < b' at line 1";
+    QTest::newRow("unclosed for") << "{% for a in b %}" << "Unclosed tag 'for'";
+    QTest::newRow("unclosed comment") << "{% comment %}" << "Unclosed tag 'comment'";
+    QTest::newRow("unexpected endif") << "{% for a in b %}{% endif %}" << "Unexpected tag 'endif' at line 1";
+    QTest::newRow("unexpected else") << "{% for a in b %}{% else %}{% endfor %}" << "Unexpected tag 'else' at line 1";
+    QTest::newRow("duplicate else") << "{% if a %}{% else %}{% else %}{% endif %}" << "Unexpected tag 'else' at line 1";
+}
+
+void tst_QDjangoTemplate::testCompileErrors()
+{
+    QFETCH(QString, source);
+    QFETCH(QString, error);
+
+    const QDjangoTemplate tmpl(source);
+    QCOMPARE(tmpl.isValid(), false);
+    QCOMPARE(tmpl.errorString(), error);
+    QCOMPARE(tmpl.render(QVariantMap()), QByteArray());
+}
+
+void tst_QDjangoTemplate::testEscape()
+{
+    QVariantMap context;
+    context.insert("value", QString::fromUtf8("<a href=\"x\">Tom & Jérôme's</a>"));
+
+    // autoescape is on by default
+    QCOMPARE(QDjangoTemplate("{{ value }}").render(context),
+             QByteArray("&lt;a href=&quot;x&quot;&gt;Tom &amp; J\xc3\xa9r\xc3\xb4me&#39;s&lt;/a&gt;"));
+    QCOMPARE(QDjangoTemplate("{{ value|safe }}").render(context),
+             QByteArray("<a href=\"x\">Tom & J\xc3\xa9r\xc3\xb4me's</a>"));
+
+    // autoescape blocks
+    QCOMPARE(QDjangoTemplate("{% autoescape off %}{{ value }}{% endautoescape %}").render(context),
+             QByteArray("<a href=\"x\">Tom & J\xc3\xa9r\xc3\xb4me's</a>"));
+    QCOMPARE(QDjangoTemplate("{% autoescape off %}{{ value|escape }}{% endautoescape %}{{ value }}").render(context),
+             QByteArray("&lt;a href=&quot;x&quot;&gt;Tom &amp; J\xc3\xa9r\xc3\xb4me&#39;s&lt;/a&gt;"
+                        "&lt;a href=&quot;x&quot;&gt;Tom &amp; J\xc3\xa9r\xc3\xb4me&#39;s&lt;/a&gt;"));
+
+    // text is never escaped
+    QCOMPARE(QDjangoTemplate("<b>&amp;</b>").render(context), QByteArray("<b>&amp;</b>"));
+}
+
+void tst_QDjangoTemplate::testFor()
+{
+    QVariantMap context;
+    context.insert("items", QStringList() << "a" << "b" << "c");
+    context.insert("item", "outer");
+
+    QCOMPARE(QDjangoTemplate("{% for item in items %}{{ item }}{% endfor %}{{ item }}").render(context),
+             QByteArray("abcouter"));
+    QCOMPARE(QDjangoTemplate("{% for item in items %}{{ forloop.counter }}{{ forloop.counter0 }}{{ forloop.revcounter }}{{ forloop.revcounter0 }},{% endfor %}").render(context),
+             QByteArray("1032,2121,3210,"));
+    QCOMPARE(QDjangoTemplate("{% for item in items %}{% if forloop.first %}[{% endif %}{{ item }}{% if not forloop.last %},{% else %}]{% endif %}{% endfor %}").render(context),
+             QByteArray("[a,b,c]"));
+    QCOMPARE(QDjangoTemplate("{% for item in missing %}{{ item }}{% endfor %}").render(context),
+             QByteArray());
+
+    // nested loops
+    QVariantList rows;
+    rows << QVariant(QStringList() << "1" << "2");
+    rows << QVariant(QStringList() << "3");
+    context.insert("rows", rows);
+    QCOMPARE(QDjangoTemplate("{% for row in rows %}{{ forloop.counter }}:{% for cell in row %}{{ cell }}{{ forloop.counter }}{% endfor %};{% endfor %}").render(context),
+             QByteArray("1:1122;2:31;"));
+}
+
+void tst_QDjangoTemplate::testIf_data()
+{
+    QTest::addColumn<QString>("source");
+    QTest::addColumn<QByteArray>("output");
+
+    QTest::newRow("true") << "{% if yes %}a{% endif %}" << QByteArray("a");
+    QTest::newRow("false") << "{% if no %}a{% endif %}" << QByteArray();
+    QTest::newRow("else") << "{% if no %}a{% else %}b{% endif %}" << QByteArray("b");
+    QTest::newRow("not") << "{% if not no %}a{% else %}b{% endif %}" << QByteArray("a");
+    QTest::newRow("missing") << "{% if missing %}a{% else %}b{% endif %}" << QByteArray("b");
+    QTest::newRow("empty string") << "{% if empty %}a{% else %}b{% endif %}" << QByteArray("b");
+    QTest::newRow("zero") << "{% if zero %}a{% else %}b{% endif %}" << QByteArray("b");
+    QTest::newRow("list") << "{% if list %}a{% else %}b{% endif %}" << QByteArray("a");
+    QTest::newRow("empty list") << "{% if empty_list %}a{% else %}b{% endif %}" << QByteArray("b");
+    QTest::newRow("map") << "{% if user %}a{% else %}b{% endif %}" << QByteArray("a");
+    QTest::newRow("equal") << "{% if user.name == \"bob\" %}a{% else %}b{% endif %}" << QByteArray("a");
+    QTest::newRow("equal single quotes") << "{% if user.name == 'bob' %}a{% else %}b{% endif %}" << QByteArray("a");
+    QTest::newRow("not equal") << "{% if user.name != \"bob\" %}a{% else %}b{% endif %}" << QByteArray("b");
+    QTest::newRow("equal number") << "{% if user.age == 42 %}a{% else %}b{% endif %}" << QByteArray("a");
+    QTest::newRow("equal variables") << "{% if user.name == name %}a{% else %}b{% endif %}" << QByteArray("a");
+    QTest::newRow("not equal negated") << "{% if not user.name != \"bob\" %}a{% else %}b{% endif %}" << QByteArray("a");
+    QTest::newRow("nested") << "{% if yes %}{% if no %}a{% else %}b{% endif %}c{% else %}d{% endif %}" << QByteArray("bc");
+}
+
+void tst_QDjangoTemplate::testIf()
+{
+    QFETCH(QString, source);
+    QFETCH(QByteArray, output);
+
+    QVariantMap user;
+    user.insert("name", "bob");
+    user.insert("age", 42);
+
+    QVariantMap context;
+    context.insert("yes", true);
+    context.insert("no", false);
+    context.insert("empty", QString());
+    context.insert("zero", 0);
+    context.insert("list", QVariantList() << 1);
+    context.insert("empty_list", QVariantList());
+    context.insert("user", user);
+    context.insert("name", "bob");
+
+    const QDjangoTemplate tmpl(source);
+    QVERIFY2(tmpl.isValid(), qPrintable(tmpl.errorString()));
+    QCOMPARE(tmpl.render(context), output);
+}
+
+void tst_QDjangoTemplate::testIncludeLoop()
+{
+    writeFile("loop.html", "a{% include \"loop.html\" %}");
+
+    QDjangoTemplateEngine engine;
+    engine.setSearchPaths(QStringList() << m_dirPath);
+    QTest::ignoreMessage(QtWarningMsg, "Could not include template 'loop.html', too many nested includes");
+    QCOMPARE(engine.render("loop.html", QVariantMap()), QByteArray(17, 'a'));
+
+    // without an engine
+    QTest::ignoreMessage(QtWarningMsg, "Could not include template 'loop.html' without a template engine");
+    QCOMPARE(QDjangoTemplate("a{% include \"loop.html\" %}b").render(QVariantMap()), QByteArray("ab"));
+}
+
+void tst_QDjangoTemplate::testLoadTemplate()
+{
+    writeFile("header.html", "<h1>{{ title }}</h1>\n");
+    writeFile("page.html", "{% include \"header.html\" %}{% for item in items %}{% include name %}{% endfor %}");
+    writeFile("item.html", "<p>{{ item }}</p>");
+    writeFile("broken.html", "{% if a %}");
+
+    QVariantMap context;
+    context.insert("title", "Title");
+    context.insert("items", QStringList() << "a" << "b");
+    context.insert("name", "item.html");
+
+    QDjangoTemplateEngine engine;
+    QCOMPARE(engine.searchPaths(), QStringList());
+
+    // names are only looked up in the search paths
+    QTest::ignoreMessage(QtWarningMsg, "Could not find template 'item.html'");
+    QCOMPARE(engine.loadTemplate("item.html").isValid(), false);
+
+    // search paths
+    engine.setSearchPaths(QStringList() << QDir::tempPath() << m_dirPath);
+    QCOMPARE(engine.searchPaths(), QStringList() << QDir::tempPath() << m_dirPath);
+    QCOMPARE(engine.render("page.html", context), QByteArray("<h1>Title</h1>\n<p>a</p><p>b</p>"));
+
+    // compiled templates look up their includes when rendered
+    const QDjangoTemplate tmpl = engine.loadTemplate("page.html");
+    QVERIFY(tmpl.isValid());
+    QCOMPARE(tmpl.render(context), QByteArray("<h1>Title</h1>\n<p>a</p><p>b</p>"));
+    QFile::remove(m_dirPath + "/item.html");
+    QTest::ignoreMessage(QtWarningMsg, "Could not find template 'item.html'");
+    QTest::ignoreMessage(QtWarningMsg, "Could not find template 'item.html'");
+    QCOMPARE(tmpl.render(context), QByteArray("<h1>Title</h1>\n"));
+
+    // missing template
+    QTest::ignoreMessage(QtWarningMsg, "Could not find template 'missing.html'");
+    QCOMPARE(engine.loadTemplate("missing.html").isValid(), false);
+
+    // names cannot escape the search paths, even when they come from the context
+    const QString absolute = m_dirPath + "/header.html";
+    QTest::ignoreMessage(QtWarningMsg, qPrintable(QString("Could not find template '%1'").arg(absolute)));
+    QCOMPARE(engine.loadTemplate(absolute).isValid(), false);
+    const QString relative = QDir(m_dirPath).dirName() + "/../" + QDir(m_dirPath).dirName() + "/header.html";
+    QTest::ignoreMessage(QtWarningMsg, qPrintable(QString("Could not find template '%1'").arg(relative)));
+    QCOMPARE(engine.loadTemplate(relative).isValid(), false);
+    QTest::ignoreMessage(QtWarningMsg, "Could not find template '..\\header.html'");
+    QCOMPARE(engine.loadTemplate("..\\header.html").isValid(), false);
+    context.insert("name", absolute);
+    QTest::ignoreMessage(QtWarningMsg, qPrintable(QString("Could not find template '%1'").arg(absolute)));
+    QTest::ignoreMessage(QtWarningMsg, qPrintable(QString("Could not find template '%1'").arg(absolute)));
+    QCOMPARE(engine.render("page.html", context), QByteArray("<h1>Title</h1>\n"));
+
+    // invalid template
+    QTest::ignoreMessage(QtWarningMsg, qPrintable(QString("Could not compile template '%1/broken.html': Unclosed tag 'if'").arg(m_dirPath)));
+    QCOMPARE(engine.loadTemplate("broken.html").isValid(), false);
+    QCOMPARE(engine.loadTemplate("broken.html").errorString(), QString("Unclosed tag 'if'"));
+}
+
+void tst_QDjangoTemplate::testModified()
+{
+    const QString path = writeFile("modified.html", "first {{ value }}");
+
+    QVariantMap context;
+    context.insert("value", "version");
+
+    QDjangoTemplateEngine engine;
+    engine.setSearchPaths(QStringList() << m_dirPath);
+    QCOMPARE(engine.render("modified.html", context), QByteArray("first version"));
+
+    // rewrite the file until its modification time changes
+    const QDateTime modified = QFileInfo(path).lastModified();
+    for (int i = 0; i < 30 && QFileInfo(path).lastModified() == modified; ++i) {
+        QTest::qWait(100);
+        writeFile("modified.html", "second {{ value }}");
+    }
+    QVERIFY(QFileInfo(path).lastModified() != modified);
+    QCOMPARE(engine.render("modified.html", context), QByteArray("second version"));
+
+    // clearing the cache
+    engine.clearCache();
+    QCOMPARE(engine.render("modified.html", context), QByteArray("second version"));
+}
+
+void tst_QDjangoTemplate::testVariable_data()
+{
+    QTest::addColumn<QString>("source");
+    QTest::addColumn<QByteArray>("output");
+
+    QTest::newRow("empty") << "" << QByteArray();
+    QTest::newRow("text") << "hello\nworld" << QByteArray("hello\nworld");
+    QTest::newRow("string") << "hello {{ name }}!" << QByteArray("hello bob!");
+    QTest::newRow("no spaces") << "hello {{name}}!" << QByteArray("hello bob!");
+    QTest::newRow("unicode") << QString::fromUtf8("{{ unicode }} é") << QByteArray("\xc3\xa9t\xc3\xa9 \xc3\xa9");
+    QTest::newRow("number") << "{{ number }}" << QByteArray("42");
+    QTest::newRow("missing") << "[{{ missing }}]" << QByteArray("[]");
+    QTest::newRow("map") << "{{ user.name }}" << QByteArray("alice");
+    QTest::newRow("missing key") << "[{{ user.missing.key }}]" << QByteArray("[]");
+    QTest::newRow("hash") << "{{ hash.key }}" << QByteArray("value");
+    QTest::newRow("list index") << "{{ list.1 }}" << QByteArray("b");
+    QTest::newRow("list out of range") << "[{{ list.5 }}]" << QByteArray("[]");
+    QTest::newRow("object") << "{{ object.objectName }}" << QByteArray("object");
+    QTest::newRow("literal") << "{{ \"x\" }}{{ 12 }}" << QByteArray("x12");
+    QTest::newRow("comment") << "a{# {{ name }} #}b" << QByteArray("ab");
+    QTest::newRow("comment block") << "a{% comment %}{{ name }}{% comment %}{% if %}{% endcomment %}{% endcomment %}b" << QByteArray("ab");
+    QTest::newRow("braces") << "{ a } {x}" << QByteArray("{ a } {x}");
+}
+
+void tst_QDjangoTemplate::testVariable()
+{
+    QFETCH(QString, source);
+    QFETCH(QByteArray, output);
+
+    QObject object;
+    object.setObjectName("object");
+
+    QVariantMap user;
+    user.insert("name", "alice");
+
+    QVariantHash hash;
+    hash.insert("key", "value");
+
+    QVariantMap context;
+    context.insert("name", "bob");
+    context.insert("unicode", QString::fromUtf8("été"));
+    context.insert("number", 42);
+    context.insert("user", user);
+    context.insert("hash", hash);
+    context.insert("list", QStringList() << "a" << "b");
+    context.insert("object", QVariant::fromValue<QObject*>(&object));
+
+    const QDjangoTemplate tmpl(source);
+    QVERIFY2(tmpl.isValid(), qPrintable(tmpl.errorString()));
+    QCOMPARE(tmpl.render(context), output);
+
+    // copies share the compiled template
+    const QDjangoTemplate copy = tmpl;
+    QCOMPARE(copy.render(context), output);
+}
+
+void tst_QDjangoTemplate::benchmarkRender_data()
+{
+    QTest::addColumn<bool>("legacy");
+
+    QTest::newRow("legacy") << true;
+    QTest::newRow("compiled") << false;
+}
+
+void tst_QDjangoTemplate::benchmarkRender()
+{
+    QFETCH(bool, legacy);
+
+    // the change list of the http-server example, without escaping
+    writeFile("header.html",
+        "<html>\n<head>\n    <title>{{ title }} | Test application</title>\n"
+        "{% comment %}\ntest\n{% endcomment %}\n</head>\n<body>\n<div class=\"breadcrumbs\">\n"
+        "{% if model_name %}\n    <a href=\"/\">Home</a> &rsaquo;\n    {{ model_name }}\n{% else %}\n    Home\n{% endif %}\n"
+        "</div>\n<h1>{{ title }}</h1>\n");
+    writeFile("footer.html", "</body>\n</html>\n");
+    writeFile("change_list.html",
+        "{% include \"header.html\" %}\n"
+        "<ul class=\"object-tools\">\n    <li><a href=\"add/\">{{ add_link }}</a></li>\n</ul>\n"
+        "<table>\n        <tr>\n"
+        "{% for field in field_list %}\n            <th>{{ field.name }}</th>\n{% endfor %}\n"
+        "        </tr>\n"
+        "{% for object in object_list %}\n        <tr id=\"{{ forloop.counter }}\">\n"
+        "{% for value in object.value_list %}\n"
+        "            <td>{% if forloop.counter == \"1\" %}<a href=\"{{ object.pk }}/\">{{ value }}</a>{% else %}{{ value }}{% endif %}</td>\n"
+        "{% endfor %}\n"
+        "            <td><a href=\"{{ object.pk }}/delete/\">{{ delete_link }}</a></td>\n"
+        "        </tr>\n"
+        "{% endfor %}\n"
+        "</table>\n"
+        "{% include \"footer.html\" %}\n");
+
+    QVariantList fieldList;
+    const QStringList fieldNames = QStringList() << "username" << "email" << "first_name" << "last_name";
+    foreach (const QString &name, fieldNames) {
+        QVariantMap field;
+        field.insert("key", name);
+        field.insert("name", name);
+        fieldList << field;
+    }
+
+    QVariantList objectList;
+    for (int i = 0; i < 100; ++i) {
+        QVariantMap object;
+        object.insert("pk", i + 1);
+        object.insert("value_list", QVariantList() << QString("user%1").arg(i) << QString("user%1_example.com").arg(i) << "first" << "last");
+        objectList << object;
+    }
+
+    QVariantMap context;
+    context.insert("title", "Select user to change");
+    context.insert("add_link", "Add user");
+    context.insert("delete_link", "Remove");
+    context.insert("model_name", "user");
+    context.insert("field_list", fieldList);
+    context.insert("object_list", objectList);
+
+    // both renderers produce the same output
+    QDjangoTemplateEngine engine;
+    engine.setSearchPaths(QStringList() << m_dirPath);
+    const QByteArray expected = legacyRenderTemplate(m_dirPath, "change_list.html", context).toUtf8();
+    QCOMPARE(engine.render("change_list.html", context), expected);
+
+    QByteArray output;
+    if (legacy) {
+        QBENCHMARK {
+            output = legacyRenderTemplate(m_dirPath, "change_list.html", context).toUtf8();
+        }
+    } else {
+        QBENCHMARK {
+            output = engine.render("change_list.html", context);
+        }
+    }
+    QCOMPARE(output, expected);
+}
+
+QTEST_MAIN(tst_QDjangoTemplate)
+#include "tst_qdjangotemplate.moc"
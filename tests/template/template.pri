@@ -0,0 +1,3 @@
+include(../tests.pri)
+
+LIBS += -L../../../src/template $$QDJANGO_TEMPLATE_LIBS
@@ -5,5 +5,5 @@ QT += testlib
 CONFIG -= app_bundle
 CONFIG += testcase
 
-QMAKE_RPATHDIR += $$OUT_PWD/../../../src/db $$OUT_PWD/../../../src/http
+QMAKE_RPATHDIR += $$OUT_PWD/../../../src/db $$OUT_PWD/../../../src/http $$OUT_PWD/../../../src/template
 INCLUDEPATH += $$PWD $$QDJANGO_INCLUDEPATH
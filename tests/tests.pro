@@ -1,2 +1,2 @@
 TEMPLATE = subdirs
-SUBDIRS = db http
+SUBDIRS = db http template